@@ -2,7 +2,12 @@
 #include "framework/FrameResource.h"
 #include "framework/GeometryGenerator.h"
 #include "framework/DDSTextureLoader.h"
+#include "framework/TextureArrayPacker.h"
+#include "framework/CompressedTexture.h"
+#include "framework/TextureBatchLoader.h"
+#include "framework/DrawKey.h"
 #include "Waves.h"
+#include <filesystem>
 
 const int gNumFrameResources = 3;
 
@@ -47,6 +52,7 @@ enum class RenderLayer : int
     Opaque = 0,
     Transparent = 1,
     AlphaTested = 2,
+    Flipbook = 3,
     Count
 };
 
@@ -71,6 +77,7 @@ private:
     void BuildCrateGeometry();
     void BuildLandGeometry();
     void BuildWavesGeometry();
+    void BuildBoltGeometry();
     void BuildMaterials();
     void BuildRenderItems();
     void BuildFrameResources();
@@ -82,6 +89,11 @@ private:
     void UpdateMainPassCB(const GameTimer& gt);
     void UpdateSunPosition(const GameTimer& gt);
     void UpdateWaves(const GameTimer& gt);   
+    // Puts the transparent layer back to front, starting from the previous frame's order.
+    void SortTransparentItems();
+    // True when the view jumped or turned enough since the last call to reorder most of
+    // the blended items.
+    bool DetectCameraCut();
 
     void DrawRenderItems(const std::vector<RenderItem*>& ritems);
 
@@ -105,6 +117,13 @@ private:
     // Render items divided by PSO.
     std::vector<RenderItem*> mRitemLayer[(int)RenderLayer::Count];
 
+    // Kept from frame to frame so sorting doesn't allocate.
+    DrawKeySorter mDrawKeySorter;
+    XMFLOAT3 mLastSortEye = { 0.f, 0.f, 0.f };
+    XMFLOAT3 mLastSortForward = { 0.f, 0.f, 0.f };
+    std::vector<DrawEntry> mDrawEntries;
+    std::vector<RenderItem*> mSortScratch;
+
     // FrameResource and RenderItem own the same dynamic vertex buffer.
     // Unlike other render items, it is updated each frame, so should be saved as a reference.
     RenderItem* mWavesRitem = nullptr;
@@ -149,6 +168,7 @@ bool BlendApp::Initialize()
     BuildCrateGeometry();
     BuildLandGeometry();
     BuildWavesGeometry();
+    BuildBoltGeometry();
     BuildMaterials();
     BuildRenderItems();
     BuildFrameResources();
@@ -208,6 +228,7 @@ void BlendApp::Update(const GameTimer& gt)
     UpdateMaterialCBs(gt);
     UpdateSunPosition(gt);
     UpdateWaves(gt);
+    SortTransparentItems();
 }
 
 void BlendApp::Draw(const GameTimer& gt)
@@ -267,6 +288,13 @@ void BlendApp::Draw(const GameTimer& gt)
     mCommandList->SetPipelineState(mPSOs["transparent"].Get());
     DrawRenderItems(mRitemLayer[(int)RenderLayer::Transparent]);
 
+    //
+    // Additive flipbook effects last, they don't write depth.
+    //
+
+    mCommandList->SetPipelineState(mPSOs["flipbook"].Get());
+    DrawRenderItems(mRitemLayer[(int)RenderLayer::Flipbook]);
+
     // Indicate a state transition on the resource usage.
     mCommandList->ResourceBarrier(1,
         &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
@@ -303,36 +331,59 @@ void BlendApp::LoadTexture()
     auto wireFenceTex = std::make_unique<Texture>();
     wireFenceTex->Name = "wireFenceTex";
     wireFenceTex->Filename = L"textures/WireFence.dds";
-    CreateDDSTextureFromFile12(
-        md3dDevice.Get(),
-        mCommandList.Get(),
-        wireFenceTex->Filename.c_str(),
-        wireFenceTex->Resource,
-        wireFenceTex->UploadHeap) >> chk;
 
     auto grassTex = std::make_unique<Texture>();
     grassTex->Name = "grassTex";
     grassTex->Filename = L"textures/grass.dds";
-    CreateDDSTextureFromFile12(
-        md3dDevice.Get(),
-        mCommandList.Get(),
-        grassTex->Filename.c_str(),
-        grassTex->Resource,
-        grassTex->UploadHeap) >> chk;
 
     auto waterTex = std::make_unique<Texture>();
     waterTex->Name = "waterTex";
     waterTex->Filename = L"textures/water1.dds";
-    CreateDDSTextureFromFile12(
-        md3dDevice.Get(),
-        mCommandList.Get(),
-        waterTex->Filename.c_str(),
-        waterTex->Resource,
-        waterTex->UploadHeap) >> chk;    
+
+    // The 60 bolt frames are packed into one Texture2DArray. The packed array is cached
+    // as a compressed DDS (.ddz, CompressedTexture.h) and loaded with the other textures
+    // afterwards; delete it to repack from the bitmaps.
+    auto boltTex = std::make_unique<Texture>();
+    boltTex->Name = "boltTex";
+    boltTex->Filename = L"textures/BoltAnim.ddz";
+
+    // The files are read, parsed and uploaded as one pipelined batch.
+    std::vector<Texture*> batch = { wireFenceTex.get(), grassTex.get(), waterTex.get() };
+    if (std::filesystem::exists(boltTex->Filename))
+    {
+        batch.push_back(boltTex.get());
+    }
+    else
+    {
+        std::vector<BmpImage> frames;
+        LoadBmpSequence(L"textures/BoltAnim/Bolt", 1, 60, frames) >> chk;
+
+        TextureArrayPackOptions options;
+        options.GenerateMips = true;
+        options.CompressBC1 = true;
+
+        PackedTextureArray packed;
+        PackTextureArray(frames, options, packed) >> chk;
+
+        // The container is made from a DDS file, which is only needed until then.
+        const wchar_t* packedFileName = L"textures/BoltAnim.dds";
+        SaveTextureArrayToDDS(packedFileName, packed) >> chk;
+        CompressDDSTextureFile(packedFileName, boltTex->Filename.c_str()) >> chk;
+        std::filesystem::remove(packedFileName);
+
+        CreateTextureArray12(
+            md3dDevice.Get(),
+            mCommandList.Get(),
+            packed,
+            boltTex->Resource,
+            boltTex->UploadHeap) >> chk;
+    }
+    CreateDDSTexturesFromFiles12(md3dDevice.Get(), mCommandList.Get(), batch) >> chk;
 
     mTextures[wireFenceTex->Name] = std::move(wireFenceTex);
     mTextures[grassTex->Name] = std::move(grassTex);
     mTextures[waterTex->Name] = std::move(waterTex);
+    mTextures[boltTex->Name] = std::move(boltTex);
 }
 
 void BlendApp::BuildRootSignature()
@@ -395,7 +446,7 @@ void BlendApp::BuildDescriptorHeaps()
     // Create the SRV heap.
     //
     D3D12_DESCRIPTOR_HEAP_DESC srvHeapDesc = {};
-    srvHeapDesc.NumDescriptors = 3;
+    srvHeapDesc.NumDescriptors = 4;
     srvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
     srvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
     md3dDevice->CreateDescriptorHeap(&srvHeapDesc, IID_PPV_ARGS(&mSrvHeap)) >> chk;
@@ -409,6 +460,7 @@ void BlendApp::BuildDescriptorHeaps()
     const auto& wireFenceTex = mTextures["wireFenceTex"]->Resource;
     const auto& grassTex = mTextures["grassTex"]->Resource;
     const auto& waterTex = mTextures["waterTex"]->Resource;
+    const auto& boltTex = mTextures["boltTex"]->Resource;
 
     D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
     srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
@@ -429,6 +481,19 @@ void BlendApp::BuildDescriptorHeaps()
     srvDesc.Texture2D.MipLevels = waterTex->GetDesc().MipLevels;
     hDescriptor.Offset(1, mCbvSrvUavDescriptorSize);    // next descriptor
     md3dDevice->CreateShaderResourceView(waterTex.Get(), &srvDesc, hDescriptor);
+
+    // The flipbook is viewed as a whole array, the shader selects the slice.
+    D3D12_SHADER_RESOURCE_VIEW_DESC arraySrvDesc = {};
+    arraySrvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+    arraySrvDesc.Format = boltTex->GetDesc().Format;
+    arraySrvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2DARRAY;
+    arraySrvDesc.Texture2DArray.MostDetailedMip = 0;
+    arraySrvDesc.Texture2DArray.MipLevels = boltTex->GetDesc().MipLevels;
+    arraySrvDesc.Texture2DArray.FirstArraySlice = 0;
+    arraySrvDesc.Texture2DArray.ArraySize = boltTex->GetDesc().DepthOrArraySize;
+    arraySrvDesc.Texture2DArray.ResourceMinLODClamp = 0.0f;
+    hDescriptor.Offset(1, mCbvSrvUavDescriptorSize);    // next descriptor
+    md3dDevice->CreateShaderResourceView(boltTex.Get(), &arraySrvDesc, hDescriptor);
 }
 
 void BlendApp::BuildShadersAndInputLayout()
@@ -444,6 +509,11 @@ void BlendApp::BuildShadersAndInputLayout()
         NULL, NULL
     };
 
+    const D3D_SHADER_MACRO flipbookDefines[] = {
+        "FLIPBOOK", "1",
+        NULL, NULL
+    };
+
     mInputLayout =
     {
         {   "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0,
@@ -457,6 +527,7 @@ void BlendApp::BuildShadersAndInputLayout()
     mShaders["standardVS"] = d3dUtil::CompileShader(L"shader/Default.hlsl", nullptr, "VS", "vs_5_0");
     mShaders["opaquePS"] = d3dUtil::CompileShader(L"shader/Default.hlsl", defines, "PS", "ps_5_0");
     mShaders["alphaTestedPS"] = d3dUtil::CompileShader(L"shader/Default.hlsl", alphaTestedDefines, "PS", "ps_5_0");
+    mShaders["flipbookPS"] = d3dUtil::CompileShader(L"shader/Default.hlsl", flipbookDefines, "PS", "ps_5_0");
 }
 
 void BlendApp::BuildCrateGeometry()
@@ -621,6 +692,55 @@ void BlendApp::BuildWavesGeometry()
     mGeometries[geo->Name] = std::move(geo);
 }
 
+void BlendApp::BuildBoltGeometry()
+{
+    // An open cylinder the bolt animation wraps around.
+    GeometryGenerator geoGen;
+    GeometryGenerator::MeshData cylinder = geoGen.CreateCylinder(2.5f, 2.5f, 10.0f, 32, 1);
+
+    std::vector<Vertex> vertices(cylinder.Vertices.size());
+    for (size_t i = 0; i < cylinder.Vertices.size(); ++i)
+    {
+        vertices[i].Pos = cylinder.Vertices[i].Position;
+        vertices[i].Normal = cylinder.Vertices[i].Normal;
+        vertices[i].TexC = cylinder.Vertices[i].TexC;
+    }
+
+    std::vector<std::uint16_t> indices = cylinder.GetIndices16();
+
+    const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
+    const UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint16_t);
+
+    auto geo = std::make_unique<MeshGeometry>();
+    geo->Name = "boltGeo";
+
+    D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU) >> chk;
+    CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
+
+    D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU) >> chk;
+    CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
+
+    geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
+        mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
+
+    geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
+        mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
+
+    geo->VertexByteStride = sizeof(Vertex);
+    geo->VertexBufferByteSize = vbByteSize;
+    geo->IndexFormat = DXGI_FORMAT_R16_UINT;
+    geo->IndexBufferByteSize = ibByteSize;
+
+    SubmeshGeometry submesh;
+    submesh.IndexCount = (UINT)indices.size();
+    submesh.StartIndexLocation = 0;
+    submesh.BaseVertexLocation = 0;
+
+    geo->DrawArgs["cylinder"] = submesh;
+
+    mGeometries[geo->Name] = std::move(geo);
+}
+
 void BlendApp::BuildMaterials()
 {
     auto wireFence = std::make_unique<Material>();
@@ -649,9 +769,21 @@ void BlendApp::BuildMaterials()
     water->FresnelR0 = XMFLOAT3(0.2f, 0.2f, 0.2f);
     water->Roughness = 0.f;
 
+    // One material plays all 60 frames of the bolt array at 30 fps.
+    auto bolt = std::make_unique<Material>();
+    bolt->Name = "bolt";
+    bolt->MatCBIndex = 3;
+    bolt->DiffuseSrvHeapIndex = 3;
+    bolt->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
+    bolt->FresnelR0 = XMFLOAT3(0.0f, 0.0f, 0.0f);
+    bolt->Roughness = 1.0f;
+    bolt->FlipbookFrameCount = 60;
+    bolt->FlipbookFramesPerSecond = 30.0f;
+
     mMaterials[wireFence->Name] = std::move(wireFence);
     mMaterials[grass->Name] = std::move(grass);
     mMaterials[water->Name] = std::move(water);
+    mMaterials[bolt->Name] = std::move(bolt);
 }
 
 void BlendApp::BuildRenderItems()
@@ -693,13 +825,30 @@ void BlendApp::BuildRenderItems()
 
     mWavesRitem = wavesRitem.get();
 
+    auto boltRitem = std::make_unique<RenderItem>();
+    XMStoreFloat4x4(&boltRitem->World, XMMatrixTranslation(-8.0f, 5.0f, -9.0f));
+    XMStoreFloat4x4(&boltRitem->TexTransform, XMMatrixScaling(2.f, 1.f, 1.f));
+    boltRitem->ObjCBIndex = 3;
+    boltRitem->Geo = mGeometries["boltGeo"].get();
+    boltRitem->Mat = mMaterials["bolt"].get();
+    boltRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+    SubmeshGeometry boltSubmesh = boltRitem->Geo->DrawArgs["cylinder"];
+    boltRitem->IndexCount = boltSubmesh.IndexCount;
+    boltRitem->StartIndexLocation = boltSubmesh.StartIndexLocation;
+    boltRitem->BaseVertexLocation = boltSubmesh.BaseVertexLocation;
+
     mRitemLayer[(int)RenderLayer::AlphaTested].push_back(boxRitem.get());
     mRitemLayer[(int)RenderLayer::Opaque].push_back(landRitem.get());
     mRitemLayer[(int)RenderLayer::Transparent].push_back(wavesRitem.get());
+    mRitemLayer[(int)RenderLayer::Flipbook].push_back(boltRitem.get());
 
     mAllRitems.push_back(std::move(boxRitem));
     mAllRitems.push_back(std::move(landRitem));
     mAllRitems.push_back(std::move(wavesRitem));
+    mAllRitems.push_back(std::move(boltRitem));
+
+    mDrawEntries.reserve(mRitemLayer[(int)RenderLayer::Transparent].size());
+    mSortScratch.reserve(mRitemLayer[(int)RenderLayer::Transparent].size());
 }
 
 void BlendApp::BuildFrameResources()
@@ -779,6 +928,22 @@ void BlendApp::BuildPSOs()
     md3dDevice->CreateGraphicsPipelineState(&alphaTestedPsoDesc, 
         IID_PPV_ARGS(&mPSOs["alphaTested"])) >> chk;
 
+    //
+    // PSO for additive flipbook effects, seen from both sides and not writing depth.
+    //
+
+    D3D12_GRAPHICS_PIPELINE_STATE_DESC flipbookPsoDesc = transparentPsoDesc;
+    flipbookPsoDesc.PS = {
+        reinterpret_cast<BYTE*>(mShaders["flipbookPS"]->GetBufferPointer()),
+        mShaders["flipbookPS"]->GetBufferSize() };
+    flipbookPsoDesc.BlendState.RenderTarget[0].SrcBlend = D3D12_BLEND_ONE;
+    flipbookPsoDesc.BlendState.RenderTarget[0].DestBlend = D3D12_BLEND_ONE;
+    flipbookPsoDesc.RasterizerState.CullMode = D3D12_CULL_MODE_NONE;
+    flipbookPsoDesc.DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ZERO;
+
+    md3dDevice->CreateGraphicsPipelineState(&flipbookPsoDesc,
+        IID_PPV_ARGS(&mPSOs["flipbook"])) >> chk;
+
     //
     // PSO for opaque wireframe objects.
     //
@@ -849,6 +1014,8 @@ void BlendApp::UpdateMaterialCBs(const GameTimer& gt)
 
             XMMATRIX matTransform = XMLoadFloat4x4(&mat->MatTransform);
             XMStoreFloat4x4(&matConstants.MatTransform, XMMatrixTranspose(matTransform));
+            matConstants.FlipbookFrameCount = mat->FlipbookFrameCount;
+            matConstants.FlipbookFramesPerSecond = mat->FlipbookFramesPerSecond;
 
             currMaterialCB->CopyData(mat->MatCBIndex, matConstants);
 
@@ -953,6 +1120,57 @@ void BlendApp::UpdateWaves(const GameTimer& gt)
     mWavesRitem->Geo->VertexBufferGPU = currWavesVB->Resource();
 }
 
+void BlendApp::SortTransparentItems()
+{
+    // Blended surfaces go back to front, by the view depth of their origin: the meshes
+    // here are built around it. The layer keeps the previous frame's order, nearly right
+    // unless the camera jumped, which is sorted from scratch.
+    std::vector<RenderItem*>& ritems = mRitemLayer[(int)RenderLayer::Transparent];
+
+    mDrawEntries.clear();
+    for (UINT i = 0; i < (UINT)ritems.size(); ++i)
+    {
+        const RenderItem* ri = ritems[i];
+        const XMVECTOR origin = XMVectorSet(ri->World._41, ri->World._42, ri->World._43, 1.f);
+        const float depth = XMVectorGetZ(XMVector3TransformCoord(origin, mView));
+        mDrawEntries.push_back({ DrawKey::BackToFront((uint32_t)RenderLayer::Transparent, 0, 0, ri->Mat->MatCBIndex, depth), i });
+    }
+    if (DetectCameraCut())
+    {
+        mDrawKeySorter.Sort(mDrawEntries);
+    }
+    else
+    {
+        mDrawKeySorter.SortCoherent(mDrawEntries);
+    }
+
+    mSortScratch.assign(ritems.begin(), ritems.end());
+    for (size_t i = 0; i < mDrawEntries.size(); ++i)
+    {
+        ritems[i] = mSortScratch[mDrawEntries[i].Item];
+    }
+}
+
+bool BlendApp::DetectCameraCut()
+{
+    // Thresholds in world units and in the cosine of the turn, about 25 degrees.
+    constexpr float maxEyeMove = 2.f;
+    constexpr float minForwardDot = 0.9f;
+
+    XMFLOAT4X4 view;
+    XMStoreFloat4x4(&view, mView);
+    const XMVECTOR forward = XMVectorSet(view._13, view._23, view._33, 0.f);
+    const XMVECTOR eye = XMLoadFloat3(&mMainPassCB.EyePosW);
+
+    const bool cut =
+        XMVectorGetX(XMVector3Length(XMVectorSubtract(eye, XMLoadFloat3(&mLastSortEye)))) > maxEyeMove ||
+        XMVectorGetX(XMVector3Dot(forward, XMLoadFloat3(&mLastSortForward))) < minForwardDot;
+
+    XMStoreFloat3(&mLastSortEye, eye);
+    XMStoreFloat3(&mLastSortForward, forward);
+    return cut;
+}
+
 void BlendApp::DrawRenderItems(const std::vector<RenderItem*>& ritems)
 {
     UINT objCBByteSize = d3dUtil::CalculateConstantBufferByteSize(
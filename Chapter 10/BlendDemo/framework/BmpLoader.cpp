@@ -0,0 +1,219 @@
+#include "BmpLoader.h"
+#include <bit>
+
+namespace
+{
+    struct ChannelMask
+    {
+        uint32_t Mask = 0;
+        uint32_t Shift = 0;
+        uint32_t Max = 0;
+
+        ChannelMask() = default;
+        explicit ChannelMask(uint32_t mask) :
+            Mask(mask)
+        {
+            if (mask != 0)
+            {
+                Shift = (uint32_t)std::countr_zero(mask);
+                Max = mask >> Shift;
+            }
+        }
+
+        uint8_t Extract(uint32_t pixel, uint8_t fallback) const
+        {
+            if (Mask == 0) { return fallback; }
+            // In 64 bits, a channel wider than 24 bits times 255 doesn't fit in 32.
+            const uint64_t value = (pixel & Mask) >> Shift;
+            return (uint8_t)((value * 255u + Max / 2) / Max);
+        }
+    };
+}
+
+HRESULT LoadBmpFromMemory(const uint8_t* bmpData, size_t bmpDataSize, BmpImage& image)
+{
+    if (!bmpData)
+    {
+        return E_POINTER;
+    }
+
+    if (bmpDataSize < sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER))
+    {
+        return E_FAIL;
+    }
+
+    BITMAPFILEHEADER fileHeader;
+    BITMAPINFOHEADER infoHeader;
+    memcpy(&fileHeader, bmpData, sizeof(fileHeader));
+    memcpy(&infoHeader, bmpData + sizeof(fileHeader), sizeof(infoHeader));
+
+    // Bitmaps always start with "BM".
+    if (fileHeader.bfType != 0x4D42 || infoHeader.biSize < sizeof(BITMAPINFOHEADER))
+    {
+        return E_FAIL;
+    }
+
+    if (infoHeader.biWidth <= 0 || infoHeader.biHeight == 0 || infoHeader.biPlanes != 1)
+    {
+        return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+    }
+
+    const UINT bpp = infoHeader.biBitCount;
+    const bool isBitfields = infoHeader.biCompression == BI_BITFIELDS;
+    if (!((infoHeader.biCompression == BI_RGB && (bpp == 8 || bpp == 24 || bpp == 32)) ||
+        (isBitfields && bpp == 32)))
+    {
+        return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+    }
+
+    // Positive height means the rows are stored bottom-up.
+    const bool bottomUp = infoHeader.biHeight > 0;
+    const UINT width = (UINT)infoHeader.biWidth;
+    const UINT height = (UINT)(bottomUp ? infoHeader.biHeight : -infoHeader.biHeight);
+
+    // Every row is padded to a multiple of 4 bytes.
+    const size_t srcRowPitch = (((size_t)width * bpp + 31) / 32) * 4;
+    if (fileHeader.bfOffBits > bmpDataSize ||
+        srcRowPitch * height > bmpDataSize - fileHeader.bfOffBits)
+    {
+        return HRESULT_FROM_WIN32(ERROR_HANDLE_EOF);
+    }
+
+    // The color masks directly follow a BITMAPINFOHEADER; in the V4/V5 headers they are
+    // members at the same offset, so the same read covers both.
+    const size_t maskOffset = sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER);
+    ChannelMask r(0x00ff0000), g(0x0000ff00), b(0x000000ff), a;
+    if (isBitfields)
+    {
+        if (maskOffset + 3 * sizeof(uint32_t) > bmpDataSize)
+        {
+            return E_FAIL;
+        }
+
+        uint32_t masks[4] = {};
+        const size_t maskCount = infoHeader.biSize >= 56 ? 4 : 3;
+        memcpy(masks, bmpData + maskOffset, maskCount * sizeof(uint32_t));
+        r = ChannelMask(masks[0]);
+        g = ChannelMask(masks[1]);
+        b = ChannelMask(masks[2]);
+        a = ChannelMask(masks[3]);
+    }
+
+    // Palette of RGBQUADs for 8-bit images.
+    const RGBQUAD* palette = nullptr;
+    UINT paletteSize = 0;
+    if (bpp == 8)
+    {
+        const size_t paletteOffset = sizeof(BITMAPFILEHEADER) + infoHeader.biSize;
+        paletteSize = infoHeader.biClrUsed ? infoHeader.biClrUsed : 256u;
+        if (paletteSize > 256 || paletteOffset + paletteSize * sizeof(RGBQUAD) > bmpDataSize)
+        {
+            return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+        }
+        palette = reinterpret_cast<const RGBQUAD*>(bmpData + paletteOffset);
+    }
+
+    image.Width = width;
+    image.Height = height;
+    image.Pixels.resize((size_t)width * height * 4);
+
+    const uint8_t* srcBits = bmpData + fileHeader.bfOffBits;
+    for (UINT y = 0; y < height; ++y)
+    {
+        const uint8_t* src = srcBits + (bottomUp ? (height - 1 - y) : y) * srcRowPitch;
+        uint8_t* dst = &image.Pixels[(size_t)y * image.RowPitch()];
+
+        for (UINT x = 0; x < width; ++x, dst += 4)
+        {
+            switch (bpp)
+            {
+            case 8:
+            {
+                const UINT index = src[x] < paletteSize ? src[x] : 0u;
+                dst[0] = palette[index].rgbRed;
+                dst[1] = palette[index].rgbGreen;
+                dst[2] = palette[index].rgbBlue;
+                dst[3] = 255;
+            } break;
+
+            case 24:
+                // Stored as B, G, R.
+                dst[0] = src[3 * x + 2];
+                dst[1] = src[3 * x + 1];
+                dst[2] = src[3 * x + 0];
+                dst[3] = 255;
+                break;
+
+            case 32:
+            {
+                uint32_t pixel;
+                memcpy(&pixel, src + 4 * x, sizeof(pixel));
+                dst[0] = r.Extract(pixel, 0);
+                dst[1] = g.Extract(pixel, 0);
+                dst[2] = b.Extract(pixel, 0);
+                // BI_RGB 32-bit bitmaps leave the high byte unused.
+                dst[3] = a.Extract(pixel, 255);
+            } break;
+            }
+        }
+    }
+
+    return S_OK;
+}
+
+HRESULT LoadBmpFromFile(const wchar_t* filename, BmpImage& image)
+{
+    if (!filename)
+    {
+        return E_INVALIDARG;
+    }
+
+    std::ifstream fin(filename, std::ios::binary);
+    if (!fin)
+    {
+        return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+    }
+
+    fin.seekg(0, std::ios_base::end);
+    const size_t size = (size_t)fin.tellg();
+    fin.seekg(0, std::ios_base::beg);
+
+    std::vector<uint8_t> bmpData(size);
+    fin.read((char*)bmpData.data(), size);
+    if ((size_t)fin.gcount() != size)
+    {
+        return E_FAIL;
+    }
+
+    return LoadBmpFromMemory(bmpData.data(), bmpData.size(), image);
+}
+
+HRESULT LoadBmpSequence(
+    const std::wstring& prefix,
+    UINT firstIndex,
+    UINT frameCount,
+    std::vector<BmpImage>& frames)
+{
+    frames.clear();
+    frames.resize(frameCount);
+
+    for (UINT i = 0; i < frameCount; ++i)
+    {
+        const std::wstring filename = std::format(L"{}{:03}.bmp", prefix, firstIndex + i);
+
+        HRESULT hr = LoadBmpFromFile(filename.c_str(), frames[i]);
+        if (FAILED(hr))
+        {
+            frames.clear();
+            return hr;
+        }
+
+        if (frames[i].Width != frames[0].Width || frames[i].Height != frames[0].Height)
+        {
+            frames.clear();
+            return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+        }
+    }
+
+    return S_OK;
+}
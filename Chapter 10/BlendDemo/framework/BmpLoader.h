@@ -0,0 +1,36 @@
+#pragma once
+
+#include "d3dUtil.h"
+
+// A decoded bitmap. Whatever the layout on disk (bottom-up or top-down, palettized,
+// 24-bit or 32-bit), pixels are stored top-down as tightly packed R8G8B8A8 so that
+// they can be handed to DXGI_FORMAT_R8G8B8A8_UNORM resources without conversion.
+struct BmpImage
+{
+	UINT Width = 0;
+	UINT Height = 0;
+	std::vector<uint8_t> Pixels;
+
+	UINT RowPitch() const { return Width * 4; }
+};
+
+// Supports uncompressed BI_RGB bitmaps with 8 (palettized), 24 or 32 bits per pixel,
+// and BI_BITFIELDS bitmaps with 32 bits per pixel. 24-bit and palettized images have
+// no alpha channel, their alpha is set to 255.
+HRESULT LoadBmpFromMemory(
+	const uint8_t* bmpData,
+	size_t bmpDataSize,
+	BmpImage& image);
+
+HRESULT LoadBmpFromFile(
+	const wchar_t* filename,
+	BmpImage& image);
+
+// Loads a numbered frame sequence such as "textures/BoltAnim/Bolt001.bmp" ... "Bolt060.bmp".
+// The file name of frame i is prefix + (firstIndex + i) padded to 3 digits + ".bmp".
+// All frames must share the same dimensions.
+HRESULT LoadBmpSequence(
+	const std::wstring& prefix,
+	UINT firstIndex,
+	UINT frameCount,
+	std::vector<BmpImage>& frames);
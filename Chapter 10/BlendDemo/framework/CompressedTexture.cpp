@@ -0,0 +1,310 @@
+#include "CompressedTexture.h"
+#include "DDSTextureLoader.h"
+#include "LzCodec.h"
+#include "TextureLayout.h"
+#include <atomic>
+#include <emmintrin.h>
+#include <thread>
+
+namespace
+{
+    constexpr uint32_t BlockSize = 64 * 1024;
+
+    // Appends one block, whichever of plain, byte planes or stored is the smallest.
+    void CompressBlock(const uint8_t* src, uint32_t size, uint32_t planeUnit,
+        std::vector<uint8_t>& planes, std::vector<uint8_t>& out)
+    {
+        std::vector<uint8_t> best;
+        LzCompress(src, size, best);
+        uint32_t flags = 0;
+
+        if (planeUnit > 1)
+        {
+            planes.resize(size);
+            SplitBytePlanes(src, size, planeUnit, planes.data());
+            std::vector<uint8_t> split;
+            LzCompress(planes.data(), size, split);
+            if (split.size() < best.size())
+            {
+                best.swap(split);
+                flags = CompressedBlockPlanes;
+            }
+        }
+
+        if (best.size() >= size)
+        {
+            best.assign(src, src + size);
+            flags = CompressedBlockStored;
+        }
+
+        const uint32_t word = (uint32_t)best.size() | flags;
+        out.insert(out.end(), (const uint8_t*)&word, (const uint8_t*)&word + sizeof(word));
+        out.insert(out.end(), best.begin(), best.end());
+    }
+
+    // Scratch for one decoding thread, blocks are decoded here rather than in the upload
+    // heap: matches read back earlier output, and reading write-combined memory is slow.
+    struct DecodeScratch
+    {
+        std::vector<uint8_t> Block = std::vector<uint8_t>(BlockSize);
+        std::vector<uint8_t> Planes = std::vector<uint8_t>(BlockSize);
+    };
+
+    bool DecodeChunk(const uint8_t* data, const CompressedTextureChunk& chunk, uint32_t blockSize,
+        uint8_t* staging, const D3D12_PLACED_SUBRESOURCE_FOOTPRINT& layout, UINT64 rowSize,
+        DecodeScratch& scratch)
+    {
+        const uint8_t* src = data + chunk.Offset;
+        const uint8_t* srcEnd = src + chunk.CompressedSize;
+        uint8_t* dst = staging + layout.Offset;
+
+        // Position in the tightly packed rows.
+        UINT64 row = 0;
+        UINT64 column = 0;
+
+        for (uint32_t position = 0; position < chunk.RawSize; position += blockSize)
+        {
+            const uint32_t rawSize = (std::min)(blockSize, chunk.RawSize - position);
+            if (srcEnd - src < (ptrdiff_t)sizeof(uint32_t))
+            {
+                return false;
+            }
+            uint32_t word;
+            memcpy(&word, src, sizeof(word));
+            src += sizeof(word);
+
+            const uint32_t storedSize = word & CompressedBlockSizeMask;
+            if ((UINT64)(srcEnd - src) < storedSize)
+            {
+                return false;
+            }
+
+            const uint8_t* block = src;
+            if (word & CompressedBlockStored)
+            {
+                if (storedSize != rawSize)
+                {
+                    return false;
+                }
+            }
+            else
+            {
+                if (!LzDecompress(src, storedSize, scratch.Block.data(), rawSize))
+                {
+                    return false;
+                }
+                block = scratch.Block.data();
+
+                if ((word & CompressedBlockPlanes) && chunk.PlaneUnit > 1)
+                {
+                    MergeBytePlanes(scratch.Block.data(), rawSize, chunk.PlaneUnit, scratch.Planes.data());
+                    block = scratch.Planes.data();
+                }
+            }
+            src += storedSize;
+
+            // Scatter the block over the padded rows of the footprint.
+            for (uint32_t offset = 0; offset < rawSize; )
+            {
+                const uint32_t size = (uint32_t)(std::min)((UINT64)(rawSize - offset), rowSize - column);
+                StreamToUploadMemory(dst + row * layout.Footprint.RowPitch + column, block + offset, size);
+                offset += size;
+                column += size;
+                if (column == rowSize)
+                {
+                    column = 0;
+                    ++row;
+                }
+            }
+        }
+
+        return src == srcEnd;
+    }
+}
+
+HRESULT CompressDDSTextureFile(const wchar_t* ddsFileName, const wchar_t* ddzFileName)
+{
+    std::vector<uint8_t> ddsData;
+    HRESULT hr = d3dUtil::ReadWholeFile(ddsFileName, ddsData);
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    D3D12_RESOURCE_DESC desc;
+    std::vector<DDS_SUBRESOURCE_LAYOUT> layout;
+    hr = GetDDSTextureLayoutFromMemory12(ddsData.data(), ddsData.size(), desc, layout);
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    // Byte planes pay off when an element is several bytes: BC endpoints and indices,
+    // or the channels of uncompressed texels.
+    FormatPlaneLayout planeLayout;
+    uint32_t planeUnit = 1;
+    if (GetFormatPlaneLayout(desc.Format, 0, planeLayout) && planeLayout.BitsPerBlock % 8 == 0)
+    {
+        planeUnit = (std::max)(planeLayout.BitsPerBlock / 8, 1u);
+    }
+
+    CompressedTextureHeader header;
+    header.DdsHeaderSize = (uint32_t)layout[0].Offset;
+    header.DdsFileSize = ddsData.size();
+    header.ChunkCount = (uint32_t)layout.size();
+    header.BlockSize = BlockSize;
+
+    std::vector<CompressedTextureChunk> chunks(layout.size());
+    std::vector<uint8_t> chunkData;
+    std::vector<uint8_t> planes;
+    uint64_t offset = sizeof(header) + header.DdsHeaderSize + chunks.size() * sizeof(CompressedTextureChunk);
+    for (size_t i = 0; i < layout.size(); ++i)
+    {
+        const uint64_t rawSize = (uint64_t)layout[i].SlicePitch * layout[i].Depth;
+        if (rawSize > UINT32_MAX)
+        {
+            return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+        }
+
+        const size_t start = chunkData.size();
+        const uint8_t* src = ddsData.data() + layout[i].Offset;
+        for (uint64_t position = 0; position < rawSize; position += BlockSize)
+        {
+            CompressBlock(src + position, (uint32_t)(std::min)((uint64_t)BlockSize, rawSize - position),
+                planeUnit, planes, chunkData);
+        }
+
+        chunks[i].Offset = offset;
+        chunks[i].CompressedSize = (uint32_t)(chunkData.size() - start);
+        chunks[i].RawSize = (uint32_t)rawSize;
+        chunks[i].PlaneUnit = planeUnit;
+        offset += chunks[i].CompressedSize;
+    }
+
+    std::ofstream fout(ddzFileName, std::ios::binary);
+    if (!fout)
+    {
+        return HRESULT_FROM_WIN32(ERROR_CANNOT_MAKE);
+    }
+    fout.write((const char*)&header, sizeof(header));
+    fout.write((const char*)ddsData.data(), header.DdsHeaderSize);
+    fout.write((const char*)chunks.data(), chunks.size() * sizeof(CompressedTextureChunk));
+    fout.write((const char*)chunkData.data(), chunkData.size());
+
+    return fout ? S_OK : HRESULT_FROM_WIN32(ERROR_WRITE_FAULT);
+}
+
+bool IsCompressedTexture(const uint8_t* data, size_t dataSize)
+{
+    return data && dataSize >= sizeof(CompressedTextureHeader) &&
+        reinterpret_cast<const CompressedTextureHeader*>(data)->Magic == CompressedTextureMagic;
+}
+
+HRESULT GetCompressedTextureLayout(const uint8_t* data, size_t dataSize,
+    D3D12_RESOURCE_DESC& desc, std::vector<CompressedTextureChunk>& chunks)
+{
+    chunks.clear();
+    if (!IsCompressedTexture(data, dataSize))
+    {
+        return E_FAIL;
+    }
+
+    CompressedTextureHeader header;
+    memcpy(&header, data, sizeof(header));
+    const uint64_t tableOffset = sizeof(header) + (uint64_t)header.DdsHeaderSize;
+    const uint64_t tableSize = (uint64_t)header.ChunkCount * sizeof(CompressedTextureChunk);
+    if (tableOffset + tableSize > dataSize ||
+        header.BlockSize != BlockSize)
+    {
+        return E_FAIL;
+    }
+
+    std::vector<DDS_SUBRESOURCE_LAYOUT> layout;
+    HRESULT hr = GetDDSTextureLayoutFromHeader12(data + sizeof(header), header.DdsHeaderSize,
+        header.DdsFileSize, desc, layout);
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+    if (layout.size() != header.ChunkCount)
+    {
+        return E_FAIL;
+    }
+
+    chunks.resize(header.ChunkCount);
+    memcpy(chunks.data(), data + tableOffset, (size_t)tableSize);
+    for (size_t i = 0; i < chunks.size(); ++i)
+    {
+        if (chunks[i].Offset + chunks[i].CompressedSize > dataSize ||
+            chunks[i].RawSize != (uint64_t)layout[i].SlicePitch * layout[i].Depth ||
+            chunks[i].PlaneUnit == 0)
+        {
+            chunks.clear();
+            return E_FAIL;
+        }
+    }
+
+    return S_OK;
+}
+
+HRESULT DecodeCompressedTexture(const uint8_t* data, size_t dataSize,
+    const std::vector<CompressedTextureChunk>& chunks, uint8_t* staging,
+    const D3D12_PLACED_SUBRESOURCE_FOOTPRINT* layouts, const UINT* numRows, const UINT64* rowSizes,
+    UINT threadCount)
+{
+    if (!IsCompressedTexture(data, dataSize) || !staging)
+    {
+        return E_INVALIDARG;
+    }
+
+    // The rows of a chunk must be exactly the rows of its footprint.
+    for (size_t i = 0; i < chunks.size(); ++i)
+    {
+        if (chunks[i].RawSize != rowSizes[i] * numRows[i] * layouts[i].Footprint.Depth)
+        {
+            return E_FAIL;
+        }
+    }
+
+    const uint32_t blockSize = reinterpret_cast<const CompressedTextureHeader*>(data)->BlockSize;
+    if (blockSize != BlockSize)
+    {
+        return E_FAIL;
+    }
+
+    if (threadCount == 0)
+    {
+        threadCount = (std::max)(std::thread::hardware_concurrency(), 1u);
+    }
+    threadCount = (std::min)(threadCount, (std::max)((UINT)chunks.size(), 1u));
+
+    std::atomic<size_t> nextChunk = 0;
+    std::atomic<bool> failed = false;
+    auto decode = [&]() {
+        DecodeScratch scratch;
+        for (size_t i = nextChunk++; i < chunks.size() && !failed; i = nextChunk++)
+        {
+            if (!DecodeChunk(data, chunks[i], blockSize, staging, layouts[i], rowSizes[i], scratch))
+            {
+                failed = true;
+            }
+        }
+
+        // Streaming stores are weakly ordered, make them visible before the GPU is told
+        // to read.
+        _mm_sfence();
+    };
+
+    std::vector<std::thread> threads;
+    for (UINT i = 1; i < threadCount; ++i)
+    {
+        threads.emplace_back(decode);
+    }
+    decode();
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+
+    return failed ? HRESULT_FROM_WIN32(ERROR_INVALID_DATA) : S_OK;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "d3dUtil.h"
+
+// Supercompressed DDS container (.ddz): the DDS headers as they are, followed by every
+// subresource compressed on its own with the LZ codec of LzCodec.h. GPU formats stay
+// GPU formats, the loader decompresses straight into the upload heap, several
+// subresources at once, instead of reading a file as large as the texture.
+//
+// Layout: CompressedTextureHeader, the DDS headers (magic number included), one
+// CompressedTextureChunk per subresource in DDS order (array slice major), then the
+// chunk data. A chunk holds its subresource's rows tightly packed, as in the DDS file,
+// cut into blocks of BlockSize bytes that decode independently. Each block starts with
+// a uint32: its stored size plus the CompressedBlock flags below.
+
+constexpr uint32_t CompressedTextureMagic = 0x315a4444; // "DDZ1"
+
+struct CompressedTextureHeader
+{
+	uint32_t Magic = CompressedTextureMagic;
+	uint32_t DdsHeaderSize = 0;
+	uint64_t DdsFileSize = 0;		// of the DDS file the headers describe
+	uint32_t ChunkCount = 0;
+	uint32_t BlockSize = 0;
+};
+
+struct CompressedTextureChunk
+{
+	uint64_t Offset = 0;			// from the start of the file
+	uint32_t CompressedSize = 0;
+	uint32_t RawSize = 0;
+	uint32_t PlaneUnit = 1;			// bytes per texel or block, for CompressedBlockPlanes
+	uint32_t Reserved = 0;
+};
+
+enum CompressedBlock : uint32_t
+{
+	CompressedBlockStored = 0x80000000,	// block kept raw, it didn't compress
+	CompressedBlockPlanes = 0x40000000,	// decompresses to byte planes (SplitBytePlanes)
+	CompressedBlockSizeMask = 0x3fffffff,
+};
+
+// Compresses a DDS file into a .ddz file.
+HRESULT CompressDDSTextureFile(const wchar_t* ddsFileName, const wchar_t* ddzFileName);
+
+bool IsCompressedTexture(const uint8_t* data, size_t dataSize);
+
+// Reads the headers and chunk table of a .ddz file in memory. desc describes the texture.
+HRESULT GetCompressedTextureLayout(const uint8_t* data, size_t dataSize,
+	D3D12_RESOURCE_DESC& desc, std::vector<CompressedTextureChunk>& chunks);
+
+// Decompresses every chunk into mapped upload memory laid out as layouts (offsets are
+// relative to staging, see ComputeCopyableFootprints). One job per chunk, spread over
+// threadCount threads, 0 picks one per hardware thread. Blocks are decoded into cached
+// memory and streamed out, the upload heap is write-combined and is never read back.
+HRESULT DecodeCompressedTexture(const uint8_t* data, size_t dataSize,
+	const std::vector<CompressedTextureChunk>& chunks, uint8_t* staging,
+	const D3D12_PLACED_SUBRESOURCE_FOOTPRINT* layouts, const UINT* numRows, const UINT64* rowSizes,
+	UINT threadCount = 0);
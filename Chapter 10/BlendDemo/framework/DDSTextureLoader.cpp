@@ -1669,29 +1669,31 @@ static HRESULT CreateTextureFromDDS( _In_ ID3D11Device* d3dDevice,
     return hr;
 }
 
-static HRESULT CreateTextureFromDDS12(
-	_In_ ID3D12Device* device,
-	_In_opt_ ID3D12GraphicsCommandList* cmdList,
+//--------------------------------------------------------------------------------------
+// Validates the header and resolves the dimensions, format and array size of the
+// texture it describes.
+//--------------------------------------------------------------------------------------
+static HRESULT GetTextureInfoFromDDS12(
 	_In_ const DDS_HEADER* header,
-	_In_reads_bytes_(bitSize) const uint8_t* bitData,
-	_In_ size_t bitSize,
-	_In_ size_t maxsize,
-	_In_ bool forceSRGB,
-	ComPtr<ID3D12Resource>& texture,
-	ComPtr<ID3D12Resource>& textureUploadHeap)
+	_Out_ uint32_t& resDim,
+	_Out_ UINT& width,
+	_Out_ UINT& height,
+	_Out_ UINT& depth,
+	_Out_ size_t& mipCount,
+	_Out_ UINT& arraySize,
+	_Out_ DXGI_FORMAT& format,
+	_Out_ bool& isCubeMap)
 {
-	HRESULT hr = S_OK;
+	width = header->width;
+	height = header->height;
+	depth = header->depth;
 
-	UINT width = header->width;
-	UINT height = header->height;
-	UINT depth = header->depth;
+	resDim = D3D12_RESOURCE_DIMENSION_UNKNOWN;
+	arraySize = 1;
+	format = DXGI_FORMAT_UNKNOWN;
+	isCubeMap = false;
 
-	uint32_t resDim = D3D12_RESOURCE_DIMENSION_UNKNOWN;
-	UINT arraySize = 1;
-	DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
-	bool isCubeMap = false;
-
-	size_t mipCount = header->mipMapCount;
+	mipCount = header->mipMapCount;
 	if (0 == mipCount) mipCount = 1;
 
 	if ((header->ddspf.flags & DDS_FOURCC) && (MAKEFOURCC('D', 'X', '1', '0') == header->ddspf.fourCC))
@@ -1835,6 +1837,37 @@ static HRESULT CreateTextureFromDDS12(
 		return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
 	}
 
+	return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+static HRESULT CreateTextureFromDDS12(
+	_In_ ID3D12Device* device,
+	_In_opt_ ID3D12GraphicsCommandList* cmdList,
+	_In_ const DDS_HEADER* header,
+	_In_reads_bytes_(bitSize) const uint8_t* bitData,
+	_In_ size_t bitSize,
+	_In_ size_t maxsize,
+	_In_ bool forceSRGB,
+	ComPtr<ID3D12Resource>& texture,
+	ComPtr<ID3D12Resource>& textureUploadHeap)
+{
+	uint32_t resDim = D3D12_RESOURCE_DIMENSION_UNKNOWN;
+	UINT width = 0;
+	UINT height = 0;
+	UINT depth = 0;
+	size_t mipCount = 0;
+	UINT arraySize = 1;
+	DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
+	bool isCubeMap = false;
+
+	HRESULT hr = GetTextureInfoFromDDS12(header, resDim, width, height, depth,
+		mipCount, arraySize, format, isCubeMap);
+	if (FAILED(hr))
+	{
+		return hr;
+	}
+
 	// Create the texture
 	std::unique_ptr<D3D12_SUBRESOURCE_DATA[]> initData(
 		new (std::nothrow) D3D12_SUBRESOURCE_DATA[mipCount * arraySize]
@@ -2365,3 +2398,226 @@ HRESULT DirectX::CreateDDSTextureFromFileEx( ID3D11Device* d3dDevice,
 
     return hr;
 }
+
+//--------------------------------------------------------------------------------------
+// data holds at least the headers of a DDS file of fileSize bytes.
+static HRESULT GetDDSTextureLayout12(
+	_In_reads_bytes_(dataSize) const uint8_t* data,
+	size_t dataSize,
+	uint64_t fileSize,
+	_Out_ D3D12_RESOURCE_DESC& desc,
+	_Out_ std::vector<DDS_SUBRESOURCE_LAYOUT>& layout,
+	_Out_opt_ bool* isCubeMap)
+{
+	ZeroMemory(&desc, sizeof(D3D12_RESOURCE_DESC));
+	layout.clear();
+	if (isCubeMap)
+	{
+		*isCubeMap = false;
+	}
+
+	if (dataSize < sizeof(uint32_t) + sizeof(DDS_HEADER))
+	{
+		return E_FAIL;
+	}
+
+	// DDS files always start with the same magic number ("DDS ")
+	if (*reinterpret_cast<const uint32_t*>(data) != DDS_MAGIC)
+	{
+		return E_FAIL;
+	}
+
+	auto header = reinterpret_cast<const DDS_HEADER*>(data + sizeof(uint32_t));
+	if (header->size != sizeof(DDS_HEADER) ||
+		header->ddspf.size != sizeof(DDS_PIXELFORMAT))
+	{
+		return E_FAIL;
+	}
+
+	const bool bDXT10Header = (header->ddspf.flags & DDS_FOURCC) &&
+		(MAKEFOURCC('D', 'X', '1', '0') == header->ddspf.fourCC);
+	if (bDXT10Header && dataSize < sizeof(uint32_t) + sizeof(DDS_HEADER) + sizeof(DDS_HEADER_DXT10))
+	{
+		return E_FAIL;
+	}
+
+	uint32_t resDim = D3D12_RESOURCE_DIMENSION_UNKNOWN;
+	UINT width = 0;
+	UINT height = 0;
+	UINT depth = 0;
+	size_t mipCount = 0;
+	UINT arraySize = 1;
+	DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
+	bool cubeMap = false;
+
+	HRESULT hr = GetTextureInfoFromDDS12(header, resDim, width, height, depth,
+		mipCount, arraySize, format, cubeMap);
+	if (FAILED(hr))
+	{
+		return hr;
+	}
+
+	// Walk the surfaces in file order, every array slice stores its whole mip chain.
+	layout.resize(mipCount * arraySize);
+
+	uint64_t offset = sizeof(uint32_t) + sizeof(DDS_HEADER)
+		+ (bDXT10Header ? sizeof(DDS_HEADER_DXT10) : 0);
+
+	size_t index = 0;
+	for (size_t j = 0; j < arraySize; j++)
+	{
+		size_t w = width;
+		size_t h = height;
+		size_t d = depth;
+		for (size_t i = 0; i < mipCount; i++)
+		{
+			size_t NumBytes = 0;
+			size_t RowBytes = 0;
+			GetSurfaceInfo(w, h, format, &NumBytes, &RowBytes, nullptr);
+
+			layout[index].Offset = offset;
+			layout[index].RowPitch = static_cast<UINT>(RowBytes);
+			layout[index].SlicePitch = static_cast<UINT>(NumBytes);
+			layout[index].Depth = static_cast<UINT>(d);
+			++index;
+
+			offset += NumBytes * d;
+
+			w = std::max<size_t>(w >> 1, 1);
+			h = std::max<size_t>(h >> 1, 1);
+			d = std::max<size_t>(d >> 1, 1);
+		}
+	}
+
+	if (offset > fileSize)
+	{
+		layout.clear();
+		return HRESULT_FROM_WIN32(ERROR_HANDLE_EOF);
+	}
+
+	desc.Dimension = static_cast<D3D12_RESOURCE_DIMENSION>(resDim);
+	desc.Alignment = 0;
+	desc.Width = width;
+	desc.Height = (resDim == D3D12_RESOURCE_DIMENSION_TEXTURE1D) ? 1 : height;
+	desc.DepthOrArraySize = (resDim == D3D12_RESOURCE_DIMENSION_TEXTURE3D) ? (UINT16)depth : (UINT16)arraySize;
+	desc.MipLevels = (UINT16)mipCount;
+	desc.Format = format;
+	desc.SampleDesc.Count = 1;
+	desc.SampleDesc.Quality = 0;
+	desc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
+	desc.Flags = D3D12_RESOURCE_FLAG_NONE;
+
+	if (isCubeMap)
+	{
+		*isCubeMap = cubeMap;
+	}
+
+	return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+HRESULT DirectX::GetDDSTextureLayoutFromFile12(
+	_In_z_ const wchar_t* szFileName,
+	_Out_ D3D12_RESOURCE_DESC& desc,
+	_Out_ std::vector<DDS_SUBRESOURCE_LAYOUT>& layout,
+	_Out_opt_ bool* isCubeMap)
+{
+	ZeroMemory(&desc, sizeof(D3D12_RESOURCE_DESC));
+	layout.clear();
+	if (isCubeMap)
+	{
+		*isCubeMap = false;
+	}
+
+	if (!szFileName)
+	{
+		return E_INVALIDARG;
+	}
+
+	// open the file
+#if (_WIN32_WINNT >= _WIN32_WINNT_WIN8)
+	ScopedHandle hFile(safe_handle(CreateFile2(szFileName,
+		GENERIC_READ,
+		FILE_SHARE_READ,
+		OPEN_EXISTING,
+		nullptr)));
+#else
+	ScopedHandle hFile(safe_handle(CreateFileW(szFileName,
+		GENERIC_READ,
+		FILE_SHARE_READ,
+		nullptr,
+		OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL,
+		nullptr)));
+#endif
+
+	if (!hFile)
+	{
+		return HRESULT_FROM_WIN32(GetLastError());
+	}
+
+	LARGE_INTEGER FileSize = { 0 };
+	if (!GetFileSizeEx(hFile.get(), &FileSize))
+	{
+		return HRESULT_FROM_WIN32(GetLastError());
+	}
+
+	// Only the headers are read, the surfaces stay on disk.
+	uint8_t headerData[sizeof(uint32_t) + sizeof(DDS_HEADER) + sizeof(DDS_HEADER_DXT10)] = {};
+	DWORD BytesRead = 0;
+	if (!ReadFile(hFile.get(), headerData, sizeof(headerData), &BytesRead, nullptr))
+	{
+		return HRESULT_FROM_WIN32(GetLastError());
+	}
+
+	if (BytesRead < sizeof(uint32_t) + sizeof(DDS_HEADER))
+	{
+		return E_FAIL;
+	}
+
+	return GetDDSTextureLayout12(headerData, BytesRead, static_cast<uint64_t>(FileSize.QuadPart),
+		desc, layout, isCubeMap);
+}
+
+//--------------------------------------------------------------------------------------
+HRESULT DirectX::GetDDSTextureLayoutFromMemory12(
+	_In_reads_bytes_(ddsDataSize) const uint8_t* ddsData,
+	_In_ size_t ddsDataSize,
+	_Out_ D3D12_RESOURCE_DESC& desc,
+	_Out_ std::vector<DDS_SUBRESOURCE_LAYOUT>& layout,
+	_Out_opt_ bool* isCubeMap)
+{
+	if (!ddsData)
+	{
+		ZeroMemory(&desc, sizeof(D3D12_RESOURCE_DESC));
+		layout.clear();
+		return E_INVALIDARG;
+	}
+
+	return GetDDSTextureLayout12(ddsData, ddsDataSize, ddsDataSize, desc, layout, isCubeMap);
+}
+
+//--------------------------------------------------------------------------------------
+HRESULT DirectX::GetDDSTextureLayoutFromHeader12(
+	_In_reads_bytes_(headerSize) const uint8_t* headerData,
+	_In_ size_t headerSize,
+	_In_ uint64_t ddsFileSize,
+	_Out_ D3D12_RESOURCE_DESC& desc,
+	_Out_ std::vector<DDS_SUBRESOURCE_LAYOUT>& layout,
+	_Out_opt_ bool* isCubeMap)
+{
+	if (!headerData)
+	{
+		ZeroMemory(&desc, sizeof(D3D12_RESOURCE_DESC));
+		layout.clear();
+		return E_INVALIDARG;
+	}
+
+	return GetDDSTextureLayout12(headerData, headerSize, ddsFileSize, desc, layout, isCubeMap);
+}
+
+//--------------------------------------------------------------------------------------
+size_t DirectX::GetBitsPerPixel12(_In_ DXGI_FORMAT format)
+{
+	return BitsPerPixel(format);
+}
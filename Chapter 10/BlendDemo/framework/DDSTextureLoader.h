@@ -24,6 +24,7 @@
 
 #include <wrl.h>
 #include <d3d11_1.h>
+#include <vector>
 #include "d3dx12.h"
 
 #pragma warning(push)
@@ -92,6 +93,45 @@ namespace DirectX
 		                               _Out_opt_ DDS_ALPHA_MODE* alphaMode = nullptr
 		                               );
 
+	// Where one subresource of a DDS file lives on disk.
+	struct DDS_SUBRESOURCE_LAYOUT
+	{
+		uint64_t Offset;        // from the start of the file
+		UINT     RowPitch;
+		UINT     SlicePitch;
+		UINT     Depth;
+	};
+
+	// Reads only the headers of a DDS file and returns the description of the full texture
+	// plus the file location of every subresource (mip + slice * MipLevels), so that
+	// surfaces can be read individually, e.g. when streaming mips.
+	HRESULT GetDDSTextureLayoutFromFile12(_In_z_ const wchar_t* szFileName,
+		                                  _Out_ D3D12_RESOURCE_DESC& desc,
+		                                  _Out_ std::vector<DDS_SUBRESOURCE_LAYOUT>& layout,
+		                                  _Out_opt_ bool* isCubeMap = nullptr
+		                                  );
+
+	// Same for a DDS file already in memory, offsets are relative to ddsData.
+	HRESULT GetDDSTextureLayoutFromMemory12(_In_reads_bytes_(ddsDataSize) const uint8_t* ddsData,
+		                                    _In_ size_t ddsDataSize,
+		                                    _Out_ D3D12_RESOURCE_DESC& desc,
+		                                    _Out_ std::vector<DDS_SUBRESOURCE_LAYOUT>& layout,
+		                                    _Out_opt_ bool* isCubeMap = nullptr
+		                                    );
+
+	// Same from the headers alone (magic number included) of a DDS file of ddsFileSize bytes.
+	HRESULT GetDDSTextureLayoutFromHeader12(_In_reads_bytes_(headerSize) const uint8_t* headerData,
+		                                    _In_ size_t headerSize,
+		                                    _In_ uint64_t ddsFileSize,
+		                                    _Out_ D3D12_RESOURCE_DESC& desc,
+		                                    _Out_ std::vector<DDS_SUBRESOURCE_LAYOUT>& layout,
+		                                    _Out_opt_ bool* isCubeMap = nullptr
+		                                    );
+
+	// Bits per texel of a format as stored in a DDS file, 0 when unsupported. Block
+	// compressed formats report their average.
+	size_t GetBitsPerPixel12(_In_ DXGI_FORMAT format);
+
     // Standard version with optional auto-gen mipmap support
     HRESULT CreateDDSTextureFromMemory( _In_ ID3D11Device* d3dDevice,
                                         _In_opt_ ID3D11DeviceContext* d3dContext,
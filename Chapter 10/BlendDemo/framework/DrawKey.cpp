@@ -0,0 +1,134 @@
+#include "DrawKey.h"
+#include <cstring>
+#include <utility>
+
+namespace
+{
+    uint64_t Field(uint32_t value, int bits)
+    {
+        return (uint64_t)value & ((1ull << bits) - 1);
+    }
+
+    constexpr int kRadixBits = 8;
+    constexpr int kBuckets = 1 << kRadixBits;
+    constexpr int kPasses = 64 / kRadixBits;
+
+    // Moves per entry SortCoherent allows before handing over to the radix sort, about
+    // what the radix passes would cost.
+    constexpr size_t kMovesPerEntry = 4;
+}
+
+uint64_t DrawKey::FrontToBack(uint32_t layer, uint32_t pso, uint32_t geometry, uint32_t material, float viewDepth)
+{
+    uint64_t key = Field(layer, LayerBits);
+    key = (key << PsoBits) | Field(pso, PsoBits);
+    key = (key << GeometryBits) | Field(geometry, GeometryBits);
+    key = (key << MaterialBits) | Field(material, MaterialBits);
+    key = (key << DepthBits) | QuantizeDepth(viewDepth);
+    return key;
+}
+
+uint64_t DrawKey::BackToFront(uint32_t layer, uint32_t pso, uint32_t geometry, uint32_t material, float viewDepth)
+{
+    uint64_t key = Field(layer, LayerBits);
+    key = (key << DepthBits) | (uint32_t)~QuantizeDepth(viewDepth);
+    key = (key << PsoBits) | Field(pso, PsoBits);
+    key = (key << GeometryBits) | Field(geometry, GeometryBits);
+    key = (key << MaterialBits) | Field(material, MaterialBits);
+    return key;
+}
+
+uint32_t DrawKey::QuantizeDepth(float viewDepth)
+{
+    // Non-negative IEEE floats order like their bits. NaN fails the test and counts as 0.
+    if (!(viewDepth > 0.f))
+    {
+        return 0;
+    }
+    uint32_t bits;
+    memcpy(&bits, &viewDepth, sizeof(bits));
+    return bits;
+}
+
+void DrawKeySorter::SortCoherent(std::vector<DrawEntry>& entries)
+{
+    mLastPassCount = 0;
+    mLastMoveCount = 0;
+
+    const size_t budget = entries.size() * kMovesPerEntry;
+    for (size_t i = 1; i < entries.size(); ++i)
+    {
+        const DrawEntry entry = entries[i];
+        size_t j = i;
+        for (; j > 0 && entries[j - 1].Key > entry.Key; --j)
+        {
+            entries[j] = entries[j - 1];
+        }
+        entries[j] = entry;
+
+        mLastMoveCount += i - j;
+        if (mLastMoveCount > budget)
+        {
+            // The radix sort takes the entries in any order, only the moves made so far
+            // are lost.
+            Sort(entries);
+            return;
+        }
+    }
+}
+
+void DrawKeySorter::Sort(std::vector<DrawEntry>& entries)
+{
+    mLastPassCount = 0;
+    const size_t count = entries.size();
+    if (count < 2)
+    {
+        return;
+    }
+
+    uint32_t histograms[kPasses][kBuckets] = {};
+    for (const DrawEntry& entry : entries)
+    {
+        for (int pass = 0; pass < kPasses; ++pass)
+        {
+            ++histograms[pass][(entry.Key >> (pass * kRadixBits)) & (kBuckets - 1)];
+        }
+    }
+
+    mScratch.resize(count);
+    DrawEntry* src = entries.data();
+    DrawEntry* dst = mScratch.data();
+    for (int pass = 0; pass < kPasses; ++pass)
+    {
+        uint32_t* histogram = histograms[pass];
+        const int shift = pass * kRadixBits;
+
+        // Every key has the same byte here, the pass would copy the entries as they are.
+        if (histogram[(src[0].Key >> shift) & (kBuckets - 1)] == count)
+        {
+            continue;
+        }
+
+        // Counts to the offsets of the buckets.
+        uint32_t offset = 0;
+        for (int bucket = 0; bucket < kBuckets; ++bucket)
+        {
+            const uint32_t bucketCount = histogram[bucket];
+            histogram[bucket] = offset;
+            offset += bucketCount;
+        }
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            dst[histogram[(src[i].Key >> shift) & (kBuckets - 1)]++] = src[i];
+        }
+        std::swap(src, dst);
+        ++mLastPassCount;
+    }
+
+    // An odd number of passes leaves the result in the scratch buffer.
+    if (src != entries.data())
+    {
+        memcpy(entries.data(), src, count * sizeof(DrawEntry));
+    }
+}
@@ -0,0 +1,204 @@
+#include "LzCodec.h"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    constexpr size_t MinMatch = 4;
+    constexpr size_t LastLiterals = 5;		// the format ends with at least 5 literals
+    constexpr size_t MatchFindLimit = 12;	// and its last match starts at least 12 bytes before the end
+    constexpr size_t MaxOffset = 65535;
+    constexpr uint32_t HashBits = 14;
+
+    uint32_t Read32(const uint8_t* p)
+    {
+        uint32_t value;
+        memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    uint32_t Hash(uint32_t sequence)
+    {
+        return (sequence * 2654435761u) >> (32 - HashBits);
+    }
+
+    void WriteLength(std::vector<uint8_t>& out, size_t length)
+    {
+        for (; length >= 255; length -= 255)
+        {
+            out.push_back(255);
+        }
+        out.push_back((uint8_t)length);
+    }
+
+    bool ReadLength(const uint8_t* src, size_t srcSize, size_t& ip, size_t& length)
+    {
+        uint8_t byte = 0;
+        do
+        {
+            if (ip >= srcSize)
+            {
+                return false;
+            }
+            byte = src[ip++];
+            length += byte;
+        } while (byte == 255);
+        return true;
+    }
+
+    void WriteSequence(std::vector<uint8_t>& out, const uint8_t* literals, size_t literalCount,
+        size_t offset, size_t matchLength)
+    {
+        const size_t matchCode = matchLength - MinMatch;
+        out.push_back((uint8_t)(((std::min<size_t>)(literalCount, 15) << 4) |
+            (offset != 0 ? (std::min<size_t>)(matchCode, 15) : 0)));
+        if (literalCount >= 15)
+        {
+            WriteLength(out, literalCount - 15);
+        }
+        out.insert(out.end(), literals, literals + literalCount);
+
+        // The last sequence is literals only.
+        if (offset == 0)
+        {
+            return;
+        }
+        out.push_back((uint8_t)offset);
+        out.push_back((uint8_t)(offset >> 8));
+        if (matchCode >= 15)
+        {
+            WriteLength(out, matchCode - 15);
+        }
+    }
+}
+
+void LzCompress(const uint8_t* src, size_t size, std::vector<uint8_t>& out)
+{
+    size_t anchor = 0;
+    if (size > MatchFindLimit)
+    {
+        std::vector<uint32_t> table((size_t)1 << HashBits, 0);
+        const size_t matchLimit = size - LastLiterals;
+        const size_t searchEnd = size - MatchFindLimit;
+
+        size_t ip = 0;
+        while (ip < searchEnd)
+        {
+            const uint32_t sequence = Read32(src + ip);
+            uint32_t& slot = table[Hash(sequence)];
+            const size_t ref = slot;
+            slot = (uint32_t)ip;
+
+            if (ref >= ip || ip - ref > MaxOffset || Read32(src + ref) != sequence)
+            {
+                ++ip;
+                continue;
+            }
+
+            size_t length = MinMatch;
+            while (ip + length < matchLimit && src[ref + length] == src[ip + length])
+            {
+                ++length;
+            }
+
+            WriteSequence(out, src + anchor, ip - anchor, ip - ref, length);
+            ip += length;
+            anchor = ip;
+        }
+    }
+
+    WriteSequence(out, src + anchor, size - anchor, 0, MinMatch);
+}
+
+bool LzDecompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize)
+{
+    size_t ip = 0;
+    size_t op = 0;
+    while (ip < srcSize)
+    {
+        const uint8_t token = src[ip++];
+
+        size_t literalCount = token >> 4;
+        if (literalCount == 15 && !ReadLength(src, srcSize, ip, literalCount))
+        {
+            return false;
+        }
+        if (literalCount > srcSize - ip || literalCount > dstSize - op)
+        {
+            return false;
+        }
+        memcpy(dst + op, src + ip, literalCount);
+        ip += literalCount;
+        op += literalCount;
+
+        if (ip == srcSize)
+        {
+            break;
+        }
+
+        if (srcSize - ip < 2)
+        {
+            return false;
+        }
+        const size_t offset = src[ip] | ((size_t)src[ip + 1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > op)
+        {
+            return false;
+        }
+
+        size_t length = token & 15;
+        if (length == 15 && !ReadLength(src, srcSize, ip, length))
+        {
+            return false;
+        }
+        length += MinMatch;
+        if (length > dstSize - op)
+        {
+            return false;
+        }
+
+        // Overlapping matches repeat the last offset bytes, copy those byte by byte.
+        const uint8_t* match = dst + op - offset;
+        if (offset >= length)
+        {
+            memcpy(dst + op, match, length);
+        }
+        else
+        {
+            for (size_t i = 0; i < length; ++i)
+            {
+                dst[op + i] = match[i];
+            }
+        }
+        op += length;
+    }
+
+    return op == dstSize;
+}
+
+void SplitBytePlanes(const uint8_t* src, size_t size, uint32_t unit, uint8_t* dst)
+{
+    const size_t count = size / unit;
+    for (size_t i = 0; i < count; ++i)
+    {
+        for (uint32_t j = 0; j < unit; ++j)
+        {
+            dst[j * count + i] = src[i * unit + j];
+        }
+    }
+    memcpy(dst + count * unit, src + count * unit, size - count * unit);
+}
+
+void MergeBytePlanes(const uint8_t* src, size_t size, uint32_t unit, uint8_t* dst)
+{
+    const size_t count = size / unit;
+    for (size_t i = 0; i < count; ++i)
+    {
+        for (uint32_t j = 0; j < unit; ++j)
+        {
+            dst[i * unit + j] = src[j * count + i];
+        }
+    }
+    memcpy(dst + count * unit, src + count * unit, size - count * unit);
+}
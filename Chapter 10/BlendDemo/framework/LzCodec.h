@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Byte oriented LZ77 compressor writing the LZ4 block format: greedy hash matching on
+// compression, and a decoder that only copies bytes, fast enough to keep up with disks
+// on one core. Used by the compressed texture container (CompressedTexture.h).
+
+// Appends the compressed form of src to out.
+void LzCompress(const uint8_t* src, size_t size, std::vector<uint8_t>& out);
+
+// Decodes exactly dstSize bytes. False when the data is corrupt or doesn't decode to
+// dstSize bytes, dst is undefined then. dst must not be write-combined memory, matches
+// read back what was decoded.
+bool LzDecompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize);
+
+// Byte-plane separation: byte j of every unit-byte element goes to plane j, so e.g. the
+// endpoint bytes of BC blocks end up next to each other and compress better. A last
+// partial element is copied as is.
+void SplitBytePlanes(const uint8_t* src, size_t size, uint32_t unit, uint8_t* dst);
+void MergeBytePlanes(const uint8_t* src, size_t size, uint32_t unit, uint8_t* dst);
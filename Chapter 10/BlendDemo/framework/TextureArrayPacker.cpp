@@ -0,0 +1,423 @@
+#include "TextureArrayPacker.h"
+
+namespace
+{
+    //
+    // The subset of the DDS file structures needed for writing a DX10 texture array.
+    // See DDSTextureLoader.cpp for the full definitions.
+    //
+#pragma pack(push, 1)
+    struct DdsPixelFormat
+    {
+        uint32_t size;
+        uint32_t flags;
+        uint32_t fourCC;
+        uint32_t RGBBitCount;
+        uint32_t RBitMask;
+        uint32_t GBitMask;
+        uint32_t BBitMask;
+        uint32_t ABitMask;
+    };
+
+    struct DdsHeader
+    {
+        uint32_t size;
+        uint32_t flags;
+        uint32_t height;
+        uint32_t width;
+        uint32_t pitchOrLinearSize;
+        uint32_t depth;
+        uint32_t mipMapCount;
+        uint32_t reserved1[11];
+        DdsPixelFormat ddspf;
+        uint32_t caps;
+        uint32_t caps2;
+        uint32_t caps3;
+        uint32_t caps4;
+        uint32_t reserved2;
+    };
+
+    struct DdsHeaderDxt10
+    {
+        DXGI_FORMAT dxgiFormat;
+        uint32_t resourceDimension;
+        uint32_t miscFlag;
+        uint32_t arraySize;
+        uint32_t miscFlags2;
+    };
+#pragma pack(pop)
+
+    constexpr uint32_t DdsMagic = 0x20534444;   // "DDS "
+    constexpr uint32_t DdsFourCC = 0x00000004;
+    constexpr uint32_t DdsFlagsTexture = 0x00001007;    // CAPS | HEIGHT | WIDTH | PIXELFORMAT
+    constexpr uint32_t DdsFlagsMipmap = 0x00020000;     // MIPMAPCOUNT
+    constexpr uint32_t DdsFlagsPitch = 0x00000008;
+    constexpr uint32_t DdsFlagsLinearSize = 0x00080000;
+    constexpr uint32_t DdsCapsTexture = 0x00001000;
+    constexpr uint32_t DdsCapsComplexMipmap = 0x00400008;
+    constexpr uint32_t DdsResourceDimensionTexture2D = 3;
+    constexpr uint32_t DdsAlphaModeOpaque = 3;
+
+    struct SurfaceInfo
+    {
+        UINT Width;
+        UINT Height;
+        size_t RowPitch;
+        size_t NumRows;
+        size_t NumBytes;
+    };
+
+    SurfaceInfo GetSurfaceInfo(UINT width, UINT height, DXGI_FORMAT format)
+    {
+        SurfaceInfo info = { width, height };
+        if (format == DXGI_FORMAT_BC1_UNORM)
+        {
+            // 8 bytes for every 4x4 block, partial blocks are padded.
+            info.RowPitch = (size_t)(std::max)(1u, (width + 3) / 4) * 8;
+            info.NumRows = (std::max)(1u, (height + 3) / 4);
+        }
+        else
+        {
+            info.RowPitch = (size_t)width * 4;
+            info.NumRows = height;
+        }
+        info.NumBytes = info.RowPitch * info.NumRows;
+        return info;
+    }
+
+    // Halves an R8G8B8A8 image with a 2x2 box filter, odd edges are clamped.
+    std::vector<uint8_t> Downsample(const std::vector<uint8_t>& src, UINT srcWidth, UINT srcHeight)
+    {
+        const UINT dstWidth = (std::max)(1u, srcWidth / 2);
+        const UINT dstHeight = (std::max)(1u, srcHeight / 2);
+        std::vector<uint8_t> dst((size_t)dstWidth * dstHeight * 4);
+
+        for (UINT y = 0; y < dstHeight; ++y)
+        {
+            const UINT y0 = (std::min)(2 * y, srcHeight - 1);
+            const UINT y1 = (std::min)(2 * y + 1, srcHeight - 1);
+            for (UINT x = 0; x < dstWidth; ++x)
+            {
+                const UINT x0 = (std::min)(2 * x, srcWidth - 1);
+                const UINT x1 = (std::min)(2 * x + 1, srcWidth - 1);
+                for (UINT c = 0; c < 4; ++c)
+                {
+                    const UINT sum =
+                        src[((size_t)y0 * srcWidth + x0) * 4 + c] +
+                        src[((size_t)y0 * srcWidth + x1) * 4 + c] +
+                        src[((size_t)y1 * srcWidth + x0) * 4 + c] +
+                        src[((size_t)y1 * srcWidth + x1) * 4 + c];
+                    dst[((size_t)y * dstWidth + x) * 4 + c] = (uint8_t)((sum + 2) / 4);
+                }
+            }
+        }
+
+        return dst;
+    }
+
+    uint16_t ToRGB565(const int rgb[3])
+    {
+        return (uint16_t)(((rgb[0] * 31 + 127) / 255) << 11 |
+            ((rgb[1] * 63 + 127) / 255) << 5 |
+            ((rgb[2] * 31 + 127) / 255));
+    }
+
+    void FromRGB565(uint16_t c, int rgb[3])
+    {
+        const int r = (c >> 11) & 31;
+        const int g = (c >> 5) & 63;
+        const int b = c & 31;
+        rgb[0] = (r << 3) | (r >> 2);
+        rgb[1] = (g << 2) | (g >> 4);
+        rgb[2] = (b << 3) | (b >> 2);
+    }
+
+    // Encodes one 4x4 block of R8G8B8A8 texels into BC1 with a bounding box fit:
+    // the endpoints are the inset min/max of each channel, always in 4-color mode.
+    void EncodeBC1Block(const uint8_t texels[16][4], uint8_t* block)
+    {
+        int minColor[3] = { 255, 255, 255 };
+        int maxColor[3] = { 0, 0, 0 };
+        for (int i = 0; i < 16; ++i)
+        {
+            for (int c = 0; c < 3; ++c)
+            {
+                minColor[c] = (std::min)(minColor[c], (int)texels[i][c]);
+                maxColor[c] = (std::max)(maxColor[c], (int)texels[i][c]);
+            }
+        }
+
+        // Inset the box by 1/16 of its extent to reduce the error of the interpolants.
+        for (int c = 0; c < 3; ++c)
+        {
+            const int inset = (maxColor[c] - minColor[c]) / 16;
+            minColor[c] += inset;
+            maxColor[c] -= inset;
+        }
+
+        uint16_t c0 = ToRGB565(maxColor);
+        uint16_t c1 = ToRGB565(minColor);
+        if (c0 < c1)
+        {
+            std::swap(c0, c1);
+        }
+
+        uint32_t indices = 0;
+        if (c0 != c1)
+        {
+            int palette[4][3];
+            FromRGB565(c0, palette[0]);
+            FromRGB565(c1, palette[1]);
+            for (int c = 0; c < 3; ++c)
+            {
+                palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+            }
+
+            for (int i = 0; i < 16; ++i)
+            {
+                int best = 0;
+                int bestDist = (std::numeric_limits<int>::max)();
+                for (int p = 0; p < 4; ++p)
+                {
+                    const int dr = texels[i][0] - palette[p][0];
+                    const int dg = texels[i][1] - palette[p][1];
+                    const int db = texels[i][2] - palette[p][2];
+                    const int dist = dr * dr + dg * dg + db * db;
+                    if (dist < bestDist)
+                    {
+                        bestDist = dist;
+                        best = p;
+                    }
+                }
+                indices |= (uint32_t)best << (2 * i);
+            }
+        }
+
+        memcpy(block + 0, &c0, sizeof(c0));
+        memcpy(block + 2, &c1, sizeof(c1));
+        memcpy(block + 4, &indices, sizeof(indices));
+    }
+
+    void EncodeBC1(const std::vector<uint8_t>& src, UINT width, UINT height, uint8_t* dst, size_t dstRowPitch)
+    {
+        const UINT blocksWide = (std::max)(1u, (width + 3) / 4);
+        const UINT blocksHigh = (std::max)(1u, (height + 3) / 4);
+
+        for (UINT by = 0; by < blocksHigh; ++by)
+        {
+            for (UINT bx = 0; bx < blocksWide; ++bx)
+            {
+                // Blocks that hang over the edge replicate the last row/column.
+                uint8_t texels[16][4];
+                for (UINT ty = 0; ty < 4; ++ty)
+                {
+                    const UINT y = (std::min)(by * 4 + ty, height - 1);
+                    for (UINT tx = 0; tx < 4; ++tx)
+                    {
+                        const UINT x = (std::min)(bx * 4 + tx, width - 1);
+                        memcpy(texels[ty * 4 + tx], &src[((size_t)y * width + x) * 4], 4);
+                    }
+                }
+
+                EncodeBC1Block(texels, dst + by * dstRowPitch + bx * 8);
+            }
+        }
+    }
+}
+
+HRESULT PackTextureArray(
+    const std::vector<BmpImage>& frames,
+    const TextureArrayPackOptions& options,
+    PackedTextureArray& packed)
+{
+    if (frames.empty())
+    {
+        return E_INVALIDARG;
+    }
+
+    const UINT width = frames[0].Width;
+    const UINT height = frames[0].Height;
+    if (width == 0 || height == 0 || frames.size() > D3D12_REQ_TEXTURE2D_ARRAY_AXIS_DIMENSION)
+    {
+        return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+    }
+
+    for (const BmpImage& frame : frames)
+    {
+        if (frame.Width != width || frame.Height != height)
+        {
+            return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+        }
+    }
+
+    // Block compression requires the top level to be made of whole blocks.
+    if (options.CompressBC1 && (width % 4 != 0 || height % 4 != 0))
+    {
+        return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+    }
+
+    UINT mipLevels = 1;
+    if (options.GenerateMips)
+    {
+        for (UINT size = (std::max)(width, height); size > 1; size >>= 1)
+        {
+            ++mipLevels;
+        }
+    }
+
+    packed.Width = width;
+    packed.Height = height;
+    packed.ArraySize = (UINT)frames.size();
+    packed.MipLevels = mipLevels;
+    packed.Format = options.CompressBC1 ? DXGI_FORMAT_BC1_UNORM : DXGI_FORMAT_R8G8B8A8_UNORM;
+
+    // Lay out all surfaces first so that Data is never reallocated once we hand out pointers.
+    std::vector<SurfaceInfo> mipInfo(mipLevels);
+    size_t sliceBytes = 0;
+    for (UINT mip = 0; mip < mipLevels; ++mip)
+    {
+        mipInfo[mip] = GetSurfaceInfo(
+            (std::max)(1u, width >> mip), (std::max)(1u, height >> mip), packed.Format);
+        sliceBytes += mipInfo[mip].NumBytes;
+    }
+
+    packed.Data.assign(sliceBytes * packed.ArraySize, 0);
+    packed.Subresources.resize((size_t)mipLevels * packed.ArraySize);
+
+    uint8_t* dst = packed.Data.data();
+    for (UINT slice = 0; slice < packed.ArraySize; ++slice)
+    {
+        std::vector<uint8_t> level = frames[slice].Pixels;
+        for (UINT mip = 0; mip < mipLevels; ++mip)
+        {
+            const SurfaceInfo& info = mipInfo[mip];
+            if (mip > 0)
+            {
+                level = Downsample(level, mipInfo[mip - 1].Width, mipInfo[mip - 1].Height);
+            }
+
+            if (options.CompressBC1)
+            {
+                EncodeBC1(level, info.Width, info.Height, dst, info.RowPitch);
+            }
+            else
+            {
+                memcpy(dst, level.data(), info.NumBytes);
+            }
+
+            D3D12_SUBRESOURCE_DATA& sub = packed.Subresources[mip + (size_t)slice * mipLevels];
+            sub.pData = dst;
+            sub.RowPitch = (LONG_PTR)info.RowPitch;
+            sub.SlicePitch = (LONG_PTR)info.NumBytes;
+
+            dst += info.NumBytes;
+        }
+    }
+
+    return S_OK;
+}
+
+HRESULT SaveTextureArrayToDDS(const wchar_t* filename, const PackedTextureArray& packed)
+{
+    if (!filename || packed.Data.empty())
+    {
+        return E_INVALIDARG;
+    }
+
+    const bool compressed = packed.Format == DXGI_FORMAT_BC1_UNORM;
+    const SurfaceInfo top = GetSurfaceInfo(packed.Width, packed.Height, packed.Format);
+
+    DdsHeader header = {};
+    header.size = sizeof(DdsHeader);
+    header.flags = DdsFlagsTexture | DdsFlagsMipmap | (compressed ? DdsFlagsLinearSize : DdsFlagsPitch);
+    header.height = packed.Height;
+    header.width = packed.Width;
+    header.pitchOrLinearSize = (uint32_t)(compressed ? top.NumBytes : top.RowPitch);
+    header.depth = 0;
+    header.mipMapCount = packed.MipLevels;
+    header.ddspf.size = sizeof(DdsPixelFormat);
+    header.ddspf.flags = DdsFourCC;
+    header.ddspf.fourCC = MAKEFOURCC('D', 'X', '1', '0');
+    header.caps = DdsCapsTexture | (packed.MipLevels > 1 ? DdsCapsComplexMipmap : 0u);
+
+    DdsHeaderDxt10 dxt10 = {};
+    dxt10.dxgiFormat = packed.Format;
+    dxt10.resourceDimension = DdsResourceDimensionTexture2D;
+    dxt10.arraySize = packed.ArraySize;
+    dxt10.miscFlags2 = compressed ? DdsAlphaModeOpaque : 0u;
+
+    std::ofstream fout(filename, std::ios::binary | std::ios::trunc);
+    if (!fout)
+    {
+        return HRESULT_FROM_WIN32(ERROR_CANNOT_MAKE);
+    }
+
+    fout.write((const char*)&DdsMagic, sizeof(DdsMagic));
+    fout.write((const char*)&header, sizeof(header));
+    fout.write((const char*)&dxt10, sizeof(dxt10));
+    fout.write((const char*)packed.Data.data(), (std::streamsize)packed.Data.size());
+
+    return fout ? S_OK : E_FAIL;
+}
+
+HRESULT CreateTextureArray12(
+    ID3D12Device* device,
+    ID3D12GraphicsCommandList* cmdList,
+    const PackedTextureArray& packed,
+    ComPtr<ID3D12Resource>& texture,
+    ComPtr<ID3D12Resource>& textureUploadHeap)
+{
+    if (!device || !cmdList || packed.Subresources.empty())
+    {
+        return E_INVALIDARG;
+    }
+
+    const D3D12_RESOURCE_DESC texDesc = CD3DX12_RESOURCE_DESC::Tex2D(
+        packed.Format,
+        packed.Width,
+        packed.Height,
+        (UINT16)packed.ArraySize,
+        (UINT16)packed.MipLevels);
+
+    HRESULT hr = device->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+        D3D12_HEAP_FLAG_NONE,
+        &texDesc,
+        D3D12_RESOURCE_STATE_COMMON,
+        nullptr,
+        IID_PPV_ARGS(&texture));
+    if (FAILED(hr))
+    {
+        texture = nullptr;
+        return hr;
+    }
+
+    // One upload heap holds every mip of every slice.
+    const UINT numSubresources = (UINT)packed.Subresources.size();
+    const UINT64 uploadBufferSize = GetRequiredIntermediateSize(texture.Get(), 0, numSubresources);
+
+    hr = device->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+        D3D12_HEAP_FLAG_NONE,
+        &CD3DX12_RESOURCE_DESC::Buffer(uploadBufferSize),
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        IID_PPV_ARGS(&textureUploadHeap));
+    if (FAILED(hr))
+    {
+        texture = nullptr;
+        return hr;
+    }
+
+    cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(texture.Get(),
+        D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_COPY_DEST));
+
+    UpdateSubresources(cmdList, texture.Get(), textureUploadHeap.Get(),
+        0, 0, numSubresources, packed.Subresources.data());
+
+    cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(texture.Get(),
+        D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
+
+    return S_OK;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "d3dUtil.h"
+#include "BmpLoader.h"
+
+// Packs a sequence of equally sized frames (a flipbook animation) into one mipped
+// Texture2DArray, one slice per frame. The whole animation then needs a single resource,
+// a single upload and a single SRV; the shader picks the slice from the time.
+struct TextureArrayPackOptions
+{
+	// Build the full mip chain down to 1x1 with a 2x2 box filter.
+	bool GenerateMips = true;
+
+	// Encode every mip of every slice as BC1. Frames without alpha (like the bolt
+	// animation) lose nothing but color precision, and the array shrinks 8x.
+	bool CompressBC1 = false;
+};
+
+struct PackedTextureArray
+{
+	UINT Width = 0;
+	UINT Height = 0;
+	UINT ArraySize = 0;
+	UINT MipLevels = 0;
+	DXGI_FORMAT Format = DXGI_FORMAT_UNKNOWN;
+
+	// Surfaces are stored slice-major (slice 0 mips 0..n, slice 1 mips 0..n, ...), which is
+	// both the order of a DDS file and the D3D12 subresource order (mip + slice * MipLevels).
+	std::vector<uint8_t> Data;
+	std::vector<D3D12_SUBRESOURCE_DATA> Subresources;	// points into Data
+};
+
+HRESULT PackTextureArray(
+	const std::vector<BmpImage>& frames,
+	const TextureArrayPackOptions& options,
+	PackedTextureArray& packed);
+
+// Offline path: writes the packed array as a DX10 DDS, which CreateDDSTextureFromFile12
+// loads back as a Texture2DArray.
+HRESULT SaveTextureArrayToDDS(
+	const wchar_t* filename,
+	const PackedTextureArray& packed);
+
+// Runtime path: creates the default heap texture and records a single upload of all
+// subresources into cmdList. Keep textureUploadHeap alive until the commands have executed.
+HRESULT CreateTextureArray12(
+	ID3D12Device* device,
+	ID3D12GraphicsCommandList* cmdList,
+	const PackedTextureArray& packed,
+	ComPtr<ID3D12Resource>& texture,
+	ComPtr<ID3D12Resource>& textureUploadHeap);
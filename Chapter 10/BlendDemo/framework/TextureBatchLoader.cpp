@@ -0,0 +1,264 @@
+#include "TextureBatchLoader.h"
+#include "CompressedTexture.h"
+#include "DDSTextureLoader.h"
+#include "TextureLayout.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+    struct LoadJob
+    {
+        Texture* Tex = nullptr;
+        HRESULT Result = S_OK;
+
+        // File contents, freed once copied into the upload heap.
+        std::vector<uint8_t> FileData;
+
+        // Filled by the worker, handed over to Tex on the calling thread.
+        ComPtr<ID3D12Resource> Resource;
+        ComPtr<ID3D12Resource> UploadHeap;
+        std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> Footprints;
+    };
+
+    // Everything but the copy commands: parses the file, creates the texture in COPY_DEST
+    // and an upload heap laid out for it, then fills the heap. Takes DDS files and their
+    // compressed form (CompressedTexture.h).
+    HRESULT PrepareTexture(ID3D12Device* device, LoadJob& job)
+    {
+        const bool compressed = IsCompressedTexture(job.FileData.data(), job.FileData.size());
+        D3D12_RESOURCE_DESC desc;
+        std::vector<DDS_SUBRESOURCE_LAYOUT> layout;
+        std::vector<CompressedTextureChunk> chunks;
+        HRESULT hr = compressed ?
+            GetCompressedTextureLayout(job.FileData.data(), job.FileData.size(), desc, chunks) :
+            GetDDSTextureLayoutFromMemory12(job.FileData.data(), job.FileData.size(), desc, layout);
+        if (FAILED(hr))
+        {
+            return hr;
+        }
+
+        const UINT subresourceCount = compressed ? (UINT)chunks.size() : (UINT)layout.size();
+        job.Footprints.resize(subresourceCount);
+        std::vector<UINT> numRows(subresourceCount);
+        std::vector<UINT64> rowSizes(subresourceCount);
+        UINT64 uploadSize = 0;
+        if (!ComputeCopyableFootprints(desc, 0, subresourceCount, 0,
+            job.Footprints.data(), numRows.data(), rowSizes.data(), &uploadSize))
+        {
+            return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+        }
+
+        // The device is free threaded, creating resources here keeps it off the calling thread.
+        hr = device->CreateCommittedResource(
+            &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+            D3D12_HEAP_FLAG_NONE,
+            &desc,
+            D3D12_RESOURCE_STATE_COPY_DEST,
+            nullptr,
+            IID_PPV_ARGS(&job.Resource));
+        if (FAILED(hr))
+        {
+            return hr;
+        }
+
+        hr = device->CreateCommittedResource(
+            &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+            D3D12_HEAP_FLAG_NONE,
+            &CD3DX12_RESOURCE_DESC::Buffer(uploadSize),
+            D3D12_RESOURCE_STATE_GENERIC_READ,
+            nullptr,
+            IID_PPV_ARGS(&job.UploadHeap));
+        if (FAILED(hr))
+        {
+            return hr;
+        }
+
+        uint8_t* staging = nullptr;
+        hr = job.UploadHeap->Map(0, &CD3DX12_RANGE(0, 0), (void**)&staging);
+        if (FAILED(hr))
+        {
+            return hr;
+        }
+
+        // The workers already run in parallel, one thread per texture.
+        if (compressed)
+        {
+            hr = DecodeCompressedTexture(job.FileData.data(), job.FileData.size(), chunks, staging,
+                job.Footprints.data(), numRows.data(), rowSizes.data(), 1);
+        }
+        else
+        {
+            std::vector<D3D12_SUBRESOURCE_DATA> subresources(subresourceCount);
+            for (UINT i = 0; i < subresourceCount; ++i)
+            {
+                subresources[i].pData = job.FileData.data() + layout[i].Offset;
+                subresources[i].RowPitch = layout[i].RowPitch;
+                subresources[i].SlicePitch = layout[i].SlicePitch;
+            }
+
+            CopySubresourceRows(staging, job.Footprints.data(), numRows.data(), rowSizes.data(),
+                subresources.data(), subresourceCount, 1);
+        }
+        job.UploadHeap->Unmap(0, nullptr);
+
+        return hr;
+    }
+}
+
+HRESULT CreateDDSTexturesFromFiles12(ID3D12Device* device,
+    ID3D12GraphicsCommandList* cmdList,
+    const std::vector<Texture*>& textures,
+    UINT workerCount,
+    UINT64 maxBufferedBytes)
+{
+    if (!device || !cmdList)
+    {
+        return E_INVALIDARG;
+    }
+
+    std::vector<LoadJob> jobs(textures.size());
+    for (size_t i = 0; i < textures.size(); ++i)
+    {
+        jobs[i].Tex = textures[i];
+    }
+
+    if (workerCount == 0)
+    {
+        // The I/O thread and the calling thread take one hardware thread each.
+        workerCount = (std::max)(std::thread::hardware_concurrency(), 3u) - 2;
+    }
+    workerCount = (std::min)(workerCount, (std::max)((UINT)jobs.size(), 1u));
+
+    std::mutex mutex;
+    std::condition_variable readCondition;		// a file was read or buffered data freed
+    std::condition_variable preparedCondition;	// a job is ready for its copies
+    std::deque<size_t> readJobs;
+    std::deque<size_t> preparedJobs;
+    UINT64 bufferedBytes = 0;
+    bool readingDone = false;
+
+    std::thread ioThread([&]() {
+        for (size_t i = 0; i < jobs.size(); ++i)
+        {
+            {
+                // Don't read ahead of the workers without bound, big batches would hold
+                // every file in memory at once.
+                std::unique_lock<std::mutex> lock(mutex);
+                readCondition.wait(lock, [&]() { return bufferedBytes == 0 || bufferedBytes < maxBufferedBytes; });
+            }
+
+            LoadJob& job = jobs[i];
+            job.Result = d3dUtil::ReadWholeFile(job.Tex->Filename, job.FileData);
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (SUCCEEDED(job.Result))
+                {
+                    bufferedBytes += job.FileData.size();
+                    readJobs.push_back(i);
+                }
+                else
+                {
+                    preparedJobs.push_back(i);
+                }
+            }
+            readCondition.notify_all();
+            preparedCondition.notify_one();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            readingDone = true;
+        }
+        readCondition.notify_all();
+    });
+
+    auto workerMain = [&]() {
+        for (;;)
+        {
+            size_t index = 0;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                readCondition.wait(lock, [&]() { return !readJobs.empty() || readingDone; });
+                if (readJobs.empty())
+                {
+                    return;
+                }
+                index = readJobs.front();
+                readJobs.pop_front();
+            }
+
+            LoadJob& job = jobs[index];
+            job.Result = PrepareTexture(device, job);
+
+            const UINT64 fileSize = job.FileData.size();
+            job.FileData = std::vector<uint8_t>();
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                bufferedBytes -= fileSize;
+                preparedJobs.push_back(index);
+            }
+            readCondition.notify_all();
+            preparedCondition.notify_one();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (UINT i = 0; i < workerCount; ++i)
+    {
+        workers.emplace_back(workerMain);
+    }
+
+    // Record the copies as textures come in, in whatever order they finish.
+    HRESULT result = S_OK;
+    std::vector<D3D12_RESOURCE_BARRIER> barriers;
+    for (size_t recorded = 0; recorded < jobs.size(); ++recorded)
+    {
+        size_t index = 0;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            preparedCondition.wait(lock, [&]() { return !preparedJobs.empty(); });
+            index = preparedJobs.front();
+            preparedJobs.pop_front();
+        }
+
+        LoadJob& job = jobs[index];
+        if (FAILED(job.Result))
+        {
+            if (SUCCEEDED(result))
+            {
+                result = job.Result;
+            }
+            continue;
+        }
+
+        for (UINT i = 0; i < (UINT)job.Footprints.size(); ++i)
+        {
+            cmdList->CopyTextureRegion(
+                &CD3DX12_TEXTURE_COPY_LOCATION(job.Resource.Get(), i), 0, 0, 0,
+                &CD3DX12_TEXTURE_COPY_LOCATION(job.UploadHeap.Get(), job.Footprints[i]), nullptr);
+        }
+        barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(job.Resource.Get(),
+            D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
+
+        job.Tex->Resource = std::move(job.Resource);
+        job.Tex->UploadHeap = std::move(job.UploadHeap);
+    }
+
+    ioThread.join();
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+
+    if (!barriers.empty())
+    {
+        cmdList->ResourceBarrier((UINT)barriers.size(), barriers.data());
+    }
+
+    return result;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "d3dUtil.h"
+
+// Loads a batch of DDS textures as a pipeline instead of one after the other: an I/O
+// thread reads the files in order, worker threads parse them, create the resources and
+// fill the upload heaps, and the calling thread only records the copies. Startup time is
+// then bound by the slowest of the three stages rather than their sum. Compressed .ddz
+// files (CompressedTexture.h) are decompressed by the workers.
+//
+// Creates Resource and UploadHeap of every texture from its Filename and records the
+// uploads into cmdList, leaving the textures in PIXEL_SHADER_RESOURCE. The upload heaps
+// must stay alive until cmdList has executed. At most maxBufferedBytes of file data wait
+// for a worker at any time. workerCount 0 picks one per spare hardware thread.
+// Returns the first failure, the textures that failed are left without a Resource.
+HRESULT CreateDDSTexturesFromFiles12(ID3D12Device* device,
+	ID3D12GraphicsCommandList* cmdList,
+	const std::vector<Texture*>& textures,
+	UINT workerCount = 0,
+	UINT64 maxBufferedBytes = 64ull << 20);
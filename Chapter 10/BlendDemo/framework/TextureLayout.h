@@ -0,0 +1,56 @@
+#pragma once
+
+#include "d3dUtil.h"
+
+// CPU implementation of the D3D12 placed footprint rules, so upload buffers can be sized
+// and filled without asking the device, e.g. on loader threads before the texture exists.
+//
+// Every row of a footprint starts on a D3D12_TEXTURE_DATA_PITCH_ALIGNMENT (256 byte)
+// boundary and every subresource on a D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT (512 byte)
+// one. A row is a row of blocks for block compressed formats. Planar formats (video
+// formats and depth-stencil) have one subresource per plane, each with its own format.
+
+// How one plane of a format is stored.
+struct FormatPlaneLayout
+{
+	DXGI_FORMAT Format = DXGI_FORMAT_UNKNOWN;	// format of the plane's footprint
+	UINT BlockWidth = 1;						// texels per block
+	UINT BlockHeight = 1;
+	UINT BitsPerBlock = 0;
+	UINT SubsampleShiftX = 0;					// plane size relative to the texture
+	UINT SubsampleShiftY = 0;
+};
+
+// 0 for formats BitsPerPixel doesn't know.
+UINT GetFormatPlaneCount(DXGI_FORMAT format);
+
+// False when the format or plane is unknown.
+bool GetFormatPlaneLayout(DXGI_FORMAT format, UINT plane, FormatPlaneLayout& layout);
+
+// Same contract as ID3D12Device::GetCopyableFootprints: fills whichever outputs are not
+// null for subresources [firstSubresource, firstSubresource + numSubresources) placed
+// from baseOffset. totalBytes doesn't include baseOffset nor the padding of the last row.
+// Returns false (and sets totalBytes to UINT64_MAX) when the description is not valid.
+bool ComputeCopyableFootprints(const D3D12_RESOURCE_DESC& desc,
+	UINT firstSubresource, UINT numSubresources, UINT64 baseOffset,
+	D3D12_PLACED_SUBRESOURCE_FOOTPRINT* layouts, UINT* numRows, UINT64* rowSizes, UINT64* totalBytes);
+
+// memcpy with non-temporal stores, for write-combined upload memory that the CPU never
+// reads back, so there is no point in pulling it into the cache. The stores are weakly
+// ordered, the writing thread must _mm_sfence before the GPU is told to read.
+void StreamToUploadMemory(uint8_t* dst, const uint8_t* src, size_t size);
+
+// Copies the rows of srcData into mapped staging memory laid out as layouts (offsets are
+// relative to staging). Uses non-temporal stores, the staging memory is write-combined and
+// only read by the GPU. Large copies are split across threadCount threads, 0 picks one
+// per hardware thread.
+void CopySubresourceRows(uint8_t* staging,
+	const D3D12_PLACED_SUBRESOURCE_FOOTPRINT* layouts, const UINT* numRows, const UINT64* rowSizes,
+	const D3D12_SUBRESOURCE_DATA* srcData, UINT numSubresources, UINT threadCount = 0);
+
+// Replaces the d3dx12 UpdateSubresources: lays the subresources out in uploadHeap from
+// uploadOffset, copies them with CopySubresourceRows and records the copies into
+// destination. Returns the bytes used in uploadHeap, 0 on failure.
+UINT64 UploadSubresources(ID3D12GraphicsCommandList* cmdList,
+	ID3D12Resource* destination, ID3D12Resource* uploadHeap, UINT64 uploadOffset,
+	UINT firstSubresource, UINT numSubresources, const D3D12_SUBRESOURCE_DATA* srcData);
@@ -105,6 +105,24 @@ ComPtr<ID3DBlob> d3dUtil::LoadBinary(const std::wstring& filename)
     return blob;
 }
 
+HRESULT d3dUtil::ReadWholeFile(const std::wstring& filename, std::vector<uint8_t>& data)
+{
+    std::ifstream fin(filename, std::ios::binary | std::ios::ate);
+    if (!fin)
+    {
+        return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+    }
+
+    data.resize((size_t)fin.tellg());
+    fin.seekg(0, std::ios_base::beg);
+    if (!fin.read((char*)data.data(), data.size()))
+    {
+        return HRESULT_FROM_WIN32(ERROR_READ_FAULT);
+    }
+
+    return S_OK;
+}
+
 DxgiInfoManager::DxgiInfoManager()
 {
             /* Code copy from chili hw3d */
@@ -62,6 +62,9 @@ public:
 		const std::string& target);
 
 	static ComPtr<ID3DBlob> LoadBinary(const std::wstring& filename);
+	// Reads the whole file into data. Unlike LoadBinary, a missing or short file is an
+	// error rather than a blob of whatever was read.
+	static HRESULT ReadWholeFile(const std::wstring& filename, std::vector<uint8_t>& data);
 };
 
 struct SubmeshGeometry {
@@ -124,6 +127,12 @@ struct MaterialConstants {
 
 	// Used in texture mapping.
 	XMFLOAT4X4 MatTransform = MathHelper::Identity4x4();
+
+	// Used by flipbook materials whose diffuse map is a Texture2DArray,
+	// the slice is picked from gTotalTime in the shader.
+	UINT FlipbookFrameCount = 0;
+	float FlipbookFramesPerSecond = 0.0f;
+	XMFLOAT2 MaterialPad = { 0.0f, 0.0f };
 };
 
 struct Material {
@@ -150,6 +159,10 @@ struct Material {
 	XMFLOAT3 FresnelR0 = { 0.01f, 0.01f, 0.01f };
 	float Roughness = .25f;
 	XMFLOAT4X4 MatTransform = MathHelper::Identity4x4();
+
+	// Number of slices of a flipbook diffuse map and its playback rate.
+	UINT FlipbookFrameCount = 0;
+	float FlipbookFramesPerSecond = 0.0f;
 };
 
 // The Light struct in hlsl is 16-byte aligned, so the layout of variables matters.
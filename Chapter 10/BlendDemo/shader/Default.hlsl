@@ -14,7 +14,12 @@
 // Include structures and functions for lighting.
 #include "LightingUtil.hlsl"
 
+#ifdef FLIPBOOK
+// All frames of the animation live in one array, one slice per frame.
+Texture2DArray gDiffuseMap : register(t0);
+#else
 Texture2D gDiffuseMap : register(t0);
+#endif
 
 SamplerState gsamPointWrap          : register(s0);
 SamplerState gsamPointClamp         : register(s1);
@@ -70,6 +75,9 @@ cbuffer cbMaterial : register(b2)
     float3 gFresnelR0;
     float gRoughness;
     float4x4 gMatTransform;
+    uint gFlipbookFrameCount;
+    float gFlipbookFramesPerSecond;
+    float2 cbMaterialPad;
 };
 
 struct VertexIn
@@ -110,7 +118,17 @@ VertexOut VS(VertexIn vin)
 
 float4 PS(VertexOut pin) : SV_TARGET
 {
+#ifdef FLIPBOOK
+    // Pick the current frame from the total time, so the animation needs no per-frame
+    // updates on the CPU.
+    float slice = fmod(floor(gTotalTime * gFlipbookFramesPerSecond), (float)gFlipbookFrameCount);
+    float4 diffuseAlbedo = gDiffuseMap.Sample(gsamAnisotropicWrap, float3(pin.TexC, slice)) * gDiffuseAlbedo;
+
+    // Flipbook effects are emissive and additively blended, lighting does not apply.
+    return diffuseAlbedo;
+#else
     float4 diffuseAlbedo = gDiffuseMap.Sample(gsamAnisotropicWrap, pin.TexC) * gDiffuseAlbedo;
+#endif
 
 #ifdef ALPHA_TEST
     // Discard pixel if texture alpha < 0.1.  We do this test as soon 
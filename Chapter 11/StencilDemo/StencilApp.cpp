@@ -2,8 +2,75 @@
 #include "framework/FrameResource.h"
 #include "framework/GeometryGenerator.h"
 #include "framework/DDSTextureLoader.h"
+#include "framework/TextureStreamer.h"
+#include "framework/TextureAtlas.h"
+#include "framework/UploadRing.h"
+#include "framework/GeometryArena.h"
+#include "framework/DeferredRelease.h"
+#include "framework/DescriptorHeap.h"
+#include "framework/FrameLatency.h"
+#include "framework/ResourceMemory.h"
+#include "framework/AllocationTracker.h"
+#include "framework/FrustumCuller.h"
+#include "framework/DrawKey.h"
+#include "framework/CommandRecorder.h"
+#include "framework/JobSystem.h"
+#include "framework/DirtyBitset.h"
+#include "framework/TransformHierarchy.h"
+
+const int gMaxFrameResources = 3;
+int gNumFrameResources = gMaxFrameResources;
+
+// The visible draws are split into about this many jobs, each recorded into its own
+// command list, but no job gets fewer than gMinDrawsPerJob draws unless its layer has
+// fewer: below that setting up a list costs more than recording it in parallel saves.
+const UINT gMaxRecordingJobs = 8;
+const UINT gMinDrawsPerJob = 64;
+
+// What the object constants and world bounds are computed from, in parallel arrays with
+// one entry per object: updating the changed objects reads their matrices back to back
+// instead of chasing a pointer per render item.
+struct RenderObjects
+{
+    // World matrix of the shape that describes the object's local space
+    // relative to the world space, which defines the position, orientation,
+    // and scale of the object in the world.
+    std::vector<XMFLOAT4X4> World;
+    std::vector<XMFLOAT4X4> TexTransform;
+
+    // Index into GPU constant buffer corresponding to the ObjectCB for this object.
+    std::vector<UINT> ObjCBIndex;
 
-const int gNumFrameResources = 3;
+    // Small index of the geometry for the draw keys.
+    std::vector<UINT> GeometryId;
+
+    // Object space bounds of the submesh drawn, and the center of the world bounds the
+    // depth draws are sorted by.
+    std::vector<BoundingBox> Bounds;
+    std::vector<BoundingSphere> Sphere;
+    std::vector<XMFLOAT3> WorldCenter;
+
+    // Objects whose world bounds must catch up with World. The constant buffers are
+    // tracked per frame resource, in FrameResource::DirtyObjects.
+    DirtyBitset BoundsDirty;
+
+    UINT GetCount() const { return (UINT)World.size(); }
+
+    // Returns the index of the new object, its bounds start dirty.
+    UINT Add(const XMFLOAT4X4& world, UINT objCBIndex, const SubmeshGeometry& submesh)
+    {
+        const UINT index = GetCount();
+        World.push_back(world);
+        TexTransform.push_back(MathHelper::Identity4x4());
+        ObjCBIndex.push_back(objCBIndex);
+        GeometryId.push_back(0);
+        Bounds.push_back(submesh.Bounds);
+        Sphere.push_back(submesh.Sphere);
+        WorldCenter.push_back(submesh.Bounds.Center);
+        BoundsDirty.Resize(index + 1, true);
+        return index;
+    }
+};
 
 // Lightweight structure stores parameters to draw a shape.  This will
 // vary from app-to-app.
@@ -11,21 +78,9 @@ struct RenderItem
 {
     RenderItem() = default;
 
-    // World matrix of the shape that describes the object's local space
-    // relative to the world space, which defines the position, orientation,
-    // and scale of the object in the world.
-    XMFLOAT4X4 World = MathHelper::Identity4x4();
-
-    XMFLOAT4X4 TexTransform = MathHelper::Identity4x4();
-
-    // Dirty flag indicating the object data has changed and we need to update the constant buffer.
-    // Because we have an object cbuffer for each FrameResource, we have to apply the
-    // update to each FrameResource.  Thus, when we modify obect data we should set 
-    // NumFramesDirty = gNumFrameResources so that each frame resource gets the update.
-    int NumFramesDirty = gNumFrameResources;
-
-    // Index into GPU constant buffer corresponding to the ObjectCB for this render item.
-    UINT ObjCBIndex = -1;
+    // Index of the item's transform in RenderObjects, and of its world bounds in the
+    // frustum culler. Items drawn in several layers share it.
+    UINT Object = 0;
 
     // The geometry to be drawn. Note, one geometry may need multiple render items.
     MeshGeometry* Geo = nullptr;
@@ -54,7 +109,8 @@ enum class RenderLayer : int
 
 class StencilApp : public App {
 public:
-    StencilApp(HINSTANCE hInstanceHandle);
+    // framesInFlight is 2 or 3, or 0 to let FrameLatencyController pick.
+    StencilApp(HINSTANCE hInstanceHandle, int framesInFlight = 0);
     StencilApp(const StencilApp&) = delete;
     StencilApp& operator=(const StencilApp&) = delete;
     ~StencilApp() {}
@@ -65,6 +121,7 @@ private:
     virtual void Update(const GameTimer& gt) override;
     virtual void Draw(const GameTimer& gt) override;
     virtual void OnResize() override;
+    virtual std::wstring GetFrameStatsText() const override;
 
     void LoadTexture();
     void BuildRootSignature();
@@ -77,15 +134,41 @@ private:
     void BuildFrameResources();
     void BuildPSOs();
 
+    void SetFramesInFlight(int count);
+    void UpdateTextureSrvs();
     void UpdateObjectCBs(const GameTimer& gt);
     void UpdateMaterialCBs(const GameTimer& gt);
     void UpdateMainPassCB(const GameTimer& gt);
     void UpdateReflectedPassCB(const GameTimer& gt);
+
+    // Moves the world bounds of the object in the culler to its current World.
+    void UpdateWorldBounds(UINT object);
+    // Sets the world matrix of an object and marks it dirty.
+    void SetObjectWorld(UINT object, FXMMATRIX world);
+    // Adds a node moving object to mTransforms.
+    UINT AddTransformNode(UINT parent, TransformKind kind, FXMMATRIX matrix, UINT object);
+    XMMATRIX GetSkullWorld() const;
+    // Flattens the skull onto the floor, away from the main light.
+    XMMATRIX GetShadowTransform() const;
+    // Fills mVisibleRitemLayer with the items of each layer in the view frustum, in
+    // submission order.
+    void CullRenderItems();
+    // Culls the reflected items against the frustum seen through the visible mirrors.
+    void CullReflectedItems(const XMFLOAT4X4& viewProj);
+    // coherent when ritems are still in the order of the previous sort.
+    void SortRenderItems(RenderLayer layer, std::vector<RenderItem*>& ritems, bool coherent = false);
+    // True when the view jumped or turned enough since the last call to reorder most of
+    // the blended items.
+    bool DetectCameraCut();
     
     // Once the data changed by input, notify the GPU.
     void OnKeyboardInput(const GameTimer& gt);
 
-    void DrawRenderItems(const std::vector<RenderItem*>& ritems);
+    // Splits the visible layers into mRecordingJobs.
+    void BuildRecordingJobs();
+    // Records mRecordingJobs[index] into its command list, on any thread.
+    void RecordDrawJob(UINT index);
+    void DrawRenderItems(CommandRecorder& recorder, std::span<RenderItem* const> ritems);
 
     float GetHillsHeight(float x, float z) const;
     XMFLOAT3 GetHillsNormal(float x, float z) const;
@@ -106,36 +189,125 @@ private:
     // List of all the render items.
     std::vector<std::unique_ptr<RenderItem>> mAllRitems;
 
+    // What the object constants of the render items are built from.
+    RenderObjects mObjects;
+
+    // Where the objects are, the reflections and the shadow derive from the object they
+    // mirror or project. mNodeObjects holds the object each node moves.
+    TransformHierarchy mTransforms;
+    std::vector<UINT> mNodeObjects;
+
     // Render items divided by PSO.
     std::vector<RenderItem*> mRitemLayer[(int)RenderLayer::Count];
 
+    // The items of each layer that survived this frame's culling, what Draw submits.
+    std::vector<RenderItem*> mVisibleRitemLayer[(int)RenderLayer::Count];
+    FrustumCuller mFrustumCuller;
+
+    // Kept from frame to frame so sorting doesn't allocate.
+    DrawKeySorter mDrawKeySorter;
+    XMFLOAT3 mLastSortEye = { 0.f, 0.f, 0.f };
+    XMFLOAT3 mLastSortForward = { 0.f, 0.f, 0.f };
+    std::vector<DrawEntry> mDrawEntries;
+    std::vector<RenderItem*> mSortScratch;
+
+    // The pipeline state, pass and stencil reference each drawn layer starts with.
+    struct LayerState
+    {
+        ID3D12PipelineState* Pso = nullptr;
+        D3D12_GPU_VIRTUAL_ADDRESS PassCB = 0;
+        UINT StencilRef = 0;
+    };
+
+    // A range of one layer's visible items, recorded into the frame resource's
+    // RecordingLists[i] for the i-th job.
+    struct RecordingJob
+    {
+        RenderLayer Layer = RenderLayer::Opaque;
+        UINT Begin = 0;
+        UINT End = 0;
+    };
+
+    LayerState mLayerStates[(int)RenderLayer::Count];
+    std::vector<RecordingJob> mRecordingJobs;
+    std::vector<ID3D12CommandList*> mSubmittedLists;
+    JobSystem mJobSystem;
+
+    // One per job, each records its command list without rebinding state.
+    std::vector<CommandRecorder> mRecorders;
+    CommandRecorderStats mLastFrameCommandStats;
+    // Constant buffer bytes the last update wrote into its frame resource.
+    UINT64 mLastFrameObjectCBBytes = 0;
+    UINT64 mLastFrameMaterialCBBytes = 0;
+
     // Pack the data to be transfered to the GPU constant buffer.
     PassConstants mMainPassCB;
     PassConstants mReflectedPassCB;
+
+    // Per-frame constants, written into mUploadRing every frame.
+    std::unique_ptr<UploadRing> mUploadRing;
+    D3D12_GPU_VIRTUAL_ADDRESS mMainPassCBAddress = 0;
+    D3D12_GPU_VIRTUAL_ADDRESS mReflectedPassCBAddress = 0;
     
     std::unordered_map<std::string, ComPtr<ID3DBlob>> mShaders;
     std::unordered_map<std::string, ComPtr<ID3D12PipelineState>> mPSOs;
+    // Looked up once by BuildPSOs, a lookup by string key in Draw would allocate the key.
+    ID3D12PipelineState* mLayerPsos[(int)RenderLayer::Count] = {};
+    ID3D12PipelineState* mOpaqueWireframePso = nullptr;
     std::unordered_map<std::string, std::unique_ptr<MeshGeometry>> mGeometries;
+
+    // Vertex and index buffers of every mesh in mGeometries.
+    std::unique_ptr<StaticGeometryArena> mGeometryArena;
+
+    // Upload heaps of the initialization copies, released once the GPU executed them.
+    DeferredReleaseQueue mDeferredReleases;
     std::unordered_map<std::string, std::unique_ptr<Material>> mMaterials;
     std::unordered_map<std::string, std::unique_ptr<Texture>> mTextures;
 
+    // Texture SRVs, and room for transient tables.
+    std::unique_ptr<DescriptorHeap> mSrvDescriptors;
+
+    // Regions of the atlas holding the material textures.
+    TextureAtlas mTextureAtlas;
+
+    // Streams the finer mips of the large textures under a memory budget.
+    std::unique_ptr<TextureStreamer> mTextureStreamer;
+
     bool mIsWireFrame = false;
 
-    RenderItem* mSkullRitem = nullptr;
-    RenderItem* mReflectedSkullRitem = nullptr;
-    RenderItem* mShadowedSkullRitem = nullptr;
+    // Frames in flight chosen by the user, 0 when mFrameLatency picks them.
+    int mFixedFramesInFlight = 0;
+    FrameLatencyController mFrameLatency{ 2, gMaxFrameResources };
+
+    bool mDumpMemoryKeyDown = false;
+
+    UINT mSkullNode = 0;
     XMFLOAT3 mSkullTranslation{ 1.f, 0.f, -5.f };
+
+    // Fixed, the shadow transform is only derived once.
+    XMFLOAT3 mMainLightDirection{ 0.57735f, -0.57735f, 0.57735f };
+
+    // Plane of the mirrors, Ax+By+Cz+D=0, here z=0.
+    XMFLOAT4 mMirrorPlane{ 0.f, 0.f, 1.f, 0.f };
 };
 
-StencilApp::StencilApp(HINSTANCE hInstanceHandle) :
-    App(hInstanceHandle)
+StencilApp::StencilApp(HINSTANCE hInstanceHandle, int framesInFlight) :
+    App(hInstanceHandle),
+    mFixedFramesInFlight(framesInFlight)
 {
+    if (framesInFlight != 0)
+    {
+        gNumFrameResources = std::clamp(framesInFlight, 2, gMaxFrameResources);
+        mFixedFramesInFlight = gNumFrameResources;
+    }
 }
 
 bool StencilApp::Initialize()
 {
     if (!App::Initialize()) { return false; }
 
+    AllocationScope scope("Initialize");
+
     // Reset the command list to prep for initialization commands.
     mCommandList->Reset(mDirectCmdListAlloc.Get(), nullptr) >> chk;
 
@@ -144,8 +316,10 @@ bool StencilApp::Initialize()
     BuildRootSignature();
     BuildDescriptorHeaps();
     BuildShadersAndInputLayout();
+    mGeometryArena = std::make_unique<StaticGeometryArena>();
     BuildRoomGeometry();
     BuildSkullGeometry();
+    mGeometryArena->Upload(md3dDevice.Get(), mCommandList.Get(), mGpuMemory.get());
     BuildMaterials();
     BuildRenderItems();
     BuildFrameResources();
@@ -156,8 +330,18 @@ bool StencilApp::Initialize()
     ID3D12CommandList* cmdsLists[] = { mCommandList.Get() };
     mCommandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
 
-    // Wait until initialization is complete.
-    FlushCommandQueue();
+    // No need to wait for the initialization: the upload memory is released once the
+    // GPU reaches this fence, and CPU copies of the meshes are only kept on request.
+    mCommandQueue->Signal(mFence.Get(), ++mCurrentFence) >> chk;
+    mGeometryArena->ReleaseStaging(mDeferredReleases, mCurrentFence);
+    for (auto& e : mGeometries)
+    {
+        ReleaseUploadData(mDeferredReleases, mCurrentFence, *e.second, true);
+    }
+    for (auto& e : mTextures)
+    {
+        ReleaseUploadData(mDeferredReleases, mCurrentFence, *e.second);
+    }
 
     return true;
 }
@@ -168,43 +352,32 @@ void StencilApp::Update(const GameTimer& gt)
 
     OnKeyboardInput(gt);
 
+    SetFramesInFlight(mFixedFramesInFlight != 0 ? mFixedFramesInFlight : mFrameLatency.GetFramesInFlight());
+
     // Cycle through the circular frame resource array.
     mCurrFrameResourceIndex = (mCurrFrameResourceIndex + 1) % gNumFrameResources;
     mCurrFrameResource = mFrameResources[mCurrFrameResourceIndex].get();
 
     // Has the GPU finished processing the commands of the current frame resource?
     // If not, wait until the GPU has completed commands up to this fence point.
-    if (mCurrFrameResource->Fence != 0 &&
-        mFence->GetCompletedValue() < mCurrFrameResource->Fence)
-    {
-        HANDLE eventHandle = CreateEventEx(nullptr, false, false, EVENT_ALL_ACCESS);
-        mFence->SetEventOnCompletion(mCurrFrameResource->Fence, eventHandle);
-        if (eventHandle)
-        {
-            WaitForSingleObject(eventHandle, INFINITE);
-            CloseHandle(eventHandle);
-        }
-        else
-        {
-            DWORD errorCode = GetLastError();
-            LPVOID lpMsgBuf = 0;
-            FormatMessage(
-                FORMAT_MESSAGE_ALLOCATE_BUFFER |
-                FORMAT_MESSAGE_FROM_SYSTEM |
-                FORMAT_MESSAGE_IGNORE_INSERTS,
-                NULL,
-                errorCode,
-                MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT),
-                (LPTSTR)&lpMsgBuf,
-                0, NULL);
-            throw std::runtime_error((char*)lpMsgBuf);
-        }
-    }
+    WaitForFence(mCurrFrameResource->Fence);
+    mFrameLatency.Update(mFrameWaitMs, gt.DeltaTime() * 1000.0);
+
+    // Whatever the frames before the current one allocated and the GPU is done with.
+    mUploadRing->Retire(mFence->GetCompletedValue());
+    mDeferredReleases.Collect(mFence->GetCompletedValue());
+    mSrvDescriptors->BeginFrame(mCurrFrameResourceIndex, mFence->GetCompletedValue());
 
+    UpdateTextureSrvs();
     UpdateObjectCBs(gt);
     UpdateMainPassCB(gt);
+    CullRenderItems();
     UpdateReflectedPassCB(gt);
     UpdateMaterialCBs(gt);
+
+    // The writers are closed, the ranges are final.
+    mLastFrameObjectCBBytes = mCurrFrameResource->ObjectCB->GetDirtyBytes();
+    mLastFrameMaterialCBBytes = mCurrFrameResource->MaterialCB->GetDirtyBytes();
 }
 
 void StencilApp::Draw(const GameTimer& gt)
@@ -212,18 +385,23 @@ void StencilApp::Draw(const GameTimer& gt)
     auto& cmdListAlloc = mCurrFrameResource->CmdListAlloc;
     cmdListAlloc->Reset() >> chk;
 
-    if (mIsWireFrame)
-    {
-        mCommandList->Reset(cmdListAlloc.Get(), mPSOs["opaqueWireframe"].Get()) >> chk;
-    }
-    else
+    // mCommandList only records the uploads, the transition and the clears, the draws go
+    // to the recording lists and are submitted after it.
+    mCommandList->Reset(cmdListAlloc.Get(), nullptr) >> chk;
+
+    // Apply the texture residency changes and upload the mips streamed in since the
+    // last frame, the materials sampling them pick up the changes from the next update on.
+    if (mTextureStreamer->RecordUploads(mCommandList.Get(), mCurrentFence + 1, mFence->GetCompletedValue()))
     {
-        mCommandList->Reset(cmdListAlloc.Get(), mPSOs["opaque"].Get()) >> chk;
+        for (auto& e : mMaterials)
+        {
+            if (e.second->DiffuseMap)
+            {
+                e.second->NumFramesDirty = gNumFrameResources;
+            }
+        }
     }
 
-    mCommandList->RSSetViewports(1, &mScreenViewport);
-    mCommandList->RSSetScissorRects(1, &mScissorRect);
-
     // Indicate a state transition on the resource usage.
     mCommandList->ResourceBarrier(1,
         &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
@@ -236,70 +414,60 @@ void StencilApp::Draw(const GameTimer& gt)
     mCommandList->ClearDepthStencilView(DepthStencilView(),
         D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, 1.0f, 0, 0, nullptr);
 
-    // Specify the buffers we are going to render to.
-    mCommandList->OMSetRenderTargets(1, &CurrentBackBufferView(), true, &DepthStencilView());
-
-    // Set descriptor heaps on command list.
-    ID3D12DescriptorHeap* descHeaps[] = { mSrvHeap.Get() };
-    mCommandList->SetDescriptorHeaps(_countof(descHeaps), descHeaps);
-
-    mCommandList->SetGraphicsRootSignature(mRootSignature.Get());
-
-    auto passCBByteSize = d3dUtil::CalculateConstantBufferByteSize(sizeof(PassConstants));
-    auto passCB = mCurrFrameResource->PassCB->Resource();
-
-    mCommandList->SetGraphicsRootConstantBufferView(2, passCB->GetGPUVirtualAddress());
-
     //
-    // Rendering opaque objects first.
+    // Opaque objects first, then the mirror marked in the stencil buffer, the reflected
+    // objects in the marked area with the reflected pass, the transparent objects and the
+    // shadow. A list doesn't inherit anything from the previous one, each job starts
+    // with the whole state of its layer.
     //
 
-    DrawRenderItems(mRitemLayer[(int)RenderLayer::Opaque]);
-
-    //
-    // Marking stencil area. Rendering into stencil buffer, not back buffer.
-    //
-
-    mCommandList->OMSetStencilRef(1);
-    mCommandList->SetPipelineState(mPSOs["markStencil"].Get());
-    DrawRenderItems(mRitemLayer[(int)RenderLayer::MarkStencil]);
-
-    //
-    // Drawing reflected objects in stencil area. Need to switch pass to reflectedPass first.
-    //
-
-    mCommandList->SetGraphicsRootConstantBufferView(2, passCB->GetGPUVirtualAddress() + (UINT64)1 * passCBByteSize);
-    mCommandList->SetPipelineState(mPSOs["reflectedStencil"].Get());
-    DrawRenderItems(mRitemLayer[(int)RenderLayer::ReflectedStencil]);
-
-    //
-    // Rendering transparent objects after opaque objects. Need to switch pass back to mainPass.
-    //
-
-    mCommandList->SetGraphicsRootConstantBufferView(2, passCB->GetGPUVirtualAddress());
-    mCommandList->SetPipelineState(mPSOs["transparent"].Get());
-    DrawRenderItems(mRitemLayer[(int)RenderLayer::Transparent]);
-
-    //
-    // Rendering shadow
-    //
+    mLayerStates[(int)RenderLayer::Opaque] = {
+        mIsWireFrame ? mOpaqueWireframePso : mLayerPsos[(int)RenderLayer::Opaque], mMainPassCBAddress, 0 };
+    mLayerStates[(int)RenderLayer::MarkStencil] = { mLayerPsos[(int)RenderLayer::MarkStencil], mMainPassCBAddress, 1 };
+    mLayerStates[(int)RenderLayer::ReflectedStencil] = {
+        mLayerPsos[(int)RenderLayer::ReflectedStencil], mReflectedPassCBAddress, 1 };
+    mLayerStates[(int)RenderLayer::Transparent] = { mLayerPsos[(int)RenderLayer::Transparent], mMainPassCBAddress, 1 };
+    mLayerStates[(int)RenderLayer::Shadow] = { mLayerPsos[(int)RenderLayer::Shadow], mMainPassCBAddress, 0 };
+
+    // Drawn textures are also the ones the residency manager sharpens. The streamer
+    // isn't thread safe, they are marked here rather than by the jobs.
+    for (int i = 0; i < (int)RenderLayer::Count; ++i)
+    {
+        for (const RenderItem* ri : mVisibleRitemLayer[i])
+        {
+            if (ri->Mat->DiffuseMap)
+            {
+                mTextureStreamer->MarkUsed(*ri->Mat->DiffuseMap);
+            }
+        }
+    }
 
-    mCommandList->OMSetStencilRef(0);
-    mCommandList->SetPipelineState(mPSOs["shadow"].Get());
-    DrawRenderItems(mRitemLayer[(int)RenderLayer::Shadow]);
+    BuildRecordingJobs();
+    mJobSystem.ParallelFor((uint32_t)mRecordingJobs.size(), [this](uint32_t i) { RecordDrawJob(i); });
 
-    // Indicate a state transition on the resource usage.
-    mCommandList->ResourceBarrier(1,
+    // Back to present at the end of the last list.
+    ID3D12GraphicsCommandList* lastList = mRecordingJobs.empty() ?
+        mCommandList.Get() : mCurrFrameResource->RecordingLists[mRecordingJobs.size() - 1].Get();
+    lastList->ResourceBarrier(1,
         &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
             D3D12_RESOURCE_STATE_RENDER_TARGET,
             D3D12_RESOURCE_STATE_PRESENT));
 
     // Done recording commands.
     mCommandList->Close() >> chk;
+    mSubmittedLists.clear();
+    mSubmittedLists.push_back(mCommandList.Get());
+    mLastFrameCommandStats = {};
+    for (UINT i = 0; i < (UINT)mRecordingJobs.size(); ++i)
+    {
+        ID3D12GraphicsCommandList* cmdList = mCurrFrameResource->RecordingLists[i].Get();
+        cmdList->Close() >> chk;
+        mSubmittedLists.push_back(cmdList);
+        mLastFrameCommandStats += mRecorders[i].GetStats();
+    }
 
-    // Add the command list to the queue for execution.
-    ID3D12CommandList* cmdsLists[] = { mCommandList.Get() };
-    mCommandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
+    // Add the command lists to the queue for execution, in layer order.
+    mCommandQueue->ExecuteCommandLists((UINT)mSubmittedLists.size(), mSubmittedLists.data());
 
     // swap the back and front buffers
     mSwapChain->Present(0, 0) >> chk;
@@ -312,6 +480,16 @@ void StencilApp::Draw(const GameTimer& gt)
     // Because we are on the GPU timeline, the new fence point won't be 
     // set until the GPU finishes processing all the commands prior to this Signal().
     mCommandQueue->Signal(mFence.Get(), mCurrentFence) >> chk;
+
+    // This frame's transient allocations are freed once the GPU reaches the fence.
+    mUploadRing->EndFrame(mCurrentFence);
+}
+
+std::wstring StencilApp::GetFrameStatsText() const
+{
+    return std::format(L"   state calls: {} issued, {} filtered   draws: {}   lists: {}   cb writes: {} B objects, {} B materials",
+        mLastFrameCommandStats.GetIssuedCount(), mLastFrameCommandStats.GetFilteredCount(), mLastFrameCommandStats.Draws,
+        mSubmittedLists.size(), mLastFrameObjectCBBytes, mLastFrameMaterialCBBytes);
 }
 
 void StencilApp::OnResize()
@@ -321,50 +499,34 @@ void StencilApp::OnResize()
 
 void StencilApp::LoadTexture()
 {
-    auto checkboardTex = std::make_unique<Texture>();
-    checkboardTex->Name = "checkboardTex";
-    checkboardTex->Filename = L"textures/checkboard.dds";
-    CreateDDSTextureFromFile12(
-        md3dDevice.Get(),
-        mCommandList.Get(),
-        checkboardTex->Filename.c_str(),
-        checkboardTex->Resource,
-        checkboardTex->UploadHeap) >> chk;
-
-    auto bricksTex = std::make_unique<Texture>();
-    bricksTex->Name = "bricksTex";
-    bricksTex->Filename = L"textures/bricks3.dds";
-    CreateDDSTextureFromFile12(
-        md3dDevice.Get(),
-        mCommandList.Get(),
-        bricksTex->Filename.c_str(),
-        bricksTex->Resource,
-        bricksTex->UploadHeap) >> chk;
-
-    auto iceTex = std::make_unique<Texture>();
-    iceTex->Name = "iceTex";
-    iceTex->Filename = L"textures/ice.dds";
-    CreateDDSTextureFromFile12(
-        md3dDevice.Get(),
-        mCommandList.Get(),
-        iceTex->Filename.c_str(),
-        iceTex->Resource,
-        iceTex->UploadHeap) >> chk;
-
-    auto white1x1Tex = std::make_unique<Texture>();
-    white1x1Tex->Name = "white1x1Tex";
-    white1x1Tex->Filename = L"textures/white1x1.dds";
-    CreateDDSTextureFromFile12(
-        md3dDevice.Get(),
-        mCommandList.Get(),
-        white1x1Tex->Filename.c_str(),
-        white1x1Tex->Resource,
-        white1x1Tex->UploadHeap) >> chk;
-
-    mTextures[checkboardTex->Name] = std::move(checkboardTex);
-    mTextures[bricksTex->Name] = std::move(bricksTex);
-    mTextures[iceTex->Name] = std::move(iceTex);
-    mTextures[white1x1Tex->Name] = std::move(white1x1Tex);
+    // Streamed textures are drawable as soon as their small mips are uploaded,
+    // the rest arrives over the following frames.
+    mTextureStreamer = std::make_unique<TextureStreamer>(md3dDevice.Get());
+
+    // The material textures share one atlas, and so one SRV. It is built on the first
+    // run, delete both files to rebuild it.
+    const wchar_t* atlasFilename = L"textures/atlas.dds";
+    const wchar_t* atlasTableFilename = L"textures/atlas.txt";
+    if (GetFileAttributesW(atlasFilename) == INVALID_FILE_ATTRIBUTES ||
+        FAILED(LoadTextureAtlasTable(atlasTableFilename, mTextureAtlas)))
+    {
+        const std::vector<AtlasSource> sources = {
+            { "checkboardTex", L"textures/checkboard.dds" },
+            { "bricksTex", L"textures/bricks3.dds" },
+            { "iceTex", L"textures/ice.dds" },
+            { "white1x1Tex", L"textures/white1x1.dds", AtlasAddressMode::Clamp },
+        };
+        BuildTextureAtlas(sources, TextureAtlasOptions(), mTextureAtlas) >> chk;
+        SaveTextureAtlas(atlasFilename, atlasTableFilename, mTextureAtlas) >> chk;
+        mTextureAtlas.Data = std::vector<uint8_t>();
+    }
+
+    auto atlasTex = std::make_unique<Texture>();
+    atlasTex->Name = "atlasTex";
+    atlasTex->Filename = atlasFilename;
+    mTextureStreamer->CreateTexture(mCommandList.Get(), *atlasTex) >> chk;
+
+    mTextures[atlasTex->Name] = std::move(atlasTex);
 }
 
 void StencilApp::BuildRootSignature()
@@ -424,49 +586,13 @@ void StencilApp::BuildRootSignature()
 void StencilApp::BuildDescriptorHeaps()
 {
     //
-    // Create the SRV heap.
-    //
-    D3D12_DESCRIPTOR_HEAP_DESC srvHeapDesc = {};
-    srvHeapDesc.NumDescriptors = 4;
-    srvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-    srvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-    md3dDevice->CreateDescriptorHeap(&srvHeapDesc, IID_PPV_ARGS(&mSrvHeap)) >> chk;
-
+    // Create the SRV heap. Textures get their SRVs from its persistent region as they
+    // are loaded or replaced, UpdateTextureSrvs creates them.
     //
-    // Fill out the heap with actual descriptors.
-    //   
-    CD3DX12_CPU_DESCRIPTOR_HANDLE hDescriptor(
-        mSrvHeap->GetCPUDescriptorHandleForHeapStart());
-
-    const auto& checkboardTex = mTextures["checkboardTex"]->Resource;
-    const auto& bricksTex = mTextures["bricksTex"]->Resource;
-    const auto& iceTex = mTextures["iceTex"]->Resource;
-    const auto& white1x1Tex = mTextures["white1x1Tex"]->Resource;
-
-    D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-    srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-    srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-    srvDesc.Texture2D.MostDetailedMip = 0;
-    srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
-
-    srvDesc.Format = checkboardTex->GetDesc().Format;
-    srvDesc.Texture2D.MipLevels = checkboardTex->GetDesc().MipLevels;
-    md3dDevice->CreateShaderResourceView(checkboardTex.Get(), &srvDesc, hDescriptor);
-
-    srvDesc.Format = bricksTex->GetDesc().Format;
-    srvDesc.Texture2D.MipLevels = bricksTex->GetDesc().MipLevels;
-    hDescriptor.Offset(1, mCbvSrvUavDescriptorSize);    // next descriptor
-    md3dDevice->CreateShaderResourceView(bricksTex.Get(), &srvDesc, hDescriptor);
-
-    srvDesc.Format = iceTex->GetDesc().Format;
-    srvDesc.Texture2D.MipLevels = iceTex->GetDesc().MipLevels;
-    hDescriptor.Offset(1, mCbvSrvUavDescriptorSize);    // next descriptor
-    md3dDevice->CreateShaderResourceView(iceTex.Get(), &srvDesc, hDescriptor);
-
-    srvDesc.Format = white1x1Tex->GetDesc().Format;
-    srvDesc.Texture2D.MipLevels = white1x1Tex->GetDesc().MipLevels;
-    hDescriptor.Offset(1, mCbvSrvUavDescriptorSize);    // next descriptor
-    md3dDevice->CreateShaderResourceView(white1x1Tex.Get(), &srvDesc, hDescriptor);
+    const UINT persistentCount = 256;
+    const UINT transientCountPerFrame = 64;
+    mSrvDescriptors = std::make_unique<DescriptorHeap>(md3dDevice.Get(),
+        persistentCount, transientCountPerFrame, gMaxFrameResources);
 }
 
 void StencilApp::BuildShadersAndInputLayout()
@@ -568,6 +694,11 @@ void StencilApp::BuildRoomGeometry()
     mirrorSubmesh.StartIndexLocation = 24;
     mirrorSubmesh.BaseVertexLocation = 0;
 
+    for (SubmeshGeometry* submesh : { &floorSubmesh, &wallSubmesh, &mirrorSubmesh })
+    {
+        d3dUtil::ComputeSubmeshBounds(*submesh, vertices.data(), sizeof(Vertex), (const std::uint16_t*)indices.data());
+    }
+
     const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
     const UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint16_t);
 
@@ -580,16 +711,11 @@ void StencilApp::BuildRoomGeometry()
     D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU);
     CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
 
-    geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-        mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
-
-    geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-        mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
-
     geo->VertexByteStride = sizeof(Vertex);
     geo->VertexBufferByteSize = vbByteSize;
     geo->IndexFormat = DXGI_FORMAT_R16_UINT;
     geo->IndexBufferByteSize = ibByteSize;
+    mGeometryArena->Add(geo.get());
 
     geo->DrawArgs["floor"] = floorSubmesh;
     geo->DrawArgs["wall"] = wallSubmesh;
@@ -623,21 +749,17 @@ void StencilApp::BuildSkullGeometry()
     D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU) >> chk;
     CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
 
-    geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-        mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
-
-    geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-        mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
-
     geo->VertexByteStride = sizeof(Vertex);
     geo->VertexBufferByteSize = vbByteSize;
     geo->IndexFormat = DXGI_FORMAT_R16_UINT;
     geo->IndexBufferByteSize = ibByteSize;
+    mGeometryArena->Add(geo.get());
 
     SubmeshGeometry skullSubmesh;
     skullSubmesh.IndexCount = (UINT)indices.size();
     skullSubmesh.StartIndexLocation = 0;
     skullSubmesh.BaseVertexLocation = 0;
+    d3dUtil::ComputeSubmeshBounds(skullSubmesh, vertices.data(), sizeof(Vertex), indices.data());
 
     geo->DrawArgs["skull"] = skullSubmesh;
 
@@ -646,10 +768,22 @@ void StencilApp::BuildSkullGeometry()
 
 void StencilApp::BuildMaterials()
 {
+    // Every material samples its region of the atlas.
+    Texture* atlasTex = mTextures["atlasTex"].get();
+    auto atlasRect = [this](const char* name) {
+        const AtlasRegion* region = mTextureAtlas.Find(name);
+        if (!region)
+        {
+            throw std::runtime_error(std::format("{} is missing from the texture atlas", name));
+        }
+        return mTextureAtlas.GetUVRect(*region);
+    };
+
     auto checkboardMat = std::make_unique<Material>();
     checkboardMat->Name = "checkboardMat";
     checkboardMat->MatCBIndex = 0;
-    checkboardMat->DiffuseSrvHeapIndex = 0;
+    checkboardMat->DiffuseMap = atlasTex;
+    checkboardMat->DiffuseAtlasRect = atlasRect("checkboardTex");
     checkboardMat->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
     checkboardMat->FresnelR0 = XMFLOAT3(0.07f, 0.07f, 0.07f);
     checkboardMat->Roughness = 0.3f;
@@ -657,7 +791,8 @@ void StencilApp::BuildMaterials()
     auto bricksMat = std::make_unique<Material>();
     bricksMat->Name = "bricksMat";
     bricksMat->MatCBIndex = 1;
-    bricksMat->DiffuseSrvHeapIndex = 1;
+    bricksMat->DiffuseMap = atlasTex;
+    bricksMat->DiffuseAtlasRect = atlasRect("bricksTex");
     bricksMat->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
     bricksMat->FresnelR0 = XMFLOAT3(0.05f, 0.05f, 0.05f);
     bricksMat->Roughness = 0.25f;
@@ -665,7 +800,8 @@ void StencilApp::BuildMaterials()
     auto iceMat = std::make_unique<Material>();
     iceMat->Name = "iceMat";
     iceMat->MatCBIndex = 2;
-    iceMat->DiffuseSrvHeapIndex = 2;
+    iceMat->DiffuseMap = atlasTex;
+    iceMat->DiffuseAtlasRect = atlasRect("iceTex");
     iceMat->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 0.3f);
     iceMat->FresnelR0 = XMFLOAT3(0.1f, 0.1f, 0.1f);
     iceMat->Roughness = 0.5f;
@@ -673,7 +809,8 @@ void StencilApp::BuildMaterials()
     auto skullMat = std::make_unique<Material>();
     skullMat->Name = "skullMat";
     skullMat->MatCBIndex = 3;
-    skullMat->DiffuseSrvHeapIndex = 3;
+    skullMat->DiffuseMap = atlasTex;
+    skullMat->DiffuseAtlasRect = atlasRect("white1x1Tex");
     skullMat->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.f);
     skullMat->FresnelR0 = XMFLOAT3(0.05f, 0.05f, 0.05f);
     skullMat->Roughness = 0.3f;
@@ -681,7 +818,8 @@ void StencilApp::BuildMaterials()
     auto shadowMat = std::make_unique<Material>();
     shadowMat->Name = "shadowMat";
     shadowMat->MatCBIndex = 4;
-    shadowMat->DiffuseSrvHeapIndex = 3;
+    shadowMat->DiffuseMap = atlasTex;
+    shadowMat->DiffuseAtlasRect = atlasRect("white1x1Tex");
     shadowMat->DiffuseAlbedo = XMFLOAT4(0.f, 0.f, 0.f, 0.5f);
     shadowMat->FresnelR0 = XMFLOAT3(0.001f, 0.001f, 0.001f);
     shadowMat->Roughness = 0.f;
@@ -696,9 +834,6 @@ void StencilApp::BuildMaterials()
 void StencilApp::BuildRenderItems()
 {
     auto floorRitem = std::make_unique<RenderItem>();
-    floorRitem->World = MathHelper::Identity4x4();
-    floorRitem->TexTransform = MathHelper::Identity4x4();
-    floorRitem->ObjCBIndex = 0;
     floorRitem->Geo = mGeometries["roomGeo"].get();
     floorRitem->Mat = mMaterials["checkboardMat"].get();
     floorRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
@@ -706,11 +841,9 @@ void StencilApp::BuildRenderItems()
     floorRitem->IndexCount = floorSubmesh.IndexCount;
     floorRitem->StartIndexLocation = floorSubmesh.StartIndexLocation;
     floorRitem->BaseVertexLocation = floorSubmesh.BaseVertexLocation;
+    floorRitem->Object = mObjects.Add(MathHelper::Identity4x4(), 0, floorSubmesh);
 
     auto wallRitem = std::make_unique<RenderItem>();
-    wallRitem->World = MathHelper::Identity4x4();
-    wallRitem->TexTransform = MathHelper::Identity4x4();
-    wallRitem->ObjCBIndex = 1;
     wallRitem->Geo = mGeometries["roomGeo"].get();
     wallRitem->Mat = mMaterials["bricksMat"].get();
     wallRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
@@ -718,11 +851,9 @@ void StencilApp::BuildRenderItems()
     wallRitem->IndexCount = wallSubmesh.IndexCount;
     wallRitem->StartIndexLocation = wallSubmesh.StartIndexLocation;
     wallRitem->BaseVertexLocation = wallSubmesh.BaseVertexLocation;
+    wallRitem->Object = mObjects.Add(MathHelper::Identity4x4(), 1, wallSubmesh);
 
     auto mirrorRitem = std::make_unique<RenderItem>();
-    mirrorRitem->World = MathHelper::Identity4x4();
-    mirrorRitem->TexTransform = MathHelper::Identity4x4();
-    mirrorRitem->ObjCBIndex = 2;
     mirrorRitem->Geo = mGeometries["roomGeo"].get();
     mirrorRitem->Mat = mMaterials["iceMat"].get();
     mirrorRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
@@ -730,11 +861,9 @@ void StencilApp::BuildRenderItems()
     mirrorRitem->IndexCount = mirrorSubmesh.IndexCount;
     mirrorRitem->StartIndexLocation = mirrorSubmesh.StartIndexLocation;
     mirrorRitem->BaseVertexLocation = mirrorSubmesh.BaseVertexLocation;
+    mirrorRitem->Object = mObjects.Add(MathHelper::Identity4x4(), 2, mirrorSubmesh);
 
     auto skullRitem = std::make_unique<RenderItem>();
-    skullRitem->World = MathHelper::Identity4x4();
-    skullRitem->TexTransform = MathHelper::Identity4x4();
-    skullRitem->ObjCBIndex = 3;
     skullRitem->Geo = mGeometries["skullGeo"].get();
     skullRitem->Mat = mMaterials["skullMat"].get();
     skullRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
@@ -742,18 +871,16 @@ void StencilApp::BuildRenderItems()
     skullRitem->IndexCount = skullSubmesh.IndexCount;
     skullRitem->StartIndexLocation = skullSubmesh.StartIndexLocation;
     skullRitem->BaseVertexLocation = skullSubmesh.BaseVertexLocation;
-    mSkullRitem = skullRitem.get();
+    skullRitem->Object = mObjects.Add(MathHelper::Identity4x4(), 3, skullSubmesh);
 
     auto reflectedSkullRitem = std::make_unique<RenderItem>();
     *reflectedSkullRitem = *skullRitem;
-    reflectedSkullRitem->ObjCBIndex = 4;
-    mReflectedSkullRitem = reflectedSkullRitem.get();
+    reflectedSkullRitem->Object = mObjects.Add(MathHelper::Identity4x4(), 4, skullSubmesh);
 
     auto shadowedSkullRitem = std::make_unique<RenderItem>();
     *shadowedSkullRitem = *skullRitem;
-    shadowedSkullRitem->ObjCBIndex = 5;
+    shadowedSkullRitem->Object = mObjects.Add(MathHelper::Identity4x4(), 5, skullSubmesh);
     shadowedSkullRitem->Mat = mMaterials["shadowMat"].get();
-    mShadowedSkullRitem = shadowedSkullRitem.get();
 
     //
     // exercise 11: reflecting floor
@@ -761,10 +888,22 @@ void StencilApp::BuildRenderItems()
 
     auto reflectedFloorRitem = std::make_unique<RenderItem>();
     *reflectedFloorRitem = *floorRitem;
-    reflectedFloorRitem->ObjCBIndex = 6;
-    XMVECTOR mirrorPlane = XMVectorSet(0.f, 0.f, 1.f, 0.f);   // Ax+By+Cz+D=0, here z=0
-    XMMATRIX R = XMMatrixReflect(mirrorPlane);
-    XMStoreFloat4x4(&reflectedFloorRitem->World, R);
+    reflectedFloorRitem->Object = mObjects.Add(MathHelper::Identity4x4(), 6, floorSubmesh);
+
+    //
+    // Transforms, depth first. The reflections and the shadow are derived from the
+    // object they show, moving the skull moves them too.
+    //
+
+    XMMATRIX R = XMMatrixReflect(XMLoadFloat4(&mMirrorPlane));
+
+    const UINT floorNode = AddTransformNode(TransformHierarchy::NoParent, TransformKind::Local, XMMatrixIdentity(), floorRitem->Object);
+    AddTransformNode(floorNode, TransformKind::Derived, R, reflectedFloorRitem->Object);
+    AddTransformNode(TransformHierarchy::NoParent, TransformKind::Local, XMMatrixIdentity(), wallRitem->Object);
+    AddTransformNode(TransformHierarchy::NoParent, TransformKind::Local, XMMatrixIdentity(), mirrorRitem->Object);
+    mSkullNode = AddTransformNode(TransformHierarchy::NoParent, TransformKind::Local, GetSkullWorld(), skullRitem->Object);
+    AddTransformNode(mSkullNode, TransformKind::Derived, R, reflectedSkullRitem->Object);
+    AddTransformNode(mSkullNode, TransformKind::Derived, GetShadowTransform(), shadowedSkullRitem->Object);
 
 
     mRitemLayer[(int)RenderLayer::Opaque].push_back(floorRitem.get());
@@ -787,15 +926,36 @@ void StencilApp::BuildRenderItems()
     mAllRitems.push_back(std::move(reflectedSkullRitem));
     mAllRitems.push_back(std::move(reflectedFloorRitem));
     mAllRitems.push_back(std::move(shadowedSkullRitem));
+
+    // World bounds are set by the first UpdateObjectCBs, every object starts dirty.
+    mFrustumCuller.Resize(mObjects.GetCount());
+    std::unordered_map<const MeshGeometry*, UINT> geometryIds;
+    for (auto& ri : mAllRitems)
+    {
+        mObjects.GeometryId[ri->Object] = geometryIds.try_emplace(ri->Geo, (UINT)geometryIds.size()).first->second;
+    }
+    for (int i = 0; i < (int)RenderLayer::Count; ++i)
+    {
+        mVisibleRitemLayer[i].reserve(mRitemLayer[i].size());
+    }
+    mDrawEntries.reserve(mAllRitems.size());
+    mSortScratch.reserve(mAllRitems.size());
 }
 
 void StencilApp::BuildFrameResources()
 {
-    for (int i = 0; i < gNumFrameResources; ++i)
+    // Splitting each layer on its own adds at most one job per layer to gMaxRecordingJobs.
+    const UINT recordingListCount = gMaxRecordingJobs + (UINT)RenderLayer::Count;
+    for (int i = 0; i < gMaxFrameResources; ++i)
     {
         mFrameResources.push_back(std::make_unique<FrameResource>(
-            md3dDevice.Get(), 2, (UINT)mAllRitems.size(), (UINT)mMaterials.size()));
+            md3dDevice.Get(), mObjects.GetCount(), (UINT)mMaterials.size(), recordingListCount));
     }
+    mRecorders.resize(recordingListCount);
+    mRecordingJobs.reserve(recordingListCount);
+    mSubmittedLists.reserve(recordingListCount + 1);
+
+    mUploadRing = std::make_unique<UploadRing>(md3dDevice.Get());
 }
 
 void StencilApp::BuildPSOs()
@@ -959,35 +1119,286 @@ void StencilApp::BuildPSOs()
 
     md3dDevice->CreateGraphicsPipelineState(&opaqueWireframePsoDesc,
         IID_PPV_ARGS(&mPSOs["opaqueWireframe"])) >> chk;
+
+    mLayerPsos[(int)RenderLayer::Opaque] = mPSOs["opaque"].Get();
+    mLayerPsos[(int)RenderLayer::MarkStencil] = mPSOs["markStencil"].Get();
+    mLayerPsos[(int)RenderLayer::ReflectedStencil] = mPSOs["reflectedStencil"].Get();
+    mLayerPsos[(int)RenderLayer::Transparent] = mPSOs["transparent"].Get();
+    mLayerPsos[(int)RenderLayer::Shadow] = mPSOs["shadow"].Get();
+    mOpaqueWireframePso = mPSOs["opaqueWireframe"].Get();
 }
 
 void StencilApp::UpdateObjectCBs(const GameTimer& gt)
 {
+    // Objects below a node that moved, the reflections and the shadow with the skull.
+    mTransforms.Update([this](UINT node, const XMFLOAT4X4& world) {
+        SetObjectWorld(mNodeObjects[node], XMLoadFloat4x4(&world));
+    });
+
+    // The bounds follow a change once, the constant buffers once per frame resource.
+    mObjects.BoundsDirty.ConsumeEach([this](uint32_t object) { UpdateWorldBounds(object); });
+
     auto currObjectCB = mCurrFrameResource->ObjectCB.get();
+    currObjectCB->ResetDirtyRange();
+    auto objectWriter = currObjectCB->Map();
+
+    // Only the objects changed since this frame resource was last written.
+    mCurrFrameResource->DirtyObjects.ConsumeEach([&](uint32_t object) {
+        ObjectConstants objConstants;
+        XMMATRIX world = XMLoadFloat4x4(&mObjects.World[object]);
+        XMMATRIX texTransform = XMLoadFloat4x4(&mObjects.TexTransform[object]);
+        XMStoreFloat4x4(&objConstants.World, XMMatrixTranspose(world));
+        XMStoreFloat4x4(&objConstants.TexTransform, XMMatrixTranspose(texTransform));
+
+        objectWriter.Write(mObjects.ObjCBIndex[object], objConstants);
+    });
+}
 
-    for (auto& ri : mAllRitems)
+void StencilApp::SetObjectWorld(UINT object, FXMMATRIX world)
+{
+    XMStoreFloat4x4(&mObjects.World[object], world);
+    mObjects.BoundsDirty.Set(object);
+    for (auto& frameResource : mFrameResources)
+    {
+        frameResource->DirtyObjects.Set(object);
+    }
+}
+
+UINT StencilApp::AddTransformNode(UINT parent, TransformKind kind, FXMMATRIX matrix, UINT object)
+{
+    XMFLOAT4X4 m;
+    XMStoreFloat4x4(&m, matrix);
+    mNodeObjects.push_back(object);
+    return mTransforms.Add(parent, kind, m);
+}
+
+XMMATRIX StencilApp::GetSkullWorld() const
+{
+    XMMATRIX skullRotate = XMMatrixRotationY(XM_PIDIV2);
+    XMMATRIX skullScale = XMMatrixScaling(0.45f, 0.45f, 0.45f);
+    XMMATRIX skullOffset = XMMatrixTranslation(mSkullTranslation.x, mSkullTranslation.y, mSkullTranslation.z);
+    return skullRotate * skullScale * skullOffset;
+}
+
+XMMATRIX StencilApp::GetShadowTransform() const
+{
+    XMVECTOR shadowPlane = XMVectorSet(0.f, 1.f, 0.f, 0.f);
+    XMVECTOR toMainLight = -XMLoadFloat3(&mMainLightDirection);
+    XMMATRIX S = XMMatrixShadow(shadowPlane, toMainLight);
+    XMMATRIX shadowOffsetY = XMMatrixTranslation(0.f, 0.001f, 0.f);
+    return S * shadowOffsetY;
+}
+
+void StencilApp::UpdateWorldBounds(UINT object)
+{
+    const XMMATRIX world = XMLoadFloat4x4(&mObjects.World[object]);
+    const BoundingSphere& localSphere = mObjects.Sphere[object];
+
+    // Through the corners, with the divide by w: the planar shadow matrix is projective.
+    XMFLOAT3 corners[BoundingBox::CORNER_COUNT];
+    mObjects.Bounds[object].GetCorners(corners);
+    XMVECTOR minCorner = g_XMFltMax;
+    XMVECTOR maxCorner = XMVectorNegate(g_XMFltMax);
+    for (const XMFLOAT3& corner : corners)
+    {
+        const XMVECTOR p = XMVector3TransformCoord(XMLoadFloat3(&corner), world);
+        minCorner = XMVectorMin(minCorner, p);
+        maxCorner = XMVectorMax(maxCorner, p);
+    }
+    BoundingBox box;
+    BoundingBox::CreateFromPoints(box, minCorner, maxCorner);
+
+    // The sphere grows by at most the Frobenius norm of the linear part, which holds for
+    // any scale or shear. The sphere around the world box is taken when it is tighter.
+    const XMVECTOR localCenter = XMLoadFloat3(&localSphere.Center);
+    const XMVECTOR center = XMVector3TransformCoord(localCenter, world);
+    float stretchSq = 0.f;
+    for (const XMVECTOR axis : { g_XMIdentityR0.v, g_XMIdentityR1.v, g_XMIdentityR2.v })
+    {
+        const XMVECTOR offset = XMVectorSubtract(XMVector3TransformCoord(XMVectorAdd(localCenter, axis), world), center);
+        stretchSq += XMVectorGetX(XMVector3LengthSq(offset));
+    }
+    BoundingSphere sphere;
+    XMStoreFloat3(&sphere.Center, center);
+    sphere.Radius = localSphere.Radius * sqrtf(stretchSq);
+
+    const float boxRadius = XMVectorGetX(XMVector3Length(XMLoadFloat3(&box.Extents)));
+    if (boxRadius < sphere.Radius)
+    {
+        sphere = BoundingSphere(box.Center, boxRadius);
+    }
+
+    mObjects.WorldCenter[object] = box.Center;
+
+    const float boxCenter[3] = { box.Center.x, box.Center.y, box.Center.z };
+    const float boxExtents[3] = { box.Extents.x, box.Extents.y, box.Extents.z };
+    const float sphereCenter[3] = { sphere.Center.x, sphere.Center.y, sphere.Center.z };
+    mFrustumCuller.SetBounds(object, boxCenter, boxExtents, sphereCenter, sphere.Radius);
+}
+
+void StencilApp::CullRenderItems()
+{
+    XMFLOAT4X4 viewProj;
+    XMStoreFloat4x4(&viewProj, XMMatrixMultiply(mView, mProj));
+    mFrustumCuller.SetViewProj(viewProj.m);
+    mFrustumCuller.Cull();
+
+    // Blended items keep their back to front order from frame to frame: the whole layer
+    // is sorted in place before culling, items coming back into view are already where
+    // they belong. The order is nearly right unless the camera cut.
+    const bool cameraCut = DetectCameraCut();
+    SortRenderItems(RenderLayer::Transparent, mRitemLayer[(int)RenderLayer::Transparent], !cameraCut);
+
+    for (int i = 0; i < (int)RenderLayer::Count; ++i)
     {
-        // Only update the cbuffer data if the constants have changed.  
-        // This needs to be tracked per frame resource.
-        if (ri->NumFramesDirty > 0)
+        if (i != (int)RenderLayer::ReflectedStencil)
         {
-            ObjectConstants objConstants;
-            XMMATRIX world = XMLoadFloat4x4(&ri->World);
-            XMMATRIX texTransform = XMLoadFloat4x4(&ri->TexTransform);
-            XMStoreFloat4x4(&objConstants.World, XMMatrixTranspose(world));
-            XMStoreFloat4x4(&objConstants.TexTransform, XMMatrixTranspose(texTransform));
+            mFrustumCuller.Compact(mRitemLayer[i], mVisibleRitemLayer[i]);
+        }
+    }
+    CullReflectedItems(viewProj);
 
-            currObjectCB->CopyData(ri->ObjCBIndex, objConstants);
+    for (int i = 0; i < (int)RenderLayer::Count; ++i)
+    {
+        if (i != (int)RenderLayer::Transparent)
+        {
+            SortRenderItems((RenderLayer)i, mVisibleRitemLayer[i]);
+        }
+    }
+}
 
-            // Next FrameResource need to be updated too.
-            ri->NumFramesDirty--;
+bool StencilApp::DetectCameraCut()
+{
+    // Thresholds in world units and in the cosine of the turn, about 25 degrees.
+    constexpr float maxEyeMove = 2.f;
+    constexpr float minForwardDot = 0.9f;
+
+    XMFLOAT4X4 view;
+    XMStoreFloat4x4(&view, mView);
+    const XMVECTOR forward = XMVectorSet(view._13, view._23, view._33, 0.f);
+    const XMVECTOR eye = XMLoadFloat3(&mMainPassCB.EyePosW);
+
+    const bool cut =
+        XMVectorGetX(XMVector3Length(XMVectorSubtract(eye, XMLoadFloat3(&mLastSortEye)))) > maxEyeMove ||
+        XMVectorGetX(XMVector3Dot(forward, XMLoadFloat3(&mLastSortForward))) < minForwardDot;
+
+    XMStoreFloat3(&mLastSortEye, eye);
+    XMStoreFloat3(&mLastSortForward, forward);
+    return cut;
+}
+
+void StencilApp::CullReflectedItems(const XMFLOAT4X4& viewProj)
+{
+    std::vector<RenderItem*>& reflected = mVisibleRitemLayer[(int)RenderLayer::ReflectedStencil];
+    reflected.clear();
+
+    // The stencil only lets the reflections through where a mirror is drawn.
+    const std::vector<RenderItem*>& mirrors = mVisibleRitemLayer[(int)RenderLayer::MarkStencil];
+    if (mirrors.empty())
+    {
+        return;
+    }
+
+    // Screen rectangle of the visible mirrors. A corner behind the eye has no meaningful
+    // projection, the whole screen is kept then.
+    const XMMATRIX vp = XMLoadFloat4x4(&viewProj);
+    float left = 1.f, right = -1.f, bottom = 1.f, top = -1.f;
+    bool wholeScreen = false;
+    for (const RenderItem* mirror : mirrors)
+    {
+        const XMMATRIX world = XMLoadFloat4x4(&mObjects.World[mirror->Object]);
+        XMFLOAT3 corners[BoundingBox::CORNER_COUNT];
+        mObjects.Bounds[mirror->Object].GetCorners(corners);
+        for (const XMFLOAT3& corner : corners)
+        {
+            XMFLOAT4 clip;
+            XMStoreFloat4(&clip, XMVector3Transform(XMVector3TransformCoord(XMLoadFloat3(&corner), world), vp));
+            if (clip.w <= 1e-4f)
+            {
+                wholeScreen = true;
+                break;
+            }
+            left = (std::min)(left, clip.x / clip.w);
+            right = (std::max)(right, clip.x / clip.w);
+            bottom = (std::min)(bottom, clip.y / clip.w);
+            top = (std::max)(top, clip.y / clip.w);
+        }
+    }
+
+    if (wholeScreen)
+    {
+        left = bottom = -1.f;
+        right = top = 1.f;
+    }
+    else
+    {
+        left = (std::max)(left, -1.f);
+        right = (std::min)(right, 1.f);
+        bottom = (std::max)(bottom, -1.f);
+        top = (std::min)(top, 1.f);
+
+        // The mirrors' bounds touched the frustum but the mirrors are off-screen or edge on.
+        if (left >= right || bottom >= top)
+        {
+            return;
         }
     }
+
+    // The near plane moves to the mirror: only what is behind it, as seen from the eye,
+    // shows in it.
+    XMVECTOR plane = XMLoadFloat4(&mMirrorPlane);
+    if (XMVectorGetX(XMPlaneDotCoord(plane, XMLoadFloat3(&mMainPassCB.EyePosW))) > 0.f)
+    {
+        plane = XMVectorNegate(plane);
+    }
+    XMFLOAT4 nearPlane;
+    XMStoreFloat4(&nearPlane, plane);
+    const float nearPlaneArray[4] = { nearPlane.x, nearPlane.y, nearPlane.z, nearPlane.w };
+
+    mFrustumCuller.SetViewProj(viewProj.m, left, right, bottom, top);
+    mFrustumCuller.SetNearPlane(nearPlaneArray);
+    mFrustumCuller.Cull();
+    mFrustumCuller.Compact(mRitemLayer[(int)RenderLayer::ReflectedStencil], reflected);
+}
+
+void StencilApp::SortRenderItems(RenderLayer layer, std::vector<RenderItem*>& ritems, bool coherent)
+{
+    // Every layer is drawn with its own PSO, the layer doubles as the PSO id. Only the
+    // transparent layer blends and must go back to front.
+    const bool backToFront = layer == RenderLayer::Transparent;
+
+    mDrawEntries.clear();
+    for (UINT i = 0; i < (UINT)ritems.size(); ++i)
+    {
+        const RenderItem* ri = ritems[i];
+        const UINT geometryId = mObjects.GeometryId[ri->Object];
+        const float depth = XMVectorGetZ(XMVector3TransformCoord(XMLoadFloat3(&mObjects.WorldCenter[ri->Object]), mView));
+        const uint64_t key = backToFront ?
+            DrawKey::BackToFront((uint32_t)layer, (uint32_t)layer, geometryId, ri->Mat->MatCBIndex, depth) :
+            DrawKey::FrontToBack((uint32_t)layer, (uint32_t)layer, geometryId, ri->Mat->MatCBIndex, depth);
+        mDrawEntries.push_back({ key, i });
+    }
+    if (coherent)
+    {
+        mDrawKeySorter.SortCoherent(mDrawEntries);
+    }
+    else
+    {
+        mDrawKeySorter.Sort(mDrawEntries);
+    }
+
+    mSortScratch.assign(ritems.begin(), ritems.end());
+    for (size_t i = 0; i < mDrawEntries.size(); ++i)
+    {
+        ritems[i] = mSortScratch[mDrawEntries[i].Item];
+    }
 }
 
 void StencilApp::UpdateMaterialCBs(const GameTimer& gt)
 {
     auto currMaterialCB = mCurrFrameResource->MaterialCB.get();
+    currMaterialCB->ResetDirtyRange();
+    auto materialWriter = currMaterialCB->Map();
 
     // Only update the cbuffer data if the constants have changed.  If the cbuffer
     // data changes, it needs to be updated for each FrameResource.
@@ -1004,7 +1415,13 @@ void StencilApp::UpdateMaterialCBs(const GameTimer& gt)
             XMMATRIX matTransform = XMLoadFloat4x4(&mat->MatTransform);
             XMStoreFloat4x4(&matConstants.MatTransform, XMMatrixTranspose(matTransform));
 
-            currMaterialCB->CopyData(mat->MatCBIndex, matConstants);
+            if (mat->DiffuseMap)
+            {
+                matConstants.DiffuseMinMip = (float)mat->DiffuseMap->MostDetailedMip;
+            }
+            matConstants.DiffuseAtlasRect = mat->DiffuseAtlasRect;
+
+            materialWriter.Write(mat->MatCBIndex, matConstants);
 
             // Next FrameResource need to be updated too.
             mat->NumFramesDirty--;
@@ -1012,6 +1429,52 @@ void StencilApp::UpdateMaterialCBs(const GameTimer& gt)
     }
 }
 
+void StencilApp::SetFramesInFlight(int count)
+{
+    // Dropping a frame resource just leaves it out of the cycle. One that joins it missed
+    // the material updates made meanwhile, so they get written to every frame resource
+    // again. Objects keep their dirty bits while out of the cycle.
+    if (count > gNumFrameResources)
+    {
+        for (auto& e : mMaterials)
+        {
+            e.second->NumFramesDirty = count;
+        }
+    }
+    gNumFrameResources = count;
+}
+
+void StencilApp::UpdateTextureSrvs()
+{
+    // Textures loaded or given a new resource since the last frame get a new SRV.
+    for (auto& e : mTextures)
+    {
+        Texture* tex = e.second.get();
+        if (tex->NumFramesDirty > 0)
+        {
+            const auto& resource = tex->Resource;
+
+            D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+            srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+            srvDesc.Format = resource->GetDesc().Format;
+            srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+            srvDesc.Texture2D.MostDetailedMip = 0;
+            srvDesc.Texture2D.MipLevels = resource->GetDesc().MipLevels;
+            srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
+
+            // Frames in flight may still read the old SRV, it is reused once the fence
+            // this frame signals completes. Only streaming replaces a resource after the
+            // first frame, the free list nodes go with its other allocations.
+            AllocationScope scope("TextureStreaming", AllocationRule::Allow);
+            mSrvDescriptors->Free(tex->Srv, mCurrentFence + 1);
+            tex->Srv = mSrvDescriptors->Allocate();
+            md3dDevice->CreateShaderResourceView(resource.Get(), &srvDesc, mSrvDescriptors->CpuHandle(tex->Srv));
+
+            tex->NumFramesDirty = 0;
+        }
+    }
+}
+
 void StencilApp::UpdateMainPassCB(const GameTimer& gt)
 {
     XMMATRIX viewProj = XMMatrixMultiply(mView, mProj);
@@ -1033,23 +1496,28 @@ void StencilApp::UpdateMainPassCB(const GameTimer& gt)
     mMainPassCB.DeltaTime = gt.DeltaTime();
     mMainPassCB.AmbientLight = { 0.25f, 0.25f, 0.35f, 1.0f };
 
-    mMainPassCB.Lights[0].Direction = { 0.57735f, -0.57735f, 0.57735f };
+    mMainPassCB.Lights[0].Direction = mMainLightDirection;
     mMainPassCB.Lights[0].Strength = { 0.9f, 0.9f, 0.9f };
     mMainPassCB.Lights[1].Direction = { -0.57735f, -0.57735f, 0.57735f };
     mMainPassCB.Lights[1].Strength = { 0.5f, 0.5f, 0.5f };
     mMainPassCB.Lights[2].Direction = { 0.0f, -0.707f, -0.707f };
     mMainPassCB.Lights[2].Strength = { 0.2f, 0.2f, 0.2f };
 
-    auto currPassCB = mCurrFrameResource->PassCB.get();
-    currPassCB->CopyData(0, mMainPassCB);
+    mMainPassCBAddress = mUploadRing->AllocateConstants(mMainPassCB);
 }
 
 void StencilApp::UpdateReflectedPassCB(const GameTimer& gt)
 {
+    // Nothing is seen in the mirrors, the reflected pass is skipped.
+    if (mVisibleRitemLayer[(int)RenderLayer::ReflectedStencil].empty())
+    {
+        mReflectedPassCBAddress = 0;
+        return;
+    }
+
     mReflectedPassCB = mMainPassCB;
 
-    XMVECTOR mirrorPlane = XMVectorSet(0.f, 0.f, 1.f, 0.f);
-    XMMATRIX R = XMMatrixReflect(mirrorPlane);
+    XMMATRIX R = XMMatrixReflect(XMLoadFloat4(&mMirrorPlane));
     for (int i = 0; i < 3; ++i)
     {
         XMVECTOR lightDir = XMLoadFloat3(&mMainPassCB.Lights[i].Direction);
@@ -1057,13 +1525,13 @@ void StencilApp::UpdateReflectedPassCB(const GameTimer& gt)
         XMStoreFloat3(&mReflectedPassCB.Lights[i].Direction, reflectedLightDir);
     }
 
-    auto currPassCB = mCurrFrameResource->PassCB.get();
-    currPassCB->CopyData(1, mReflectedPassCB);
+    mReflectedPassCBAddress = mUploadRing->AllocateConstants(mReflectedPassCB);
 }
 
 void StencilApp::OnKeyboardInput(const GameTimer& gt)
 {
     const float dt = gt.DeltaTime();
+    const XMFLOAT3 oldSkullTranslation = mSkullTranslation;
 
     if (GetAsyncKeyState(VK_LEFT) & 0x8000)
         mSkullTranslation.z -= 1.0f * dt;
@@ -1077,29 +1545,92 @@ void StencilApp::OnKeyboardInput(const GameTimer& gt)
     if (GetAsyncKeyState(VK_DOWN) & 0x8000)
         mSkullTranslation.x += 1.0f * dt;
 
-    // Update the new world matrix.
-    XMMATRIX skullRotate = XMMatrixRotationY(XM_PIDIV2);
-    XMMATRIX skullScale = XMMatrixScaling(0.45f, 0.45f, 0.45f);
-    XMMATRIX skullOffset = XMMatrixTranslation(mSkullTranslation.x, mSkullTranslation.y, mSkullTranslation.z);
-    XMMATRIX skullWorld = skullRotate * skullScale * skullOffset;
-    XMStoreFloat4x4(&mSkullRitem->World, skullWorld);
+    // 2 and 3 fix the frames in flight, 0 hands them back to the latency controller.
+    if (GetAsyncKeyState('2') & 0x8000)
+        mFixedFramesInFlight = 2;
 
-    XMVECTOR mirrorPlane = XMVectorSet(0.f, 0.f, 1.f, 0.f);   // Ax+By+Cz+D=0, here z=0
-    XMMATRIX R = XMMatrixReflect(mirrorPlane);
-    XMStoreFloat4x4(&mReflectedSkullRitem->World, skullWorld * R);
+    if (GetAsyncKeyState('3') & 0x8000)
+        mFixedFramesInFlight = 3;
 
-    XMVECTOR shadowPlane = XMVectorSet(0.f, 1.f, 0.f, 0.f);
-    XMVECTOR toMainLight = -XMLoadFloat3(&mMainPassCB.Lights[0].Direction);
-    XMMATRIX S = XMMatrixShadow(shadowPlane, toMainLight);
-    XMMATRIX shadowOffsetY = XMMatrixTranslation(0.f, 0.001f, 0.f);
-    XMStoreFloat4x4(&mShadowedSkullRitem->World, skullWorld * S * shadowOffsetY);
+    if (GetAsyncKeyState('0') & 0x8000)
+        mFixedFramesInFlight = 0;
+
+    // M writes what the GPU memory holds this frame, once per press.
+    const bool dumpMemory = (GetAsyncKeyState('M') & 0x8000) != 0;
+    if (dumpMemory && !mDumpMemoryKeyDown)
+    {
+        AllocationScope scope("MemoryDump", AllocationRule::Allow);
+        std::ofstream file("memory.json");
+        file << MemoryTracker::Get().ToJson(mCurrentFence + 1);
+    }
+    mDumpMemoryKeyDown = dumpMemory;
+
+    // Update the new world matrix, the reflected and shadowed skulls follow in
+    // UpdateObjectCBs. Nothing is marked dirty while the skull stays put.
+    if (XMVector3NotEqual(XMLoadFloat3(&oldSkullTranslation), XMLoadFloat3(&mSkullTranslation)))
+    {
+        mTransforms.SetMatrix(mSkullNode, GetSkullWorld());
+    }
+}
+
+void StencilApp::BuildRecordingJobs()
+{
+    // Submission order of the layers.
+    constexpr RenderLayer drawOrder[] = { RenderLayer::Opaque, RenderLayer::MarkStencil,
+        RenderLayer::ReflectedStencil, RenderLayer::Transparent, RenderLayer::Shadow };
+
+    UINT drawCount = 0;
+    for (RenderLayer layer : drawOrder)
+    {
+        drawCount += (UINT)mVisibleRitemLayer[(int)layer].size();
+    }
+    const UINT drawsPerJob = (std::max)(gMinDrawsPerJob, (drawCount + gMaxRecordingJobs - 1) / gMaxRecordingJobs);
+
+    // Chunks of a layer are even, a layer of 65 draws is two jobs of 33 and 32 rather
+    // than 64 and 1.
+    mRecordingJobs.clear();
+    for (RenderLayer layer : drawOrder)
+    {
+        const UINT count = (UINT)mVisibleRitemLayer[(int)layer].size();
+        const UINT jobCount = (count + drawsPerJob - 1) / drawsPerJob;
+        for (UINT j = 0; j < jobCount; ++j)
+        {
+            mRecordingJobs.push_back({ layer, count * j / jobCount, count * (j + 1) / jobCount });
+        }
+    }
+}
+
+void StencilApp::RecordDrawJob(UINT index)
+{
+    const RecordingJob& job = mRecordingJobs[index];
+    const LayerState& state = mLayerStates[(int)job.Layer];
 
-    mSkullRitem->NumFramesDirty = gNumFrameResources;
-    mReflectedSkullRitem->NumFramesDirty = gNumFrameResources;
-    mShadowedSkullRitem->NumFramesDirty = gNumFrameResources;
+    ID3D12CommandAllocator* cmdListAlloc = mCurrFrameResource->RecordingAllocs[index].Get();
+    ID3D12GraphicsCommandList* cmdList = mCurrFrameResource->RecordingLists[index].Get();
+    cmdListAlloc->Reset() >> chk;
+    cmdList->Reset(cmdListAlloc, state.Pso) >> chk;
+
+    CommandRecorder& recorder = mRecorders[index];
+    recorder.Begin(cmdList, state.Pso);
+    recorder.ResetStats();
+
+    const D3D12_CPU_DESCRIPTOR_HANDLE backBufferView = CurrentBackBufferView();
+    const D3D12_CPU_DESCRIPTOR_HANDLE depthStencilView = DepthStencilView();
+    cmdList->RSSetViewports(1, &mScreenViewport);
+    cmdList->RSSetScissorRects(1, &mScissorRect);
+    cmdList->OMSetRenderTargets(1, &backBufferView, true, &depthStencilView);
+
+    ID3D12DescriptorHeap* descHeaps[] = { mSrvDescriptors->Heap() };
+    recorder.SetDescriptorHeaps(_countof(descHeaps), descHeaps);
+    recorder.SetGraphicsRootSignature(mRootSignature.Get());
+    recorder.SetGraphicsRootConstantBufferView(2, state.PassCB);
+    recorder.OMSetStencilRef(state.StencilRef);
+
+    const std::vector<RenderItem*>& ritems = mVisibleRitemLayer[(int)job.Layer];
+    DrawRenderItems(recorder, std::span(ritems).subspan(job.Begin, job.End - job.Begin));
 }
 
-void StencilApp::DrawRenderItems(const std::vector<RenderItem*>& ritems)
+void StencilApp::DrawRenderItems(CommandRecorder& recorder, std::span<RenderItem* const> ritems)
 {
     UINT objCBByteSize = d3dUtil::CalculateConstantBufferByteSize(
         sizeof(ObjectConstants));   
@@ -1109,26 +1640,28 @@ void StencilApp::DrawRenderItems(const std::vector<RenderItem*>& ritems)
     auto objectCB = mCurrFrameResource->ObjectCB->Resource();
     auto matCB = mCurrFrameResource->MaterialCB->Resource();
 
-    // For each render item...
+    // For each render item... the recorder drops what the previous item already bound,
+    // the sorted items mostly share geometry and the atlas SRV.
     for (const RenderItem* ri: ritems)
     {
-        mCommandList->IASetVertexBuffers(0, 1, &ri->Geo->VertexBufferView());
-        mCommandList->IASetIndexBuffer(&ri->Geo->IndexBufferView());
-        mCommandList->IASetPrimitiveTopology(ri->PrimitiveType);
+        recorder.IASetVertexBuffers(0, 1, &ri->Geo->VertexBufferView());
+        recorder.IASetIndexBuffer(&ri->Geo->IndexBufferView());
+        recorder.IASetPrimitiveTopology(ri->PrimitiveType);
 
-        CD3DX12_GPU_DESCRIPTOR_HANDLE tex(mSrvHeap->GetGPUDescriptorHandleForHeapStart());
-        tex.Offset(ri->Mat->DiffuseSrvHeapIndex, mCbvSrvUavDescriptorSize);
+        if (ri->Mat->DiffuseMap)
+        {
+            recorder.SetGraphicsRootDescriptorTable(0, mSrvDescriptors->GpuHandle(ri->Mat->DiffuseMap->Srv));
+        }
 
         D3D12_GPU_VIRTUAL_ADDRESS objCBAddress = 
-            objectCB->GetGPUVirtualAddress() + (UINT64)ri->ObjCBIndex * objCBByteSize;
+            objectCB->GetGPUVirtualAddress() + (UINT64)mObjects.ObjCBIndex[ri->Object] * objCBByteSize;
         D3D12_GPU_VIRTUAL_ADDRESS matCBAddress = 
             matCB->GetGPUVirtualAddress() + (UINT64)ri->Mat->MatCBIndex * matCBByteSize;
 
-        mCommandList->SetGraphicsRootDescriptorTable(0, tex);
-        mCommandList->SetGraphicsRootConstantBufferView(1, objCBAddress);
-        mCommandList->SetGraphicsRootConstantBufferView(3, matCBAddress);
+        recorder.SetGraphicsRootConstantBufferView(1, objCBAddress);
+        recorder.SetGraphicsRootConstantBufferView(3, matCBAddress);
 
-        mCommandList->DrawIndexedInstanced(ri->IndexCount, 1, 
+        recorder.DrawIndexedInstanced(ri->IndexCount, 1, 
             ri->StartIndexLocation, ri->BaseVertexLocation, 0);
     }
 }
@@ -1288,7 +1821,20 @@ WinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance,
     _In_ PSTR pCmdLine, _In_ int nCmdShow)
 {
     try {
-        StencilApp app(hInstance);
+        // -frames N fixes the number of frames in flight, adaptive otherwise.
+        int framesInFlight = 0;
+        if (const char* arg = strstr(pCmdLine, "-frames "))
+        {
+            framesInFlight = atoi(arg + strlen("-frames "));
+        }
+
+        StencilApp app(hInstance, framesInFlight);
+
+        // -zeroalloc N stops the program on any allocation in Update or Draw after N frames.
+        if (const char* arg = strstr(pCmdLine, "-zeroalloc "))
+        {
+            app.SetAllocationFreeFrames(atoi(arg + strlen("-zeroalloc ")));
+        }
         if (!app.Initialize()) { return 0; }
         return app.Run();
     }
@@ -0,0 +1,273 @@
+#include "AllocationTracker.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+namespace
+{
+    struct AtomicCounters
+    {
+        std::atomic<uint64_t> Allocations;
+        std::atomic<uint64_t> Frees;
+        std::atomic<uint64_t> AllocatedBytes;
+    };
+
+    // Everything here is constant initialized, operator new can run before any dynamic
+    // initializer.
+    std::atomic<const char*> gTags[AllocationTracker::MaxTags] = { "untagged" };
+    AtomicCounters gCurrentFrame[AllocationTracker::MaxTags];
+    AtomicCounters gLastFrame[AllocationTracker::MaxTags];
+    AtomicCounters gTotal[AllocationTracker::MaxTags];
+    std::atomic<uint64_t> gViolationCount;
+    std::atomic<AllocationTracker::ViolationHandler> gViolationHandler;
+
+    thread_local int tTag = 0;
+    thread_local bool tForbidden = false;
+    thread_local bool tInHandler = false;
+
+    void DefaultViolationHandler(const char* tag, size_t size)
+    {
+        char message[192];
+        snprintf(message, sizeof(message),
+            "heap allocation of %zu bytes in allocation free scope \"%s\"\n", size, tag);
+#ifdef _WIN32
+        OutputDebugStringA(message);
+        if (IsDebuggerPresent())
+        {
+            __debugbreak();
+            return;
+        }
+#else
+        fputs(message, stderr);
+#endif
+        std::abort();
+    }
+
+    AllocationCounters Load(const AtomicCounters& counters)
+    {
+        return {
+            counters.Allocations.load(std::memory_order_relaxed),
+            counters.Frees.load(std::memory_order_relaxed),
+            counters.AllocatedBytes.load(std::memory_order_relaxed) };
+    }
+
+    AllocationCounters Sum(const AtomicCounters (&counters)[AllocationTracker::MaxTags])
+    {
+        AllocationCounters sum;
+        for (const AtomicCounters& c : counters)
+        {
+            const AllocationCounters value = Load(c);
+            sum.Allocations += value.Allocations;
+            sum.Frees += value.Frees;
+            sum.AllocatedBytes += value.AllocatedBytes;
+        }
+        return sum;
+    }
+
+    void* AllocateOrThrow(size_t size, size_t alignment)
+    {
+        size = size != 0 ? size : 1;
+        for (;;)
+        {
+#ifdef _MSC_VER
+            void* p = alignment != 0 ? _aligned_malloc(size, alignment) : malloc(size);
+#else
+            void* p = alignment != 0 ? aligned_alloc(alignment, (size + alignment - 1) & ~(alignment - 1)) : malloc(size);
+#endif
+            if (p)
+            {
+                return p;
+            }
+
+            std::new_handler handler = std::get_new_handler();
+            if (!handler)
+            {
+                throw std::bad_alloc();
+            }
+            handler();
+        }
+    }
+}
+
+void AllocationTracker::BeginFrame()
+{
+    for (int i = 0; i < MaxTags; ++i)
+    {
+        gLastFrame[i].Allocations.store(gCurrentFrame[i].Allocations.exchange(0, std::memory_order_relaxed), std::memory_order_relaxed);
+        gLastFrame[i].Frees.store(gCurrentFrame[i].Frees.exchange(0, std::memory_order_relaxed), std::memory_order_relaxed);
+        gLastFrame[i].AllocatedBytes.store(gCurrentFrame[i].AllocatedBytes.exchange(0, std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+}
+
+AllocationCounters AllocationTracker::GetLastFrame()
+{
+    return Sum(gLastFrame);
+}
+
+AllocationCounters AllocationTracker::GetLastFrame(const char* tag)
+{
+    const int index = FindTag(tag);
+    return index >= 0 ? Load(gLastFrame[index]) : AllocationCounters{};
+}
+
+AllocationCounters AllocationTracker::GetTotal()
+{
+    return Sum(gTotal);
+}
+
+AllocationCounters AllocationTracker::GetTotal(const char* tag)
+{
+    const int index = FindTag(tag);
+    return index >= 0 ? Load(gTotal[index]) : AllocationCounters{};
+}
+
+uint64_t AllocationTracker::GetViolationCount()
+{
+    return gViolationCount.load(std::memory_order_relaxed);
+}
+
+void AllocationTracker::SetViolationHandler(ViolationHandler handler)
+{
+    gViolationHandler.store(handler);
+}
+
+void AllocationTracker::OnAllocate(size_t size)
+{
+    const int tag = tTag;
+    gCurrentFrame[tag].Allocations.fetch_add(1, std::memory_order_relaxed);
+    gCurrentFrame[tag].AllocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    gTotal[tag].Allocations.fetch_add(1, std::memory_order_relaxed);
+    gTotal[tag].AllocatedBytes.fetch_add(size, std::memory_order_relaxed);
+
+    // The handler may allocate anyway (a debugger attached, a test recording the
+    // violation), that is not a second violation.
+    if (tForbidden && !tInHandler)
+    {
+        tInHandler = true;
+        gViolationCount.fetch_add(1, std::memory_order_relaxed);
+        ViolationHandler handler = gViolationHandler.load();
+        (handler ? handler : DefaultViolationHandler)(gTags[tag].load(), size);
+        tInHandler = false;
+    }
+}
+
+void AllocationTracker::OnFree()
+{
+    const int tag = tTag;
+    gCurrentFrame[tag].Frees.fetch_add(1, std::memory_order_relaxed);
+    gTotal[tag].Frees.fetch_add(1, std::memory_order_relaxed);
+}
+
+const char* AllocationTracker::GetCurrentTag()
+{
+    return gTags[tTag].load(std::memory_order_relaxed);
+}
+
+AllocationRule AllocationTracker::GetCurrentRule()
+{
+    return tForbidden ? AllocationRule::Forbid : AllocationRule::Allow;
+}
+
+int AllocationTracker::RegisterTag(const char* tag)
+{
+    // Slots are claimed once and never released, a lookup is a walk over the claimed ones.
+    // Slot 0 is never claimed, but GetCurrentTag can give back its name.
+    for (int i = 0; i < MaxTags; ++i)
+    {
+        const char* existing = gTags[i].load(std::memory_order_acquire);
+        if (existing == nullptr && gTags[i].compare_exchange_strong(existing, tag, std::memory_order_acq_rel))
+        {
+            return i;
+        }
+        if (existing == tag || strcmp(existing, tag) == 0)
+        {
+            return i;
+        }
+    }
+    return 0;
+}
+
+int AllocationTracker::FindTag(const char* tag)
+{
+    for (int i = 0; i < MaxTags; ++i)
+    {
+        const char* existing = gTags[i].load(std::memory_order_acquire);
+        if (existing == nullptr)
+        {
+            break;
+        }
+        if (existing == tag || strcmp(existing, tag) == 0)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+AllocationScope::AllocationScope(const char* tag, AllocationRule rule) :
+    mPreviousTag(tTag),
+    mPreviousForbidden(tForbidden)
+{
+    tTag = AllocationTracker::RegisterTag(tag);
+    if (rule != AllocationRule::Inherit)
+    {
+        tForbidden = rule == AllocationRule::Forbid;
+    }
+}
+
+AllocationScope::~AllocationScope()
+{
+    tTag = mPreviousTag;
+    tForbidden = mPreviousForbidden;
+}
+
+// The replaceable global allocation functions. The array and nothrow forms call these by
+// default, so they are counted too.
+void* operator new(size_t size)
+{
+    AllocationTracker::OnAllocate(size);
+    return AllocateOrThrow(size, 0);
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+    AllocationTracker::OnAllocate(size);
+    return AllocateOrThrow(size, (size_t)alignment);
+}
+
+void operator delete(void* p) noexcept
+{
+    if (p)
+    {
+        AllocationTracker::OnFree();
+        free(p);
+    }
+}
+
+void operator delete(void* p, std::align_val_t) noexcept
+{
+    if (p)
+    {
+        AllocationTracker::OnFree();
+#ifdef _MSC_VER
+        _aligned_free(p);
+#else
+        free(p);
+#endif
+    }
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    operator delete(p);
+}
+
+void operator delete(void* p, size_t, std::align_val_t alignment) noexcept
+{
+    operator delete(p, alignment);
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Counts the heap allocations made through the global operator new and delete, which
+// AllocationTracker.cpp replaces, to find the ones hot paths make without showing it
+// (growing containers, string keys, std::function captures...).
+//
+// Each allocation is counted for the current frame, for the whole run and for the tag of
+// the innermost AllocationScope of the allocating thread. A scope can also forbid
+// allocations: any made inside it, nested scopes included, is a violation and goes to the
+// violation handler, which by default reports it and stops the program. The main loop
+// uses that to enforce allocation free Update and Draw once warmed up.
+//
+// malloc, HeapAlloc and the allocations of the D3D runtime itself are not seen.
+struct AllocationCounters
+{
+	uint64_t Allocations = 0;
+	uint64_t Frees = 0;
+	uint64_t AllocatedBytes = 0;
+};
+
+// Forbid makes every allocation in the scope a violation, Allow lifts that for a nested
+// scope (a user triggered dump in a frame that must not allocate), Inherit keeps what the
+// enclosing scope says.
+enum class AllocationRule
+{
+	Inherit,
+	Forbid,
+	Allow
+};
+
+class AllocationTracker
+{
+public:
+	// Tags past the last one share the untagged counters.
+	static constexpr int MaxTags = 32;
+
+	// Called with the tag of the scope forbidding allocations and the requested size.
+	// Runs inside operator new, it must not allocate.
+	using ViolationHandler = void (*)(const char* tag, size_t size);
+
+	// Ends the current frame, its counters are the ones GetLastFrame returns from now on.
+	static void BeginFrame();
+
+	static AllocationCounters GetLastFrame();
+	static AllocationCounters GetLastFrame(const char* tag);
+	static AllocationCounters GetTotal();
+	static AllocationCounters GetTotal(const char* tag);
+
+	static uint64_t GetViolationCount();
+
+	// Tag and rule of the innermost scope of the calling thread, the rule is Forbid or
+	// Allow. Work handed to another thread reopens them there (JobSystem does) to be
+	// tagged and checked like the code that handed it over.
+	static const char* GetCurrentTag();
+	static AllocationRule GetCurrentRule();
+
+	// nullptr restores the default handler.
+	static void SetViolationHandler(ViolationHandler handler);
+
+	// Called by operator new and delete.
+	static void OnAllocate(size_t size);
+	static void OnFree();
+
+private:
+	friend class AllocationScope;
+
+	// 0 is the untagged slot, returned for unknown tags and when the table is full.
+	static int RegisterTag(const char* tag);
+	static int FindTag(const char* tag);
+};
+
+// Tags the allocations the current thread makes during its lifetime. tag must live as
+// long as the program, a string literal.
+class AllocationScope
+{
+public:
+	explicit AllocationScope(const char* tag, AllocationRule rule = AllocationRule::Inherit);
+	~AllocationScope();
+
+	AllocationScope(const AllocationScope&) = delete;
+	AllocationScope& operator=(const AllocationScope&) = delete;
+
+private:
+	int mPreviousTag = 0;
+	bool mPreviousForbidden = false;
+};
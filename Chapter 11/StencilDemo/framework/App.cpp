@@ -1,5 +1,8 @@
 #include "App.h"
+#include "ResourceMemory.h"
+#include "AllocationTracker.h"
 #include <filesystem>
+#include <chrono>
 #include <shlobj.h>
 
 LRESULT CALLBACK
@@ -22,6 +25,10 @@ App::~App()
     {
         FlushCommandQueue();
     }
+    if (mFenceEvent)
+    {
+        CloseHandle(mFenceEvent);
+    }
 }
 
 int App::Run()
@@ -45,8 +52,19 @@ int App::Run()
             if (!mTimer.IsStopped())
             {
                 CalculateFrameStats();
-                Update(mTimer);
-                Draw(mTimer);
+                AllocationTracker::BeginFrame();
+
+                const bool allocationFree = mAllocationWarmUpFrames >= 0 && mFrameCount >= (UINT64)mAllocationWarmUpFrames;
+                const AllocationRule rule = allocationFree ? AllocationRule::Forbid : AllocationRule::Inherit;
+                {
+                    AllocationScope scope("Update", rule);
+                    Update(mTimer);
+                }
+                {
+                    AllocationScope scope("Draw", rule);
+                    Draw(mTimer);
+                }
+                ++mFrameCount;
             }
             else
             {
@@ -330,6 +348,14 @@ bool App::InitDirect3D()
         IID_PPV_ARGS(&md3dDevice)) >> chk ;
     
     md3dDevice->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&mFence)) >> chk;
+
+    mFenceEvent = CreateEventEx(nullptr, nullptr, 0, EVENT_ALL_ACCESS);
+    if (!mFenceEvent)
+    {
+        throw std::runtime_error(std::format("CreateEventEx failed: {}", GetLastError()));
+    }
+
+    mGpuMemory = std::make_unique<GpuMemoryAllocator>(md3dDevice.Get());
     
     mRtvDescriptorSize = md3dDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
     mDsvDescriptorSize = md3dDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_DSV);
@@ -364,6 +390,7 @@ void App::OnResize()
     for (int i = 0; i < SwapChainBufferCount; ++i)
         mSwapChainBuffer[i].Reset();
     mDepthStencilBuffer.Reset();
+    mGpuMemory->Free(mDepthStencilAllocation);
 
     // Resize the swap chain.
     mSwapChain->ResizeBuffers(
@@ -378,6 +405,7 @@ void App::OnResize()
     for (UINT i = 0; i < SwapChainBufferCount; i++)
     {
         mSwapChain->GetBuffer(i, IID_PPV_ARGS(&mSwapChainBuffer[i])) >> chk;
+        TrackResource(mSwapChainBuffer[i].Get(), MemoryCategory::RenderTarget, std::format("SwapChainBuffer{}", i));
         md3dDevice->CreateRenderTargetView(mSwapChainBuffer[i].Get(), nullptr, rtvHeapHandle);
         rtvHeapHandle.Offset(1, mRtvDescriptorSize);
     }
@@ -413,13 +441,9 @@ void App::OnResize()
         },
     };
 
-    md3dDevice->CreateCommittedResource(
-        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-        D3D12_HEAP_FLAG_NONE,
-        &depthStencilDesc,
-        D3D12_RESOURCE_STATE_COMMON,
-        &optClear,
-        IID_PPV_ARGS(&mDepthStencilBuffer)) >> chk;
+    mDepthStencilAllocation = mGpuMemory->CreateResource(depthStencilDesc, D3D12_RESOURCE_STATE_COMMON, &optClear);
+    mDepthStencilBuffer = mDepthStencilAllocation.Resource;
+    TrackResource(mDepthStencilBuffer.Get(), MemoryCategory::RenderTarget, "DepthStencilBuffer");
 
     // Create descriptor to mip level 0 of entire resource using the format of the resource.
     const D3D12_DEPTH_STENCIL_VIEW_DESC dsvDesc = {
@@ -679,9 +703,14 @@ void App::CalculateFrameStats()
 
     static int frameCnt = 0;
     static float timeElapsed = 0.0f;
+    static double waitMs = 0.0;
 
     frameCnt++;
 
+    // The previous frame is over, its fence waits count towards the average.
+    waitMs += mFrameWaitMs;
+    mFrameWaitMs = 0.0;
+
     // Compute averages over one second period.
     if ((mTimer.TotalTime() - timeElapsed) >= 1.0f)
     {
@@ -691,14 +720,22 @@ void App::CalculateFrameStats()
         std::wstring fpsStr = std::to_wstring(fps);
         std::wstring mspfStr = std::to_wstring(mspf);
 
+        const MemoryTotals memory = MemoryTracker::Get().GetTotals();
+        const uint64_t frameAllocations =
+            AllocationTracker::GetLastFrame("Update").Allocations + AllocationTracker::GetLastFrame("Draw").Allocations;
         std::wstring windowText = mMainWndCaption +
             L"    fps: " + fpsStr +
-            L"   mspf: " + mspfStr;
+            L"   mspf: " + mspfStr +
+            std::format(L"   fence wait: {:.2f} ms   frames in flight: {}", waitMs / frameCnt, gNumFrameResources) +
+            std::format(L"   gpu memory: {:.1f} MB (peak {:.1f} MB)", memory.Bytes / 1048576.0, memory.PeakBytes / 1048576.0) +
+            std::format(L"   frame allocations: {}", frameAllocations) +
+            GetFrameStatsText();
 
         SetWindowText(mhMainWnd, windowText.c_str());
 
         // Reset for next average.
         frameCnt = 0;
+        waitMs = 0.0;
         timeElapsed += 1.0f;
     }
 }
@@ -859,18 +896,23 @@ void App::FlushCommandQueue()
     mCommandQueue->Signal(mFence.Get(), mCurrentFence) >> chk;
 
     // Wait until the GPU has completed commands up to this fence point.
-    if (mFence->GetCompletedValue() < mCurrentFence)
+    WaitForFence(mCurrentFence);
+}
+
+void App::WaitForFence(UINT64 fenceValue)
+{
+    if (mFence->GetCompletedValue() >= fenceValue)
     {
-        HANDLE eventHandle = CreateEventEx(nullptr, false, false, EVENT_ALL_ACCESS);
-        assert(eventHandle);
+        return;
+    }
 
-        // Fire event when GPU hits current fence.  
-        mFence->SetEventOnCompletion(mCurrentFence, eventHandle) >> chk;
+    const auto start = std::chrono::steady_clock::now();
 
-        // Wait until the GPU hits current fence event is fired.
-        WaitForSingleObject(eventHandle, INFINITE);
-        CloseHandle(eventHandle);
-    }
+    // Fire event when GPU hits the fence, the event resets itself once the wait returns.
+    mFence->SetEventOnCompletion(fenceValue, mFenceEvent) >> chk;
+    WaitForSingleObject(mFenceEvent, INFINITE);
+
+    mFrameWaitMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
 }
 
 ID3D12Resource* App::CurrentBackBuffer() const
@@ -2,6 +2,7 @@
 
 #include "GameTimer.h"
 #include "d3dUtil.h"
+#include "GpuMemoryAllocator.h"
 
 #if defined(DEBUG) || defined(_DEBUG)
 #define _CRTDBG_MAP_ALLOC
@@ -25,11 +26,18 @@ public:
 
 	virtual bool Initialize();
 
+	// From warmUpFrames frames on, any heap allocation in Update or Draw is a violation
+	// (AllocationTracker.h) and stops the program. Negative turns the check off.
+	void SetAllocationFreeFrames(int warmUpFrames) { mAllocationWarmUpFrames = warmUpFrames; }
+
 protected:
 	virtual void Update(const GameTimer& gt);
 	virtual void Draw(const GameTimer& gt) = 0;
 	virtual void OnResize();
 
+	// Appended to the stats in the window caption.
+	virtual std::wstring GetFrameStatsText() const { return {}; }
+
 	virtual void OnLButtonDown(WPARAM btnState, int x, int y);
 	virtual void OnLButtonUp(WPARAM btnState, int x, int y);
 	virtual void OnMButtonDown(WPARAM btnState, int x, int y);
@@ -71,6 +79,9 @@ protected:
 
 	void FlushCommandQueue();
 
+	// Blocks until the GPU reaches fenceValue, adding the time blocked to mFrameWaitMs.
+	void WaitForFence(UINT64 fenceValue);
+
 	ID3D12Resource* CurrentBackBuffer() const;
 	D3D12_CPU_DESCRIPTOR_HANDLE CurrentBackBufferView() const;
 	D3D12_CPU_DESCRIPTOR_HANDLE DepthStencilView() const;
@@ -85,6 +96,10 @@ protected:
 	static const int SwapChainBufferCount = 2;
 	int mCurrBackBuffer = 0;
 	ComPtr<ID3D12Resource> mSwapChainBuffer[SwapChainBufferCount];
+
+	// Placed resources of the app, the depth stencil buffer among them.
+	std::unique_ptr<GpuMemoryAllocator> mGpuMemory;
+	GpuMemoryAllocator::Allocation mDepthStencilAllocation;
 	ComPtr<ID3D12Resource> mDepthStencilBuffer;
 	
 	ComPtr<IDXGIFactory4> mdxgiFactory;		// Create swap chain
@@ -94,6 +109,16 @@ protected:
 	ComPtr<ID3D12Fence> mFence;
 	UINT64 mCurrentFence = 0;
 
+	// Reused by every wait on mFence.
+	HANDLE mFenceEvent = nullptr;
+
+	// Time the CPU spent blocked on mFence since the frame started.
+	double mFrameWaitMs = 0.0;
+
+	// Frames run so far, and the ones to run before Update and Draw must stop allocating.
+	UINT64 mFrameCount = 0;
+	int mAllocationWarmUpFrames = -1;
+
 	ComPtr<ID3D12CommandQueue> mCommandQueue;
 	ComPtr<ID3D12CommandAllocator> mDirectCmdListAlloc;
 	ComPtr<ID3D12GraphicsCommandList> mCommandList;
@@ -0,0 +1,196 @@
+#include "CommandRecorder.h"
+
+namespace
+{
+    bool SameView(const D3D12_VERTEX_BUFFER_VIEW& a, const D3D12_VERTEX_BUFFER_VIEW& b)
+    {
+        return a.BufferLocation == b.BufferLocation && a.SizeInBytes == b.SizeInBytes && a.StrideInBytes == b.StrideInBytes;
+    }
+
+    bool SameView(const D3D12_INDEX_BUFFER_VIEW& a, const D3D12_INDEX_BUFFER_VIEW& b)
+    {
+        return a.BufferLocation == b.BufferLocation && a.SizeInBytes == b.SizeInBytes && a.Format == b.Format;
+    }
+}
+
+UINT CommandRecorderStats::GetIssuedCount() const
+{
+    UINT count = 0;
+    for (UINT n : Issued)
+    {
+        count += n;
+    }
+    return count;
+}
+
+UINT CommandRecorderStats::GetFilteredCount() const
+{
+    UINT count = 0;
+    for (UINT n : Filtered)
+    {
+        count += n;
+    }
+    return count;
+}
+
+CommandRecorderStats& CommandRecorderStats::operator+=(const CommandRecorderStats& other)
+{
+    for (int i = 0; i < (int)RecordedCommand::Count; ++i)
+    {
+        Issued[i] += other.Issued[i];
+        Filtered[i] += other.Filtered[i];
+    }
+    Draws += other.Draws;
+    return *this;
+}
+
+void CommandRecorder::Begin(ID3D12GraphicsCommandList* cmdList, ID3D12PipelineState* initialState)
+{
+    mCmdList = cmdList;
+    Invalidate();
+    mPipelineState = initialState;
+}
+
+void CommandRecorder::Invalidate()
+{
+    mPipelineState = nullptr;
+    mRootSignature = nullptr;
+    for (D3D12_VERTEX_BUFFER_VIEW& view : mVertexBuffers)
+    {
+        view = {};
+    }
+    mIndexBuffer = {};
+    mTopology = D3D_PRIMITIVE_TOPOLOGY_UNDEFINED;
+    for (D3D12_GPU_VIRTUAL_ADDRESS& address : mRootCbvs)
+    {
+        address = 0;
+    }
+    InvalidateDescriptorTables();
+    mStencilRefKnown = false;
+}
+
+void CommandRecorder::InvalidateDescriptorTables()
+{
+    for (D3D12_GPU_DESCRIPTOR_HANDLE& table : mRootTables)
+    {
+        table.ptr = 0;
+    }
+}
+
+void CommandRecorder::SetPipelineState(ID3D12PipelineState* pipelineState)
+{
+    if (Count(RecordedCommand::PipelineState, pipelineState == nullptr || pipelineState != mPipelineState))
+    {
+        mCmdList->SetPipelineState(pipelineState);
+        mPipelineState = pipelineState;
+    }
+}
+
+void CommandRecorder::SetGraphicsRootSignature(ID3D12RootSignature* rootSignature)
+{
+    if (Count(RecordedCommand::RootSignature, rootSignature == nullptr || rootSignature != mRootSignature))
+    {
+        mCmdList->SetGraphicsRootSignature(rootSignature);
+        mRootSignature = rootSignature;
+        for (D3D12_GPU_VIRTUAL_ADDRESS& address : mRootCbvs)
+        {
+            address = 0;
+        }
+        InvalidateDescriptorTables();
+    }
+}
+
+void CommandRecorder::SetDescriptorHeaps(UINT count, ID3D12DescriptorHeap* const* heaps)
+{
+    mCmdList->SetDescriptorHeaps(count, heaps);
+    InvalidateDescriptorTables();
+}
+
+void CommandRecorder::IASetVertexBuffers(UINT startSlot, UINT viewCount, const D3D12_VERTEX_BUFFER_VIEW* views)
+{
+    bool changed = views == nullptr || startSlot + viewCount > MaxVertexBufferSlots;
+    for (UINT i = 0; i < viewCount && !changed; ++i)
+    {
+        changed = views[i].BufferLocation == 0 || !SameView(views[i], mVertexBuffers[startSlot + i]);
+    }
+
+    if (Count(RecordedCommand::VertexBuffers, changed))
+    {
+        mCmdList->IASetVertexBuffers(startSlot, viewCount, views);
+        for (UINT i = 0; i < viewCount && startSlot + i < MaxVertexBufferSlots; ++i)
+        {
+            mVertexBuffers[startSlot + i] = views ? views[i] : D3D12_VERTEX_BUFFER_VIEW{};
+        }
+    }
+}
+
+void CommandRecorder::IASetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW* view)
+{
+    if (Count(RecordedCommand::IndexBuffer, view == nullptr || view->BufferLocation == 0 || !SameView(*view, mIndexBuffer)))
+    {
+        mCmdList->IASetIndexBuffer(view);
+        mIndexBuffer = view ? *view : D3D12_INDEX_BUFFER_VIEW{};
+    }
+}
+
+void CommandRecorder::IASetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY topology)
+{
+    if (Count(RecordedCommand::PrimitiveTopology, topology == D3D_PRIMITIVE_TOPOLOGY_UNDEFINED || topology != mTopology))
+    {
+        mCmdList->IASetPrimitiveTopology(topology);
+        mTopology = topology;
+    }
+}
+
+void CommandRecorder::SetGraphicsRootConstantBufferView(UINT parameter, D3D12_GPU_VIRTUAL_ADDRESS address)
+{
+    const bool shadowed = parameter < MaxRootParameters;
+    if (Count(RecordedCommand::RootConstantBufferView, !shadowed || address == 0 || address != mRootCbvs[parameter]))
+    {
+        mCmdList->SetGraphicsRootConstantBufferView(parameter, address);
+        if (shadowed)
+        {
+            mRootCbvs[parameter] = address;
+            mRootTables[parameter].ptr = 0;
+        }
+    }
+}
+
+void CommandRecorder::SetGraphicsRootDescriptorTable(UINT parameter, D3D12_GPU_DESCRIPTOR_HANDLE baseDescriptor)
+{
+    const bool shadowed = parameter < MaxRootParameters;
+    if (Count(RecordedCommand::RootDescriptorTable,
+        !shadowed || baseDescriptor.ptr == 0 || baseDescriptor.ptr != mRootTables[parameter].ptr))
+    {
+        mCmdList->SetGraphicsRootDescriptorTable(parameter, baseDescriptor);
+        if (shadowed)
+        {
+            mRootTables[parameter] = baseDescriptor;
+            mRootCbvs[parameter] = 0;
+        }
+    }
+}
+
+void CommandRecorder::OMSetStencilRef(UINT stencilRef)
+{
+    if (Count(RecordedCommand::StencilRef, !mStencilRefKnown || stencilRef != mStencilRef))
+    {
+        mCmdList->OMSetStencilRef(stencilRef);
+        mStencilRef = stencilRef;
+        mStencilRefKnown = true;
+    }
+}
+
+void CommandRecorder::DrawIndexedInstanced(UINT indexCountPerInstance, UINT instanceCount,
+    UINT startIndexLocation, INT baseVertexLocation, UINT startInstanceLocation)
+{
+    mCmdList->DrawIndexedInstanced(indexCountPerInstance, instanceCount,
+        startIndexLocation, baseVertexLocation, startInstanceLocation);
+    ++mStats.Draws;
+}
+
+bool CommandRecorder::Count(RecordedCommand command, bool changed)
+{
+    ++(changed ? mStats.Issued : mStats.Filtered)[(int)command];
+    return changed;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "d3dUtil.h"
+
+// The state setting calls CommandRecorder filters, for its counters.
+enum class RecordedCommand : uint8_t
+{
+	PipelineState,
+	RootSignature,
+	VertexBuffers,
+	IndexBuffer,
+	PrimitiveTopology,
+	RootConstantBufferView,
+	RootDescriptorTable,
+	StencilRef,
+	Count
+};
+
+struct CommandRecorderStats
+{
+	UINT Issued[(int)RecordedCommand::Count] = {};		// reached the command list
+	UINT Filtered[(int)RecordedCommand::Count] = {};	// dropped, the state was already bound
+	UINT Draws = 0;
+
+	UINT GetIssuedCount() const;
+	UINT GetFilteredCount() const;
+
+	// Sums the counts of recorders working on separate command lists.
+	CommandRecorderStats& operator+=(const CommandRecorderStats& other);
+};
+
+// Thin layer over a graphics command list that remembers the state it bound and drops
+// the calls binding it again: the same vertex and index buffer views, topology, root
+// arguments, PSO or stencil reference as the previous call. Sorted draws share most of
+// their state, each dropped call is runtime and driver validation the CPU doesn't pay.
+//
+// Everything else goes straight to Get(). Calls made that way that change the shadowed
+// state (a Reset, another root signature, new descriptor heaps...) must be followed by
+// the matching Invalidate, or the recorder will drop calls that were needed.
+class CommandRecorder
+{
+public:
+	// Root parameters past this are never filtered.
+	static constexpr UINT MaxRootParameters = 16;
+	static constexpr UINT MaxVertexBufferSlots = 4;
+
+	// Starts recording into cmdList, which was just reset with initialState.
+	void Begin(ID3D12GraphicsCommandList* cmdList, ID3D12PipelineState* initialState = nullptr);
+
+	ID3D12GraphicsCommandList* Get() const { return mCmdList; }
+
+	// Forgets all the shadowed state.
+	void Invalidate();
+	// Forgets the descriptor tables, for SetDescriptorHeaps made through Get().
+	void InvalidateDescriptorTables();
+
+	void SetPipelineState(ID3D12PipelineState* pipelineState);
+	// Root arguments don't survive a root signature change, they are forgotten too.
+	void SetGraphicsRootSignature(ID3D12RootSignature* rootSignature);
+	void SetDescriptorHeaps(UINT count, ID3D12DescriptorHeap* const* heaps);
+
+	void IASetVertexBuffers(UINT startSlot, UINT viewCount, const D3D12_VERTEX_BUFFER_VIEW* views);
+	void IASetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW* view);
+	void IASetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY topology);
+
+	void SetGraphicsRootConstantBufferView(UINT parameter, D3D12_GPU_VIRTUAL_ADDRESS address);
+	void SetGraphicsRootDescriptorTable(UINT parameter, D3D12_GPU_DESCRIPTOR_HANDLE baseDescriptor);
+
+	void OMSetStencilRef(UINT stencilRef);
+
+	void DrawIndexedInstanced(UINT indexCountPerInstance, UINT instanceCount,
+		UINT startIndexLocation, INT baseVertexLocation, UINT startInstanceLocation);
+
+	// Counts since the last ResetStats, Begin doesn't reset them.
+	const CommandRecorderStats& GetStats() const { return mStats; }
+	void ResetStats() { mStats = {}; }
+
+private:
+	// True when the call has to reach the command list, counted either way.
+	bool Count(RecordedCommand command, bool changed);
+
+	ID3D12GraphicsCommandList* mCmdList = nullptr;
+
+	// Null, or a zero address or handle, means unknown.
+	ID3D12PipelineState* mPipelineState = nullptr;
+	ID3D12RootSignature* mRootSignature = nullptr;
+	D3D12_VERTEX_BUFFER_VIEW mVertexBuffers[MaxVertexBufferSlots] = {};
+	D3D12_INDEX_BUFFER_VIEW mIndexBuffer = {};
+	D3D12_PRIMITIVE_TOPOLOGY mTopology = D3D_PRIMITIVE_TOPOLOGY_UNDEFINED;
+	D3D12_GPU_VIRTUAL_ADDRESS mRootCbvs[MaxRootParameters] = {};
+	D3D12_GPU_DESCRIPTOR_HANDLE mRootTables[MaxRootParameters] = {};
+	bool mStencilRefKnown = false;
+	UINT mStencilRef = 0;
+
+	CommandRecorderStats mStats;
+};
@@ -0,0 +1,46 @@
+#include "DeferredRelease.h"
+
+void DeferredReleaseQueue::Release(ComPtr<ID3D12Resource>& resource, UINT64 fenceValue)
+{
+    if (!resource)
+    {
+        return;
+    }
+    assert(mPending.empty() || mPending.back().Fence <= fenceValue);
+
+    const D3D12_RESOURCE_DESC desc = resource->GetDesc();
+    Pending pending;
+    pending.Fence = fenceValue;
+    pending.ByteSize = desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER ? desc.Width : 0;
+    pending.Resource = std::move(resource);
+
+    mPendingBytes += pending.ByteSize;
+    mPending.push_back(std::move(pending));
+}
+
+void DeferredReleaseQueue::Collect(UINT64 completedFenceValue)
+{
+    while (!mPending.empty() && mPending.front().Fence <= completedFenceValue)
+    {
+        mPendingBytes -= mPending.front().ByteSize;
+        mReclaimedBytes += mPending.front().ByteSize;
+        mPending.pop_front();
+    }
+}
+
+void ReleaseUploadData(DeferredReleaseQueue& queue, UINT64 fenceValue, MeshGeometry& geo, bool dropCpuCopies)
+{
+    queue.Release(geo.VertexBufferUploader, fenceValue);
+    queue.Release(geo.IndexBufferUploader, fenceValue);
+
+    if (dropCpuCopies && !geo.CpuAccess)
+    {
+        geo.VertexBufferCPU = nullptr;
+        geo.IndexBufferCPU = nullptr;
+    }
+}
+
+void ReleaseUploadData(DeferredReleaseQueue& queue, UINT64 fenceValue, Texture& texture)
+{
+    queue.Release(texture.UploadHeap, fenceValue);
+}
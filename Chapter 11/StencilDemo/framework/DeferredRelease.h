@@ -0,0 +1,43 @@
+#pragma once
+
+#include "d3dUtil.h"
+#include <deque>
+
+// Holds objects the GPU may still read (upload heaps of initialization copies, replaced
+// resources) until the fence value of the last command list using them completes,
+// instead of keeping them for the lifetime of their owner or flushing the queue.
+class DeferredReleaseQueue
+{
+public:
+	// Takes resource, released once the GPU reaches fenceValue. Fence values must not
+	// decrease from one call to the next.
+	void Release(ComPtr<ID3D12Resource>& resource, UINT64 fenceValue);
+
+	// Releases what the GPU is done with.
+	void Collect(UINT64 completedFenceValue);
+
+	size_t GetPendingCount() const { return mPending.size(); }
+	UINT64 GetPendingBytes() const { return mPendingBytes; }
+
+	// Total size of the buffers released so far.
+	UINT64 GetReclaimedBytes() const { return mReclaimedBytes; }
+
+private:
+	struct Pending
+	{
+		UINT64 Fence = 0;
+		UINT64 ByteSize = 0;		// buffers only, 0 for textures
+		ComPtr<ID3D12Resource> Resource;
+	};
+
+	std::deque<Pending> mPending;
+	UINT64 mPendingBytes = 0;
+	UINT64 mReclaimedBytes = 0;
+};
+
+// Hands the uploaders of geo to queue, the copies reading them were recorded before the
+// command list signaling fenceValue. With dropCpuCopies VertexBufferCPU and IndexBufferCPU
+// go too, unless geo.CpuAccess is set; nothing on the GPU reads those.
+void ReleaseUploadData(DeferredReleaseQueue& queue, UINT64 fenceValue, MeshGeometry& geo, bool dropCpuCopies);
+
+void ReleaseUploadData(DeferredReleaseQueue& queue, UINT64 fenceValue, Texture& texture);
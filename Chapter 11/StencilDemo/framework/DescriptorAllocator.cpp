@@ -0,0 +1,119 @@
+#include "DescriptorAllocator.h"
+#include <cassert>
+#include <iterator>
+
+DescriptorAllocator::DescriptorAllocator(uint32_t persistentCount, uint32_t transientCountPerFrame, uint32_t frameCount) :
+    mPersistentCount(persistentCount),
+    mTransientCountPerFrame(transientCountPerFrame),
+    mFrameCount(frameCount),
+    mGenerations(persistentCount, 0)
+{
+    if (persistentCount != 0)
+    {
+        mFreeRanges[0] = persistentCount;
+    }
+}
+
+DescriptorHandle DescriptorAllocator::Allocate(uint32_t count)
+{
+    if (count == 0)
+    {
+        return {};
+    }
+
+    for (auto it = mFreeRanges.begin(); it != mFreeRanges.end(); ++it)
+    {
+        if (it->second < count)
+        {
+            continue;
+        }
+
+        const uint32_t index = it->first;
+        const uint32_t rest = it->second - count;
+        mFreeRanges.erase(it);
+        if (rest != 0)
+        {
+            mFreeRanges[index + count] = rest;
+        }
+        mPersistentUsed += count;
+
+        DescriptorHandle handle;
+        handle.Index = index;
+        handle.Count = count;
+        handle.Generation = mGenerations[index];
+        return handle;
+    }
+    return {};
+}
+
+void DescriptorAllocator::Free(DescriptorHandle& handle, uint64_t fenceValue)
+{
+    if (handle.IsNull())
+    {
+        return;
+    }
+    assert(IsValid(handle) && "descriptor freed twice");
+    assert(mPendingFrees.empty() || mPendingFrees.back().Fence <= fenceValue);
+
+    // Bumping the generations now invalidates every copy of the handle.
+    for (uint32_t i = 0; i < handle.Count; ++i)
+    {
+        ++mGenerations[handle.Index + i];
+    }
+    mPendingFrees.push_back({ fenceValue, handle.Index, handle.Count });
+    handle = {};
+}
+
+bool DescriptorAllocator::IsValid(const DescriptorHandle& handle) const
+{
+    return !handle.IsNull() &&
+        handle.Index + handle.Count <= mPersistentCount &&
+        mGenerations[handle.Index] == handle.Generation;
+}
+
+void DescriptorAllocator::BeginFrame(uint32_t frameIndex, uint64_t completedFenceValue)
+{
+    assert(frameIndex < mFrameCount);
+    mFrame = frameIndex;
+    mTransientUsed = 0;
+
+    while (!mPendingFrees.empty() && mPendingFrees.front().Fence <= completedFenceValue)
+    {
+        Release(mPendingFrees.front().Index, mPendingFrees.front().Count);
+        mPendingFrees.pop_front();
+    }
+}
+
+uint32_t DescriptorAllocator::AllocateTransient(uint32_t count)
+{
+    if (count == 0 || mTransientUsed + count > mTransientCountPerFrame)
+    {
+        return UINT32_MAX;
+    }
+    const uint32_t index = mPersistentCount + mFrame * mTransientCountPerFrame + mTransientUsed;
+    mTransientUsed += count;
+    return index;
+}
+
+void DescriptorAllocator::Release(uint32_t index, uint32_t count)
+{
+    mPersistentUsed -= count;
+
+    // Merge with the free runs right after and right before.
+    auto next = mFreeRanges.lower_bound(index);
+    if (next != mFreeRanges.end() && next->first == index + count)
+    {
+        count += next->second;
+        next = mFreeRanges.erase(next);
+    }
+    if (next != mFreeRanges.begin())
+    {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == index)
+        {
+            prev->second += count;
+            return;
+        }
+    }
+    mFreeRanges[index] = count;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <vector>
+
+// Decides which slots of the shader visible descriptor heap each SRV or table uses, and
+// DescriptorHeap.h writes the descriptors into the D3D12 heap. The heap is split into two
+// regions that are managed differently.
+//
+// The heap starts with a persistent region for descriptors that live across frames
+// (texture SRVs), allocated in contiguous runs from a free list of ranges, first fit,
+// merged again on free. Freeing takes the fence value of the last frame that may still
+// read the descriptors, they are reused once BeginFrame sees it completed. Handles carry a
+// generation which freeing bumps, so a stale handle is detected instead of silently
+// reading whatever reused its slots.
+//
+// After it come one linear region per frame resource for transient tables, built while
+// recording a frame and thrown away as a whole when the frame resource comes around again.
+struct DescriptorHandle
+{
+	uint32_t Index = UINT32_MAX;		// first slot in the heap
+	uint32_t Count = 0;
+	uint32_t Generation = 0;
+
+	bool IsNull() const { return Count == 0; }
+};
+
+class DescriptorAllocator
+{
+public:
+	DescriptorAllocator(uint32_t persistentCount, uint32_t transientCountPerFrame, uint32_t frameCount);
+
+	uint32_t GetTotalCount() const { return mPersistentCount + mTransientCountPerFrame * mFrameCount; }
+
+	// count contiguous persistent slots. Null handle when no run is long enough.
+	DescriptorHandle Allocate(uint32_t count = 1);
+
+	// The slots are reused once the GPU reaches fenceValue. handle is nulled.
+	void Free(DescriptorHandle& handle, uint64_t fenceValue);
+
+	// False for null handles and handles freed since they were allocated.
+	bool IsValid(const DescriptorHandle& handle) const;
+
+	// Call when starting to record with frame resource frameIndex, after waiting for its
+	// fence: reuses its transient region and the persistent slots freed up to
+	// completedFenceValue.
+	void BeginFrame(uint32_t frameIndex, uint64_t completedFenceValue);
+
+	// count contiguous slots of the current frame's transient region, valid until the
+	// frame resource is used again. UINT32_MAX when the region is full.
+	uint32_t AllocateTransient(uint32_t count);
+
+	uint32_t GetPersistentUsed() const { return mPersistentUsed; }
+	uint32_t GetTransientUsed() const { return mTransientUsed; }
+	size_t GetFreeRangeCount() const { return mFreeRanges.size(); }
+
+private:
+	struct PendingFree
+	{
+		uint64_t Fence = 0;
+		uint32_t Index = 0;
+		uint32_t Count = 0;
+	};
+
+	void Release(uint32_t index, uint32_t count);
+
+	uint32_t mPersistentCount = 0;
+	uint32_t mTransientCountPerFrame = 0;
+	uint32_t mFrameCount = 0;
+
+	// Free persistent runs by first slot.
+	std::map<uint32_t, uint32_t> mFreeRanges;
+	std::deque<PendingFree> mPendingFrees;
+	std::vector<uint32_t> mGenerations;
+	uint32_t mPersistentUsed = 0;
+
+	uint32_t mFrame = 0;
+	uint32_t mTransientUsed = 0;
+};
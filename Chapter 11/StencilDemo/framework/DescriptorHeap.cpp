@@ -0,0 +1,62 @@
+#include "DescriptorHeap.h"
+
+DescriptorHeap::DescriptorHeap(ID3D12Device* device, UINT persistentCount, UINT transientCountPerFrame, UINT frameCount) :
+    mAllocator(persistentCount, transientCountPerFrame, frameCount)
+{
+    D3D12_DESCRIPTOR_HEAP_DESC heapDesc = {};
+    heapDesc.NumDescriptors = mAllocator.GetTotalCount();
+    heapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+    heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+    device->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(&mHeap)) >> chk;
+
+    mDescriptorSize = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+}
+
+DescriptorHandle DescriptorHeap::Allocate(UINT count)
+{
+    DescriptorHandle handle = mAllocator.Allocate(count);
+    if (handle.IsNull())
+    {
+        throw std::runtime_error(std::format("DescriptorHeap has no run of {} free descriptors", count));
+    }
+    return handle;
+}
+
+UINT DescriptorHeap::AllocateTransient(UINT count)
+{
+    const UINT index = mAllocator.AllocateTransient(count);
+    if (index == UINT32_MAX)
+    {
+        throw std::runtime_error(std::format("DescriptorHeap transient region can't fit {} descriptors", count));
+    }
+    return index;
+}
+
+CD3DX12_CPU_DESCRIPTOR_HANDLE DescriptorHeap::CpuHandle(const DescriptorHandle& handle, UINT offset) const
+{
+    return CpuHandle(Resolve(handle, offset));
+}
+
+CD3DX12_GPU_DESCRIPTOR_HANDLE DescriptorHeap::GpuHandle(const DescriptorHandle& handle, UINT offset) const
+{
+    return GpuHandle(Resolve(handle, offset));
+}
+
+CD3DX12_CPU_DESCRIPTOR_HANDLE DescriptorHeap::CpuHandle(UINT index) const
+{
+    return CD3DX12_CPU_DESCRIPTOR_HANDLE(mHeap->GetCPUDescriptorHandleForHeapStart(), (INT)index, mDescriptorSize);
+}
+
+CD3DX12_GPU_DESCRIPTOR_HANDLE DescriptorHeap::GpuHandle(UINT index) const
+{
+    return CD3DX12_GPU_DESCRIPTOR_HANDLE(mHeap->GetGPUDescriptorHandleForHeapStart(), (INT)index, mDescriptorSize);
+}
+
+UINT DescriptorHeap::Resolve(const DescriptorHandle& handle, UINT offset) const
+{
+    if (!mAllocator.IsValid(handle) || offset >= handle.Count)
+    {
+        throw std::runtime_error(std::format("stale or out of range descriptor handle {}+{}", handle.Index, offset));
+    }
+    return handle.Index + offset;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "d3dUtil.h"
+#include "DescriptorAllocator.h"
+
+// A shader visible CBV/SRV/UAV heap laid out by DescriptorAllocator: persistent
+// descriptors behind generation-checked handles, then per frame regions for transient
+// tables.
+class DescriptorHeap
+{
+public:
+	DescriptorHeap(ID3D12Device* device, UINT persistentCount, UINT transientCountPerFrame, UINT frameCount);
+	DescriptorHeap(const DescriptorHeap&) = delete;
+	DescriptorHeap& operator=(const DescriptorHeap&) = delete;
+
+	ID3D12DescriptorHeap* Heap() const { return mHeap.Get(); }
+
+	// Throws when the persistent region has no run of count free descriptors.
+	DescriptorHandle Allocate(UINT count = 1);
+	void Free(DescriptorHandle& handle, UINT64 fenceValue) { mAllocator.Free(handle, fenceValue); }
+	bool IsValid(const DescriptorHandle& handle) const { return mAllocator.IsValid(handle); }
+
+	void BeginFrame(UINT frameIndex, UINT64 completedFenceValue) { mAllocator.BeginFrame(frameIndex, completedFenceValue); }
+
+	// Throws when the frame's transient region is full.
+	UINT AllocateTransient(UINT count);
+
+	// Descriptor offset of the handle, throws for stale handles.
+	CD3DX12_CPU_DESCRIPTOR_HANDLE CpuHandle(const DescriptorHandle& handle, UINT offset = 0) const;
+	CD3DX12_GPU_DESCRIPTOR_HANDLE GpuHandle(const DescriptorHandle& handle, UINT offset = 0) const;
+
+	// For transient indices.
+	CD3DX12_CPU_DESCRIPTOR_HANDLE CpuHandle(UINT index) const;
+	CD3DX12_GPU_DESCRIPTOR_HANDLE GpuHandle(UINT index) const;
+
+	const DescriptorAllocator& Allocator() const { return mAllocator; }
+
+private:
+	UINT Resolve(const DescriptorHandle& handle, UINT offset) const;
+
+	ComPtr<ID3D12DescriptorHeap> mHeap;
+	UINT mDescriptorSize = 0;
+	DescriptorAllocator mAllocator;
+};
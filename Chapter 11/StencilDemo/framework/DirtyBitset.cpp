@@ -0,0 +1,57 @@
+#include "DirtyBitset.h"
+
+void DirtyBitset::Resize(uint32_t count, bool value)
+{
+    const uint32_t oldSize = mSize;
+    mWords.resize(((size_t)count + 63) / 64, 0);
+    mSummary.resize((mWords.size() + 63) / 64, 0);
+    mSize = count;
+
+    // Bits past the size are always clear, ConsumeEach would visit them otherwise.
+    if (count < oldSize)
+    {
+        if (count % 64 != 0)
+        {
+            mWords[count / 64] &= (1ull << (count % 64)) - 1;
+        }
+        for (uint64_t& summary : mSummary)
+        {
+            summary = 0;
+        }
+        for (size_t w = 0; w < mWords.size(); ++w)
+        {
+            if (mWords[w] != 0)
+            {
+                mSummary[w / 64] |= 1ull << (w % 64);
+            }
+        }
+    }
+
+    if (value)
+    {
+        for (uint32_t i = oldSize; i < count; ++i)
+        {
+            Set(i);
+        }
+    }
+}
+
+void DirtyBitset::SetAll()
+{
+    for (uint32_t i = 0; i < mSize; ++i)
+    {
+        Set(i);
+    }
+}
+
+bool DirtyBitset::Any() const
+{
+    for (uint64_t summary : mSummary)
+    {
+        if (summary != 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// One bit per object, with a second level marking the 64 bit words that have a bit set:
+// visiting the set bits skips 4096 clear ones per summary word, the cost follows the
+// number of set bits rather than the size.
+class DirtyBitset
+{
+public:
+	// Bits added by growing the set are set to value, the others are kept.
+	void Resize(uint32_t count, bool value = false);
+	uint32_t GetSize() const { return mSize; }
+
+	void Set(uint32_t index)
+	{
+		mWords[index >> 6] |= 1ull << (index & 63);
+		mSummary[index >> 12] |= 1ull << ((index >> 6) & 63);
+	}
+	void SetAll();
+	bool Test(uint32_t index) const { return (mWords[index >> 6] >> (index & 63)) & 1; }
+	bool Any() const;
+
+	// Calls fn(index) for every set bit, in increasing order, and clears them. fn must not
+	// set bits.
+	template<typename Fn>
+	void ConsumeEach(const Fn& fn)
+	{
+		for (size_t s = 0; s < mSummary.size(); ++s)
+		{
+			while (mSummary[s] != 0)
+			{
+				const size_t w = s * 64 + std::countr_zero(mSummary[s]);
+				mSummary[s] &= mSummary[s] - 1;
+
+				uint64_t bits = std::exchange(mWords[w], 0);
+				while (bits != 0)
+				{
+					fn((uint32_t)(w * 64 + std::countr_zero(bits)));
+					bits &= bits - 1;
+				}
+			}
+		}
+	}
+
+private:
+	std::vector<uint64_t> mWords;
+	std::vector<uint64_t> mSummary;
+	uint32_t mSize = 0;
+};
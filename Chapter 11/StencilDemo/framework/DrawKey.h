@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 64 bit keys ordering draws for submission, and the radix sort putting them in order.
+//
+// Opaque draws are grouped by state first, the most expensive change in the highest bits,
+// and go front to back within a group so early depth rejects what is hidden:
+//
+//   63     60 59   54 53        44 43        32 31             0
+//   | layer  |  pso  |  geometry  |  material  | depth          |
+//
+// Blended draws must go back to front whatever their state, depth comes right after
+// the layer, inverted so the farthest sorts first:
+//
+//   | layer  | ~depth                        |  pso  | geometry | material |
+//
+// Ids wider than their field are truncated, which only costs grouping.
+struct DrawKey
+{
+	static constexpr int LayerBits = 4;
+	static constexpr int PsoBits = 6;
+	static constexpr int GeometryBits = 10;
+	static constexpr int MaterialBits = 12;
+	static constexpr int DepthBits = 32;
+
+	static uint64_t FrontToBack(uint32_t layer, uint32_t pso, uint32_t geometry, uint32_t material, float viewDepth);
+	static uint64_t BackToFront(uint32_t layer, uint32_t pso, uint32_t geometry, uint32_t material, float viewDepth);
+
+	// Bits of a view space depth that order like the depth, negative depths count as 0.
+	static uint32_t QuantizeDepth(float viewDepth);
+};
+
+struct DrawEntry
+{
+	uint64_t Key = 0;
+	uint32_t Item = 0;	// index of the draw in whatever list the caller keeps
+};
+
+// LSD radix sort, one byte per pass, stable. All eight histograms are built in one pass
+// over the keys and the passes where every key has the same byte are skipped, which with
+// a handful of layers, PSOs and materials is most of them. The scratch buffer is kept,
+// sorting the same number of entries every frame doesn't allocate.
+//
+// Entries kept in the order of the previous frame are mostly sorted already: SortCoherent
+// insertion sorts them, O(n) plus the distance each entry moves, and falls back to the
+// radix sort once the moves show the order is far off, after a camera cut say.
+class DrawKeySorter
+{
+public:
+	void Sort(std::vector<DrawEntry>& entries);
+	void SortCoherent(std::vector<DrawEntry>& entries);
+
+	// Passes the last sort actually ran, 0 when the insertion sort was enough.
+	int GetLastPassCount() const { return mLastPassCount; }
+	// Entries the last SortCoherent moved by one place before it finished or gave up.
+	size_t GetLastMoveCount() const { return mLastMoveCount; }
+
+private:
+	std::vector<DrawEntry> mScratch;
+	int mLastPassCount = 0;
+	size_t mLastMoveCount = 0;
+};
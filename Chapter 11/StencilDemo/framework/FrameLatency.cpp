@@ -0,0 +1,51 @@
+#include "FrameLatency.h"
+#include <algorithm>
+
+namespace
+{
+    // Weight of the newest frame in the averages, about a third of a second at 60 Hz.
+    constexpr double kSmoothing = 0.05;
+
+    // Above this share of the frame spent waiting the GPU is the bottleneck, below the
+    // lower one the CPU is. The gap keeps the controller from oscillating.
+    constexpr double kGpuBoundWaitShare = 0.10;
+    constexpr double kCpuBoundWaitShare = 0.02;
+
+    // Frames to let the averages settle after a change.
+    constexpr int kHoldFrames = 120;
+}
+
+FrameLatencyController::FrameLatencyController(int minFrames, int maxFrames) :
+    mMinFrames((std::min)(minFrames, maxFrames)),
+    mMaxFrames(maxFrames),
+    mFramesInFlight(maxFrames)
+{
+}
+
+void FrameLatencyController::Update(double waitMs, double frameMs)
+{
+    const double share = frameMs > 0.0 ? (std::min)(waitMs / frameMs, 1.0) : 0.0;
+    mWaitShare += (share - mWaitShare) * kSmoothing;
+    mAverageWaitMs += (waitMs - mAverageWaitMs) * kSmoothing;
+
+    if (++mFramesSinceChange < kHoldFrames)
+    {
+        return;
+    }
+
+    int framesInFlight = mFramesInFlight;
+    if (mWaitShare > kGpuBoundWaitShare)
+    {
+        framesInFlight = (std::max)(mFramesInFlight - 1, mMinFrames);
+    }
+    else if (mWaitShare < kCpuBoundWaitShare)
+    {
+        framesInFlight = (std::min)(mFramesInFlight + 1, mMaxFrames);
+    }
+
+    if (framesInFlight != mFramesInFlight)
+    {
+        mFramesInFlight = framesInFlight;
+        mFramesSinceChange = 0;
+    }
+}
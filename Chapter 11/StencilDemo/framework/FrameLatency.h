@@ -0,0 +1,33 @@
+#pragma once
+
+// Picks how many frames the CPU may record ahead of the GPU from the time it spends
+// blocked on the frame fence.
+//
+// When the CPU keeps waiting the GPU is the bottleneck and the queue is always full: one
+// frame less in flight cuts a frame of input latency without losing throughput. When it
+// almost never waits the CPU is the bottleneck, the queue is short anyway and one frame
+// more absorbs CPU spikes at no latency cost. Waits are averaged and a change is held
+// for a while so the count doesn't flip every frame.
+class FrameLatencyController
+{
+public:
+	FrameLatencyController(int minFrames = 2, int maxFrames = 3);
+
+	// Call once per frame with the time blocked on the fence and the whole frame time.
+	void Update(double waitMs, double frameMs);
+
+	int GetFramesInFlight() const { return mFramesInFlight; }
+
+	// Exponential averages of the share of the frame spent waiting, and of the wait.
+	double GetWaitShare() const { return mWaitShare; }
+	double GetAverageWaitMs() const { return mAverageWaitMs; }
+
+private:
+	int mMinFrames = 2;
+	int mMaxFrames = 3;
+	int mFramesInFlight = 3;
+
+	double mWaitShare = 0.0;
+	double mAverageWaitMs = 0.0;
+	int mFramesSinceChange = 0;
+};
@@ -1,17 +1,32 @@
 #include "FrameResource.h"
 
-FrameResource::FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount,UINT materialCount)
+FrameResource::FrameResource(ID3D12Device* device, UINT objectCount, UINT materialCount, UINT recordingListCount)
 {
 	device->CreateCommandAllocator(
 		D3D12_COMMAND_LIST_TYPE_DIRECT, 
 		IID_PPV_ARGS(&CmdListAlloc)) >> chk;
 
-	PassCB = std::make_unique<UploadBuffer<PassConstants>>(
-		device, passCount, true);
+	RecordingAllocs.resize(recordingListCount);
+	RecordingLists.resize(recordingListCount);
+	for (UINT i = 0; i < recordingListCount; ++i)
+	{
+		device->CreateCommandAllocator(
+			D3D12_COMMAND_LIST_TYPE_DIRECT,
+			IID_PPV_ARGS(&RecordingAllocs[i])) >> chk;
+		device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT,
+			RecordingAllocs[i].Get(), nullptr, IID_PPV_ARGS(&RecordingLists[i])) >> chk;
+
+		// Lists are created open, Draw expects to find them closed.
+		RecordingLists[i]->Close() >> chk;
+	}
+
 	ObjectCB = std::make_unique<UploadBuffer<ObjectConstants>>(
-		device, objectCount, true);
+		device, objectCount, true, "ObjectCB");
 	MaterialCB = std::make_unique<UploadBuffer<MaterialConstants>>(
-		device, materialCount, true);
+		device, materialCount, true, "MaterialCB");
+
+	// Nothing was written yet.
+	DirtyObjects.Resize(objectCount, true);
 }
 
 FrameResource::~FrameResource()
@@ -1,6 +1,7 @@
 #pragma once
 #include "d3dUtil.h"
 #include "UploadBuffer.h"
+#include "DirtyBitset.h"
 
 struct ObjectConstants 
 {
@@ -53,7 +54,7 @@ struct Vertex
 // for a frame.  
 struct FrameResource {
 public:
-	FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount);
+	FrameResource(ID3D12Device* device, UINT objectCount, UINT materialCount, UINT recordingListCount = 0);
 	FrameResource(const FrameResource&) = delete;
 	FrameResource& operator=(const FrameResource&) = delete;
 	~FrameResource();
@@ -62,12 +63,22 @@ public:
 	// So each frame needs their own allocator.
 	ComPtr<ID3D12CommandAllocator> CmdListAlloc;
 
+	// One allocator and command list per job recording draws in parallel, an allocator
+	// must only be used by one thread at a time. The lists are closed between frames.
+	std::vector<ComPtr<ID3D12CommandAllocator>> RecordingAllocs;
+	std::vector<ComPtr<ID3D12GraphicsCommandList>> RecordingLists;
+
 	// We cannot update a cbuffer until the GPU is done processing the commands
-	// that reference it.  So each frame needs their own cbuffers.
-	std::unique_ptr<UploadBuffer<PassConstants>> PassCB = nullptr;
+	// that reference it.  So each frame needs their own cbuffers. Pass constants are
+	// rewritten every frame and come from an UploadRing instead.
 	std::unique_ptr<UploadBuffer<ObjectConstants>> ObjectCB = nullptr;
 	std::unique_ptr<UploadBuffer<MaterialConstants>> MaterialCB = nullptr;
 
+	// Objects whose constants changed since ObjectCB was last written. Kept for every
+	// frame resource, also the ones out of the frame cycle, so one joining it again
+	// catches up on its own.
+	DirtyBitset DirtyObjects;
+
 	// Fence value to mark commands up to this fence point.  This lets us
 	// check if these frame resources are still in use by the GPU.
 	UINT64 Fence = 0;
@@ -0,0 +1,150 @@
+#include "FrustumCuller.h"
+#include <cmath>
+#include <xmmintrin.h>
+
+namespace
+{
+    // Bounds that fail every plane test, for items not set yet and the padding.
+    constexpr float kUnsetRadius = -1.f;
+
+    void Normalize(float (&plane)[4])
+    {
+        const float length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+        if (length > 0.f)
+        {
+            for (float& v : plane)
+            {
+                v /= length;
+            }
+        }
+    }
+}
+
+void FrustumCuller::SetViewProj(const float (&m)[4][4])
+{
+    SetViewProj(m, -1.f, 1.f, -1.f, 1.f);
+}
+
+void FrustumCuller::SetViewProj(const float (&m)[4][4], float left, float right, float bottom, float top)
+{
+    // Gribb-Hartmann: with row vectors the clip coordinates are dot products with the
+    // columns, left * w <= x <= right * w gives the left and right planes and so on,
+    // 0 <= z <= w the near and far ones.
+    for (int i = 0; i < 4; ++i)
+    {
+        mPlanes[0][i] = m[i][0] - left * m[i][3];    // left
+        mPlanes[1][i] = right * m[i][3] - m[i][0];   // right
+        mPlanes[2][i] = m[i][1] - bottom * m[i][3];  // bottom
+        mPlanes[3][i] = top * m[i][3] - m[i][1];     // top
+        mPlanes[4][i] = m[i][2];                     // near
+        mPlanes[5][i] = m[i][3] - m[i][2];           // far
+    }
+
+    for (float (&plane)[4] : mPlanes)
+    {
+        Normalize(plane);
+    }
+}
+
+void FrustumCuller::SetNearPlane(const float (&plane)[4])
+{
+    for (int i = 0; i < 4; ++i)
+    {
+        mPlanes[4][i] = plane[i];
+    }
+    Normalize(mPlanes[4]);
+}
+
+void FrustumCuller::Resize(uint32_t count)
+{
+    const size_t padded = ((size_t)count + 3) & ~(size_t)3;
+    for (std::vector<float>* v : { &mBoxCenterX, &mBoxCenterY, &mBoxCenterZ,
+        &mBoxExtentX, &mBoxExtentY, &mBoxExtentZ, &mSphereX, &mSphereY, &mSphereZ })
+    {
+        v->resize(padded, 0.f);
+    }
+    mSphereRadius.resize(padded, kUnsetRadius);
+    mVisibleMasks.resize(padded / 4, 0);
+
+    // Padding past a shrunk count must not show up as visible again.
+    for (size_t i = count; i < padded; ++i)
+    {
+        mSphereRadius[i] = kUnsetRadius;
+    }
+    mCount = count;
+}
+
+void FrustumCuller::SetBounds(uint32_t index, const float (&boxCenter)[3], const float (&boxExtents)[3],
+    const float (&sphereCenter)[3], float sphereRadius)
+{
+    mBoxCenterX[index] = boxCenter[0];
+    mBoxCenterY[index] = boxCenter[1];
+    mBoxCenterZ[index] = boxCenter[2];
+    mBoxExtentX[index] = boxExtents[0];
+    mBoxExtentY[index] = boxExtents[1];
+    mBoxExtentZ[index] = boxExtents[2];
+    mSphereX[index] = sphereCenter[0];
+    mSphereY[index] = sphereCenter[1];
+    mSphereZ[index] = sphereCenter[2];
+    mSphereRadius[index] = sphereRadius;
+}
+
+void FrustumCuller::Cull()
+{
+    // The plane terms are the same for every group, splat them once.
+    __m128 a[6], b[6], c[6], d[6], absA[6], absB[6], absC[6];
+    const __m128 signMask = _mm_set1_ps(-0.f);
+    for (int p = 0; p < 6; ++p)
+    {
+        a[p] = _mm_set1_ps(mPlanes[p][0]);
+        b[p] = _mm_set1_ps(mPlanes[p][1]);
+        c[p] = _mm_set1_ps(mPlanes[p][2]);
+        d[p] = _mm_set1_ps(mPlanes[p][3]);
+        absA[p] = _mm_andnot_ps(signMask, a[p]);
+        absB[p] = _mm_andnot_ps(signMask, b[p]);
+        absC[p] = _mm_andnot_ps(signMask, c[p]);
+    }
+
+    const __m128 zero = _mm_setzero_ps();
+    uint32_t visibleCount = 0;
+    for (size_t g = 0; g < mVisibleMasks.size(); ++g)
+    {
+        const size_t i = g * 4;
+        const __m128 sx = _mm_loadu_ps(&mSphereX[i]);
+        const __m128 sy = _mm_loadu_ps(&mSphereY[i]);
+        const __m128 sz = _mm_loadu_ps(&mSphereZ[i]);
+        const __m128 radius = _mm_loadu_ps(&mSphereRadius[i]);
+        const __m128 cx = _mm_loadu_ps(&mBoxCenterX[i]);
+        const __m128 cy = _mm_loadu_ps(&mBoxCenterY[i]);
+        const __m128 cz = _mm_loadu_ps(&mBoxCenterZ[i]);
+        const __m128 ex = _mm_loadu_ps(&mBoxExtentX[i]);
+        const __m128 ey = _mm_loadu_ps(&mBoxExtentY[i]);
+        const __m128 ez = _mm_loadu_ps(&mBoxExtentZ[i]);
+
+        // Unset items have a negative radius.
+        __m128 visible = _mm_cmpge_ps(radius, zero);
+        const __m128 negRadius = _mm_xor_ps(radius, signMask);
+        for (int p = 0; p < 6; ++p)
+        {
+            // Sphere: the center is at least -radius from the plane.
+            __m128 sphereDistance = _mm_add_ps(_mm_mul_ps(a[p], sx), d[p]);
+            sphereDistance = _mm_add_ps(sphereDistance, _mm_mul_ps(b[p], sy));
+            sphereDistance = _mm_add_ps(sphereDistance, _mm_mul_ps(c[p], sz));
+            visible = _mm_and_ps(visible, _mm_cmpge_ps(sphereDistance, negRadius));
+
+            // Box: the corner furthest along the normal is in front of the plane.
+            __m128 boxDistance = _mm_add_ps(_mm_mul_ps(a[p], cx), d[p]);
+            boxDistance = _mm_add_ps(boxDistance, _mm_mul_ps(b[p], cy));
+            boxDistance = _mm_add_ps(boxDistance, _mm_mul_ps(c[p], cz));
+            boxDistance = _mm_add_ps(boxDistance, _mm_mul_ps(absA[p], ex));
+            boxDistance = _mm_add_ps(boxDistance, _mm_mul_ps(absB[p], ey));
+            boxDistance = _mm_add_ps(boxDistance, _mm_mul_ps(absC[p], ez));
+            visible = _mm_and_ps(visible, _mm_cmpge_ps(boxDistance, zero));
+        }
+
+        const int mask = _mm_movemask_ps(visible);
+        mVisibleMasks[g] = (uint8_t)mask;
+        visibleCount += (uint32_t)(((mask >> 0) & 1) + ((mask >> 1) & 1) + ((mask >> 2) & 1) + ((mask >> 3) & 1));
+    }
+    mVisibleCount = visibleCount;
+}
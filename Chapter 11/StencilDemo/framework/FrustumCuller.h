@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Tests the world bounds of every render item against the view frustum, four items per
+// SSE instruction. Bounds are kept in structure of arrays form, set when an item moves,
+// so a cull is a straight pass over a few float arrays whatever the number of items.
+//
+// An item is visible when both its bounding sphere and its box intersect the frustum:
+// the sphere rejects what is far out, the box is the tight test for what is near the
+// edges. Both are conservative, nothing visible is ever culled.
+class FrustumCuller
+{
+public:
+	// Planes of the frustum of viewProj, a row vector matrix (DirectXMath layout,
+	// clip = p * viewProj) with the D3D [0, w] depth range.
+	void SetViewProj(const float (&viewProj)[4][4]);
+	// The part of that frustum inside the rectangle [left, right] x [bottom, top] of
+	// normalized device coordinates, what is seen through a portal covering it.
+	void SetViewProj(const float (&viewProj)[4][4], float left, float right, float bottom, float top);
+	// Replaces the near plane, inside when a*x + b*y + c*z + d >= 0. Through a portal
+	// nothing in front of the portal's plane is seen.
+	void SetNearPlane(const float (&plane)[4]);
+
+	// Items are indexed [0, count), new ones start invisible until SetBounds.
+	void Resize(uint32_t count);
+	uint32_t GetCount() const { return mCount; }
+
+	void SetBounds(uint32_t index, const float (&boxCenter)[3], const float (&boxExtents)[3],
+		const float (&sphereCenter)[3], float sphereRadius);
+
+	// Updates the visibility of all items.
+	void Cull();
+
+	bool IsVisible(uint32_t index) const { return (mVisibleMasks[index >> 2] >> (index & 3)) & 1; }
+	uint32_t GetVisibleCount() const { return mVisibleCount; }
+
+	// Appends the visible items of items to visible, in order. T needs an Object, the
+	// index its bounds were set at.
+	template<typename T>
+	void Compact(const std::vector<T*>& items, std::vector<T*>& visible) const
+	{
+		visible.clear();
+		for (T* item : items)
+		{
+			if (IsVisible(item->Object))
+			{
+				visible.push_back(item);
+			}
+		}
+	}
+
+private:
+	// Inside when a*x + b*y + c*z + d >= 0, (a, b, c) normalized.
+	float mPlanes[6][4] = {};
+
+	uint32_t mCount = 0;
+	uint32_t mVisibleCount = 0;
+
+	// Padded to a multiple of 4.
+	std::vector<float> mBoxCenterX, mBoxCenterY, mBoxCenterZ;
+	std::vector<float> mBoxExtentX, mBoxExtentY, mBoxExtentZ;
+	std::vector<float> mSphereX, mSphereY, mSphereZ, mSphereRadius;
+
+	// One bit per item, four per byte.
+	std::vector<uint8_t> mVisibleMasks;
+};
@@ -0,0 +1,122 @@
+#include "GeometryArena.h"
+#include "ResourceMemory.h"
+
+namespace
+{
+    // Enough for any index format and vertex stride.
+    constexpr UINT64 kRangeAlignment = 16;
+
+    UINT64 AlignRange(UINT64 value)
+    {
+        return (value + kRangeAlignment - 1) & ~(kRangeAlignment - 1);
+    }
+}
+
+StaticGeometryArena::StaticGeometryArena(UINT64 maxBufferSize) :
+    mMaxBufferSize(AlignRange(maxBufferSize))
+{
+}
+
+void StaticGeometryArena::Add(MeshGeometry* geo)
+{
+    assert(geo->VertexBufferCPU && geo->IndexBufferCPU);
+    assert(mStaging == nullptr && "Add after Upload");
+
+    const UINT64 vbSize = AlignRange(geo->VertexBufferByteSize);
+    const UINT64 ibSize = AlignRange(geo->IndexBufferByteSize);
+
+    // Meshes aren't split, one larger than mMaxBufferSize gets a buffer of its own.
+    if (mBuffers.empty() ||
+        (mBuffers.back().Size != 0 && mBuffers.back().Size + vbSize + ibSize > mMaxBufferSize))
+    {
+        mBuffers.emplace_back();
+        mBuffers.back().StagingOffset = mTotalBytes;
+    }
+
+    Buffer& buffer = mBuffers.back();
+    Entry entry;
+    entry.Geo = geo;
+    entry.Buffer = mBuffers.size() - 1;
+    entry.VertexOffset = buffer.Size;
+    entry.IndexOffset = buffer.Size + vbSize;
+    mEntries.push_back(entry);
+
+    buffer.Size += vbSize + ibSize;
+    mTotalBytes += vbSize + ibSize;
+}
+
+void StaticGeometryArena::Upload(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList, GpuMemoryAllocator* gpuMemory)
+{
+    if (mEntries.empty())
+    {
+        return;
+    }
+
+    device->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+        D3D12_HEAP_FLAG_NONE,
+        &CD3DX12_RESOURCE_DESC::Buffer(mTotalBytes),
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        IID_PPV_ARGS(&mStaging)) >> chk;
+    TrackResource(mStaging.Get(), MemoryCategory::Upload, "GeometryArenaStaging");
+
+    uint8_t* staging = nullptr;
+    mStaging->Map(0, &CD3DX12_RANGE(0, 0), (void**)&staging) >> chk;
+    for (const Entry& entry : mEntries)
+    {
+        const UINT64 base = mBuffers[entry.Buffer].StagingOffset;
+        memcpy(staging + base + entry.VertexOffset,
+            entry.Geo->VertexBufferCPU->GetBufferPointer(), entry.Geo->VertexBufferByteSize);
+        memcpy(staging + base + entry.IndexOffset,
+            entry.Geo->IndexBufferCPU->GetBufferPointer(), entry.Geo->IndexBufferByteSize);
+    }
+    mStaging->Unmap(0, nullptr);
+
+    // Buffers are created in the common state and promoted to copy dest by the copy, so
+    // the only barriers are the ones to the final state, all in one call.
+    std::vector<D3D12_RESOURCE_BARRIER> barriers;
+    barriers.reserve(mBuffers.size());
+    for (Buffer& buffer : mBuffers)
+    {
+        if (gpuMemory)
+        {
+            buffer.Placement = gpuMemory->CreateResource(CD3DX12_RESOURCE_DESC::Buffer(buffer.Size), D3D12_RESOURCE_STATE_COMMON);
+            buffer.Resource = buffer.Placement.Resource;
+        }
+        else
+        {
+            device->CreateCommittedResource(
+                &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+                D3D12_HEAP_FLAG_NONE,
+                &CD3DX12_RESOURCE_DESC::Buffer(buffer.Size),
+                D3D12_RESOURCE_STATE_COMMON,
+                nullptr,
+                IID_PPV_ARGS(&buffer.Resource)) >> chk;
+        }
+        TrackResource(buffer.Resource.Get(), MemoryCategory::Geometry, "GeometryArena");
+
+        cmdList->CopyBufferRegion(buffer.Resource.Get(), 0, mStaging.Get(), buffer.StagingOffset, buffer.Size);
+
+        barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(buffer.Resource.Get(),
+            D3D12_RESOURCE_STATE_COPY_DEST,
+            D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER | D3D12_RESOURCE_STATE_INDEX_BUFFER));
+    }
+    cmdList->ResourceBarrier((UINT)barriers.size(), barriers.data());
+
+    for (const Entry& entry : mEntries)
+    {
+        MeshGeometry* geo = entry.Geo;
+        geo->VertexBufferGPU = mBuffers[entry.Buffer].Resource;
+        geo->IndexBufferGPU = mBuffers[entry.Buffer].Resource;
+        geo->VertexBufferOffset = entry.VertexOffset;
+        geo->IndexBufferOffset = entry.IndexOffset;
+        geo->VertexBufferUploader = nullptr;
+        geo->IndexBufferUploader = nullptr;
+    }
+}
+
+void StaticGeometryArena::ReleaseStaging(DeferredReleaseQueue& queue, UINT64 fenceValue)
+{
+    queue.Release(mStaging, fenceValue);
+}
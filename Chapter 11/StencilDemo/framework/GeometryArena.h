@@ -0,0 +1,61 @@
+#pragma once
+
+#include "d3dUtil.h"
+#include "GpuMemoryAllocator.h"
+#include "DeferredRelease.h"
+
+// Static vertex and index data of every mesh built at init, uploaded together instead
+// of one default buffer and one upload buffer per vertex and index buffer.
+//
+// Add only records the meshes, Upload packs their CPU copies into a single upload
+// buffer and records one CopyBufferRegion per default buffer followed by a single
+// barrier batch. Meshes share the default buffers and address their data by
+// MeshGeometry::VertexBufferOffset and IndexBufferOffset. A default buffer is at most
+// maxBufferSize bytes, larger arenas are split between several of them at mesh
+// boundaries.
+class StaticGeometryArena
+{
+public:
+	explicit StaticGeometryArena(UINT64 maxBufferSize = 64ull << 20);
+	StaticGeometryArena(const StaticGeometryArena&) = delete;
+	StaticGeometryArena& operator=(const StaticGeometryArena&) = delete;
+
+	// geo's VertexBufferCPU and IndexBufferCPU, byte sizes and stride must be set, and
+	// geo must outlive Upload.
+	void Add(MeshGeometry* geo);
+
+	// Records the upload of every added mesh on cmdList and points the meshes at their
+	// ranges. The upload buffer is held until ReleaseStaging.
+	// The default buffers are placed by gpuMemory when given, committed otherwise.
+	void Upload(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList, GpuMemoryAllocator* gpuMemory = nullptr);
+
+	// Hands the upload buffer to queue, fenceValue being signaled after cmdList executed.
+	void ReleaseStaging(DeferredReleaseQueue& queue, UINT64 fenceValue);
+
+	size_t GetBufferCount() const { return mBuffers.size(); }
+	UINT64 GetTotalBytes() const { return mTotalBytes; }
+
+private:
+	struct Entry
+	{
+		MeshGeometry* Geo = nullptr;
+		size_t Buffer = 0;
+		UINT64 VertexOffset = 0;		// from the start of Buffer
+		UINT64 IndexOffset = 0;
+	};
+
+	struct Buffer
+	{
+		ComPtr<ID3D12Resource> Resource;
+		GpuMemoryAllocator::Allocation Placement;
+		UINT64 StagingOffset = 0;		// start of its data in mStaging
+		UINT64 Size = 0;
+	};
+
+	UINT64 mMaxBufferSize = 0;
+	UINT64 mTotalBytes = 0;
+
+	std::vector<Entry> mEntries;
+	std::vector<Buffer> mBuffers;
+	ComPtr<ID3D12Resource> mStaging;
+};
@@ -0,0 +1,209 @@
+#include "GpuMemoryAllocator.h"
+#include <bit>
+
+namespace
+{
+    void Accumulate(SuballocatorStats& total, const SuballocatorStats& stats)
+    {
+        total.Capacity += stats.Capacity;
+        total.UsedBytes += stats.UsedBytes;
+        total.RequestedBytes += stats.RequestedBytes;
+        total.AllocationCount += stats.AllocationCount;
+        total.FreeRangeCount += stats.FreeRangeCount;
+        total.LargestFreeRange = (std::max)(total.LargestFreeRange, stats.LargestFreeRange);
+    }
+}
+
+GpuMemoryAllocator::GpuMemoryAllocator(ID3D12Device* device, UINT64 blockSize) :
+    mDevice(device),
+    mBlockSize(std::bit_ceil(blockSize))
+{
+}
+
+GpuMemoryAllocator::Allocation GpuMemoryAllocator::CreateResource(
+    const D3D12_RESOURCE_DESC& desc,
+    D3D12_RESOURCE_STATES initialState,
+    const D3D12_CLEAR_VALUE* clearValue)
+{
+    const D3D12_RESOURCE_ALLOCATION_INFO info = mDevice->GetResourceAllocationInfo(0, 1, &desc);
+    if (info.SizeInBytes == UINT64_MAX)
+    {
+        throw std::runtime_error("GpuMemoryAllocator: invalid resource description");
+    }
+
+    Allocation allocation;
+    allocation.Pool = PoolOf(desc);
+
+    std::vector<Block>& blocks = mBlocks[allocation.Pool];
+    UINT blockIndex = UINT_MAX;
+    for (UINT i = 0; i < blocks.size(); ++i)
+    {
+        if (blocks[i].Heap && AllocateFrom(blocks[i], info.SizeInBytes, info.Alignment, allocation.Range))
+        {
+            blockIndex = i;
+            break;
+        }
+    }
+    if (blockIndex == UINT_MAX)
+    {
+        blockIndex = CreateBlock((Pool)allocation.Pool, info.SizeInBytes, info.Alignment);
+        if (!AllocateFrom(blocks[blockIndex], info.SizeInBytes, info.Alignment, allocation.Range))
+        {
+            throw std::runtime_error(std::format("GpuMemoryAllocator can't fit {} bytes", info.SizeInBytes));
+        }
+    }
+
+    allocation.Block = blockIndex;
+    allocation.Heap = blocks[blockIndex].Heap.Get();
+    allocation.HeapOffset = allocation.Range.Offset;
+
+    mDevice->CreatePlacedResource(
+        allocation.Heap,
+        allocation.HeapOffset,
+        &desc,
+        initialState,
+        clearValue,
+        IID_PPV_ARGS(&allocation.Resource)) >> chk;
+
+    return allocation;
+}
+
+ComPtr<ID3D12Resource> GpuMemoryAllocator::CreateAliasedResource(
+    const Allocation& allocation,
+    const D3D12_RESOURCE_DESC& desc,
+    D3D12_RESOURCE_STATES initialState,
+    const D3D12_CLEAR_VALUE* clearValue)
+{
+    const D3D12_RESOURCE_ALLOCATION_INFO info = mDevice->GetResourceAllocationInfo(0, 1, &desc);
+    if (PoolOf(desc) != allocation.Pool ||
+        info.SizeInBytes > allocation.Range.Size ||
+        allocation.HeapOffset % info.Alignment != 0)
+    {
+        throw std::runtime_error(std::format(
+            "GpuMemoryAllocator: a resource of {} bytes can't alias an allocation of {} bytes",
+            info.SizeInBytes, allocation.Range.Size));
+    }
+
+    ComPtr<ID3D12Resource> resource;
+    mDevice->CreatePlacedResource(
+        allocation.Heap,
+        allocation.HeapOffset,
+        &desc,
+        initialState,
+        clearValue,
+        IID_PPV_ARGS(&resource)) >> chk;
+    return resource;
+}
+
+void GpuMemoryAllocator::Free(Allocation& allocation)
+{
+    if (!allocation.Resource)
+    {
+        return;
+    }
+    allocation.Resource = nullptr;
+
+    std::vector<Block>& blocks = mBlocks[allocation.Pool];
+    Block& block = blocks[allocation.Block];
+    bool isEmpty;
+    if (block.Tlsf)
+    {
+        block.Tlsf->Free(allocation.Range);
+        isEmpty = block.Tlsf->IsEmpty();
+    }
+    else
+    {
+        block.Buddy->Free(allocation.Range);
+        isEmpty = block.Buddy->IsEmpty();
+    }
+
+    // Keep the first block of each kind around, the others are released once empty.
+    if (isEmpty && allocation.Block != 0)
+    {
+        block = Block();
+    }
+    allocation.Heap = nullptr;
+}
+
+GpuMemoryAllocator::Stats GpuMemoryAllocator::GetStats() const
+{
+    Stats stats;
+    SuballocatorStats* totals[PoolCount] = { &stats.Buffers, &stats.Textures, &stats.Targets };
+    for (UINT pool = 0; pool < PoolCount; ++pool)
+    {
+        for (const Block& block : mBlocks[pool])
+        {
+            if (!block.Heap)
+            {
+                continue;
+            }
+            const SuballocatorStats blockStats = block.Tlsf ? block.Tlsf->GetStats() : block.Buddy->GetStats();
+            Accumulate(*totals[pool], blockStats);
+            stats.HeapBytes += blockStats.Capacity;
+            ++stats.BlockCount;
+        }
+    }
+    return stats;
+}
+
+GpuMemoryAllocator::Pool GpuMemoryAllocator::PoolOf(const D3D12_RESOURCE_DESC& desc)
+{
+    if (desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+    {
+        return BufferPool;
+    }
+    if (desc.Flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL))
+    {
+        return TargetPool;
+    }
+    return TexturePool;
+}
+
+bool GpuMemoryAllocator::AllocateFrom(Block& block, UINT64 size, UINT64 alignment, SuballocatorAllocation& range)
+{
+    return block.Tlsf ?
+        block.Tlsf->Allocate(size, alignment, range) :
+        block.Buddy->Allocate(size, alignment, range);
+}
+
+UINT GpuMemoryAllocator::CreateBlock(Pool pool, UINT64 minSize, UINT64 alignment)
+{
+    static const D3D12_HEAP_FLAGS kPoolFlags[PoolCount] = {
+        D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS,
+        D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES,
+        D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES,
+    };
+
+    // Blocks are powers of two for the buddy allocator, heaps aligned for MSAA textures.
+    const UINT64 size = (std::max)(mBlockSize, std::bit_ceil(minSize));
+    const D3D12_HEAP_DESC heapDesc = {
+        .SizeInBytes = size,
+        .Properties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+        .Alignment = (std::max)(alignment, (UINT64)D3D12_DEFAULT_MSAA_RESOURCE_PLACEMENT_ALIGNMENT),
+        .Flags = kPoolFlags[pool],
+    };
+
+    Block block;
+    mDevice->CreateHeap(&heapDesc, IID_PPV_ARGS(&block.Heap)) >> chk;
+    if (pool == BufferPool)
+    {
+        block.Tlsf = std::make_unique<TlsfAllocator>(size, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT);
+    }
+    else
+    {
+        block.Buddy = std::make_unique<BuddyAllocator>(size, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT);
+    }
+
+    // Reuse the slot of a released block.
+    std::vector<Block>& blocks = mBlocks[pool];
+    for (UINT i = 0; i < blocks.size(); ++i)
+    {
+        if (!blocks[i].Heap)
+        {
+            blocks[i] = std::move(block);
+            return i;
+        }
+    }
+    blocks.push_back(std::move(block));
+    return (UINT)blocks.size() - 1;
+}
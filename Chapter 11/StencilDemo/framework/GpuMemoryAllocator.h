@@ -0,0 +1,85 @@
+#pragma once
+
+#include "d3dUtil.h"
+#include "HeapSuballocator.h"
+
+// Places buffers and textures in a few large ID3D12Heap blocks instead of one committed
+// allocation each. Buffers are suballocated by TlsfAllocator, textures by BuddyAllocator;
+// heaps of resource heap tier 1 only hold one kind of resource, so buffers, textures and
+// render target or depth stencil textures each have their own blocks. A resource too
+// large for a block gets a block of its own, empty blocks beyond the first of a kind are
+// released.
+//
+// Transient targets that are never used at the same time can share memory: an aliased
+// resource is placed over an existing allocation, switching between them takes an
+// aliasing barrier (CD3DX12_RESOURCE_BARRIER::Aliasing).
+//
+// Free releases the memory immediately, the GPU must be done with the resource.
+class GpuMemoryAllocator
+{
+public:
+	struct Allocation
+	{
+		ComPtr<ID3D12Resource> Resource;
+		ID3D12Heap* Heap = nullptr;
+		UINT64 HeapOffset = 0;
+
+		// Which pool, block and range, for Free and CreateAliasedResource.
+		UINT Pool = 0;
+		UINT Block = 0;
+		SuballocatorAllocation Range;
+	};
+
+	GpuMemoryAllocator(ID3D12Device* device, UINT64 blockSize = 64ull << 20);
+	GpuMemoryAllocator(const GpuMemoryAllocator&) = delete;
+	GpuMemoryAllocator& operator=(const GpuMemoryAllocator&) = delete;
+
+	// A placed resource in a default heap, which starts in initialState (buffers always
+	// start in the common state, see CreatePlacedResource).
+	Allocation CreateResource(
+		const D3D12_RESOURCE_DESC& desc,
+		D3D12_RESOURCE_STATES initialState,
+		const D3D12_CLEAR_VALUE* clearValue = nullptr);
+
+	// A resource sharing the memory of allocation, which must be at least as large. The
+	// returned resource doesn't own the memory: release it before freeing allocation.
+	ComPtr<ID3D12Resource> CreateAliasedResource(
+		const Allocation& allocation,
+		const D3D12_RESOURCE_DESC& desc,
+		D3D12_RESOURCE_STATES initialState,
+		const D3D12_CLEAR_VALUE* clearValue = nullptr);
+
+	void Free(Allocation& allocation);
+
+	struct Stats
+	{
+		UINT BlockCount = 0;
+		UINT64 HeapBytes = 0;
+		SuballocatorStats Buffers;
+		SuballocatorStats Textures;
+		SuballocatorStats Targets;
+	};
+
+	// The LargestFreeRange of each kind is the largest over its blocks.
+	Stats GetStats() const;
+
+private:
+	enum Pool : UINT { BufferPool, TexturePool, TargetPool, PoolCount };
+
+	struct Block
+	{
+		ComPtr<ID3D12Heap> Heap;
+		std::unique_ptr<TlsfAllocator> Tlsf;		// buffer blocks
+		std::unique_ptr<BuddyAllocator> Buddy;		// texture and target blocks
+	};
+
+	static Pool PoolOf(const D3D12_RESOURCE_DESC& desc);
+	bool AllocateFrom(Block& block, UINT64 size, UINT64 alignment, SuballocatorAllocation& range);
+	UINT CreateBlock(Pool pool, UINT64 minSize, UINT64 alignment);
+
+	ID3D12Device* mDevice = nullptr;
+	UINT64 mBlockSize = 0;
+
+	// Freed blocks are reset rather than erased, so block indices stay valid.
+	std::vector<Block> mBlocks[PoolCount];
+};
@@ -0,0 +1,437 @@
+#include "HeapSuballocator.h"
+#include <algorithm>
+#include <bit>
+#include <cassert>
+
+namespace
+{
+    uint64_t AlignUp(uint64_t value, uint64_t alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+}
+
+TlsfAllocator::TlsfAllocator(uint64_t capacity, uint64_t granularity) :
+    mCapacity(capacity & ~(granularity - 1)),
+    mGranularity(granularity),
+    mGranularityLog2((uint32_t)std::countr_zero(granularity))
+{
+    assert(std::has_single_bit(granularity));
+    for (auto& heads : mFreeHeads)
+    {
+        std::fill(std::begin(heads), std::end(heads), kNull);
+    }
+
+    mStats.Capacity = mCapacity;
+    if (mCapacity != 0)
+    {
+        uint32_t index = NewRange();
+        mRanges[index].Size = mCapacity;
+        InsertFree(index);
+    }
+}
+
+bool TlsfAllocator::Allocate(uint64_t size, uint64_t alignment, SuballocatorAllocation& allocation)
+{
+    assert(std::has_single_bit(alignment));
+    const uint64_t requested = size;
+    size = AlignUp((std::max)(size, (uint64_t)1), mGranularity);
+    alignment = (std::max)(alignment, mGranularity);
+
+    if (size > mCapacity)
+    {
+        return false;
+    }
+
+    // The first range of the size class often starts aligned already, otherwise any range
+    // of size + alignment - granularity bytes fits wherever the aligned start falls.
+    uint32_t index = FindFreeRange(size);
+    if (index != kNull && alignment > mGranularity &&
+        AlignUp(mRanges[index].Offset, alignment) + size > mRanges[index].Offset + mRanges[index].Size)
+    {
+        const uint64_t searchSize = size + alignment - mGranularity;
+        index = searchSize <= mCapacity ? FindFreeRange(searchSize) : kNull;
+    }
+    if (index == kNull)
+    {
+        return false;
+    }
+    RemoveFree(index);
+
+    // Free ranges never touch another free range, so the padding in front and the rest
+    // behind go back to the free lists as they are.
+    const uint64_t padding = AlignUp(mRanges[index].Offset, alignment) - mRanges[index].Offset;
+    if (padding != 0)
+    {
+        const uint32_t front = index;
+        index = SplitOff(front, padding);
+        InsertFree(front);
+    }
+    if (mRanges[index].Size > size)
+    {
+        InsertFree(SplitOff(index, size));
+    }
+
+    Range& range = mRanges[index];
+    range.IsFree = false;
+    range.Requested = requested;
+
+    mStats.UsedBytes += range.Size;
+    mStats.RequestedBytes += requested;
+    ++mStats.AllocationCount;
+
+    allocation.Offset = range.Offset;
+    allocation.Size = range.Size;
+    allocation.Handle = index;
+    return true;
+}
+
+void TlsfAllocator::Free(const SuballocatorAllocation& allocation)
+{
+    uint32_t index = allocation.Handle;
+    assert(index < mRanges.size() && !mRanges[index].IsFree);
+
+    mStats.UsedBytes -= mRanges[index].Size;
+    mStats.RequestedBytes -= mRanges[index].Requested;
+    --mStats.AllocationCount;
+
+    mRanges[index].IsFree = true;
+    mRanges[index].Requested = 0;
+
+    // Merge with the free neighbors.
+    const uint32_t prev = mRanges[index].PrevPhysical;
+    if (prev != kNull && mRanges[prev].IsFree)
+    {
+        RemoveFree(prev);
+        mRanges[prev].Size += mRanges[index].Size;
+        mRanges[prev].NextPhysical = mRanges[index].NextPhysical;
+        if (mRanges[index].NextPhysical != kNull)
+        {
+            mRanges[mRanges[index].NextPhysical].PrevPhysical = prev;
+        }
+        DeleteRange(index);
+        index = prev;
+    }
+
+    const uint32_t next = mRanges[index].NextPhysical;
+    if (next != kNull && mRanges[next].IsFree)
+    {
+        RemoveFree(next);
+        mRanges[index].Size += mRanges[next].Size;
+        mRanges[index].NextPhysical = mRanges[next].NextPhysical;
+        if (mRanges[next].NextPhysical != kNull)
+        {
+            mRanges[mRanges[next].NextPhysical].PrevPhysical = index;
+        }
+        DeleteRange(next);
+    }
+
+    InsertFree(index);
+}
+
+SuballocatorStats TlsfAllocator::GetStats() const
+{
+    SuballocatorStats stats = mStats;
+    stats.LargestFreeRange = 0;
+
+    // The largest range is in the highest non-empty size class.
+    if (mFirstLevelBitmap != 0)
+    {
+        const uint32_t fl = 63 - (uint32_t)std::countl_zero(mFirstLevelBitmap);
+        const uint32_t sl = 31 - (uint32_t)std::countl_zero(mSecondLevelBitmaps[fl]);
+        for (uint32_t index = mFreeHeads[fl][sl]; index != kNull; index = mRanges[index].NextFree)
+        {
+            stats.LargestFreeRange = (std::max)(stats.LargestFreeRange, mRanges[index].Size);
+        }
+    }
+    return stats;
+}
+
+void TlsfAllocator::Mapping(uint64_t size, uint32_t& firstLevel, uint32_t& secondLevel) const
+{
+    // Sizes below kSecondLevelCount granules each have their own list, above that every
+    // power of two is divided into kSecondLevelCount linear classes.
+    const uint64_t units = size >> mGranularityLog2;
+    if (units < kSecondLevelCount)
+    {
+        firstLevel = 0;
+        secondLevel = (uint32_t)units;
+        return;
+    }
+    const uint32_t msb = 63 - (uint32_t)std::countl_zero(units);
+    firstLevel = msb - kSecondLevelLog2 + 1;
+    secondLevel = (uint32_t)(units >> (msb - kSecondLevelLog2)) - kSecondLevelCount;
+}
+
+uint32_t TlsfAllocator::FindFreeRange(uint64_t size) const
+{
+    // Round the size up to the next class so any range of the class found fits it.
+    uint64_t units = size >> mGranularityLog2;
+    if (units >= kSecondLevelCount)
+    {
+        const uint32_t msb = 63 - (uint32_t)std::countl_zero(units);
+        units += (1ull << (msb - kSecondLevelLog2)) - 1;
+    }
+
+    uint32_t fl, sl;
+    Mapping(units << mGranularityLog2, fl, sl);
+    if (fl >= kFirstLevelCount)
+    {
+        return kNull;
+    }
+
+    uint32_t slMap = mSecondLevelBitmaps[fl] & (~0u << sl);
+    if (slMap == 0)
+    {
+        const uint64_t flMap = fl + 1 < 64 ? mFirstLevelBitmap & (~0ull << (fl + 1)) : 0;
+        if (flMap == 0)
+        {
+            return kNull;
+        }
+        fl = (uint32_t)std::countr_zero(flMap);
+        slMap = mSecondLevelBitmaps[fl];
+    }
+    sl = (uint32_t)std::countr_zero(slMap);
+    return mFreeHeads[fl][sl];
+}
+
+void TlsfAllocator::InsertFree(uint32_t index)
+{
+    uint32_t fl, sl;
+    Mapping(mRanges[index].Size, fl, sl);
+
+    Range& range = mRanges[index];
+    range.IsFree = true;
+    range.PrevFree = kNull;
+    range.NextFree = mFreeHeads[fl][sl];
+    if (range.NextFree != kNull)
+    {
+        mRanges[range.NextFree].PrevFree = index;
+    }
+    mFreeHeads[fl][sl] = index;
+
+    mFirstLevelBitmap |= 1ull << fl;
+    mSecondLevelBitmaps[fl] |= 1u << sl;
+    ++mStats.FreeRangeCount;
+}
+
+void TlsfAllocator::RemoveFree(uint32_t index)
+{
+    uint32_t fl, sl;
+    Mapping(mRanges[index].Size, fl, sl);
+
+    const Range& range = mRanges[index];
+    if (range.PrevFree != kNull)
+    {
+        mRanges[range.PrevFree].NextFree = range.NextFree;
+    }
+    else
+    {
+        mFreeHeads[fl][sl] = range.NextFree;
+    }
+    if (range.NextFree != kNull)
+    {
+        mRanges[range.NextFree].PrevFree = range.PrevFree;
+    }
+
+    if (mFreeHeads[fl][sl] == kNull)
+    {
+        mSecondLevelBitmaps[fl] &= ~(1u << sl);
+        if (mSecondLevelBitmaps[fl] == 0)
+        {
+            mFirstLevelBitmap &= ~(1ull << fl);
+        }
+    }
+    --mStats.FreeRangeCount;
+}
+
+uint32_t TlsfAllocator::SplitOff(uint32_t index, uint64_t size)
+{
+    // Keeps the first size bytes in index, the rest goes to a new range after it.
+    const uint32_t rest = NewRange();
+    Range& range = mRanges[index];
+    Range& restRange = mRanges[rest];
+
+    restRange.Offset = range.Offset + size;
+    restRange.Size = range.Size - size;
+    restRange.PrevPhysical = index;
+    restRange.NextPhysical = range.NextPhysical;
+    if (range.NextPhysical != kNull)
+    {
+        mRanges[range.NextPhysical].PrevPhysical = rest;
+    }
+
+    range.Size = size;
+    range.NextPhysical = rest;
+    return rest;
+}
+
+uint32_t TlsfAllocator::NewRange()
+{
+    if (!mUnusedRanges.empty())
+    {
+        const uint32_t index = mUnusedRanges.back();
+        mUnusedRanges.pop_back();
+        mRanges[index] = Range();
+        return index;
+    }
+    mRanges.emplace_back();
+    return (uint32_t)mRanges.size() - 1;
+}
+
+void TlsfAllocator::DeleteRange(uint32_t index)
+{
+    mRanges[index].IsFree = false;
+    mUnusedRanges.push_back(index);
+}
+
+BuddyAllocator::BuddyAllocator(uint64_t capacity, uint64_t minBlockSize) :
+    mMinBlockSize(minBlockSize)
+{
+    assert(std::has_single_bit(minBlockSize));
+    const uint64_t blocks = capacity / minBlockSize;
+    if (blocks == 0)
+    {
+        return;
+    }
+
+    mMaxOrder = 63 - (uint32_t)std::countl_zero(blocks);
+    mCapacity = BlockSize(mMaxOrder);
+    mStats.Capacity = mCapacity;
+
+    size_t count = 0;
+    for (uint32_t order = 0; order <= mMaxOrder; ++order)
+    {
+        mOrderStart.push_back(count);
+        count += (size_t)(mCapacity / BlockSize(order));
+    }
+    mStates.assign(count, BlockState::Unused);
+    mFreeSlots.assign(count, 0);
+    mRequested.assign(count, 0);
+    mFreeLists.resize(mMaxOrder + 1);
+
+    PushFree(mMaxOrder, 0);
+}
+
+bool BuddyAllocator::Allocate(uint64_t size, uint64_t alignment, SuballocatorAllocation& allocation)
+{
+    assert(std::has_single_bit(alignment));
+    if (mCapacity == 0)
+    {
+        return false;
+    }
+
+    // Blocks are aligned to their size, so alignment only raises the order.
+    const uint64_t blockSize = (std::max)({ size, alignment, mMinBlockSize });
+    if (blockSize > mCapacity)
+    {
+        return false;
+    }
+    const uint32_t order = (uint32_t)std::countr_zero(std::bit_ceil(blockSize) / mMinBlockSize);
+
+    uint32_t found = order;
+    while (found <= mMaxOrder && mFreeLists[found].empty())
+    {
+        ++found;
+    }
+    if (found > mMaxOrder)
+    {
+        return false;
+    }
+
+    const uint64_t offset = mFreeLists[found].back();
+    EraseFree(found, offset);
+
+    // Split down to the order asked, freeing the upper halves.
+    while (found > order)
+    {
+        mStates[BlockIndex(found, offset)] = BlockState::Split;
+        --found;
+        PushFree(found, offset + BlockSize(found));
+    }
+
+    const size_t block = BlockIndex(order, offset);
+    mStates[block] = BlockState::Allocated;
+    mRequested[block] = size;
+
+    mStats.UsedBytes += BlockSize(order);
+    mStats.RequestedBytes += size;
+    ++mStats.AllocationCount;
+
+    allocation.Offset = offset;
+    allocation.Size = BlockSize(order);
+    allocation.Handle = order;
+    return true;
+}
+
+void BuddyAllocator::Free(const SuballocatorAllocation& allocation)
+{
+    uint32_t order = allocation.Handle;
+    uint64_t offset = allocation.Offset;
+    size_t block = BlockIndex(order, offset);
+    assert(mStates[block] == BlockState::Allocated);
+
+    mStats.UsedBytes -= BlockSize(order);
+    mStats.RequestedBytes -= mRequested[block];
+    --mStats.AllocationCount;
+    mRequested[block] = 0;
+    mStates[block] = BlockState::Unused;
+
+    // Merge with the buddy as long as it is free.
+    while (order < mMaxOrder)
+    {
+        const uint64_t buddy = offset ^ BlockSize(order);
+        const size_t buddyBlock = BlockIndex(order, buddy);
+        if (mStates[buddyBlock] != BlockState::Free)
+        {
+            break;
+        }
+        EraseFree(order, buddy);
+        mStates[buddyBlock] = BlockState::Unused;
+
+        offset = (std::min)(offset, buddy);
+        ++order;
+        mStates[BlockIndex(order, offset)] = BlockState::Unused;
+    }
+
+    PushFree(order, offset);
+}
+
+SuballocatorStats BuddyAllocator::GetStats() const
+{
+    SuballocatorStats stats = mStats;
+    stats.FreeRangeCount = 0;
+    stats.LargestFreeRange = 0;
+    for (uint32_t order = 0; order < mFreeLists.size(); ++order)
+    {
+        stats.FreeRangeCount += mFreeLists[order].size();
+        if (!mFreeLists[order].empty())
+        {
+            stats.LargestFreeRange = BlockSize(order);
+        }
+    }
+    return stats;
+}
+
+size_t BuddyAllocator::BlockIndex(uint32_t order, uint64_t offset) const
+{
+    return mOrderStart[order] + (size_t)(offset / BlockSize(order));
+}
+
+void BuddyAllocator::PushFree(uint32_t order, uint64_t offset)
+{
+    const size_t block = BlockIndex(order, offset);
+    mStates[block] = BlockState::Free;
+    mFreeSlots[block] = (uint32_t)mFreeLists[order].size();
+    mFreeLists[order].push_back(offset);
+}
+
+void BuddyAllocator::EraseFree(uint32_t order, uint64_t offset)
+{
+    // Swap with the last entry of the list.
+    std::vector<uint64_t>& list = mFreeLists[order];
+    const uint32_t slot = mFreeSlots[BlockIndex(order, offset)];
+    list[slot] = list.back();
+    mFreeSlots[BlockIndex(order, list[slot])] = slot;
+    list.pop_back();
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Two strategies for placing resources inside one large heap block. They work only with
+// offsets and sizes, and GpuMemoryAllocator.h picks one per block and creates the placed
+// resources.
+//
+// TlsfAllocator (two-level segregated fit) handles the arbitrary sizes of buffers with
+// O(1) allocation and free and immediate coalescing of free neighbors. BuddyAllocator
+// handles textures, whose sizes and alignments are multiples of 64 KiB, by splitting
+// power of two blocks, which keeps every block aligned to its size.
+struct SuballocatorStats
+{
+	uint64_t Capacity = 0;
+	uint64_t UsedBytes = 0;			// including alignment and rounding
+	uint64_t RequestedBytes = 0;	// as asked by the callers
+	uint64_t AllocationCount = 0;
+	uint64_t FreeRangeCount = 0;
+	uint64_t LargestFreeRange = 0;
+
+	// 0 when all the free space is one range, towards 1 as it breaks into small ones.
+	double ExternalFragmentation() const
+	{
+		const uint64_t freeBytes = Capacity - UsedBytes;
+		return freeBytes == 0 ? 0.0 : 1.0 - (double)LargestFreeRange / (double)freeBytes;
+	}
+
+	// Share of the used bytes lost to rounding and alignment.
+	double InternalFragmentation() const
+	{
+		return UsedBytes == 0 ? 0.0 : 1.0 - (double)RequestedBytes / (double)UsedBytes;
+	}
+};
+
+struct SuballocatorAllocation
+{
+	uint64_t Offset = 0;
+	uint64_t Size = 0;				// actually reserved, at least the requested size
+	uint32_t Handle = UINT32_MAX;	// allocator specific, given back to Free
+};
+
+class TlsfAllocator
+{
+public:
+	// capacity and every size are rounded to granularity, a power of two.
+	explicit TlsfAllocator(uint64_t capacity, uint64_t granularity = 256);
+
+	// alignment must be a power of two. False when no free range fits.
+	bool Allocate(uint64_t size, uint64_t alignment, SuballocatorAllocation& allocation);
+	void Free(const SuballocatorAllocation& allocation);
+
+	uint64_t GetCapacity() const { return mCapacity; }
+	bool IsEmpty() const { return mStats.AllocationCount == 0; }
+	SuballocatorStats GetStats() const;
+
+private:
+	static constexpr uint32_t kNull = UINT32_MAX;
+	static constexpr uint32_t kSecondLevelLog2 = 4;
+	static constexpr uint32_t kSecondLevelCount = 1u << kSecondLevelLog2;
+	static constexpr uint32_t kFirstLevelCount = 64 - kSecondLevelLog2 + 1;
+
+	// Physical neighbors link every range of the block in address order, free ranges
+	// are also linked in the list of their size class.
+	struct Range
+	{
+		uint64_t Offset = 0;
+		uint64_t Size = 0;
+		uint64_t Requested = 0;
+		uint32_t PrevPhysical = kNull;
+		uint32_t NextPhysical = kNull;
+		uint32_t PrevFree = kNull;
+		uint32_t NextFree = kNull;
+		bool IsFree = false;
+	};
+
+	void Mapping(uint64_t size, uint32_t& firstLevel, uint32_t& secondLevel) const;
+	uint32_t FindFreeRange(uint64_t size) const;
+	void InsertFree(uint32_t index);
+	void RemoveFree(uint32_t index);
+	uint32_t SplitOff(uint32_t index, uint64_t size);
+	uint32_t NewRange();
+	void DeleteRange(uint32_t index);
+
+	uint64_t mCapacity = 0;
+	uint64_t mGranularity = 0;
+	uint32_t mGranularityLog2 = 0;
+
+	uint64_t mFirstLevelBitmap = 0;
+	uint32_t mSecondLevelBitmaps[kFirstLevelCount] = {};
+	uint32_t mFreeHeads[kFirstLevelCount][kSecondLevelCount];
+
+	std::vector<Range> mRanges;
+	std::vector<uint32_t> mUnusedRanges;
+
+	SuballocatorStats mStats;
+};
+
+class BuddyAllocator
+{
+public:
+	// capacity is rounded down to minBlockSize times a power of two, both powers of two.
+	explicit BuddyAllocator(uint64_t capacity, uint64_t minBlockSize = 64 * 1024);
+
+	// alignment must be a power of two. False when no block fits.
+	bool Allocate(uint64_t size, uint64_t alignment, SuballocatorAllocation& allocation);
+	void Free(const SuballocatorAllocation& allocation);
+
+	uint64_t GetCapacity() const { return mCapacity; }
+	bool IsEmpty() const { return mStats.AllocationCount == 0; }
+	SuballocatorStats GetStats() const;
+
+private:
+	// Per order, state of every block: free, split into two halves, or allocated. The
+	// order of an allocation is its Handle.
+	enum class BlockState : uint8_t { Unused, Free, Split, Allocated };
+
+	uint64_t BlockSize(uint32_t order) const { return mMinBlockSize << order; }
+	size_t BlockIndex(uint32_t order, uint64_t offset) const;
+	void PushFree(uint32_t order, uint64_t offset);
+	void EraseFree(uint32_t order, uint64_t offset);
+
+	uint64_t mCapacity = 0;
+	uint64_t mMinBlockSize = 0;
+	uint32_t mMaxOrder = 0;
+
+	// Blocks of every order in one array, order k starting at mOrderStart[k].
+	std::vector<BlockState> mStates;
+	std::vector<size_t> mOrderStart;
+
+	// Free blocks per order, with their position in the list for O(1) removal.
+	std::vector<std::vector<uint64_t>> mFreeLists;
+	std::vector<uint32_t> mFreeSlots;
+
+	// Requested size of every allocated block, indexed like mStates.
+	std::vector<uint64_t> mRequested;
+
+	SuballocatorStats mStats;
+};
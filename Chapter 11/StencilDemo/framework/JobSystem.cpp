@@ -0,0 +1,133 @@
+#include "JobSystem.h"
+#include <algorithm>
+#include <utility>
+
+JobSystem::JobSystem(uint32_t workerCount)
+{
+    if (workerCount == 0)
+    {
+        workerCount = (std::max)(std::thread::hardware_concurrency(), 1u) - 1;
+    }
+
+    mWorkers.reserve(workerCount);
+    for (uint32_t i = 0; i < workerCount; ++i)
+    {
+        mWorkers.emplace_back(&JobSystem::WorkerLoop, this);
+    }
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard lock(mMutex);
+        mQuit = true;
+    }
+    mWakeUp.notify_all();
+
+    for (std::thread& worker : mWorkers)
+    {
+        worker.join();
+    }
+}
+
+void JobSystem::Run(uint32_t count, JobFunction function, const void* context)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    // Waking the workers for a single iteration costs more than it saves.
+    if (mWorkers.empty() || count == 1)
+    {
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            function(context, i);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard lock(mMutex);
+        mFunction = function;
+        mContext = context;
+        mCount = count;
+        mAllocationTag = AllocationTracker::GetCurrentTag();
+        mAllocationRule = AllocationTracker::GetCurrentRule();
+        mNext.store(0, std::memory_order_relaxed);
+        ++mGeneration;
+    }
+    mWakeUp.notify_all();
+
+    Work(function, context, count);
+
+    // Every iteration is taken, wait for the workers still running one. Clearing the loop
+    // under the same lock keeps late workers from joining it once context is gone.
+    std::exception_ptr error;
+    {
+        std::unique_lock lock(mMutex);
+        mDone.wait(lock, [this]() { return mActiveWorkers == 0; });
+        mFunction = nullptr;
+        mContext = nullptr;
+        error = std::exchange(mError, nullptr);
+    }
+
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+}
+
+void JobSystem::Work(JobFunction function, const void* context, uint32_t count)
+{
+    for (uint32_t i = mNext.fetch_add(1, std::memory_order_relaxed); i < count;
+        i = mNext.fetch_add(1, std::memory_order_relaxed))
+    {
+        try
+        {
+            function(context, i);
+        }
+        catch (...)
+        {
+            std::lock_guard lock(mMutex);
+            if (!mError)
+            {
+                mError = std::current_exception();
+            }
+        }
+    }
+}
+
+void JobSystem::WorkerLoop()
+{
+    uint64_t generation = 0;
+    std::unique_lock lock(mMutex);
+    for (;;)
+    {
+        mWakeUp.wait(lock, [&]() { return mQuit || (mFunction != nullptr && mGeneration != generation); });
+        if (mQuit)
+        {
+            return;
+        }
+
+        generation = mGeneration;
+        const JobFunction function = mFunction;
+        const void* context = mContext;
+        const uint32_t count = mCount;
+        const char* allocationTag = mAllocationTag;
+        const AllocationRule allocationRule = mAllocationRule;
+        ++mActiveWorkers;
+
+        lock.unlock();
+        {
+            AllocationScope scope(allocationTag, allocationRule);
+            Work(function, context, count);
+        }
+        lock.lock();
+
+        if (--mActiveWorkers == 0)
+        {
+            mDone.notify_one();
+        }
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "AllocationTracker.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed pool of worker threads running the iterations of a parallel loop. The calling
+// thread takes iterations too and only returns once all of them ran, so a loop body can
+// use anything the caller owns. Iterations are handed out one at a time from a shared
+// counter, uneven ones balance themselves. Running a loop doesn't allocate.
+//
+// One loop at a time: ParallelFor must not be called from a loop body or from two
+// threads at once. An exception thrown by a body is rethrown by ParallelFor, after the
+// other iterations finished.
+//
+// The workers run their iterations in the AllocationScope tag and rule of the caller, an
+// allocation free frame stays allocation free on every thread.
+class JobSystem
+{
+public:
+	// workerCount 0 picks one per hardware thread besides the calling one.
+	explicit JobSystem(uint32_t workerCount = 0);
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+	~JobSystem();
+
+	uint32_t GetWorkerCount() const { return (uint32_t)mWorkers.size(); }
+
+	// Calls fn(i) for every i in [0, count), in no particular order.
+	template <class Fn>
+	void ParallelFor(uint32_t count, const Fn& fn)
+	{
+		Run(count, [](const void* context, uint32_t i) { (*static_cast<const Fn*>(context))(i); }, &fn);
+	}
+
+private:
+	using JobFunction = void (*)(const void* context, uint32_t index);
+
+	void Run(uint32_t count, JobFunction function, const void* context);
+	// Runs iterations until there are none left.
+	void Work(JobFunction function, const void* context, uint32_t count);
+	void WorkerLoop();
+
+	std::vector<std::thread> mWorkers;
+
+	std::mutex mMutex;
+	std::condition_variable mWakeUp;
+	std::condition_variable mDone;
+
+	// The running loop, null between loops.
+	JobFunction mFunction = nullptr;
+	const void* mContext = nullptr;
+	uint32_t mCount = 0;
+	const char* mAllocationTag = nullptr;
+	AllocationRule mAllocationRule = AllocationRule::Inherit;
+	uint64_t mGeneration = 0;
+	std::atomic<uint32_t> mNext = 0;
+
+	// Workers inside Work, the loop is over when it drops to 0.
+	uint32_t mActiveWorkers = 0;
+	std::exception_ptr mError;
+	bool mQuit = false;
+};
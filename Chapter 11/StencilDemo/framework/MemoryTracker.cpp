@@ -0,0 +1,179 @@
+#include "MemoryTracker.h"
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+namespace
+{
+    void AppendJsonString(std::string& json, std::string_view text)
+    {
+        json += '"';
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+            {
+                json += '\\';
+                json += c;
+            }
+            else if ((unsigned char)c < 0x20)
+            {
+                char escaped[8];
+                snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned)c);
+                json += escaped;
+            }
+            else
+            {
+                json += c;
+            }
+        }
+        json += '"';
+    }
+
+    void AppendTotals(std::string& json, const MemoryTotals& totals)
+    {
+        json += "{\"bytes\":" + std::to_string(totals.Bytes) +
+            ",\"count\":" + std::to_string(totals.Count) +
+            ",\"peakBytes\":" + std::to_string(totals.PeakBytes) + "}";
+    }
+}
+
+const char* ToString(MemoryCategory category)
+{
+    switch (category)
+    {
+    case MemoryCategory::Geometry:          return "geometry";
+    case MemoryCategory::Texture:           return "texture";
+    case MemoryCategory::ConstantBuffer:    return "constantBuffer";
+    case MemoryCategory::Upload:            return "upload";
+    case MemoryCategory::RenderTarget:      return "renderTarget";
+    default:                                return "other";
+    }
+}
+
+const char* ToString(MemoryHeapType heapType)
+{
+    switch (heapType)
+    {
+    case MemoryHeapType::Default:   return "default";
+    case MemoryHeapType::Upload:    return "upload";
+    case MemoryHeapType::Readback:  return "readback";
+    default:                        return "custom";
+    }
+}
+
+MemoryTracker& MemoryTracker::Get()
+{
+    static MemoryTracker tracker;
+    return tracker;
+}
+
+uint64_t MemoryTracker::Add(MemoryCategory category, MemoryHeapType heapType, std::string_view name, uint64_t size)
+{
+    std::lock_guard lock(mMutex);
+    const uint64_t id = mNextId++;
+    mRecords[id] = { category, heapType, std::string(name), size };
+
+    Adjust(mTotal, size, true);
+    Adjust(mCategoryTotals[(int)category], size, true);
+    Adjust(mHeapTotals[(int)heapType], size, true);
+    return id;
+}
+
+void MemoryTracker::Remove(uint64_t id)
+{
+    std::lock_guard lock(mMutex);
+    auto it = mRecords.find(id);
+    if (it == mRecords.end())
+    {
+        return;
+    }
+
+    const Record& record = it->second;
+    Adjust(mTotal, record.Size, false);
+    Adjust(mCategoryTotals[(int)record.Category], record.Size, false);
+    Adjust(mHeapTotals[(int)record.HeapType], record.Size, false);
+    mRecords.erase(it);
+}
+
+MemoryTotals MemoryTracker::GetTotals() const
+{
+    std::lock_guard lock(mMutex);
+    return mTotal;
+}
+
+MemoryTotals MemoryTracker::GetTotals(MemoryCategory category) const
+{
+    std::lock_guard lock(mMutex);
+    return mCategoryTotals[(int)category];
+}
+
+MemoryTotals MemoryTracker::GetTotals(MemoryHeapType heapType) const
+{
+    std::lock_guard lock(mMutex);
+    return mHeapTotals[(int)heapType];
+}
+
+std::string MemoryTracker::ToJson(uint64_t frame) const
+{
+    std::lock_guard lock(mMutex);
+
+    std::string json = "{\"frame\":" + std::to_string(frame) + ",\"total\":";
+    AppendTotals(json, mTotal);
+
+    json += ",\"categories\":{";
+    for (int i = 0; i < (int)MemoryCategory::Count; ++i)
+    {
+        json += i == 0 ? "\"" : ",\"";
+        json += ToString((MemoryCategory)i);
+        json += "\":";
+        AppendTotals(json, mCategoryTotals[i]);
+    }
+
+    json += "},\"heaps\":{";
+    for (int i = 0; i < (int)MemoryHeapType::Count; ++i)
+    {
+        json += i == 0 ? "\"" : ",\"";
+        json += ToString((MemoryHeapType)i);
+        json += "\":";
+        AppendTotals(json, mHeapTotals[i]);
+    }
+
+    std::vector<const Record*> records;
+    records.reserve(mRecords.size());
+    for (const auto& e : mRecords)
+    {
+        records.push_back(&e.second);
+    }
+    std::sort(records.begin(), records.end(), [](const Record* a, const Record* b) {
+        return a->Size != b->Size ? a->Size > b->Size : a->Name < b->Name;
+    });
+
+    json += "},\"allocations\":[";
+    for (size_t i = 0; i < records.size(); ++i)
+    {
+        json += i == 0 ? "{\"name\":" : ",{\"name\":";
+        AppendJsonString(json, records[i]->Name);
+        json += ",\"category\":\"";
+        json += ToString(records[i]->Category);
+        json += "\",\"heap\":\"";
+        json += ToString(records[i]->HeapType);
+        json += "\",\"bytes\":" + std::to_string(records[i]->Size) + "}";
+    }
+    json += "]}";
+    return json;
+}
+
+void MemoryTracker::Adjust(MemoryTotals& totals, uint64_t size, bool add)
+{
+    if (add)
+    {
+        totals.Bytes += size;
+        ++totals.Count;
+        totals.PeakBytes = (std::max)(totals.PeakBytes, totals.Bytes);
+    }
+    else
+    {
+        totals.Bytes -= size;
+        --totals.Count;
+    }
+}
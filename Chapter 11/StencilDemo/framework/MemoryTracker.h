@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Process-wide record of the GPU memory the app owns, labelled by what the memory holds
+// and by the heap it lives in. ResourceMemory.h adds each D3D12 resource when it is
+// created and removes it when it is destroyed, and the memory dump key writes the JSON.
+//
+// Totals and high-water marks are kept per category, per heap type and overall. ToJson
+// lists them with every live allocation, largest first.
+enum class MemoryCategory : uint8_t
+{
+	Geometry,
+	Texture,
+	ConstantBuffer,
+	Upload,			// staging memory of copies to default heaps
+	RenderTarget,	// render targets and depth stencil buffers
+	Other,
+	Count
+};
+
+enum class MemoryHeapType : uint8_t
+{
+	Default,
+	Upload,
+	Readback,
+	Custom,
+	Count
+};
+
+const char* ToString(MemoryCategory category);
+const char* ToString(MemoryHeapType heapType);
+
+struct MemoryTotals
+{
+	uint64_t Bytes = 0;
+	uint64_t Count = 0;
+	uint64_t PeakBytes = 0;		// largest Bytes seen
+};
+
+class MemoryTracker
+{
+public:
+	// The tracker ResourceMemory.h records into.
+	static MemoryTracker& Get();
+
+	// Returns the id to remove the allocation with, never 0.
+	uint64_t Add(MemoryCategory category, MemoryHeapType heapType, std::string_view name, uint64_t size);
+	void Remove(uint64_t id);
+
+	MemoryTotals GetTotals() const;
+	MemoryTotals GetTotals(MemoryCategory category) const;
+	MemoryTotals GetTotals(MemoryHeapType heapType) const;
+
+	// {"frame":..., "total":{...}, "categories":{...}, "heaps":{...}, "allocations":[...]}
+	std::string ToJson(uint64_t frame) const;
+
+private:
+	struct Record
+	{
+		MemoryCategory Category = MemoryCategory::Other;
+		MemoryHeapType HeapType = MemoryHeapType::Default;
+		std::string Name;
+		uint64_t Size = 0;
+	};
+
+	static void Adjust(MemoryTotals& totals, uint64_t size, bool add);
+
+	mutable std::mutex mMutex;
+	std::unordered_map<uint64_t, Record> mRecords;
+	uint64_t mNextId = 1;
+
+	MemoryTotals mTotal;
+	MemoryTotals mCategoryTotals[(int)MemoryCategory::Count];
+	MemoryTotals mHeapTotals[(int)MemoryHeapType::Count];
+};
@@ -0,0 +1,134 @@
+#include "ResourceMemory.h"
+#include "TextureLayout.h"
+#include <atomic>
+
+namespace
+{
+    // {6D3A3A8E-1F0B-4C52-9E0D-5B6C2B7E4A91}
+    const GUID kMemoryTrackerToken =
+        { 0x6d3a3a8e, 0x1f0b, 0x4c52, { 0x9e, 0x0d, 0x5b, 0x6c, 0x2b, 0x7e, 0x4a, 0x91 } };
+
+    UINT64 AlignUp(UINT64 value, UINT64 alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    // Kept in the private data of a tracked resource, which releases it when it dies.
+    class TrackerToken : public IUnknown
+    {
+    public:
+        explicit TrackerToken(uint64_t id) : mId(id) {}
+
+        HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** object) override
+        {
+            if (object == nullptr)
+            {
+                return E_POINTER;
+            }
+            if (riid == __uuidof(IUnknown))
+            {
+                *object = static_cast<IUnknown*>(this);
+                AddRef();
+                return S_OK;
+            }
+            *object = nullptr;
+            return E_NOINTERFACE;
+        }
+
+        ULONG STDMETHODCALLTYPE AddRef() override
+        {
+            return ++mRefCount;
+        }
+
+        ULONG STDMETHODCALLTYPE Release() override
+        {
+            const ULONG count = --mRefCount;
+            if (count == 0)
+            {
+                MemoryTracker::Get().Remove(mId);
+                delete this;
+            }
+            return count;
+        }
+
+    private:
+        std::atomic<ULONG> mRefCount = 1;
+        uint64_t mId = 0;
+    };
+}
+
+UINT64 EstimateResourceSize(const D3D12_RESOURCE_DESC& desc)
+{
+    const UINT sampleCount = (std::max)(desc.SampleDesc.Count, 1u);
+    UINT64 alignment = desc.Alignment;
+    if (alignment == 0)
+    {
+        alignment = sampleCount > 1 ?
+            D3D12_DEFAULT_MSAA_RESOURCE_PLACEMENT_ALIGNMENT : D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+    }
+
+    if (desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+    {
+        return AlignUp(desc.Width, alignment);
+    }
+
+    UINT mipLevels = desc.MipLevels;
+    if (mipLevels == 0)
+    {
+        UINT64 size = (std::max)(desc.Width, (UINT64)desc.Height);
+        if (desc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D)
+        {
+            size = (std::max)(size, (UINT64)desc.DepthOrArraySize);
+        }
+        for (mipLevels = 1; size > 1; size >>= 1)
+        {
+            ++mipLevels;
+        }
+    }
+    const UINT arraySize = desc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D ? 1u : desc.DepthOrArraySize;
+    const UINT subresourceCount = mipLevels * arraySize * (std::max)(GetFormatPlaneCount(desc.Format), 1u);
+
+    UINT64 totalBytes = 0;
+    if (!ComputeCopyableFootprints(desc, 0, subresourceCount, 0, nullptr, nullptr, nullptr, &totalBytes))
+    {
+        return 0;
+    }
+    return AlignUp(totalBytes * sampleCount, alignment);
+}
+
+MemoryHeapType ToMemoryHeapType(D3D12_HEAP_TYPE heapType)
+{
+    switch (heapType)
+    {
+    case D3D12_HEAP_TYPE_DEFAULT:   return MemoryHeapType::Default;
+    case D3D12_HEAP_TYPE_UPLOAD:    return MemoryHeapType::Upload;
+    case D3D12_HEAP_TYPE_READBACK:  return MemoryHeapType::Readback;
+    default:                        return MemoryHeapType::Custom;
+    }
+}
+
+void TrackResource(ID3D12Resource* resource, MemoryCategory category, std::string_view name)
+{
+    if (resource == nullptr)
+    {
+        return;
+    }
+
+    // Reserved resources have no heap of their own, their tiles are counted with the heaps
+    // they are mapped to.
+    D3D12_HEAP_PROPERTIES heapProperties = {};
+    D3D12_HEAP_FLAGS heapFlags = D3D12_HEAP_FLAG_NONE;
+    if (FAILED(resource->GetHeapProperties(&heapProperties, &heapFlags)))
+    {
+        return;
+    }
+
+    const uint64_t id = MemoryTracker::Get().Add(category, ToMemoryHeapType(heapProperties.Type),
+        name, EstimateResourceSize(resource->GetDesc()));
+
+    // The resource holds its own reference to the token, it replaces (and so removes) an
+    // earlier record of the same resource.
+    auto* token = new TrackerToken(id);
+    resource->SetPrivateDataInterface(kMemoryTrackerToken, token) >> chk;
+    token->Release();
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "d3dUtil.h"
+#include "MemoryTracker.h"
+
+// Records D3D12 resources in MemoryTracker::Get(). Every place that creates a resource
+// calls TrackResource right after, the record goes away on its own when the resource is
+// destroyed, through a token kept in the resource's private data.
+
+// Bytes the resource takes in its heap, from its description alone: buffers and the
+// copyable footprints of all subresources times the sample count, rounded up to the
+// placement alignment. Close to GetResourceAllocationInfo without needing the device.
+UINT64 EstimateResourceSize(const D3D12_RESOURCE_DESC& desc);
+
+MemoryHeapType ToMemoryHeapType(D3D12_HEAP_TYPE heapType);
+
+// Tracks resource (null is ignored) until its last reference goes. Tracking it again
+// replaces the previous record.
+void TrackResource(ID3D12Resource* resource, MemoryCategory category, std::string_view name);
@@ -0,0 +1,105 @@
+#include "RingAllocator.h"
+#include <algorithm>
+
+RingAllocator::RingAllocator(uint64_t capacity, uint64_t maxCapacity) :
+    mCapacity(capacity),
+    mMaxCapacity((std::max)(capacity, maxCapacity))
+{
+}
+
+bool RingAllocator::Allocate(uint64_t size, uint64_t alignment, RingAllocation& allocation, bool& grew)
+{
+    grew = false;
+    if (size > mMaxCapacity || alignment > mMaxCapacity)
+    {
+        return false;
+    }
+
+    // Align from the head, or skip the end of the buffer when the allocation would
+    // straddle it, allocations are contiguous.
+    const uint64_t head = mHead % mCapacity;
+    uint64_t offset = (head + alignment - 1) & ~(alignment - 1);
+    uint64_t padding = offset - head;
+    if (offset + size > mCapacity)
+    {
+        padding = mCapacity - head;
+        offset = 0;
+    }
+
+    if (size <= mCapacity && mHead + padding + size - mTail <= mCapacity)
+    {
+        mHead += padding + size;
+        mPeakUsed = (std::max)(mPeakUsed, mHead - mTail);
+        allocation = { mBuffer, offset };
+        return true;
+    }
+
+    // Out of space: move on to a larger buffer, the current one is released once the
+    // frames using it complete.
+    uint64_t capacity = mCapacity;
+    while (capacity < size || capacity == mCapacity)
+    {
+        if (capacity > mMaxCapacity / 2)
+        {
+            capacity = mMaxCapacity;
+            break;
+        }
+        capacity *= 2;
+    }
+    if (capacity < size || capacity == mCapacity)
+    {
+        return false;
+    }
+
+    mRetiredBuffers.push_back({ mBuffer, 0 });
+    ++mBuffer;
+    mCapacity = capacity;
+    mHead = size;
+    mTail = 0;
+    mPeakUsed = size;
+
+    allocation = { mBuffer, 0 };
+    grew = true;
+    return true;
+}
+
+void RingAllocator::EndFrame(uint64_t fenceValue)
+{
+    mFrames.push_back({ fenceValue, mBuffer, mHead });
+
+    for (RetiredBuffer& retired : mRetiredBuffers)
+    {
+        if (retired.LastFenceValue == 0)
+        {
+            retired.LastFenceValue = fenceValue;
+        }
+    }
+}
+
+void RingAllocator::Retire(uint64_t completedFenceValue, std::vector<uint64_t>& releasedBuffers)
+{
+    size_t retiredFrames = 0;
+    for (; retiredFrames < mFrames.size() && mFrames[retiredFrames].FenceValue <= completedFenceValue; ++retiredFrames)
+    {
+        // Frames of replaced buffers only matter for releasing those.
+        if (mFrames[retiredFrames].Buffer == mBuffer)
+        {
+            mTail = mFrames[retiredFrames].Head;
+        }
+    }
+    mFrames.erase(mFrames.begin(), mFrames.begin() + retiredFrames);
+
+    for (size_t i = 0; i < mRetiredBuffers.size(); )
+    {
+        const RetiredBuffer& retired = mRetiredBuffers[i];
+        if (retired.LastFenceValue != 0 && retired.LastFenceValue <= completedFenceValue)
+        {
+            releasedBuffers.push_back(retired.Buffer);
+            mRetiredBuffers.erase(mRetiredBuffers.begin() + i);
+        }
+        else
+        {
+            ++i;
+        }
+    }
+}
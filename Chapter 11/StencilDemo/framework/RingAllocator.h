@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Hands out offsets and buffer ids for the per-frame upload data, and UploadRing.h maps
+// the ids to D3D12 upload buffers. Nothing is freed one allocation at a time, whole frames
+// are given back as their fences complete.
+//
+// Allocations are carved linearly from the head of the current buffer and live for the
+// frame they were made in: EndFrame tags everything allocated since the previous call
+// with the fence value the GPU signals once done with it, and Retire moves the tail past
+// the frames whose fence completed. An allocation that doesn't fit between head and tail
+// switches to a new buffer twice as large (or large enough), the old one is released by
+// Retire once its last frame completed. Buffers are named by increasing ids.
+struct RingAllocation
+{
+	uint64_t Buffer = 0;		// id of the buffer
+	uint64_t Offset = 0;		// from the start of the buffer
+};
+
+class RingAllocator
+{
+public:
+	// Buffers never grow past maxCapacity.
+	explicit RingAllocator(uint64_t capacity, uint64_t maxCapacity = UINT64_MAX);
+
+	// alignment must be a power of two. False when size can't fit even in a buffer of
+	// maxCapacity. grew is set when allocation lives in a new buffer, which the caller
+	// has to create (with GetCapacity bytes) before using the allocation.
+	bool Allocate(uint64_t size, uint64_t alignment, RingAllocation& allocation, bool& grew);
+
+	// Closes the frame: everything allocated since the last call is in use until the GPU
+	// reaches fenceValue. Fence values must increase.
+	void EndFrame(uint64_t fenceValue);
+
+	// Frees the frames whose fence value is at most completedFenceValue. Appends the ids
+	// of the buffers that are no longer used to releasedBuffers.
+	void Retire(uint64_t completedFenceValue, std::vector<uint64_t>& releasedBuffers);
+
+	uint64_t GetBuffer() const { return mBuffer; }
+	uint64_t GetCapacity() const { return mCapacity; }
+
+	// Bytes between tail and head, padding included.
+	uint64_t GetUsedBytes() const { return mHead - mTail; }
+
+	// Largest use of the current buffer seen.
+	uint64_t GetPeakUsedBytes() const { return mPeakUsed; }
+
+private:
+	struct Frame
+	{
+		uint64_t FenceValue;
+		uint64_t Buffer;
+		uint64_t Head;			// end of the frame's allocations in Buffer
+	};
+
+	// Buffer replaced by a larger one, released once no open frame uses it.
+	struct RetiredBuffer
+	{
+		uint64_t Buffer;
+		uint64_t LastFenceValue;	// 0 while the current frame still allocates from it
+	};
+
+	uint64_t mCapacity = 0;
+	uint64_t mMaxCapacity = 0;
+	uint64_t mBuffer = 0;
+
+	// Positions grow without wrapping, the offset in the buffer is position % capacity.
+	uint64_t mHead = 0;
+	uint64_t mTail = 0;
+	uint64_t mPeakUsed = 0;
+
+	// Oldest first. A vector rather than a deque, whose blocks would be allocated and freed
+	// as frames go through.
+	std::vector<Frame> mFrames;
+	std::vector<RetiredBuffer> mRetiredBuffers;
+};
@@ -0,0 +1,810 @@
+#include "TextureAtlas.h"
+#include "DDSTextureLoader.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace
+{
+    //
+    // The subset of the DDS file structures needed for writing the atlas.
+    // See DDSTextureLoader.cpp for the full definitions.
+    //
+#pragma pack(push, 1)
+    struct DdsPixelFormat
+    {
+        uint32_t size;
+        uint32_t flags;
+        uint32_t fourCC;
+        uint32_t RGBBitCount;
+        uint32_t RBitMask;
+        uint32_t GBitMask;
+        uint32_t BBitMask;
+        uint32_t ABitMask;
+    };
+
+    struct DdsHeader
+    {
+        uint32_t size;
+        uint32_t flags;
+        uint32_t height;
+        uint32_t width;
+        uint32_t pitchOrLinearSize;
+        uint32_t depth;
+        uint32_t mipMapCount;
+        uint32_t reserved1[11];
+        DdsPixelFormat ddspf;
+        uint32_t caps;
+        uint32_t caps2;
+        uint32_t caps3;
+        uint32_t caps4;
+        uint32_t reserved2;
+    };
+
+    struct DdsHeaderDxt10
+    {
+        DXGI_FORMAT dxgiFormat;
+        uint32_t resourceDimension;
+        uint32_t miscFlag;
+        uint32_t arraySize;
+        uint32_t miscFlags2;
+    };
+#pragma pack(pop)
+
+    constexpr uint32_t DdsMagic = 0x20534444;   // "DDS "
+    constexpr uint32_t DdsFourCC = 0x00000004;
+    constexpr uint32_t DdsFlagsTexture = 0x00001007;    // CAPS | HEIGHT | WIDTH | PIXELFORMAT
+    constexpr uint32_t DdsFlagsMipmap = 0x00020000;     // MIPMAPCOUNT
+    constexpr uint32_t DdsFlagsPitch = 0x00000008;
+    constexpr uint32_t DdsFlagsLinearSize = 0x00080000;
+    constexpr uint32_t DdsCapsTexture = 0x00001000;
+    constexpr uint32_t DdsCapsComplexMipmap = 0x00400008;
+    constexpr uint32_t DdsResourceDimensionTexture2D = 3;
+    constexpr uint32_t DdsAlphaModeOpaque = 3;
+
+    // R8G8B8A8 texels.
+    struct Image
+    {
+        UINT Width = 0;
+        UINT Height = 0;
+        std::vector<uint8_t> Pixels;
+    };
+
+    struct SurfaceInfo
+    {
+        UINT Width;
+        UINT Height;
+        size_t RowPitch;
+        size_t NumRows;
+        size_t NumBytes;
+    };
+
+    SurfaceInfo GetSurfaceInfo(UINT width, UINT height, DXGI_FORMAT format)
+    {
+        SurfaceInfo info = { width, height };
+        if (format == DXGI_FORMAT_BC1_UNORM)
+        {
+            // 8 bytes for every 4x4 block, partial blocks are padded.
+            info.RowPitch = (size_t)(std::max)(1u, (width + 3) / 4) * 8;
+            info.NumRows = (std::max)(1u, (height + 3) / 4);
+        }
+        else
+        {
+            info.RowPitch = (size_t)width * 4;
+            info.NumRows = height;
+        }
+        info.NumBytes = info.RowPitch * info.NumRows;
+        return info;
+    }
+
+    UINT AlignUp(UINT value, UINT alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    uint16_t ToRGB565(const int rgb[3])
+    {
+        return (uint16_t)(((rgb[0] * 31 + 127) / 255) << 11 |
+            ((rgb[1] * 63 + 127) / 255) << 5 |
+            ((rgb[2] * 31 + 127) / 255));
+    }
+
+    void FromRGB565(uint16_t c, int rgb[3])
+    {
+        const int r = (c >> 11) & 31;
+        const int g = (c >> 5) & 63;
+        const int b = c & 31;
+        rgb[0] = (r << 3) | (r >> 2);
+        rgb[1] = (g << 2) | (g >> 4);
+        rgb[2] = (b << 3) | (b >> 2);
+    }
+
+    // Color part of BC1-3 blocks. BC1 blocks with c0 <= c1 are in 3-color mode, where
+    // index 3 is transparent black, BC2 and BC3 always use 4 colors.
+    void DecodeColorBlock(const uint8_t* block, bool allowThreeColors, uint8_t texels[16][4])
+    {
+        uint16_t c0;
+        uint16_t c1;
+        uint32_t indices;
+        memcpy(&c0, block + 0, sizeof(c0));
+        memcpy(&c1, block + 2, sizeof(c1));
+        memcpy(&indices, block + 4, sizeof(indices));
+
+        int palette[4][4];
+        FromRGB565(c0, palette[0]);
+        FromRGB565(c1, palette[1]);
+        palette[0][3] = palette[1][3] = palette[2][3] = palette[3][3] = 255;
+        const bool threeColors = allowThreeColors && c0 <= c1;
+        for (int c = 0; c < 3; ++c)
+        {
+            if (threeColors)
+            {
+                palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+                palette[3][c] = 0;
+            }
+            else
+            {
+                palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+            }
+        }
+        if (threeColors)
+        {
+            palette[3][3] = 0;
+        }
+
+        for (int i = 0; i < 16; ++i)
+        {
+            const int* color = palette[(indices >> (2 * i)) & 3];
+            for (int c = 0; c < 4; ++c)
+            {
+                texels[i][c] = (uint8_t)color[c];
+            }
+        }
+    }
+
+    // Interpolated alpha of BC3 blocks.
+    void DecodeAlphaBlock(const uint8_t* block, uint8_t texels[16][4])
+    {
+        int alpha[8] = { block[0], block[1] };
+        if (alpha[0] > alpha[1])
+        {
+            for (int i = 1; i < 7; ++i)
+            {
+                alpha[i + 1] = ((7 - i) * alpha[0] + i * alpha[1]) / 7;
+            }
+        }
+        else
+        {
+            for (int i = 1; i < 5; ++i)
+            {
+                alpha[i + 1] = ((5 - i) * alpha[0] + i * alpha[1]) / 5;
+            }
+            alpha[6] = 0;
+            alpha[7] = 255;
+        }
+
+        uint64_t indices = 0;
+        memcpy(&indices, block + 2, 6);
+        for (int i = 0; i < 16; ++i)
+        {
+            texels[i][3] = (uint8_t)alpha[(indices >> (3 * i)) & 7];
+        }
+    }
+
+    // Decodes the top mip of a DDS file to R8G8B8A8.
+    HRESULT LoadSourceImage(const std::wstring& filename, Image& image)
+    {
+        std::vector<uint8_t> fileData;
+        HRESULT hr = d3dUtil::ReadWholeFile(filename, fileData);
+        if (FAILED(hr))
+        {
+            return hr;
+        }
+
+        D3D12_RESOURCE_DESC desc;
+        std::vector<DDS_SUBRESOURCE_LAYOUT> layout;
+        hr = GetDDSTextureLayoutFromMemory12(fileData.data(), fileData.size(), desc, layout);
+        if (FAILED(hr))
+        {
+            return hr;
+        }
+        if (desc.Dimension != D3D12_RESOURCE_DIMENSION_TEXTURE2D)
+        {
+            return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+        }
+
+        image.Width = (UINT)desc.Width;
+        image.Height = desc.Height;
+        image.Pixels.assign((size_t)image.Width * image.Height * 4, 255);
+
+        const uint8_t* src = fileData.data() + layout[0].Offset;
+        const UINT rowPitch = layout[0].RowPitch;
+        switch (desc.Format)
+        {
+        case DXGI_FORMAT_R8G8B8A8_UNORM:
+        case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+        case DXGI_FORMAT_B8G8R8A8_UNORM:
+        case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+        case DXGI_FORMAT_B8G8R8X8_UNORM:
+        {
+            const bool bgr = desc.Format != DXGI_FORMAT_R8G8B8A8_UNORM &&
+                desc.Format != DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+            for (UINT y = 0; y < image.Height; ++y)
+            {
+                for (UINT x = 0; x < image.Width; ++x)
+                {
+                    const uint8_t* texel = src + (size_t)y * rowPitch + x * 4;
+                    uint8_t* dst = &image.Pixels[((size_t)y * image.Width + x) * 4];
+                    dst[0] = texel[bgr ? 2 : 0];
+                    dst[1] = texel[1];
+                    dst[2] = texel[bgr ? 0 : 2];
+                    dst[3] = desc.Format == DXGI_FORMAT_B8G8R8X8_UNORM ? 255 : texel[3];
+                }
+            }
+            break;
+        }
+
+        case DXGI_FORMAT_BC1_UNORM:
+        case DXGI_FORMAT_BC1_UNORM_SRGB:
+        case DXGI_FORMAT_BC2_UNORM:
+        case DXGI_FORMAT_BC2_UNORM_SRGB:
+        case DXGI_FORMAT_BC3_UNORM:
+        case DXGI_FORMAT_BC3_UNORM_SRGB:
+        {
+            const bool bc1 = desc.Format == DXGI_FORMAT_BC1_UNORM || desc.Format == DXGI_FORMAT_BC1_UNORM_SRGB;
+            const bool bc2 = desc.Format == DXGI_FORMAT_BC2_UNORM || desc.Format == DXGI_FORMAT_BC2_UNORM_SRGB;
+            const UINT blockBytes = bc1 ? 8 : 16;
+            const UINT blocksWide = (std::max)(1u, (image.Width + 3) / 4);
+            const UINT blocksHigh = (std::max)(1u, (image.Height + 3) / 4);
+            for (UINT by = 0; by < blocksHigh; ++by)
+            {
+                for (UINT bx = 0; bx < blocksWide; ++bx)
+                {
+                    const uint8_t* block = src + (size_t)by * rowPitch + bx * blockBytes;
+                    uint8_t texels[16][4];
+                    DecodeColorBlock(bc1 ? block : block + 8, bc1, texels);
+                    if (bc2)
+                    {
+                        // Explicit 4-bit alpha.
+                        for (int i = 0; i < 16; ++i)
+                        {
+                            const int a = (block[i / 2] >> (4 * (i & 1))) & 15;
+                            texels[i][3] = (uint8_t)(a * 17);
+                        }
+                    }
+                    else if (!bc1)
+                    {
+                        DecodeAlphaBlock(block, texels);
+                    }
+
+                    // Blocks hanging over the edge hold padding.
+                    for (UINT ty = 0; ty < 4 && by * 4 + ty < image.Height; ++ty)
+                    {
+                        for (UINT tx = 0; tx < 4 && bx * 4 + tx < image.Width; ++tx)
+                        {
+                            memcpy(&image.Pixels[((size_t)(by * 4 + ty) * image.Width + bx * 4 + tx) * 4],
+                                texels[ty * 4 + tx], 4);
+                        }
+                    }
+                }
+            }
+            break;
+        }
+
+        default:
+            return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+        }
+
+        return S_OK;
+    }
+
+    // Halves an image with a 2x2 box filter, odd edges are clamped.
+    Image Downsample(const Image& src)
+    {
+        Image dst;
+        dst.Width = (std::max)(1u, src.Width / 2);
+        dst.Height = (std::max)(1u, src.Height / 2);
+        dst.Pixels.resize((size_t)dst.Width * dst.Height * 4);
+
+        for (UINT y = 0; y < dst.Height; ++y)
+        {
+            const UINT y0 = (std::min)(2 * y, src.Height - 1);
+            const UINT y1 = (std::min)(2 * y + 1, src.Height - 1);
+            for (UINT x = 0; x < dst.Width; ++x)
+            {
+                const UINT x0 = (std::min)(2 * x, src.Width - 1);
+                const UINT x1 = (std::min)(2 * x + 1, src.Width - 1);
+                for (UINT c = 0; c < 4; ++c)
+                {
+                    const UINT sum =
+                        src.Pixels[((size_t)y0 * src.Width + x0) * 4 + c] +
+                        src.Pixels[((size_t)y0 * src.Width + x1) * 4 + c] +
+                        src.Pixels[((size_t)y1 * src.Width + x0) * 4 + c] +
+                        src.Pixels[((size_t)y1 * src.Width + x1) * 4 + c];
+                    dst.Pixels[((size_t)y * dst.Width + x) * 4 + c] = (uint8_t)((sum + 2) / 4);
+                }
+            }
+        }
+
+        return dst;
+    }
+
+    // Encodes one 4x4 block of R8G8B8A8 texels into BC1 with a bounding box fit:
+    // the endpoints are the inset min/max of each channel, always in 4-color mode.
+    void EncodeBC1Block(const uint8_t texels[16][4], uint8_t* block)
+    {
+        int minColor[3] = { 255, 255, 255 };
+        int maxColor[3] = { 0, 0, 0 };
+        for (int i = 0; i < 16; ++i)
+        {
+            for (int c = 0; c < 3; ++c)
+            {
+                minColor[c] = (std::min)(minColor[c], (int)texels[i][c]);
+                maxColor[c] = (std::max)(maxColor[c], (int)texels[i][c]);
+            }
+        }
+
+        // Inset the box by 1/16 of its extent to reduce the error of the interpolants.
+        for (int c = 0; c < 3; ++c)
+        {
+            const int inset = (maxColor[c] - minColor[c]) / 16;
+            minColor[c] += inset;
+            maxColor[c] -= inset;
+        }
+
+        uint16_t c0 = ToRGB565(maxColor);
+        uint16_t c1 = ToRGB565(minColor);
+        if (c0 < c1)
+        {
+            std::swap(c0, c1);
+        }
+
+        uint32_t indices = 0;
+        if (c0 != c1)
+        {
+            int palette[4][3];
+            FromRGB565(c0, palette[0]);
+            FromRGB565(c1, palette[1]);
+            for (int c = 0; c < 3; ++c)
+            {
+                palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+            }
+
+            for (int i = 0; i < 16; ++i)
+            {
+                int best = 0;
+                int bestDist = (std::numeric_limits<int>::max)();
+                for (int p = 0; p < 4; ++p)
+                {
+                    const int dr = texels[i][0] - palette[p][0];
+                    const int dg = texels[i][1] - palette[p][1];
+                    const int db = texels[i][2] - palette[p][2];
+                    const int dist = dr * dr + dg * dg + db * db;
+                    if (dist < bestDist)
+                    {
+                        bestDist = dist;
+                        best = p;
+                    }
+                }
+                indices |= (uint32_t)best << (2 * i);
+            }
+        }
+
+        memcpy(block + 0, &c0, sizeof(c0));
+        memcpy(block + 2, &c1, sizeof(c1));
+        memcpy(block + 4, &indices, sizeof(indices));
+    }
+
+    void EncodeBC1(const Image& src, uint8_t* dst, size_t dstRowPitch)
+    {
+        const UINT blocksWide = (std::max)(1u, (src.Width + 3) / 4);
+        const UINT blocksHigh = (std::max)(1u, (src.Height + 3) / 4);
+
+        for (UINT by = 0; by < blocksHigh; ++by)
+        {
+            for (UINT bx = 0; bx < blocksWide; ++bx)
+            {
+                // Blocks that hang over the edge replicate the last row/column.
+                uint8_t texels[16][4];
+                for (UINT ty = 0; ty < 4; ++ty)
+                {
+                    const UINT y = (std::min)(by * 4 + ty, src.Height - 1);
+                    for (UINT tx = 0; tx < 4; ++tx)
+                    {
+                        const UINT x = (std::min)(bx * 4 + tx, src.Width - 1);
+                        memcpy(texels[ty * 4 + tx], &src.Pixels[((size_t)y * src.Width + x) * 4], 4);
+                    }
+                }
+
+                EncodeBC1Block(texels, dst + by * dstRowPitch + bx * 8);
+            }
+        }
+    }
+
+    // Texel of image at coordinate i (possibly outside the image) along an axis of size n.
+    UINT Address(int i, UINT n, AtlasAddressMode mode)
+    {
+        if (mode == AtlasAddressMode::Wrap)
+        {
+            return (UINT)(((i % (int)n) + (int)n) % (int)n);
+        }
+        return (UINT)std::clamp(i, 0, (int)n - 1);
+    }
+
+    bool Contains(const AtlasRect& outer, const AtlasRect& inner)
+    {
+        return inner.X >= outer.X && inner.Y >= outer.Y &&
+            inner.X + inner.Width <= outer.X + outer.Width &&
+            inner.Y + inner.Height <= outer.Y + outer.Height;
+    }
+}
+
+MaxRectsPacker::MaxRectsPacker(UINT width, UINT height) :
+    mWidth(width),
+    mHeight(height)
+{
+    mFreeRects.push_back({ 0, 0, width, height });
+}
+
+bool MaxRectsPacker::Insert(UINT width, UINT height, AtlasRect& rect)
+{
+    UINT bestShortSide = UINT_MAX;
+    UINT bestLongSide = UINT_MAX;
+    for (const AtlasRect& freeRect : mFreeRects)
+    {
+        if (freeRect.Width < width || freeRect.Height < height)
+        {
+            continue;
+        }
+
+        const UINT leftoverX = freeRect.Width - width;
+        const UINT leftoverY = freeRect.Height - height;
+        const UINT shortSide = (std::min)(leftoverX, leftoverY);
+        const UINT longSide = (std::max)(leftoverX, leftoverY);
+        if (shortSide < bestShortSide || (shortSide == bestShortSide && longSide < bestLongSide))
+        {
+            rect = { freeRect.X, freeRect.Y, width, height };
+            bestShortSide = shortSide;
+            bestLongSide = longSide;
+        }
+    }
+
+    if (bestShortSide == UINT_MAX)
+    {
+        return false;
+    }
+
+    SplitFreeRects(rect);
+    PruneFreeRects();
+    mUsedArea += (UINT64)width * height;
+    return true;
+}
+
+float MaxRectsPacker::Occupancy() const
+{
+    return (float)((double)mUsedArea / ((double)mWidth * mHeight));
+}
+
+void MaxRectsPacker::SplitFreeRects(const AtlasRect& used)
+{
+    // Every free rectangle overlapping used is replaced by the (up to four) maximal
+    // rectangles around it.
+    std::vector<AtlasRect> split;
+    for (size_t i = 0; i < mFreeRects.size(); )
+    {
+        const AtlasRect f = mFreeRects[i];
+        if (used.X >= f.X + f.Width || used.X + used.Width <= f.X ||
+            used.Y >= f.Y + f.Height || used.Y + used.Height <= f.Y)
+        {
+            ++i;
+            continue;
+        }
+
+        if (used.X > f.X)
+        {
+            split.push_back({ f.X, f.Y, used.X - f.X, f.Height });
+        }
+        if (used.X + used.Width < f.X + f.Width)
+        {
+            split.push_back({ used.X + used.Width, f.Y, f.X + f.Width - (used.X + used.Width), f.Height });
+        }
+        if (used.Y > f.Y)
+        {
+            split.push_back({ f.X, f.Y, f.Width, used.Y - f.Y });
+        }
+        if (used.Y + used.Height < f.Y + f.Height)
+        {
+            split.push_back({ f.X, used.Y + used.Height, f.Width, f.Y + f.Height - (used.Y + used.Height) });
+        }
+
+        mFreeRects[i] = mFreeRects.back();
+        mFreeRects.pop_back();
+    }
+
+    mFreeRects.insert(mFreeRects.end(), split.begin(), split.end());
+}
+
+void MaxRectsPacker::PruneFreeRects()
+{
+    // Drop the free rectangles contained in another one.
+    for (size_t i = 0; i < mFreeRects.size(); ++i)
+    {
+        for (size_t j = i + 1; j < mFreeRects.size(); )
+        {
+            if (Contains(mFreeRects[i], mFreeRects[j]))
+            {
+                mFreeRects.erase(mFreeRects.begin() + j);
+            }
+            else if (Contains(mFreeRects[j], mFreeRects[i]))
+            {
+                mFreeRects.erase(mFreeRects.begin() + i);
+                j = i + 1;
+            }
+            else
+            {
+                ++j;
+            }
+        }
+    }
+}
+
+const AtlasRegion* TextureAtlas::Find(const std::string& name) const
+{
+    for (const AtlasRegion& region : Regions)
+    {
+        if (region.Name == name)
+        {
+            return &region;
+        }
+    }
+    return nullptr;
+}
+
+XMFLOAT4 TextureAtlas::GetUVRect(const AtlasRegion& region) const
+{
+    return XMFLOAT4(
+        (float)region.Rect.X / Width,
+        (float)region.Rect.Y / Height,
+        (float)region.Rect.Width / Width,
+        (float)region.Rect.Height / Height);
+}
+
+HRESULT BuildTextureAtlas(
+    const std::vector<AtlasSource>& sources,
+    const TextureAtlasOptions& options,
+    TextureAtlas& atlas)
+{
+    if (sources.empty() || options.MipLevels == 0 || options.MipLevels > 15)
+    {
+        return E_INVALIDARG;
+    }
+
+    std::vector<Image> images(sources.size());
+    bool hasAlpha = false;
+    for (size_t i = 0; i < sources.size(); ++i)
+    {
+        HRESULT hr = LoadSourceImage(sources[i].Filename, images[i]);
+        if (FAILED(hr))
+        {
+            return hr;
+        }
+
+        for (size_t p = 3; p < images[i].Pixels.size() && !hasAlpha; p += 4)
+        {
+            hasAlpha = images[i].Pixels[p] != 255;
+        }
+    }
+
+    const bool compressed = options.CompressBC1 && !hasAlpha;
+    const DXGI_FORMAT format = compressed ? DXGI_FORMAT_BC1_UNORM : DXGI_FORMAT_R8G8B8A8_UNORM;
+
+    // A gutter of one texel in the last mip, and cells starting on a whole texel (a
+    // whole block when compressed) in every mip.
+    const UINT gutter = 1u << (options.MipLevels - 1);
+    const UINT alignment = gutter * (compressed ? 4 : 1);
+
+    std::vector<AtlasRect> cells(sources.size());
+    UINT64 cellArea = 0;
+    UINT minSide = alignment;
+    for (size_t i = 0; i < sources.size(); ++i)
+    {
+        cells[i].Width = AlignUp(images[i].Width + 2 * gutter, alignment);
+        cells[i].Height = AlignUp(images[i].Height + 2 * gutter, alignment);
+        cellArea += (UINT64)cells[i].Width * cells[i].Height;
+        minSide = (std::max)({ minSide, cells[i].Width, cells[i].Height });
+    }
+
+    // Largest cells first, MaxRects packs them best in that order.
+    std::vector<size_t> order(sources.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        const UINT sideA = (std::max)(cells[a].Width, cells[a].Height);
+        const UINT sideB = (std::max)(cells[b].Width, cells[b].Height);
+        return sideA != sideB ? sideA > sideB : cells[a].Width * cells[a].Height > cells[b].Width * cells[b].Height;
+    });
+
+    // The smallest square bin that takes every cell, cropped to what was used.
+    UINT side = (std::max)(minSide, AlignUp((UINT)std::ceil(std::sqrt((double)cellArea)), alignment));
+    bool packed = false;
+    for (; side <= options.MaxSize && !packed; side += alignment)
+    {
+        MaxRectsPacker packer(side, side);
+        packed = true;
+        for (size_t i : order)
+        {
+            if (!packer.Insert(cells[i].Width, cells[i].Height, cells[i]))
+            {
+                packed = false;
+                break;
+            }
+        }
+    }
+    if (!packed)
+    {
+        return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+    }
+
+    atlas.Width = 0;
+    atlas.Height = 0;
+    for (const AtlasRect& cell : cells)
+    {
+        atlas.Width = (std::max)(atlas.Width, cell.X + cell.Width);
+        atlas.Height = (std::max)(atlas.Height, cell.Y + cell.Height);
+    }
+    atlas.MipLevels = options.MipLevels;
+    atlas.Format = format;
+
+    atlas.Regions.resize(sources.size());
+    for (size_t i = 0; i < sources.size(); ++i)
+    {
+        atlas.Regions[i].Name = sources[i].Name;
+        atlas.Regions[i].Rect = { cells[i].X + gutter, cells[i].Y + gutter, images[i].Width, images[i].Height };
+    }
+
+    size_t dataSize = 0;
+    for (UINT mip = 0; mip < atlas.MipLevels; ++mip)
+    {
+        dataSize += GetSurfaceInfo(atlas.Width >> mip, atlas.Height >> mip, format).NumBytes;
+    }
+    atlas.Data.assign(dataSize, 0);
+
+    // Each mip is assembled from the sources' own mips: every texel of a cell is a texel
+    // of its source, addressed relative to the region.
+    uint8_t* dst = atlas.Data.data();
+    Image level;
+    for (UINT mip = 0; mip < atlas.MipLevels; ++mip)
+    {
+        level.Width = atlas.Width >> mip;
+        level.Height = atlas.Height >> mip;
+        level.Pixels.assign((size_t)level.Width * level.Height * 4, 0);
+
+        for (size_t i = 0; i < sources.size(); ++i)
+        {
+            const Image& image = images[i];
+            const int originX = (int)(atlas.Regions[i].Rect.X >> mip);
+            const int originY = (int)(atlas.Regions[i].Rect.Y >> mip);
+            const UINT cellX = cells[i].X >> mip;
+            const UINT cellY = cells[i].Y >> mip;
+            for (UINT y = cellY; y < cellY + (cells[i].Height >> mip); ++y)
+            {
+                const UINT sy = Address((int)y - originY, image.Height, sources[i].AddressMode);
+                for (UINT x = cellX; x < cellX + (cells[i].Width >> mip); ++x)
+                {
+                    const UINT sx = Address((int)x - originX, image.Width, sources[i].AddressMode);
+                    memcpy(&level.Pixels[((size_t)y * level.Width + x) * 4],
+                        &image.Pixels[((size_t)sy * image.Width + sx) * 4], 4);
+                }
+            }
+
+            images[i] = Downsample(image);
+        }
+
+        const SurfaceInfo info = GetSurfaceInfo(level.Width, level.Height, format);
+        if (compressed)
+        {
+            EncodeBC1(level, dst, info.RowPitch);
+        }
+        else
+        {
+            memcpy(dst, level.Pixels.data(), info.NumBytes);
+        }
+        dst += info.NumBytes;
+    }
+
+    return S_OK;
+}
+
+HRESULT SaveTextureAtlas(
+    const wchar_t* ddsFilename,
+    const wchar_t* tableFilename,
+    const TextureAtlas& atlas)
+{
+    if (!ddsFilename || !tableFilename || atlas.Data.empty())
+    {
+        return E_INVALIDARG;
+    }
+
+    const bool compressed = atlas.Format == DXGI_FORMAT_BC1_UNORM;
+    const SurfaceInfo top = GetSurfaceInfo(atlas.Width, atlas.Height, atlas.Format);
+
+    DdsHeader header = {};
+    header.size = sizeof(DdsHeader);
+    header.flags = DdsFlagsTexture | DdsFlagsMipmap | (compressed ? DdsFlagsLinearSize : DdsFlagsPitch);
+    header.height = atlas.Height;
+    header.width = atlas.Width;
+    header.pitchOrLinearSize = (uint32_t)(compressed ? top.NumBytes : top.RowPitch);
+    header.depth = 0;
+    header.mipMapCount = atlas.MipLevels;
+    header.ddspf.size = sizeof(DdsPixelFormat);
+    header.ddspf.flags = DdsFourCC;
+    header.ddspf.fourCC = MAKEFOURCC('D', 'X', '1', '0');
+    header.caps = DdsCapsTexture | (atlas.MipLevels > 1 ? DdsCapsComplexMipmap : 0u);
+
+    DdsHeaderDxt10 dxt10 = {};
+    dxt10.dxgiFormat = atlas.Format;
+    dxt10.resourceDimension = DdsResourceDimensionTexture2D;
+    dxt10.arraySize = 1;
+    dxt10.miscFlags2 = compressed ? DdsAlphaModeOpaque : 0u;
+
+    std::ofstream fout(ddsFilename, std::ios::binary | std::ios::trunc);
+    if (!fout)
+    {
+        return HRESULT_FROM_WIN32(ERROR_CANNOT_MAKE);
+    }
+
+    fout.write((const char*)&DdsMagic, sizeof(DdsMagic));
+    fout.write((const char*)&header, sizeof(header));
+    fout.write((const char*)&dxt10, sizeof(dxt10));
+    fout.write((const char*)atlas.Data.data(), (std::streamsize)atlas.Data.size());
+    if (!fout)
+    {
+        return E_FAIL;
+    }
+
+    std::ofstream table(tableFilename, std::ios::trunc);
+    if (!table)
+    {
+        return HRESULT_FROM_WIN32(ERROR_CANNOT_MAKE);
+    }
+
+    table << "atlas " << atlas.Width << " " << atlas.Height << " " << atlas.MipLevels << "\n";
+    for (const AtlasRegion& region : atlas.Regions)
+    {
+        table << region.Name << " " << region.Rect.X << " " << region.Rect.Y << " "
+            << region.Rect.Width << " " << region.Rect.Height << "\n";
+    }
+
+    return table ? S_OK : E_FAIL;
+}
+
+HRESULT LoadTextureAtlasTable(
+    const wchar_t* tableFilename,
+    TextureAtlas& atlas)
+{
+    std::ifstream table(tableFilename);
+    if (!table)
+    {
+        return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+    }
+
+    std::string tag;
+    if (!(table >> tag >> atlas.Width >> atlas.Height >> atlas.MipLevels) || tag != "atlas")
+    {
+        return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+    }
+
+    atlas.Regions.clear();
+    AtlasRegion region;
+    while (table >> region.Name >> region.Rect.X >> region.Rect.Y >> region.Rect.Width >> region.Rect.Height)
+    {
+        if (region.Rect.X + region.Rect.Width > atlas.Width || region.Rect.Y + region.Rect.Height > atlas.Height)
+        {
+            return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+        }
+        atlas.Regions.push_back(region);
+    }
+
+    return table.eof() ? S_OK : HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+}
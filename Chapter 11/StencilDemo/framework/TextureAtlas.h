@@ -0,0 +1,111 @@
+#pragma once
+
+#include "d3dUtil.h"
+
+// Packs textures of any size into one mipped atlas, so the materials sampling them
+// share a single SRV and draws no longer switch descriptor tables per material.
+//
+// Every texture gets a cell: its rectangle surrounded by a gutter of 2^(MipLevels-1)
+// texels filled with its own content (wrapped or clamped), so every mip of the atlas
+// still has at least one texel of gutter and filtering never reaches a neighbour. Cells
+// are aligned so that each region starts on a whole texel (and block) in every mip, and
+// every mip of a region is built from that texture's own mip, nothing bleeds in.
+// Shaders address a region with its UV rectangle and wrap inside it, see Default.hlsl.
+
+struct AtlasRect
+{
+	UINT X = 0;
+	UINT Y = 0;
+	UINT Width = 0;
+	UINT Height = 0;
+};
+
+// MaxRects bin packer with the best short side fit heuristic: keeps the maximal free
+// rectangles of the bin and places each rectangle where it leaves the least space on
+// its shorter side.
+class MaxRectsPacker
+{
+public:
+	MaxRectsPacker(UINT width, UINT height);
+
+	// False when the rectangle doesn't fit anywhere.
+	bool Insert(UINT width, UINT height, AtlasRect& rect);
+
+	// Fraction of the bin used.
+	float Occupancy() const;
+
+private:
+	void SplitFreeRects(const AtlasRect& used);
+	void PruneFreeRects();
+
+	UINT mWidth = 0;
+	UINT mHeight = 0;
+	UINT64 mUsedArea = 0;
+	std::vector<AtlasRect> mFreeRects;
+};
+
+enum class AtlasAddressMode
+{
+	Wrap,	// the gutter repeats the opposite edge, for tiled textures
+	Clamp,	// the gutter repeats the nearest edge
+};
+
+struct AtlasSource
+{
+	std::string Name;
+	std::wstring Filename;		// DDS in R8G8B8A8, B8G8R8A8, BC1, BC2 or BC3
+	AtlasAddressMode AddressMode = AtlasAddressMode::Wrap;
+};
+
+struct TextureAtlasOptions
+{
+	// Mips of the atlas, sets the gutter (2^(MipLevels-1) texels) and the alignment of
+	// the cells. Regions are exact in every mip when their size is a multiple of the
+	// alignment or smaller than a texel at the last mip.
+	UINT MipLevels = 6;
+
+	UINT MaxSize = D3D12_REQ_TEXTURE2D_U_OR_V_DIMENSION;
+
+	// Encode the atlas as BC1 when no source has alpha.
+	bool CompressBC1 = true;
+};
+
+struct AtlasRegion
+{
+	std::string Name;
+	AtlasRect Rect;				// mip 0 texels, without the gutter
+};
+
+struct TextureAtlas
+{
+	UINT Width = 0;
+	UINT Height = 0;
+	UINT MipLevels = 0;
+	DXGI_FORMAT Format = DXGI_FORMAT_UNKNOWN;
+	std::vector<AtlasRegion> Regions;
+
+	// Mips in DDS order, only filled by BuildTextureAtlas.
+	std::vector<uint8_t> Data;
+
+	const AtlasRegion* Find(const std::string& name) const;
+
+	// Offset (xy) and scale (zw) taking [0,1] UVs to the region.
+	XMFLOAT4 GetUVRect(const AtlasRegion& region) const;
+};
+
+HRESULT BuildTextureAtlas(
+	const std::vector<AtlasSource>& sources,
+	const TextureAtlasOptions& options,
+	TextureAtlas& atlas);
+
+// Writes the atlas as a DDS and its regions as a text table, one "name x y width height"
+// line per region after an "atlas width height mipLevels" line.
+HRESULT SaveTextureAtlas(
+	const wchar_t* ddsFilename,
+	const wchar_t* tableFilename,
+	const TextureAtlas& atlas);
+
+// Reads back a table written by SaveTextureAtlas, everything but Format and Data.
+HRESULT LoadTextureAtlasTable(
+	const wchar_t* tableFilename,
+	TextureAtlas& atlas);
@@ -0,0 +1,422 @@
+#include "TextureLayout.h"
+#include "DDSTextureLoader.h"
+#include <emmintrin.h>
+#include <thread>
+
+namespace
+{
+    UINT64 AlignUp(UINT64 value, UINT64 alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    UINT MipCount(const D3D12_RESOURCE_DESC& desc)
+    {
+        if (desc.MipLevels != 0)
+        {
+            return desc.MipLevels;
+        }
+
+        // 0 means the full chain.
+        UINT64 size = (std::max)(desc.Width, (UINT64)desc.Height);
+        if (desc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D)
+        {
+            size = (std::max)(size, (UINT64)desc.DepthOrArraySize);
+        }
+
+        UINT count = 1;
+        while (size > 1)
+        {
+            size >>= 1;
+            ++count;
+        }
+        return count;
+    }
+
+    // One run of rows to copy: a depth slice of a subresource.
+    struct RowRun
+    {
+        const uint8_t* Src = nullptr;
+        uint8_t* Dst = nullptr;
+        size_t SrcPitch = 0;
+        size_t DstPitch = 0;
+        size_t RowSize = 0;
+        UINT Rows = 0;
+    };
+
+    // Copies rows [firstRow, endRow) counted across all runs.
+    void CopyRows(const std::vector<RowRun>& runs, UINT64 firstRow, UINT64 endRow)
+    {
+        UINT64 runStart = 0;
+        for (const RowRun& run : runs)
+        {
+            const UINT64 runEnd = runStart + run.Rows;
+            const UINT64 begin = (std::max)(firstRow, runStart);
+            const UINT64 end = (std::min)(endRow, runEnd);
+            for (UINT64 row = begin; row < end; ++row)
+            {
+                const size_t i = (size_t)(row - runStart);
+                StreamToUploadMemory(run.Dst + i * run.DstPitch, run.Src + i * run.SrcPitch, run.RowSize);
+            }
+
+            runStart = runEnd;
+            if (runStart >= endRow)
+            {
+                break;
+            }
+        }
+
+        // Streaming stores are weakly ordered, make them visible before the GPU is told
+        // to read.
+        _mm_sfence();
+    }
+}
+
+void StreamToUploadMemory(uint8_t* dst, const uint8_t* src, size_t size)
+{
+    const size_t head = (std::min)(size, (size_t)((16 - ((uintptr_t)dst & 15)) & 15));
+    memcpy(dst, src, head);
+    dst += head;
+    src += head;
+    size -= head;
+
+    for (; size >= 64; size -= 64, dst += 64, src += 64)
+    {
+        const __m128i a = _mm_loadu_si128((const __m128i*)src);
+        const __m128i b = _mm_loadu_si128((const __m128i*)(src + 16));
+        const __m128i c = _mm_loadu_si128((const __m128i*)(src + 32));
+        const __m128i d = _mm_loadu_si128((const __m128i*)(src + 48));
+        _mm_stream_si128((__m128i*)dst, a);
+        _mm_stream_si128((__m128i*)(dst + 16), b);
+        _mm_stream_si128((__m128i*)(dst + 32), c);
+        _mm_stream_si128((__m128i*)(dst + 48), d);
+    }
+    for (; size >= 16; size -= 16, dst += 16, src += 16)
+    {
+        _mm_stream_si128((__m128i*)dst, _mm_loadu_si128((const __m128i*)src));
+    }
+
+    memcpy(dst, src, size);
+}
+
+UINT GetFormatPlaneCount(DXGI_FORMAT format)
+{
+    switch (format)
+    {
+    case DXGI_FORMAT_NV12:
+    case DXGI_FORMAT_420_OPAQUE:
+    case DXGI_FORMAT_P010:
+    case DXGI_FORMAT_P016:
+    case DXGI_FORMAT_NV11:
+    case DXGI_FORMAT_R24G8_TYPELESS:
+    case DXGI_FORMAT_D24_UNORM_S8_UINT:
+    case DXGI_FORMAT_R24_UNORM_X8_TYPELESS:
+    case DXGI_FORMAT_X24_TYPELESS_G8_UINT:
+    case DXGI_FORMAT_R32G8X24_TYPELESS:
+    case DXGI_FORMAT_D32_FLOAT_S8X24_UINT:
+    case DXGI_FORMAT_R32_FLOAT_X8X24_TYPELESS:
+    case DXGI_FORMAT_X32_TYPELESS_G8X24_UINT:
+        return 2;
+
+    default:
+        return GetBitsPerPixel12(format) != 0 ? 1 : 0;
+    }
+}
+
+bool GetFormatPlaneLayout(DXGI_FORMAT format, UINT plane, FormatPlaneLayout& layout)
+{
+    if (plane >= GetFormatPlaneCount(format))
+    {
+        return false;
+    }
+
+    layout = FormatPlaneLayout();
+    layout.Format = format;
+
+    switch (format)
+    {
+    // Luma plane, then a half width, half height plane of interleaved chroma.
+    case DXGI_FORMAT_NV12:
+    case DXGI_FORMAT_420_OPAQUE:
+        layout.Format = plane == 0 ? DXGI_FORMAT_R8_TYPELESS : DXGI_FORMAT_R8G8_TYPELESS;
+        layout.BitsPerBlock = plane == 0 ? 8 : 16;
+        layout.SubsampleShiftX = layout.SubsampleShiftY = plane;
+        break;
+
+    case DXGI_FORMAT_P010:
+    case DXGI_FORMAT_P016:
+        layout.Format = plane == 0 ? DXGI_FORMAT_R16_TYPELESS : DXGI_FORMAT_R16G16_TYPELESS;
+        layout.BitsPerBlock = plane == 0 ? 16 : 32;
+        layout.SubsampleShiftX = layout.SubsampleShiftY = plane;
+        break;
+
+    // Quarter width chroma.
+    case DXGI_FORMAT_NV11:
+        layout.Format = plane == 0 ? DXGI_FORMAT_R8_TYPELESS : DXGI_FORMAT_R8G8_TYPELESS;
+        layout.BitsPerBlock = plane == 0 ? 8 : 16;
+        layout.SubsampleShiftX = plane * 2;
+        break;
+
+    // Depth and stencil are copied separately, the stencil plane is one byte per texel.
+    case DXGI_FORMAT_R24G8_TYPELESS:
+    case DXGI_FORMAT_D24_UNORM_S8_UINT:
+    case DXGI_FORMAT_R24_UNORM_X8_TYPELESS:
+    case DXGI_FORMAT_X24_TYPELESS_G8_UINT:
+    case DXGI_FORMAT_R32G8X24_TYPELESS:
+    case DXGI_FORMAT_D32_FLOAT_S8X24_UINT:
+    case DXGI_FORMAT_R32_FLOAT_X8X24_TYPELESS:
+    case DXGI_FORMAT_X32_TYPELESS_G8X24_UINT:
+        layout.Format = plane == 0 ? DXGI_FORMAT_R32_TYPELESS : DXGI_FORMAT_R8_TYPELESS;
+        layout.BitsPerBlock = plane == 0 ? 32 : 8;
+        break;
+
+    case DXGI_FORMAT_BC1_TYPELESS:
+    case DXGI_FORMAT_BC1_UNORM:
+    case DXGI_FORMAT_BC1_UNORM_SRGB:
+    case DXGI_FORMAT_BC4_TYPELESS:
+    case DXGI_FORMAT_BC4_UNORM:
+    case DXGI_FORMAT_BC4_SNORM:
+        layout.BlockWidth = layout.BlockHeight = 4;
+        layout.BitsPerBlock = 64;
+        break;
+
+    case DXGI_FORMAT_BC2_TYPELESS:
+    case DXGI_FORMAT_BC2_UNORM:
+    case DXGI_FORMAT_BC2_UNORM_SRGB:
+    case DXGI_FORMAT_BC3_TYPELESS:
+    case DXGI_FORMAT_BC3_UNORM:
+    case DXGI_FORMAT_BC3_UNORM_SRGB:
+    case DXGI_FORMAT_BC5_TYPELESS:
+    case DXGI_FORMAT_BC5_UNORM:
+    case DXGI_FORMAT_BC5_SNORM:
+    case DXGI_FORMAT_BC6H_TYPELESS:
+    case DXGI_FORMAT_BC6H_UF16:
+    case DXGI_FORMAT_BC6H_SF16:
+    case DXGI_FORMAT_BC7_TYPELESS:
+    case DXGI_FORMAT_BC7_UNORM:
+    case DXGI_FORMAT_BC7_UNORM_SRGB:
+        layout.BlockWidth = layout.BlockHeight = 4;
+        layout.BitsPerBlock = 128;
+        break;
+
+    // Two texels share their chroma, a block is a pair of texels.
+    case DXGI_FORMAT_R8G8_B8G8_UNORM:
+    case DXGI_FORMAT_G8R8_G8B8_UNORM:
+    case DXGI_FORMAT_YUY2:
+        layout.BlockWidth = 2;
+        layout.BitsPerBlock = 32;
+        break;
+
+    case DXGI_FORMAT_Y210:
+    case DXGI_FORMAT_Y216:
+        layout.BlockWidth = 2;
+        layout.BitsPerBlock = 64;
+        break;
+
+    default:
+        layout.BitsPerBlock = (UINT)GetBitsPerPixel12(format);
+        break;
+    }
+
+    return true;
+}
+
+bool ComputeCopyableFootprints(const D3D12_RESOURCE_DESC& desc,
+    UINT firstSubresource, UINT numSubresources, UINT64 baseOffset,
+    D3D12_PLACED_SUBRESOURCE_FOOTPRINT* layouts, UINT* numRows, UINT64* rowSizes, UINT64* totalBytes)
+{
+    auto fail = [&]() {
+        for (UINT i = 0; i < numSubresources; ++i)
+        {
+            if (layouts) { memset(&layouts[i], 0xff, sizeof(layouts[i])); }
+            if (numRows) { numRows[i] = UINT_MAX; }
+            if (rowSizes) { rowSizes[i] = UINT64_MAX; }
+        }
+        if (totalBytes) { *totalBytes = UINT64_MAX; }
+        return false;
+    };
+
+    if (desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+    {
+        if (firstSubresource != 0 || numSubresources > 1 || desc.Width == 0 || desc.Width > UINT_MAX)
+        {
+            return fail();
+        }
+
+        if (numSubresources == 1)
+        {
+            if (layouts)
+            {
+                layouts[0].Offset = baseOffset;
+                layouts[0].Footprint = { DXGI_FORMAT_UNKNOWN, (UINT)desc.Width, 1, 1,
+                    (UINT)AlignUp(desc.Width, D3D12_TEXTURE_DATA_PITCH_ALIGNMENT) };
+            }
+            if (numRows) { numRows[0] = 1; }
+            if (rowSizes) { rowSizes[0] = desc.Width; }
+        }
+        if (totalBytes) { *totalBytes = numSubresources == 1 ? desc.Width : 0; }
+        return true;
+    }
+
+    const bool is3D = desc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D;
+    const UINT mipLevels = MipCount(desc);
+    const UINT arraySize = is3D ? 1u : desc.DepthOrArraySize;
+    const UINT planeCount = GetFormatPlaneCount(desc.Format);
+    const UINT64 subresourceCount = (UINT64)mipLevels * arraySize * planeCount;
+
+    if (desc.Width == 0 || desc.Height == 0 || desc.DepthOrArraySize == 0 || planeCount == 0 ||
+        (UINT64)firstSubresource + numSubresources > subresourceCount)
+    {
+        return fail();
+    }
+
+    UINT64 total = 0;
+    for (UINT i = 0; i < numSubresources; ++i)
+    {
+        const UINT subresource = firstSubresource + i;
+        const UINT mip = subresource % mipLevels;
+        const UINT plane = subresource / (mipLevels * arraySize);
+
+        FormatPlaneLayout format;
+        GetFormatPlaneLayout(desc.Format, plane, format);
+
+        UINT64 width = (std::max)(desc.Width >> mip, (UINT64)1);
+        UINT height = (std::max)(desc.Height >> mip, 1u);
+        const UINT depth = is3D ? (std::max)(desc.DepthOrArraySize >> mip, 1) : 1u;
+
+        // Chroma planes are rounded up, an odd sized luma plane still gets its last column.
+        width = (width + (1ull << format.SubsampleShiftX) - 1) >> format.SubsampleShiftX;
+        height = (height + (1u << format.SubsampleShiftY) - 1) >> format.SubsampleShiftY;
+
+        const UINT64 blocksWide = (width + format.BlockWidth - 1) / format.BlockWidth;
+        const UINT blocksHigh = (height + format.BlockHeight - 1) / format.BlockHeight;
+        const UINT64 rowSize = (blocksWide * format.BitsPerBlock + 7) / 8;
+        const UINT64 rowPitch = AlignUp(rowSize, D3D12_TEXTURE_DATA_PITCH_ALIGNMENT);
+        if (rowPitch > UINT_MAX || blocksWide * format.BlockWidth > UINT_MAX)
+        {
+            return fail();
+        }
+
+        const UINT64 offset = AlignUp(total, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+
+        if (layouts)
+        {
+            layouts[i].Offset = baseOffset + offset;
+            layouts[i].Footprint.Format = format.Format;
+            layouts[i].Footprint.Width = (UINT)(blocksWide * format.BlockWidth);
+            layouts[i].Footprint.Height = blocksHigh * format.BlockHeight;
+            layouts[i].Footprint.Depth = depth;
+            layouts[i].Footprint.RowPitch = (UINT)rowPitch;
+        }
+        if (numRows) { numRows[i] = blocksHigh; }
+        if (rowSizes) { rowSizes[i] = rowSize; }
+
+        // The last row of a subresource needs no padding.
+        total = offset + rowPitch * ((UINT64)blocksHigh * depth - 1) + rowSize;
+    }
+
+    if (totalBytes) { *totalBytes = total; }
+    return true;
+}
+
+void CopySubresourceRows(uint8_t* staging,
+    const D3D12_PLACED_SUBRESOURCE_FOOTPRINT* layouts, const UINT* numRows, const UINT64* rowSizes,
+    const D3D12_SUBRESOURCE_DATA* srcData, UINT numSubresources, UINT threadCount)
+{
+    std::vector<RowRun> runs;
+    UINT64 rowCount = 0;
+    UINT64 byteCount = 0;
+    for (UINT i = 0; i < numSubresources; ++i)
+    {
+        const D3D12_SUBRESOURCE_FOOTPRINT& footprint = layouts[i].Footprint;
+        for (UINT z = 0; z < footprint.Depth; ++z)
+        {
+            RowRun run;
+            run.Src = (const uint8_t*)srcData[i].pData + (size_t)srcData[i].SlicePitch * z;
+            run.Dst = staging + layouts[i].Offset + (size_t)footprint.RowPitch * numRows[i] * z;
+            run.SrcPitch = (size_t)srcData[i].RowPitch;
+            run.DstPitch = footprint.RowPitch;
+            run.RowSize = (size_t)rowSizes[i];
+            run.Rows = numRows[i];
+            runs.push_back(run);
+
+            rowCount += run.Rows;
+            byteCount += (UINT64)run.Rows * run.RowSize;
+        }
+    }
+
+    // Below a few hundred KB per thread starting threads costs more than it saves.
+    constexpr UINT64 minBytesPerThread = 256 << 10;
+    if (threadCount == 0)
+    {
+        threadCount = (std::max)(std::thread::hardware_concurrency(), 1u);
+    }
+    threadCount = (UINT)(std::min)((UINT64)threadCount, (std::max)(byteCount / minBytesPerThread, (UINT64)1));
+    threadCount = (UINT)(std::min)((UINT64)threadCount, (std::max)(rowCount, (UINT64)1));
+
+    // Rows are split evenly, the rows of one call tend to have similar sizes.
+    std::vector<std::thread> threads;
+    for (UINT t = 1; t < threadCount; ++t)
+    {
+        threads.emplace_back(CopyRows, std::cref(runs), rowCount * t / threadCount, rowCount * (t + 1) / threadCount);
+    }
+    CopyRows(runs, 0, rowCount / threadCount);
+
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+}
+
+UINT64 UploadSubresources(ID3D12GraphicsCommandList* cmdList,
+    ID3D12Resource* destination, ID3D12Resource* uploadHeap, UINT64 uploadOffset,
+    UINT firstSubresource, UINT numSubresources, const D3D12_SUBRESOURCE_DATA* srcData)
+{
+    if (uploadOffset % D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT != 0)
+    {
+        return 0;
+    }
+
+    const D3D12_RESOURCE_DESC desc = destination->GetDesc();
+
+    std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> layouts(numSubresources);
+    std::vector<UINT> numRows(numSubresources);
+    std::vector<UINT64> rowSizes(numSubresources);
+    UINT64 requiredSize = 0;
+    if (!ComputeCopyableFootprints(desc, firstSubresource, numSubresources, uploadOffset,
+        layouts.data(), numRows.data(), rowSizes.data(), &requiredSize))
+    {
+        return 0;
+    }
+
+    const D3D12_RESOURCE_DESC uploadDesc = uploadHeap->GetDesc();
+    if (uploadDesc.Dimension != D3D12_RESOURCE_DIMENSION_BUFFER ||
+        uploadDesc.Width < uploadOffset + requiredSize)
+    {
+        return 0;
+    }
+
+    uint8_t* staging = nullptr;
+    if (FAILED(uploadHeap->Map(0, &CD3DX12_RANGE(0, 0), (void**)&staging)))
+    {
+        return 0;
+    }
+    CopySubresourceRows(staging, layouts.data(), numRows.data(), rowSizes.data(), srcData, numSubresources);
+    uploadHeap->Unmap(0, &CD3DX12_RANGE((SIZE_T)uploadOffset, (SIZE_T)(uploadOffset + requiredSize)));
+
+    if (desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+    {
+        cmdList->CopyBufferRegion(destination, 0, uploadHeap, layouts[0].Offset, layouts[0].Footprint.Width);
+    }
+    else
+    {
+        for (UINT i = 0; i < numSubresources; ++i)
+        {
+            cmdList->CopyTextureRegion(
+                &CD3DX12_TEXTURE_COPY_LOCATION(destination, firstSubresource + i), 0, 0, 0,
+                &CD3DX12_TEXTURE_COPY_LOCATION(uploadHeap, layouts[i]), nullptr);
+        }
+    }
+
+    return requiredSize;
+}
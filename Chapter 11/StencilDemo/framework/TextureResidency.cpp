@@ -0,0 +1,215 @@
+#include "TextureResidency.h"
+#include <algorithm>
+
+TextureResidencyManager::TextureResidencyManager(uint64_t budgetBytes, uint32_t minIdleFrames) :
+    mBudgetBytes(budgetBytes),
+    mMinIdleFrames(minIdleFrames)
+{
+    mStats.BudgetBytes = budgetBytes;
+}
+
+TextureResidencyManager::TextureId TextureResidencyManager::Register(
+    const std::vector<uint64_t>& mipSizes, uint32_t floorMip, uint32_t targetMip)
+{
+    const uint32_t lastMip = mipSizes.empty() ? 0u : (uint32_t)mipSizes.size() - 1;
+
+    Entry entry;
+    entry.MipSizes = mipSizes;
+    entry.FloorMip = (std::min)(floorMip, lastMip);
+    entry.TargetMip = (std::min)(targetMip, entry.FloorMip);
+    entry.LastUsedFrame = mFrame;
+
+    mCommittedBytes += FootprintFrom(entry, entry.TargetMip);
+    mEntries.push_back(std::move(entry));
+
+    mStats.TextureCount = (uint32_t)mEntries.size();
+    mStats.CommittedBytes = mCommittedBytes;
+
+    return (TextureId)(mEntries.size() - 1);
+}
+
+void TextureResidencyManager::MarkUsed(TextureId id)
+{
+    Entry& entry = mEntries[id];
+    entry.UsedThisFrame = true;
+    entry.LastUsedFrame = mFrame;
+}
+
+void TextureResidencyManager::EndFrame(std::vector<Change>& changes)
+{
+    mOldTargets.resize(mEntries.size());
+    for (size_t i = 0; i < mEntries.size(); ++i)
+    {
+        mOldTargets[i] = mEntries[i].TargetMip;
+    }
+
+    mStats.WantedBytes = 0;
+    for (const Entry& entry : mEntries)
+    {
+        if (entry.UsedThisFrame)
+        {
+            mStats.WantedBytes += FootprintFrom(entry, 0);
+        }
+    }
+
+    // The budget may have shrunk, nothing is protected then.
+    if (mCommittedBytes > mBudgetBytes)
+    {
+        Reclaim(mCommittedBytes - mBudgetBytes, true);
+    }
+
+    // Every finer mip a drawn texture is missing, coarsest first across textures and
+    // smallest first within a level, so the budget sharpens as many textures as it can.
+    mLoads.clear();
+    for (size_t i = 0; i < mEntries.size(); ++i)
+    {
+        const Entry& entry = mEntries[i];
+        if (!entry.UsedThisFrame)
+        {
+            continue;
+        }
+
+        for (uint32_t mip = entry.TargetMip; mip-- > 0;)
+        {
+            mLoads.push_back({ (TextureId)i, mip, entry.MipSizes[mip] });
+        }
+    }
+
+    std::sort(mLoads.begin(), mLoads.end(), [](const Load& a, const Load& b) {
+        if (a.Mip != b.Mip) { return a.Mip > b.Mip; }
+        if (a.Size != b.Size) { return a.Size < b.Size; }
+        return a.Id < b.Id;
+    });
+
+    for (const Load& load : mLoads)
+    {
+        Entry& entry = mEntries[load.Id];
+
+        // A coarser mip of this texture did not fit, there is no skipping levels.
+        if (load.Mip + 1 != entry.TargetMip)
+        {
+            continue;
+        }
+
+        if (mCommittedBytes + load.Size > mBudgetBytes)
+        {
+            // Only trim the idle textures when that is enough, a partial trim would
+            // throw away mips for nothing.
+            const uint64_t needed = mCommittedBytes + load.Size - mBudgetBytes;
+            if (needed > Reclaimable())
+            {
+                continue;
+            }
+            Reclaim(needed, false);
+        }
+
+        entry.TargetMip = load.Mip;
+        mCommittedBytes += load.Size;
+    }
+
+    // Report trims first, so a backend can release memory before it allocates.
+    mStats.MipsLoaded = 0;
+    mStats.MipsTrimmed = 0;
+    const size_t firstLoad = changes.size();
+    for (size_t i = 0; i < mEntries.size(); ++i)
+    {
+        const uint32_t newTarget = mEntries[i].TargetMip;
+        const uint32_t oldTarget = mOldTargets[i];
+        if (newTarget == oldTarget)
+        {
+            continue;
+        }
+
+        const Change change = { (TextureId)i, oldTarget, newTarget };
+        if (newTarget > oldTarget)
+        {
+            mStats.MipsTrimmed += newTarget - oldTarget;
+            changes.insert(changes.begin() + firstLoad, change);
+        }
+        else
+        {
+            mStats.MipsLoaded += oldTarget - newTarget;
+            changes.push_back(change);
+        }
+    }
+
+    for (Entry& entry : mEntries)
+    {
+        entry.UsedThisFrame = false;
+    }
+    ++mFrame;
+
+    mStats.BudgetBytes = mBudgetBytes;
+    mStats.CommittedBytes = mCommittedBytes;
+}
+
+uint64_t TextureResidencyManager::FootprintFrom(const Entry& entry, uint32_t mip)
+{
+    uint64_t bytes = 0;
+    for (size_t i = mip; i < entry.MipSizes.size(); ++i)
+    {
+        bytes += entry.MipSizes[i];
+    }
+    return bytes;
+}
+
+uint64_t TextureResidencyManager::Reclaim(uint64_t bytes, bool includeRecent)
+{
+    mCandidates.clear();
+    for (size_t i = 0; i < mEntries.size(); ++i)
+    {
+        const Entry& entry = mEntries[i];
+        if (entry.TargetMip < entry.FloorMip && (includeRecent || IsIdle(entry)))
+        {
+            mCandidates.push_back((TextureId)i);
+        }
+    }
+
+    // Least recently used first, then the ones whose finest mip frees the most.
+    std::sort(mCandidates.begin(), mCandidates.end(), [this](TextureId a, TextureId b) {
+        const Entry& ea = mEntries[a];
+        const Entry& eb = mEntries[b];
+        if (ea.LastUsedFrame != eb.LastUsedFrame) { return ea.LastUsedFrame < eb.LastUsedFrame; }
+        return ea.MipSizes[ea.TargetMip] > eb.MipSizes[eb.TargetMip];
+    });
+
+    uint64_t freed = 0;
+    for (TextureId id : mCandidates)
+    {
+        Entry& entry = mEntries[id];
+        while (freed < bytes && entry.TargetMip < entry.FloorMip)
+        {
+            freed += entry.MipSizes[entry.TargetMip];
+            mCommittedBytes -= entry.MipSizes[entry.TargetMip];
+            ++entry.TargetMip;
+        }
+
+        if (freed >= bytes)
+        {
+            break;
+        }
+    }
+
+    return freed;
+}
+
+uint64_t TextureResidencyManager::Reclaimable() const
+{
+    uint64_t bytes = 0;
+    for (const Entry& entry : mEntries)
+    {
+        if (IsIdle(entry))
+        {
+            for (uint32_t mip = entry.TargetMip; mip < entry.FloorMip; ++mip)
+            {
+                bytes += entry.MipSizes[mip];
+            }
+        }
+    }
+    return bytes;
+}
+
+bool TextureResidencyManager::IsIdle(const Entry& entry) const
+{
+    return !entry.UsedThisFrame && mFrame - entry.LastUsedFrame >= mMinIdleFrames;
+}
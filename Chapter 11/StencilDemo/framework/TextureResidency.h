@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Decides which mips of which textures stay in memory under a byte budget. A texture is
+// only a list of mip sizes to the manager: the renderer registers every texture with the
+// size of each of its mips, reports the textures it draws each frame, and creates and
+// releases the mips EndFrame asks for (TextureStreamer does that).
+//
+// A texture's target is the finest mip it keeps, everything from the target down to the
+// coarsest mip counts against the budget. Textures drawn this frame are sharpened, coarse
+// mips first across all of them. The room comes from the least recently used textures,
+// which are trimmed one mip at a time, never below their floor mip (the mip tail, so
+// every texture stays drawable).
+class TextureResidencyManager
+{
+public:
+	using TextureId = uint32_t;
+
+	struct Change
+	{
+		TextureId Id = 0;
+		uint32_t OldTargetMip = 0;
+		// Finer than OldTargetMip means stream mips in, coarser means drop them.
+		uint32_t NewTargetMip = 0;
+	};
+
+	struct Stats
+	{
+		uint64_t BudgetBytes = 0;
+		uint64_t CommittedBytes = 0;	// all textures at their target mip
+		uint64_t WantedBytes = 0;		// textures drawn last frame at full resolution
+		uint32_t TextureCount = 0;
+		uint32_t MipsLoaded = 0;		// during the last EndFrame
+		uint32_t MipsTrimmed = 0;		// during the last EndFrame
+	};
+
+	// A texture has to stay unused for minIdleFrames before its mips are given to
+	// another texture, so textures drawn every other frame don't thrash.
+	explicit TextureResidencyManager(uint64_t budgetBytes, uint32_t minIdleFrames = 2);
+
+	// mipSizes[i] is the memory taken by mip i, mip 0 being the finest. Mips from floorMip
+	// to the coarsest are never trimmed. The texture starts out at targetMip.
+	TextureId Register(const std::vector<uint64_t>& mipSizes, uint32_t floorMip, uint32_t targetMip);
+
+	// Takes effect at the next EndFrame, trimming the least recently used textures first.
+	void SetBudget(uint64_t budgetBytes) { mBudgetBytes = budgetBytes; }
+	uint64_t GetBudget() const { return mBudgetBytes; }
+
+	// Call for every texture drawn during the frame, any number of times.
+	void MarkUsed(TextureId id);
+
+	// Ends the frame: picks the new targets and appends the textures whose target changed
+	// to changes, trims before loads.
+	void EndFrame(std::vector<Change>& changes);
+
+	uint32_t GetTargetMip(TextureId id) const { return mEntries[id].TargetMip; }
+	uint64_t GetTargetBytes(TextureId id) const { return FootprintFrom(mEntries[id], mEntries[id].TargetMip); }
+	const Stats& GetStats() const { return mStats; }
+
+private:
+	struct Entry
+	{
+		std::vector<uint64_t> MipSizes;
+		uint32_t FloorMip = 0;
+		uint32_t TargetMip = 0;
+		uint64_t LastUsedFrame = 0;
+		bool UsedThisFrame = false;
+	};
+
+	struct Load
+	{
+		TextureId Id;
+		uint32_t Mip;
+		uint64_t Size;
+	};
+
+	static uint64_t FootprintFrom(const Entry& entry, uint32_t mip);
+
+	// Trims textures, least recently used first, until bytes are freed. Textures used in
+	// the last minIdleFrames frames are only trimmed when includeRecent is set.
+	// Returns the number of bytes freed, which may be less than asked.
+	uint64_t Reclaim(uint64_t bytes, bool includeRecent);
+
+	// What Reclaim(..., false) could free at most.
+	uint64_t Reclaimable() const;
+
+	bool IsIdle(const Entry& entry) const;
+
+private:
+	std::vector<Entry> mEntries;
+	uint64_t mBudgetBytes = 0;
+	uint64_t mCommittedBytes = 0;
+	uint32_t mMinIdleFrames = 0;
+	uint64_t mFrame = 0;
+	Stats mStats;
+
+	// Scratch for EndFrame and Reclaim, kept so a frame doesn't allocate once they reached
+	// their size.
+	std::vector<uint32_t> mOldTargets;
+	std::vector<Load> mLoads;
+	std::vector<TextureId> mCandidates;
+};
@@ -0,0 +1,511 @@
+#include "TextureStreamer.h"
+#include "TextureLayout.h"
+#include "ResourceMemory.h"
+#include "AllocationTracker.h"
+#include <algorithm>
+
+namespace
+{
+    bool IsBlockCompressed(DXGI_FORMAT format)
+    {
+        return (format >= DXGI_FORMAT_BC1_TYPELESS && format <= DXGI_FORMAT_BC5_SNORM) ||
+            (format >= DXGI_FORMAT_BC6H_TYPELESS && format <= DXGI_FORMAT_BC7_UNORM_SRGB);
+    }
+
+    UINT64 AlignPlacement(UINT64 offset)
+    {
+        return (offset + D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT - 1) & ~(UINT64)(D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT - 1);
+    }
+}
+
+TextureStreamer::TextureStreamer(ID3D12Device* device, UINT64 memoryBudget, UINT64 uploadBudgetPerFrame, UINT mipTailMaxDimension) :
+    mDevice(device),
+    mUploadBudgetPerFrame(uploadBudgetPerFrame),
+    mMipTailMaxDimension(mipTailMaxDimension),
+    mMaxBufferedBytes(4 * uploadBudgetPerFrame),
+    mResidency(memoryBudget)
+{
+    mIoThread = std::thread(&TextureStreamer::IoThreadMain, this);
+}
+
+TextureStreamer::~TextureStreamer()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mQuit = true;
+    }
+    mCondition.notify_all();
+    mIoThread.join();
+}
+
+HRESULT TextureStreamer::CreateTexture(ID3D12GraphicsCommandList* cmdList, Texture& texture)
+{
+    auto streamed = std::make_unique<StreamedTexture>();
+    streamed->Filename = texture.Filename;
+    streamed->Tex = &texture;
+
+    HRESULT hr = GetDDSTextureLayoutFromFile12(
+        streamed->Filename.c_str(), streamed->Desc, streamed->Layout);
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    const D3D12_RESOURCE_DESC& desc = streamed->Desc;
+    if (desc.Dimension != D3D12_RESOURCE_DIMENSION_TEXTURE2D)
+    {
+        return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+    }
+
+    // The tail starts at the first mip small enough, or at the last mip. Every mip down to
+    // the tail may become mip 0 of the resource, which for block compressed formats has to
+    // be a whole number of blocks.
+    UINT tailMip = 0;
+    while (tailMip + 1u < desc.MipLevels &&
+        (std::max)(desc.Width >> tailMip, (UINT64)(desc.Height >> tailMip)) > mMipTailMaxDimension)
+    {
+        const D3D12_RESOURCE_DESC next = GetResourceDesc(*streamed, tailMip + 1);
+        if (IsBlockCompressed(desc.Format) && (next.Width % 4 != 0 || next.Height % 4 != 0))
+        {
+            break;
+        }
+        ++tailMip;
+    }
+    const UINT tailMipCount = desc.MipLevels - tailMip;
+
+    // Memory each mip adds to the resource, the tail counts as a whole.
+    std::vector<uint64_t> mipSizes(desc.MipLevels, 0);
+    UINT64 coarserSize = 0;
+    for (UINT mip = tailMip + 1; mip-- > 0;)
+    {
+        const D3D12_RESOURCE_DESC mipDesc = GetResourceDesc(*streamed, mip);
+        const UINT64 size = mDevice->GetResourceAllocationInfo(0, 1, &mipDesc).SizeInBytes;
+        mipSizes[mip] = size > coarserSize ? size - coarserSize : 0;
+        coarserSize = (std::max)(size, coarserSize);
+    }
+
+    // The tail is small by construction, read it right away.
+    std::vector<uint8_t> tailBytes;
+    hr = ReadMips(*streamed, tailMip, tailMipCount, tailBytes);
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    const D3D12_RESOURCE_DESC tailDesc = GetResourceDesc(*streamed, tailMip);
+    hr = mDevice->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+        D3D12_HEAP_FLAG_NONE,
+        &tailDesc,
+        D3D12_RESOURCE_STATE_COPY_DEST,
+        nullptr,
+        IID_PPV_ARGS(&texture.Resource));
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    hr = mDevice->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+        D3D12_HEAP_FLAG_NONE,
+        &CD3DX12_RESOURCE_DESC::Buffer(GetUploadSize(*streamed, tailMip, tailMipCount)),
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        IID_PPV_ARGS(&texture.UploadHeap));
+    if (FAILED(hr))
+    {
+        texture.Resource = nullptr;
+        return hr;
+    }
+    TrackResource(texture.Resource.Get(), MemoryCategory::Texture, texture.Name);
+    TrackResource(texture.UploadHeap.Get(), MemoryCategory::Upload, texture.Name + "Upload");
+
+    streamed->BaseMip = tailMip;
+    streamed->RequestedMip = tailMip;
+
+    UINT64 uploadOffset = 0;
+    UploadMips(cmdList, *streamed, tailMip, tailMipCount, tailBytes.data(),
+        texture.UploadHeap.Get(), uploadOffset);
+
+    cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(texture.Resource.Get(),
+        D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
+
+    texture.MostDetailedMip = 0;
+
+    // Finer mips come when the residency manager asks for them, i.e. once it is drawn.
+    ReserveFor(desc.MipLevels);
+    const auto id = mResidency.Register(mipSizes, tailMip, tailMip);
+    assert(id == mTextures.size());
+    mTextureIds[&texture] = id;
+    mTextures.push_back(std::move(streamed));
+
+    return S_OK;
+}
+
+void TextureStreamer::MarkUsed(const Texture& texture)
+{
+    auto it = mTextureIds.find(&texture);
+    if (it != mTextureIds.end())
+    {
+        mResidency.MarkUsed(it->second);
+    }
+}
+
+bool TextureStreamer::RecordUploads(ID3D12GraphicsCommandList* cmdList, UINT64 fenceValue, UINT64 completedFenceValue)
+{
+    std::erase_if(mRetired, [completedFenceValue](const RetiredResource& retired) {
+        return retired.Fence <= completedFenceValue;
+    });
+
+    mCopyDest.clear();
+    bool changed = false;
+
+    //
+    // Apply the residency decisions, trims come first so their memory is freed early.
+    //
+
+    mChanges.clear();
+    mResidency.EndFrame(mChanges);
+    for (const TextureResidencyManager::Change& change : mChanges)
+    {
+        StreamedTexture& texture = *mTextures[change.Id];
+        Resize(cmdList, texture, change.NewTargetMip, fenceValue);
+        mCopyDest.push_back(texture.Tex->Resource.Get());
+
+        if (change.NewTargetMip < texture.RequestedMip)
+        {
+            RequestMips(texture, change.NewTargetMip);
+        }
+        changed = true;
+    }
+
+    //
+    // Upload what the I/O thread has read, within the budget. A mip larger than the whole
+    // budget still goes through on its own, otherwise it would never be uploaded.
+    //
+
+    mReady.clear();
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        UINT64 readyBytes = 0;
+        while (!mCompleted.empty() &&
+            (mReady.empty() || readyBytes + mCompleted.front().Bytes.size() <= mUploadBudgetPerFrame))
+        {
+            readyBytes += mCompleted.front().Bytes.size();
+            mCompletedBytes -= mCompleted.front().Bytes.size();
+            mReady.push_back(std::move(mCompleted.front()));
+            mCompleted.pop_front();
+        }
+    }
+
+    if (!mReady.empty())
+    {
+        // There is room to read ahead again.
+        mCondition.notify_one();
+    }
+
+    // Keep the mips that extend a texture by exactly one level. Anything else is stale: a
+    // trim dropped it, or a duplicate request already brought it in. A mip that overtook
+    // a coarser one is read again later.
+    mAccepted.clear();
+    for (MipData& data : mReady)
+    {
+        data.Result >> chk;
+
+        StreamedTexture& texture = *data.Source;
+        const UINT nextMip = texture.BaseMip + texture.Tex->MostDetailedMip;
+        if (texture.Tex->MostDetailedMip > 0 && data.Mip + 1 == nextMip)
+        {
+            // Mips arrive coarsest first, so everything from data.Mip down is resident now.
+            texture.Tex->MostDetailedMip--;
+            mAccepted.push_back(std::move(data));
+        }
+        else if (data.Mip >= texture.BaseMip && data.Mip + 1 < nextMip)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                mRequests.push_back({ &texture, data.Mip, mNextSequence++ });
+                std::push_heap(mRequests.begin(), mRequests.end());
+            }
+            mCondition.notify_one();
+        }
+    }
+
+    if (!mAccepted.empty())
+    {
+        AllocationScope scope("TextureStreaming", AllocationRule::Allow);
+
+        // One staging buffer for the whole frame.
+        UINT64 uploadSize = 0;
+        for (const MipData& data : mAccepted)
+        {
+            uploadSize = AlignPlacement(uploadSize) + GetUploadSize(*data.Source, data.Mip, 1);
+        }
+
+        RetiredResource staging;
+        staging.Fence = fenceValue;
+        mDevice->CreateCommittedResource(
+            &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+            D3D12_HEAP_FLAG_NONE,
+            &CD3DX12_RESOURCE_DESC::Buffer(uploadSize),
+            D3D12_RESOURCE_STATE_GENERIC_READ,
+            nullptr,
+            IID_PPV_ARGS(&staging.Resource)) >> chk;
+        TrackResource(staging.Resource.Get(), MemoryCategory::Upload, "TextureStreamerStaging");
+
+        // Several mips of one texture may land in the same frame, transition each texture once.
+        mBarriers.clear();
+        for (const MipData& data : mAccepted)
+        {
+            ID3D12Resource* resource = data.Source->Tex->Resource.Get();
+            if (std::find(mCopyDest.begin(), mCopyDest.end(), resource) == mCopyDest.end())
+            {
+                mCopyDest.push_back(resource);
+                mBarriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(resource,
+                    D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_DEST));
+            }
+        }
+        if (!mBarriers.empty())
+        {
+            cmdList->ResourceBarrier((UINT)mBarriers.size(), mBarriers.data());
+        }
+
+        UINT64 uploadOffset = 0;
+        for (const MipData& data : mAccepted)
+        {
+            UploadMips(cmdList, *data.Source, data.Mip, 1, data.Bytes.data(),
+                staging.Resource.Get(), uploadOffset);
+        }
+
+        mRetired.push_back(std::move(staging));
+        changed = true;
+    }
+
+    mBarriers.clear();
+    for (ID3D12Resource* resource : mCopyDest)
+    {
+        mBarriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(resource,
+            D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
+    }
+    if (!mBarriers.empty())
+    {
+        cmdList->ResourceBarrier((UINT)mBarriers.size(), mBarriers.data());
+    }
+
+    // The uploaded bytes are in the staging buffer, free them now rather than next frame.
+    mReady.clear();
+    mAccepted.clear();
+
+    return changed;
+}
+
+bool TextureStreamer::IsIdle() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mRequests.empty() && mCompleted.empty() && !mReading;
+}
+
+void TextureStreamer::IoThreadMain()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    for (;;)
+    {
+        mCondition.wait(lock, [this] {
+            return mQuit ||
+                (!mRequests.empty() && (mCompleted.empty() || mCompletedBytes < mMaxBufferedBytes));
+        });
+
+        if (mQuit)
+        {
+            return;
+        }
+
+        std::pop_heap(mRequests.begin(), mRequests.end());
+        MipData data;
+        data.Source = mRequests.back().Source;
+        data.Mip = mRequests.back().Mip;
+        mRequests.pop_back();
+        mReading = true;
+
+        // Read without holding the lock, the main thread keeps queueing and uploading.
+        lock.unlock();
+        data.Result = ReadMips(*data.Source, data.Mip, 1, data.Bytes);
+        lock.lock();
+
+        mReading = false;
+        mCompletedBytes += data.Bytes.size();
+        mCompleted.push_back(std::move(data));
+    }
+}
+
+void TextureStreamer::RequestMips(StreamedTexture& texture, UINT firstMip)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        for (UINT mip = texture.RequestedMip; mip-- > firstMip;)
+        {
+            mRequests.push_back({ &texture, mip, mNextSequence++ });
+            std::push_heap(mRequests.begin(), mRequests.end());
+        }
+    }
+    mCondition.notify_one();
+
+    texture.RequestedMip = firstMip;
+}
+
+D3D12_RESOURCE_DESC TextureStreamer::GetResourceDesc(const StreamedTexture& texture, UINT baseMip)
+{
+    D3D12_RESOURCE_DESC desc = texture.Desc;
+    desc.Width = (std::max)(desc.Width >> baseMip, (UINT64)1);
+    desc.Height = (std::max)(desc.Height >> baseMip, 1u);
+    desc.MipLevels = (UINT16)(desc.MipLevels - baseMip);
+    return desc;
+}
+
+void TextureStreamer::Resize(ID3D12GraphicsCommandList* cmdList, StreamedTexture& texture, UINT baseMip, UINT64 fenceValue)
+{
+    Texture& tex = *texture.Tex;
+    const UINT mipLevels = texture.Desc.MipLevels;
+    const UINT arraySize = texture.Desc.DepthOrArraySize;
+    const UINT oldBaseMip = texture.BaseMip;
+
+    AllocationScope scope("TextureStreaming", AllocationRule::Allow);
+
+    ComPtr<ID3D12Resource> resource;
+    const D3D12_RESOURCE_DESC desc = GetResourceDesc(texture, baseMip);
+    mDevice->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+        D3D12_HEAP_FLAG_NONE,
+        &desc,
+        D3D12_RESOURCE_STATE_COPY_DEST,
+        nullptr,
+        IID_PPV_ARGS(&resource)) >> chk;
+    TrackResource(resource.Get(), MemoryCategory::Texture, tex.Name);
+
+    // Carry over the resident mips that are still wanted.
+    const UINT firstKept = (std::max)(baseMip, oldBaseMip + tex.MostDetailedMip);
+
+    cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(tex.Resource.Get(),
+        D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_SOURCE));
+
+    for (UINT slice = 0; slice < arraySize; ++slice)
+    {
+        for (UINT mip = firstKept; mip < mipLevels; ++mip)
+        {
+            CD3DX12_TEXTURE_COPY_LOCATION dst(resource.Get(),
+                D3D12CalcSubresource(mip - baseMip, slice, 0, mipLevels - baseMip, arraySize));
+            CD3DX12_TEXTURE_COPY_LOCATION src(tex.Resource.Get(),
+                D3D12CalcSubresource(mip - oldBaseMip, slice, 0, mipLevels - oldBaseMip, arraySize));
+            cmdList->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+        }
+    }
+
+    // The draws of this frame still sample the old resource through the old SRVs.
+    cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(tex.Resource.Get(),
+        D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
+
+    mRetired.push_back({ fenceValue, tex.Resource });
+
+    tex.Resource = resource;
+    tex.MostDetailedMip = firstKept - baseMip;
+    tex.NumFramesDirty = gNumFrameResources;
+
+    texture.BaseMip = baseMip;
+    texture.RequestedMip = (std::max)(texture.RequestedMip, baseMip);
+}
+
+HRESULT TextureStreamer::ReadMips(const StreamedTexture& texture, UINT firstMip, UINT mipCount, std::vector<uint8_t>& bytes)
+{
+    const UINT mipLevels = texture.Desc.MipLevels;
+    const UINT arraySize = texture.Desc.DepthOrArraySize;
+
+    std::ifstream fin(texture.Filename, std::ios::binary);
+    if (!fin)
+    {
+        return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+    }
+
+    // Within a slice the mips are contiguous in the file, one read per slice.
+    bytes.clear();
+    for (UINT slice = 0; slice < arraySize; ++slice)
+    {
+        const DDS_SUBRESOURCE_LAYOUT& first = texture.Layout[firstMip + slice * mipLevels];
+        const DDS_SUBRESOURCE_LAYOUT& last = texture.Layout[firstMip + mipCount - 1 + slice * mipLevels];
+        const size_t sliceBytes = (size_t)(last.Offset + (UINT64)last.SlicePitch * last.Depth - first.Offset);
+
+        const size_t begin = bytes.size();
+        bytes.resize(begin + sliceBytes);
+
+        fin.seekg((std::streamoff)first.Offset, std::ios::beg);
+        fin.read(reinterpret_cast<char*>(bytes.data() + begin), (std::streamsize)sliceBytes);
+        if ((size_t)fin.gcount() != sliceBytes)
+        {
+            bytes.clear();
+            return HRESULT_FROM_WIN32(ERROR_HANDLE_EOF);
+        }
+    }
+
+    return S_OK;
+}
+
+UINT64 TextureStreamer::GetUploadSize(const StreamedTexture& texture, UINT firstMip, UINT mipCount)
+{
+    const UINT mipLevels = texture.Desc.MipLevels;
+    const UINT arraySize = texture.Desc.DepthOrArraySize;
+
+    // Footprints only depend on the mip dimensions, the file layout gives the same
+    // sizes as the resized resource.
+    UINT64 size = 0;
+    for (UINT slice = 0; slice < arraySize; ++slice)
+    {
+        UINT64 sliceSize = 0;
+        ComputeCopyableFootprints(texture.Desc, firstMip + slice * mipLevels, mipCount,
+            0, nullptr, nullptr, nullptr, &sliceSize);
+
+        // Every slice starts on a new texture data placement boundary.
+        size = AlignPlacement(size) + sliceSize;
+    }
+
+    return size;
+}
+
+void TextureStreamer::UploadMips(ID3D12GraphicsCommandList* cmdList, const StreamedTexture& texture,
+    UINT firstMip, UINT mipCount, const uint8_t* bytes,
+    ID3D12Resource* uploadHeap, UINT64& uploadOffset)
+{
+    const UINT mipLevels = texture.Desc.MipLevels;
+    const UINT arraySize = texture.Desc.DepthOrArraySize;
+    const UINT resourceMipLevels = mipLevels - texture.BaseMip;
+
+    mSubresources.resize(mipCount);
+    for (UINT slice = 0; slice < arraySize; ++slice)
+    {
+        for (UINT i = 0; i < mipCount; ++i)
+        {
+            const DDS_SUBRESOURCE_LAYOUT& layout = texture.Layout[firstMip + i + slice * mipLevels];
+            mSubresources[i].pData = bytes;
+            mSubresources[i].RowPitch = layout.RowPitch;
+            mSubresources[i].SlicePitch = layout.SlicePitch;
+            bytes += (size_t)layout.SlicePitch * layout.Depth;
+        }
+
+        uploadOffset = AlignPlacement(uploadOffset);
+        uploadOffset += UploadSubresources(cmdList, texture.Tex->Resource.Get(), uploadHeap, uploadOffset,
+            D3D12CalcSubresource(firstMip - texture.BaseMip, slice, 0, resourceMipLevels, arraySize),
+            mipCount, mSubresources.data());
+    }
+}
+
+void TextureStreamer::ReserveFor(UINT mipLevels)
+{
+    // A request per mip, twice over for the mips requested again after a trim or after
+    // overtaking a coarser one. A texture is replaced at most once per frame, plus one
+    // staging buffer per frame, kept for the frames in flight.
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mRequestCapacity += 2 * mipLevels;
+        mRequests.reserve(mRequestCapacity);
+    }
+    mRetired.reserve((mTextures.size() + 2) * (gMaxFrameResources + 1));
+}
@@ -0,0 +1,167 @@
+#pragma once
+
+#include "d3dUtil.h"
+#include "DDSTextureLoader.h"
+#include "TextureResidency.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+// Streams DDS textures progressively under a memory budget. Creating a texture uploads
+// only its mip tail (the levels no larger than mipTailMaxDimension), so it can be drawn
+// right away. Which finer mips a texture gets is up to a TextureResidencyManager fed with
+// the textures drawn each frame: the mips it asks for are read by a background I/O
+// thread, coarsest first across all textures, and uploaded on the main thread within a
+// byte budget per frame. The mips it takes away are released.
+//
+// A texture's Resource only holds the mips it may keep, so it is recreated (and its
+// NumFramesDirty set) whenever that range changes. Texture::MostDetailedMip tracks the
+// finest mip of Resource holding data; shaders must not sample finer than that,
+// Default.hlsl clamps to gDiffuseMinMip.
+class TextureStreamer
+{
+public:
+	TextureStreamer(ID3D12Device* device,
+		UINT64 memoryBudget = 256ull << 20,
+		UINT64 uploadBudgetPerFrame = 4ull << 20,
+		UINT mipTailMaxDimension = 128);
+	TextureStreamer(const TextureStreamer&) = delete;
+	TextureStreamer& operator=(const TextureStreamer&) = delete;
+	~TextureStreamer();
+
+	// Creates texture.Resource from texture.Filename and records the upload of the mip tail
+	// into cmdList, texture.UploadHeap holds the tail data. Only 2D textures and arrays
+	// are supported. The texture must outlive the streamer.
+	HRESULT CreateTexture(ID3D12GraphicsCommandList* cmdList, Texture& texture);
+
+	// Call for every streamed texture a draw samples.
+	void MarkUsed(const Texture& texture);
+
+	// Call once per frame before recording draws. Applies the residency decisions for the
+	// usage marked since the last call, then records the upload of the mips read since
+	// the last call, as many as fit in the upload budget but at least one.
+	// fenceValue is the fence value this frame signals, replaced resources and staging
+	// memory are released once completedFenceValue reaches it.
+	// Returns true when any texture got a new Resource or MostDetailedMip.
+	//
+	// A frame with nothing to stream doesn't allocate. Creating resources, recording them
+	// in the MemoryTracker and copying the mips does, that work runs in a "TextureStreaming"
+	// AllocationScope which allows it inside an allocation free frame.
+	bool RecordUploads(ID3D12GraphicsCommandList* cmdList, UINT64 fenceValue, UINT64 completedFenceValue);
+
+	// True when no mip is queued or waiting for upload.
+	bool IsIdle() const;
+
+	TextureResidencyManager& Residency() { return mResidency; }
+
+private:
+	struct StreamedTexture
+	{
+		// Written once by CreateTexture, read by the I/O thread afterwards.
+		std::wstring Filename;
+		D3D12_RESOURCE_DESC Desc = {};	// the whole texture as stored in the file
+		std::vector<DDS_SUBRESOURCE_LAYOUT> Layout;
+
+		// Main thread only. Mips are numbered as in the file.
+		Texture* Tex = nullptr;
+		UINT BaseMip = 0;		// file mip stored in mip 0 of Tex->Resource
+		UINT RequestedMip = 0;	// finest mip that is resident or queued
+	};
+
+	// One mip level of a texture, all array slices.
+	struct MipRequest
+	{
+		StreamedTexture* Source = nullptr;
+		UINT Mip = 0;
+		UINT64 Sequence = 0;
+
+		// Coarser mips first so all textures sharpen at the same pace,
+		// requests for the same mip in submission order.
+		bool operator<(const MipRequest& rhs) const
+		{
+			return Mip != rhs.Mip ? Mip < rhs.Mip : Sequence > rhs.Sequence;
+		}
+	};
+
+	struct MipData
+	{
+		StreamedTexture* Source = nullptr;
+		UINT Mip = 0;
+		HRESULT Result = S_OK;
+		std::vector<uint8_t> Bytes;
+	};
+
+	// Kept alive until the GPU has passed Fence.
+	struct RetiredResource
+	{
+		UINT64 Fence = 0;
+		ComPtr<ID3D12Resource> Resource;
+	};
+
+	void IoThreadMain();
+
+	// Queues mips [firstMip, texture.RequestedMip). Takes the lock.
+	void RequestMips(StreamedTexture& texture, UINT firstMip);
+
+	// Description of the resource holding mips baseMip and coarser.
+	static D3D12_RESOURCE_DESC GetResourceDesc(const StreamedTexture& texture, UINT baseMip);
+
+	// Replaces texture.Tex->Resource with one holding mips baseMip and coarser, copying the
+	// resident mips still wanted. The new resource is left in COPY_DEST.
+	void Resize(ID3D12GraphicsCommandList* cmdList, StreamedTexture& texture, UINT baseMip, UINT64 fenceValue);
+
+	// Reads mips [firstMip, firstMip + mipCount) of every slice, slice-major as in the file.
+	static HRESULT ReadMips(const StreamedTexture& texture, UINT firstMip, UINT mipCount, std::vector<uint8_t>& bytes);
+
+	// Upload heap bytes needed by ReadMips data of the same range.
+	static UINT64 GetUploadSize(const StreamedTexture& texture, UINT firstMip, UINT mipCount);
+
+	// Records the copy of ReadMips data into the texture through uploadHeap, starting at
+	// uploadOffset which is advanced past the data. The texture must be in COPY_DEST.
+	void UploadMips(ID3D12GraphicsCommandList* cmdList, const StreamedTexture& texture,
+		UINT firstMip, UINT mipCount, const uint8_t* bytes,
+		ID3D12Resource* uploadHeap, UINT64& uploadOffset);
+
+	// Makes room in mRequests and mRetired for one more texture of mipLevels mips.
+	void ReserveFor(UINT mipLevels);
+
+private:
+	ComPtr<ID3D12Device> mDevice;
+	UINT64 mUploadBudgetPerFrame = 0;
+	UINT mMipTailMaxDimension = 0;
+
+	// The I/O thread stops reading ahead once this much data waits for upload.
+	UINT64 mMaxBufferedBytes = 0;
+
+	TextureResidencyManager mResidency;
+
+	// Indexed by residency id.
+	std::vector<std::unique_ptr<StreamedTexture>> mTextures;
+	std::unordered_map<const Texture*, TextureResidencyManager::TextureId> mTextureIds;
+	std::vector<RetiredResource> mRetired;
+
+	// Scratch for RecordUploads and UploadMips, reused from frame to frame. mCopyDest holds
+	// the resources left in COPY_DEST, they go back to PIXEL_SHADER_RESOURCE at the end of
+	// the frame.
+	std::vector<TextureResidencyManager::Change> mChanges;
+	std::vector<MipData> mReady;
+	std::vector<MipData> mAccepted;
+	std::vector<ID3D12Resource*> mCopyDest;
+	std::vector<D3D12_RESOURCE_BARRIER> mBarriers;
+	std::vector<D3D12_SUBRESOURCE_DATA> mSubresources;
+
+	// Shared with the I/O thread.
+	mutable std::mutex mMutex;
+	std::condition_variable mCondition;
+	// Max-heap on MipRequest::operator<, a vector so its capacity can be reserved.
+	std::vector<MipRequest> mRequests;
+	std::deque<MipData> mCompleted;
+	size_t mRequestCapacity = 0;
+	UINT64 mCompletedBytes = 0;
+	UINT64 mNextSequence = 0;
+	bool mReading = false;
+	bool mQuit = false;
+
+	std::thread mIoThread;
+};
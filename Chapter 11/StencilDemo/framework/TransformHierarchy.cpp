@@ -0,0 +1,50 @@
+#include "TransformHierarchy.h"
+
+UINT TransformHierarchy::Add(UINT parent, TransformKind kind, const XMFLOAT4X4& matrix)
+{
+    const UINT node = GetCount();
+    if (parent != NoParent)
+    {
+        // The subtree of the parent must still end at the new node.
+        if (parent >= node || mSubtreeEnd[parent] != node)
+        {
+            throw std::runtime_error(std::format(
+                "TransformHierarchy: node {} can't go under node {}, nodes are added depth first", node, parent));
+        }
+        for (UINT ancestor = parent; ancestor != NoParent; ancestor = mParent[ancestor])
+        {
+            ++mSubtreeEnd[ancestor];
+        }
+    }
+
+    mMatrix.push_back(matrix);
+    mWorld.push_back(MathHelper::Identity4x4());
+    mParent.push_back(parent);
+    mSubtreeEnd.push_back(node + 1);
+    mKind.push_back(kind);
+    mDirty.Resize(node + 1, true);
+    return node;
+}
+
+void TransformHierarchy::SetMatrix(UINT node, FXMMATRIX matrix)
+{
+    XMStoreFloat4x4(&mMatrix[node], matrix);
+    mDirty.Set(node);
+}
+
+void TransformHierarchy::ComputeWorld(UINT node)
+{
+    const UINT parent = mParent[node];
+    if (parent == NoParent)
+    {
+        mWorld[node] = mMatrix[node];
+        return;
+    }
+
+    const XMMATRIX matrix = XMLoadFloat4x4(&mMatrix[node]);
+    const XMMATRIX parentWorld = XMLoadFloat4x4(&mWorld[parent]);
+    const XMMATRIX world = mKind[node] == TransformKind::Local ?
+        XMMatrixMultiply(matrix, parentWorld) :
+        XMMatrixMultiply(parentWorld, matrix);
+    XMStoreFloat4x4(&mWorld[node], world);
+}
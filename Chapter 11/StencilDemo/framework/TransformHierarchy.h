@@ -0,0 +1,66 @@
+#pragma once
+
+#include "d3dUtil.h"
+#include "DirtyBitset.h"
+
+// How a node's world matrix follows its parent's.
+enum class TransformKind : uint8_t
+{
+	Local,		// world = matrix * parentWorld, a child placed in its parent's space
+	Derived,	// world = parentWorld * matrix, the parent seen through a reflection or projection
+};
+
+// Tree of world transforms recomputed only below the nodes that changed.
+//
+// Nodes are stored depth first, the subtree of a node is the range of nodes right after
+// it, so walking up the indices is a topological order and recomputing a subtree is one
+// pass over contiguous matrices. This needs the nodes to be added depth first: a new node
+// goes under the last node added or one of its ancestors.
+class TransformHierarchy
+{
+public:
+	static constexpr UINT NoParent = UINT_MAX;
+
+	// Returns the index of the new node, its world is computed by the next Update.
+	UINT Add(UINT parent, TransformKind kind, const XMFLOAT4X4& matrix);
+	UINT GetCount() const { return (UINT)mParent.size(); }
+
+	// Replaces the local or derivation matrix of a node, its subtree is recomputed by the
+	// next Update.
+	void SetMatrix(UINT node, FXMMATRIX matrix);
+
+	const XMFLOAT4X4& GetWorld(UINT node) const { return mWorld[node]; }
+
+	// Recomputes the world matrix of the nodes set since the last Update and of their
+	// subtrees, parents first, and calls changed(node, world) for each.
+	template<typename Fn>
+	void Update(const Fn& changed)
+	{
+		// A node set inside a subtree just recomputed is already up to date.
+		UINT end = 0;
+		mDirty.ConsumeEach([&](uint32_t first) {
+			if (first < end)
+			{
+				return;
+			}
+			end = mSubtreeEnd[first];
+			for (UINT node = first; node < end; ++node)
+			{
+				ComputeWorld(node);
+				changed(node, mWorld[node]);
+			}
+		});
+	}
+
+private:
+	void ComputeWorld(UINT node);
+
+	std::vector<XMFLOAT4X4> mMatrix;
+	std::vector<XMFLOAT4X4> mWorld;
+	std::vector<UINT> mParent;
+	// One past the last node of the subtree.
+	std::vector<UINT> mSubtreeEnd;
+	std::vector<TransformKind> mKind;
+
+	DirtyBitset mDirty;
+};
@@ -1,13 +1,15 @@
 #pragma once
 
 #include "d3dUtil.h"
+#include "ResourceMemory.h"
+#include <emmintrin.h>
 
 template<typename T>
 class UploadBuffer
 {
 public:
 	UploadBuffer(ID3D12Device* device, UINT elementCount,
-		bool isConstantBuffer) :
+		bool isConstantBuffer, std::string_view name = "UploadBuffer") :
 		mIsConstantBuffer(isConstantBuffer)
 	{
 		mElementByteSize = sizeof(T);
@@ -31,6 +33,8 @@ public:
 			D3D12_RESOURCE_STATE_GENERIC_READ,
 			nullptr,
 			IID_PPV_ARGS(&mUploadBuffer)) >> chk;
+		TrackResource(mUploadBuffer.Get(),
+			isConstantBuffer ? MemoryCategory::ConstantBuffer : MemoryCategory::Upload, name);
 
 		mUploadBuffer->Map(0, nullptr, reinterpret_cast<void**>(&mMappedData)) >> chk;
 
@@ -57,9 +61,80 @@ public:
 			&mMappedData[elementIndex * mElementByteSize],
 			&data,
 			sizeof(T));
+		MarkDirty(elementIndex, elementIndex + 1);
 	}
 
+	// Writes scattered elements with streaming stores, fenced once when the writer goes
+	// out of scope; it must be destroyed before the command list reading them executes.
+	class Writer
+	{
+	public:
+		explicit Writer(UploadBuffer& buffer) : mBuffer(buffer) {}
+		Writer(const Writer&) = delete;
+		Writer& operator=(const Writer&) = delete;
+		~Writer()
+		{
+			if (mEnd > mBegin)
+			{
+				_mm_sfence();
+				mBuffer.MarkDirty(mBegin, mEnd);
+			}
+		}
+
+		void Write(int elementIndex, const T& data)
+		{
+			StreamElement(&mBuffer.mMappedData[elementIndex * mBuffer.mElementByteSize], data);
+			mBegin = (std::min)(mBegin, elementIndex);
+			mEnd = (std::max)(mEnd, elementIndex + 1);
+		}
+
+	private:
+		UploadBuffer& mBuffer;
+		int mBegin = INT_MAX;
+		int mEnd = 0;
+	};
+
+	Writer Map() { return Writer(*this); }
+
+	// Size of the range written since the last ResetDirtyRange, from the first element
+	// written to the end of the last one, padding included.
+	UINT64 GetDirtyBytes() const
+	{
+		return mDirtyRange.End > mDirtyRange.Begin ? mDirtyRange.End - mDirtyRange.Begin : 0;
+	}
+	void ResetDirtyRange() { mDirtyRange = { SIZE_MAX, 0 }; }
+
 private:
+	static void StreamElement(BYTE* dst, const T& data)
+	{
+		// Elements start 16-byte aligned when their size is a multiple of 16 (constant
+		// buffer elements always are), the copy is then whole streaming stores.
+		if constexpr (sizeof(T) % 16 == 0)
+		{
+			const BYTE* src = reinterpret_cast<const BYTE*>(&data);
+			for (size_t i = 0; i < sizeof(T); i += 16)
+			{
+				_mm_stream_si128((__m128i*)(dst + i), _mm_loadu_si128((const __m128i*)(src + i)));
+			}
+		}
+		else
+		{
+			memcpy(dst, &data, sizeof(T));
+		}
+	}
+
+	void MarkDirty(int begin, int end)
+	{
+		if (begin >= end)
+		{
+			return;
+		}
+		mDirtyRange.Begin = (std::min)(mDirtyRange.Begin, (SIZE_T)begin * mElementByteSize);
+		mDirtyRange.End = (std::max)(mDirtyRange.End, (SIZE_T)(end - 1) * mElementByteSize + sizeof(T));
+	}
+
+	D3D12_RANGE mDirtyRange = { SIZE_MAX, 0 };
+
 	bool mIsConstantBuffer = false;
 	UINT mElementByteSize = 0;
 
@@ -0,0 +1,81 @@
+#include "UploadRing.h"
+#include "ResourceMemory.h"
+
+UploadRing::UploadRing(ID3D12Device* device, UINT64 initialSize, UINT64 maxSize) :
+    mDevice(device),
+    mAllocator(initialSize, maxSize)
+{
+    CreateBuffer(mAllocator.GetBuffer(), mAllocator.GetCapacity());
+}
+
+UploadRing::~UploadRing()
+{
+    for (Buffer& buffer : mBuffers)
+    {
+        buffer.Resource->Unmap(0, nullptr);
+    }
+}
+
+UploadRing::Allocation UploadRing::Allocate(UINT64 size, UINT64 alignment)
+{
+    RingAllocation ringAllocation;
+    bool grew = false;
+    if (!mAllocator.Allocate(size, alignment, ringAllocation, grew))
+    {
+        throw std::runtime_error(std::format("UploadRing can't fit {} bytes", size));
+    }
+    if (grew)
+    {
+        CreateBuffer(ringAllocation.Buffer, mAllocator.GetCapacity());
+    }
+
+    const Buffer& buffer = mBuffers.back();
+    Allocation allocation;
+    allocation.Resource = buffer.Resource.Get();
+    allocation.Offset = ringAllocation.Offset;
+    allocation.CpuAddress = buffer.MappedData + ringAllocation.Offset;
+    allocation.GpuAddress = buffer.Resource->GetGPUVirtualAddress() + ringAllocation.Offset;
+    return allocation;
+}
+
+void UploadRing::EndFrame(UINT64 fenceValue)
+{
+    mAllocator.EndFrame(fenceValue);
+}
+
+void UploadRing::Retire(UINT64 completedFenceValue)
+{
+    mReleasedBuffers.clear();
+    mAllocator.Retire(completedFenceValue, mReleasedBuffers);
+
+    for (uint64_t id : mReleasedBuffers)
+    {
+        for (size_t i = 0; i < mBuffers.size(); ++i)
+        {
+            if (mBuffers[i].Id == id)
+            {
+                mBuffers[i].Resource->Unmap(0, nullptr);
+                mBuffers.erase(mBuffers.begin() + i);
+                break;
+            }
+        }
+    }
+}
+
+void UploadRing::CreateBuffer(uint64_t id, UINT64 size)
+{
+    Buffer buffer;
+    buffer.Id = id;
+    mDevice->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+        D3D12_HEAP_FLAG_NONE,
+        &CD3DX12_RESOURCE_DESC::Buffer(size),
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        IID_PPV_ARGS(&buffer.Resource)) >> chk;
+    TrackResource(buffer.Resource.Get(), MemoryCategory::Upload, std::format("UploadRing{}", id));
+
+    // Mapped for its whole life, the CPU only writes it.
+    buffer.Resource->Map(0, &CD3DX12_RANGE(0, 0), (void**)&buffer.MappedData) >> chk;
+    mBuffers.push_back(std::move(buffer));
+}
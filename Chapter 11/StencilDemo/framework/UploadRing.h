@@ -0,0 +1,63 @@
+#pragma once
+
+#include "d3dUtil.h"
+#include "RingAllocator.h"
+
+// Transient upload memory for anything written once per frame (constants, dynamic
+// vertices): one persistently mapped upload buffer per device, suballocated as a ring
+// by RingAllocator. Allocations stay valid until the fence value given to the next
+// EndFrame completes, so there is no need for one buffer per FrameResource sized up
+// front. When the in-flight frames fill the buffer a larger one replaces it.
+class UploadRing
+{
+public:
+	struct Allocation
+	{
+		ID3D12Resource* Resource = nullptr;
+		UINT64 Offset = 0;
+		uint8_t* CpuAddress = nullptr;			// write-combined, never read it
+		D3D12_GPU_VIRTUAL_ADDRESS GpuAddress = 0;
+	};
+
+	UploadRing(ID3D12Device* device, UINT64 initialSize = 1ull << 20, UINT64 maxSize = 256ull << 20);
+	UploadRing(const UploadRing&) = delete;
+	UploadRing& operator=(const UploadRing&) = delete;
+	~UploadRing();
+
+	// Throws when size doesn't fit in maxSize.
+	Allocation Allocate(UINT64 size, UINT64 alignment = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
+
+	// A constant buffer holding data, the returned address can be bound as a root CBV.
+	template<typename T>
+	D3D12_GPU_VIRTUAL_ADDRESS AllocateConstants(const T& data)
+	{
+		Allocation allocation = Allocate(d3dUtil::CalculateConstantBufferByteSize(sizeof(T)));
+		memcpy(allocation.CpuAddress, &data, sizeof(T));
+		return allocation.GpuAddress;
+	}
+
+	// Call once per frame after signaling fenceValue, see RingAllocator::EndFrame.
+	void EndFrame(UINT64 fenceValue);
+
+	// Call once per frame before allocating, with the fence's completed value.
+	void Retire(UINT64 completedFenceValue);
+
+	const RingAllocator& GetAllocator() const { return mAllocator; }
+
+private:
+	struct Buffer
+	{
+		uint64_t Id = 0;
+		ComPtr<ID3D12Resource> Resource;
+		uint8_t* MappedData = nullptr;
+	};
+
+	void CreateBuffer(uint64_t id, UINT64 size);
+
+	ID3D12Device* mDevice = nullptr;
+	RingAllocator mAllocator;
+
+	// The current buffer is the last one, the others wait for their frames to complete.
+	std::vector<Buffer> mBuffers;
+	std::vector<uint64_t> mReleasedBuffers;
+};
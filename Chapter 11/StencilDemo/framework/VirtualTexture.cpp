@@ -0,0 +1,359 @@
+#include "VirtualTexture.h"
+#include <algorithm>
+#include <cassert>
+
+uint32_t VirtualTextureDesc::MipLevels() const
+{
+    uint32_t levels = 1;
+    while (PagesX(levels - 1) > 1 || PagesY(levels - 1) > 1)
+    {
+        ++levels;
+    }
+    return levels;
+}
+
+uint32_t VirtualTextureDesc::PagesX(uint32_t mip) const
+{
+    return (std::max)((Width / PageSize) >> mip, 1u);
+}
+
+uint32_t VirtualTextureDesc::PagesY(uint32_t mip) const
+{
+    return (std::max)((Height / PageSize) >> mip, 1u);
+}
+
+bool VirtualTextureDesc::IsValid(const VirtualPage& page) const
+{
+    return page.Mip < MipLevels() && page.X < PagesX(page.Mip) && page.Y < PagesY(page.Mip);
+}
+
+VirtualTextureFeedback::VirtualTextureFeedback(const VirtualTextureDesc& desc) :
+    mDesc(desc)
+{
+}
+
+void VirtualTextureFeedback::Analyze(const uint32_t* feedback, size_t count, std::vector<Request>& requests)
+{
+    requests.clear();
+    mCounts.clear();
+
+    // Neighbouring texels mostly ask for the same page, skip runs before hashing.
+    uint32_t lastKey = VirtualFeedbackNone;
+    uint32_t* lastCount = nullptr;
+    for (size_t i = 0; i < count; ++i)
+    {
+        const uint32_t key = feedback[i];
+        if (key == VirtualFeedbackNone)
+        {
+            continue;
+        }
+        if (key == lastKey)
+        {
+            ++*lastCount;
+            continue;
+        }
+        if (!mDesc.IsValid(VirtualPage::Unpack(key)))
+        {
+            continue;
+        }
+
+        lastKey = key;
+        lastCount = &mCounts[key];
+        ++*lastCount;
+    }
+
+    // Every ancestor counts for the texels of its descendants. Walking the mips finest
+    // first adds each level once to its parent.
+    const uint32_t mipLevels = mDesc.MipLevels();
+    std::vector<std::vector<std::pair<uint32_t, uint32_t>>> byMip(mipLevels);
+    for (const auto& [key, texels] : mCounts)
+    {
+        byMip[VirtualPage::Unpack(key).Mip].push_back({ key, texels });
+    }
+    for (uint32_t mip = 0; mip + 1 < mipLevels; ++mip)
+    {
+        for (const auto& [key, texels] : byMip[mip])
+        {
+            const VirtualPage page = VirtualPage::Unpack(key);
+            const VirtualPage parent = { page.X >> 1, page.Y >> 1, mip + 1 };
+            auto [it, inserted] = mCounts.try_emplace(parent.Pack(), 0);
+            if (inserted)
+            {
+                byMip[mip + 1].push_back({ parent.Pack(), 0 });
+            }
+            it->second += texels;
+        }
+
+        // The counts just added to the next level's list are stale, refresh them.
+        for (auto& [key, texels] : byMip[mip + 1])
+        {
+            texels = mCounts[key];
+        }
+    }
+
+    requests.reserve(mCounts.size());
+    for (const auto& [key, texels] : mCounts)
+    {
+        requests.push_back({ VirtualPage::Unpack(key), texels });
+    }
+
+    std::sort(requests.begin(), requests.end(), [](const Request& a, const Request& b) {
+        if (a.Page.Mip != b.Page.Mip) { return a.Page.Mip > b.Page.Mip; }
+        if (a.Count != b.Count) { return a.Count > b.Count; }
+        return a.Page.Pack() < b.Page.Pack();
+    });
+}
+
+VirtualPageCache::VirtualPageCache(uint32_t slotCount) :
+    mEntries(slotCount)
+{
+    for (Slot slot = 0; slot < slotCount; ++slot)
+    {
+        PushBack(slot);
+    }
+    mStats.SlotCount = slotCount;
+}
+
+VirtualPageCache::Slot VirtualPageCache::Find(uint32_t key) const
+{
+    auto it = mSlots.find(key);
+    return it != mSlots.end() ? it->second : InvalidSlot;
+}
+
+void VirtualPageCache::Touch(Slot slot, uint64_t frame)
+{
+    Entry& entry = mEntries[slot];
+    entry.LastUsedFrame = frame;
+    ++mStats.Hits;
+
+    if (!entry.Locked)
+    {
+        Unlink(slot);
+        PushBack(slot);
+    }
+}
+
+VirtualPageCache::Slot VirtualPageCache::Allocate(uint32_t key, uint64_t frame, uint32_t& evictedKey)
+{
+    evictedKey = VirtualFeedbackNone;
+
+    // The head is the least recently used, if this frame needs it so does it the rest.
+    const Slot slot = mHead;
+    if (slot == None)
+    {
+        return InvalidSlot;
+    }
+
+    Entry& entry = mEntries[slot];
+    if (entry.Key != VirtualFeedbackNone)
+    {
+        if (entry.LastUsedFrame == frame)
+        {
+            return InvalidSlot;
+        }
+
+        evictedKey = entry.Key;
+        mSlots.erase(entry.Key);
+        ++mStats.Evictions;
+    }
+    else
+    {
+        ++mStats.UsedSlots;
+    }
+
+    entry.Key = key;
+    entry.LastUsedFrame = frame;
+    mSlots[key] = slot;
+
+    Unlink(slot);
+    PushBack(slot);
+    return slot;
+}
+
+void VirtualPageCache::Lock(Slot slot)
+{
+    Entry& entry = mEntries[slot];
+    if (!entry.Locked)
+    {
+        Unlink(slot);
+        entry.Locked = true;
+        ++mStats.LockedSlots;
+    }
+}
+
+void VirtualPageCache::Unlink(Slot slot)
+{
+    Entry& entry = mEntries[slot];
+    (entry.Prev != None ? mEntries[entry.Prev].Next : mHead) = entry.Next;
+    (entry.Next != None ? mEntries[entry.Next].Prev : mTail) = entry.Prev;
+    entry.Prev = entry.Next = None;
+}
+
+void VirtualPageCache::PushBack(Slot slot)
+{
+    Entry& entry = mEntries[slot];
+    entry.Prev = mTail;
+    entry.Next = None;
+    (mTail != None ? mEntries[mTail].Next : mHead) = slot;
+    mTail = slot;
+}
+
+VirtualPageTable::VirtualPageTable(const VirtualTextureDesc& desc) :
+    mDesc(desc)
+{
+    const uint32_t mipLevels = desc.MipLevels();
+    mTable.resize(mipLevels);
+    mMapped.resize(mipLevels);
+    for (uint32_t mip = 0; mip < mipLevels; ++mip)
+    {
+        const size_t pages = (size_t)desc.PagesX(mip) * desc.PagesY(mip);
+        mTable[mip].assign(pages, 0);
+        mMapped[mip].assign(pages, false);
+    }
+    mDirtyMips = (1u << mipLevels) - 1;
+}
+
+void VirtualPageTable::MapPage(const VirtualPage& page, uint32_t slotX, uint32_t slotY)
+{
+    assert(slotX < 256 && slotY < 256);
+    mMapped[page.Mip][Index(page)] = true;
+    FillSubtree(page, MakeEntry(slotX, slotY, page.Mip));
+}
+
+void VirtualPageTable::UnmapPage(const VirtualPage& page)
+{
+    if (!IsMapped(page))
+    {
+        return;
+    }
+    mMapped[page.Mip][Index(page)] = false;
+
+    // What stood in for the page before it was loaded stands in again.
+    uint32_t parentEntry = 0;
+    if (page.Mip + 1 < mTable.size())
+    {
+        parentEntry = GetEntry({ page.X >> 1, page.Y >> 1, page.Mip + 1 });
+    }
+    FillSubtree(page, parentEntry);
+}
+
+bool VirtualPageTable::IsMapped(const VirtualPage& page) const
+{
+    return mMapped[page.Mip][Index(page)];
+}
+
+uint32_t VirtualPageTable::GetEntry(const VirtualPage& page) const
+{
+    return mTable[page.Mip][Index(page)];
+}
+
+void VirtualPageTable::FillSubtree(const VirtualPage& page, uint32_t entry)
+{
+    // Entries already pointing at a finer page keep it, those are closer.
+    for (uint32_t mip = page.Mip + 1; mip-- > 0;)
+    {
+        const uint32_t shift = page.Mip - mip;
+        const uint32_t pagesX = mDesc.PagesX(mip);
+        const uint32_t pagesY = mDesc.PagesY(mip);
+        const uint32_t x0 = page.X << shift;
+        const uint32_t y0 = page.Y << shift;
+        const uint32_t x1 = (std::min)((page.X + 1) << shift, pagesX);
+        const uint32_t y1 = (std::min)((page.Y + 1) << shift, pagesY);
+
+        std::vector<uint32_t>& table = mTable[mip];
+        for (uint32_t y = y0; y < y1; ++y)
+        {
+            for (uint32_t x = x0; x < x1; ++x)
+            {
+                uint32_t& current = table[(size_t)y * pagesX + x];
+                if (!IsValidEntry(current) || EntryMip(current) >= page.Mip)
+                {
+                    current = entry;
+                }
+            }
+        }
+        mDirtyMips |= 1u << mip;
+    }
+}
+
+VirtualTextureSystem::VirtualTextureSystem(const VirtualTextureDesc& desc, uint32_t slotsX, uint32_t slotsY,
+    uint32_t maxRequestsPerFrame) :
+    mDesc(desc),
+    mSlotsX(slotsX),
+    mSlotsY(slotsY),
+    mMaxRequestsPerFrame(maxRequestsPerFrame),
+    mFeedback(desc),
+    mCache(slotsX * slotsY),
+    mPageTable(desc)
+{
+}
+
+void VirtualTextureSystem::ProcessFeedback(const uint32_t* feedback, size_t count, std::vector<VirtualPage>& requests)
+{
+    mFeedback.Analyze(feedback, count, mRequests);
+
+    // Nothing can be drawn before the coarsest mip, whatever the feedback says.
+    const uint32_t topMip = mDesc.MipLevels() - 1;
+    for (uint32_t y = 0; y < mDesc.PagesY(topMip); ++y)
+    {
+        for (uint32_t x = 0; x < mDesc.PagesX(topMip); ++x)
+        {
+            const VirtualPage page = { x, y, topMip };
+            if (!mPageTable.IsMapped(page) && mPending.count(page.Pack()) == 0 &&
+                mPending.size() < mMaxRequestsPerFrame)
+            {
+                mPending.insert(page.Pack());
+                requests.push_back(page);
+            }
+        }
+    }
+
+    for (const VirtualTextureFeedback::Request& request : mRequests)
+    {
+        const uint32_t key = request.Page.Pack();
+        const VirtualPageCache::Slot slot = mCache.Find(key);
+        if (slot != VirtualPageCache::InvalidSlot)
+        {
+            mCache.Touch(slot, mFrame);
+        }
+        else if (mPending.count(key) == 0 && mPending.size() < mMaxRequestsPerFrame)
+        {
+            mPending.insert(key);
+            requests.push_back(request.Page);
+        }
+    }
+}
+
+bool VirtualTextureSystem::CommitPage(const VirtualPage& page, uint32_t& slotX, uint32_t& slotY)
+{
+    const uint32_t key = page.Pack();
+    mPending.erase(key);
+
+    uint32_t evictedKey = VirtualFeedbackNone;
+    const VirtualPageCache::Slot slot = mCache.Allocate(key, mFrame, evictedKey);
+    if (slot == VirtualPageCache::InvalidSlot)
+    {
+        return false;
+    }
+
+    if (evictedKey != VirtualFeedbackNone)
+    {
+        mPageTable.UnmapPage(VirtualPage::Unpack(evictedKey));
+    }
+
+    slotX = slot % mSlotsX;
+    slotY = slot / mSlotsX;
+    mPageTable.MapPage(page, slotX, slotY);
+
+    if (page.Mip == mDesc.MipLevels() - 1)
+    {
+        mCache.Lock(slot);
+    }
+
+    return true;
+}
+
+void VirtualTextureSystem::CancelPage(const VirtualPage& page)
+{
+    mPending.erase(page.Pack());
+}
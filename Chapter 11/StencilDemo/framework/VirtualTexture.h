@@ -0,0 +1,224 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// CPU side of sparse virtual texturing. A virtual texture is cut into square pages of
+// PageSize texels at every mip, only the pages sampled recently live in a physical
+// texture of fixed size, and a page table texture (one texel per page) tells the shader
+// where to find each page, or the closest coarser page that is resident.
+//
+// The classes below decide which pages to load and evict and where they go, from the
+// page ids the feedback pass reads back. VirtualTextureStreamer does the GPU side: it
+// reads the feedback, uploads the pages into their slots and the page table changes.
+
+// Address of one page, mip 0 being the finest.
+struct VirtualPage
+{
+	uint32_t X = 0;
+	uint32_t Y = 0;
+	uint32_t Mip = 0;
+
+	// Layout the feedback pass writes: x in bits 0-11, y in bits 12-23, mip in bits 24-27.
+	uint32_t Pack() const { return X | (Y << 12) | (Mip << 24); }
+	static VirtualPage Unpack(uint32_t key) { return { key & 0xfff, (key >> 12) & 0xfff, (key >> 24) & 0xf }; }
+
+	bool operator==(const VirtualPage& rhs) const { return X == rhs.X && Y == rhs.Y && Mip == rhs.Mip; }
+};
+
+// Feedback texels where nothing virtual was drawn.
+constexpr uint32_t VirtualFeedbackNone = 0xffffffff;
+
+struct VirtualTextureDesc
+{
+	uint32_t Width = 0;			// texels of mip 0, a multiple of PageSize
+	uint32_t Height = 0;
+	uint32_t PageSize = 128;	// texels of a page without its borders
+	uint32_t Border = 4;		// texels repeated from the neighbour pages on each side, for filtering
+
+	// Pages down to the mip that fits in a single page.
+	uint32_t MipLevels() const;
+	uint32_t PagesX(uint32_t mip) const;
+	uint32_t PagesY(uint32_t mip) const;
+	uint32_t PaddedPageSize() const { return PageSize + 2 * Border; }
+	bool IsValid(const VirtualPage& page) const;
+};
+
+// Turns the page ids the feedback pass wrote into the set of pages the frame needs, each
+// with its coarser ancestors (a page is only worth loading once its parent can stand in
+// for it), most important first: coarse mips first, then the pages covering the most
+// feedback texels.
+class VirtualTextureFeedback
+{
+public:
+	struct Request
+	{
+		VirtualPage Page;
+		uint32_t Count = 0;	// feedback texels that needed this page or a finer one
+	};
+
+	explicit VirtualTextureFeedback(const VirtualTextureDesc& desc);
+
+	// Replaces requests with the pages feedback asks for. Ids of pages the texture doesn't
+	// have are ignored, feedback can be a low resolution, unfiltered target.
+	void Analyze(const uint32_t* feedback, size_t count, std::vector<Request>& requests);
+
+private:
+	VirtualTextureDesc mDesc;
+	std::unordered_map<uint32_t, uint32_t> mCounts;
+};
+
+// Fixed number of physical page slots recycled least recently used first. Slots can be
+// locked, e.g. for the coarsest mip so every texel always has something to fall back to.
+class VirtualPageCache
+{
+public:
+	using Slot = uint32_t;
+	static constexpr Slot InvalidSlot = 0xffffffff;
+
+	struct Stats
+	{
+		uint32_t SlotCount = 0;
+		uint32_t UsedSlots = 0;
+		uint32_t LockedSlots = 0;
+		uint64_t Hits = 0;			// Touch calls on resident pages
+		uint64_t Evictions = 0;
+	};
+
+	explicit VirtualPageCache(uint32_t slotCount);
+
+	// Slot holding the page (a VirtualPage::Pack key), InvalidSlot when not resident.
+	Slot Find(uint32_t key) const;
+
+	// Marks the slot used during frame, it won't be recycled before the next frame.
+	void Touch(Slot slot, uint64_t frame);
+
+	// Gives the least recently used slot to key. evictedKey is the page that lived in it
+	// (VirtualFeedbackNone if the slot was free). Returns InvalidSlot when every slot is
+	// locked or used during frame, nothing is evicted then.
+	Slot Allocate(uint32_t key, uint64_t frame, uint32_t& evictedKey);
+
+	// Locked slots are never recycled.
+	void Lock(Slot slot);
+
+	const Stats& GetStats() const { return mStats; }
+
+private:
+	static constexpr uint32_t None = 0xffffffff;
+
+	struct Entry
+	{
+		uint32_t Key = VirtualFeedbackNone;
+		uint64_t LastUsedFrame = 0;
+		uint32_t Prev = None;
+		uint32_t Next = None;
+		bool Locked = false;
+	};
+
+	void Unlink(Slot slot);
+	void PushBack(Slot slot);
+
+private:
+	std::vector<Entry> mEntries;
+	std::unordered_map<uint32_t, Slot> mSlots;
+
+	// LRU list of the unlocked slots, free ones first.
+	uint32_t mHead = None;
+	uint32_t mTail = None;
+
+	Stats mStats;
+};
+
+// Contents of the page table texture: every page of every mip maps to the physical slot
+// of its finest resident ancestor, itself included. Kept up to date incrementally as pages
+// come and go, only the subtree under a page changes.
+class VirtualPageTable
+{
+public:
+	// One page table texel, R8G8B8A8_UINT: slot x, slot y, mip of the page in that slot,
+	// and 255 when valid.
+	static uint32_t MakeEntry(uint32_t slotX, uint32_t slotY, uint32_t mip)
+	{
+		return slotX | (slotY << 8) | (mip << 16) | (0xffu << 24);
+	}
+	static uint32_t EntryMip(uint32_t entry) { return (entry >> 16) & 0xff; }
+	static bool IsValidEntry(uint32_t entry) { return (entry >> 24) != 0; }
+
+	explicit VirtualPageTable(const VirtualTextureDesc& desc);
+
+	// The page now lives in slot (slotX, slotY) of the physical texture, at most 256x256 slots.
+	void MapPage(const VirtualPage& page, uint32_t slotX, uint32_t slotY);
+	void UnmapPage(const VirtualPage& page);
+
+	bool IsMapped(const VirtualPage& page) const;
+	uint32_t GetEntry(const VirtualPage& page) const;
+
+	// PagesX(mip) x PagesY(mip) entries, row by row.
+	const std::vector<uint32_t>& GetMip(uint32_t mip) const { return mTable[mip]; }
+
+	// Bit per mip changed since the last ClearDirty.
+	uint32_t GetDirtyMips() const { return mDirtyMips; }
+	void ClearDirty() { mDirtyMips = 0; }
+
+private:
+	size_t Index(const VirtualPage& page) const { return (size_t)page.Y * mDesc.PagesX(page.Mip) + page.X; }
+
+	// Sets every entry under page, at its mip and finer, that is invalid or maps to a
+	// page of page.Mip or coarser to entry.
+	void FillSubtree(const VirtualPage& page, uint32_t entry);
+
+private:
+	VirtualTextureDesc mDesc;
+	std::vector<std::vector<uint32_t>> mTable;
+	std::vector<std::vector<bool>> mMapped;
+	uint32_t mDirtyMips = 0;
+};
+
+// Ties the three together for one virtual texture.
+class VirtualTextureSystem
+{
+public:
+	VirtualTextureSystem(const VirtualTextureDesc& desc, uint32_t slotsX, uint32_t slotsY,
+		uint32_t maxRequestsPerFrame = 32);
+
+	// Takes one frame of feedback: marks the resident pages it needs as used and appends
+	// the missing ones to requests, most important first, at most maxRequestsPerFrame
+	// including the ones still in flight. The coarsest mip is always requested until it
+	// is resident.
+	void ProcessFeedback(const uint32_t* feedback, size_t count, std::vector<VirtualPage>& requests);
+
+	// A requested page's data arrived. Gives it a slot, unmapping the page evicted from it,
+	// and maps it. Returns false when every slot is needed by this frame, the page is then
+	// dropped and will be asked for again.
+	bool CommitPage(const VirtualPage& page, uint32_t& slotX, uint32_t& slotY);
+
+	// A requested page could not be loaded.
+	void CancelPage(const VirtualPage& page);
+
+	// Call once per frame after the uploads.
+	void EndFrame() { ++mFrame; }
+
+	const VirtualTextureDesc& GetDesc() const { return mDesc; }
+	uint32_t GetSlotsX() const { return mSlotsX; }
+	uint32_t GetSlotsY() const { return mSlotsY; }
+	VirtualPageTable& PageTable() { return mPageTable; }
+	const VirtualPageCache& Cache() const { return mCache; }
+	size_t GetPendingCount() const { return mPending.size(); }
+
+private:
+	VirtualTextureDesc mDesc;
+	uint32_t mSlotsX = 0;
+	uint32_t mSlotsY = 0;
+	uint32_t mMaxRequestsPerFrame = 0;
+	uint64_t mFrame = 0;
+
+	VirtualTextureFeedback mFeedback;
+	VirtualPageCache mCache;
+	VirtualPageTable mPageTable;
+
+	std::vector<VirtualTextureFeedback::Request> mRequests;
+	std::unordered_set<uint32_t> mPending;
+};
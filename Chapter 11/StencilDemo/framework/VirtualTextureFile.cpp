@@ -0,0 +1,108 @@
+#include "VirtualTextureFile.h"
+
+namespace
+{
+    // Where each mip starts in the offset table, plus the total page count at the end.
+    std::vector<size_t> GetFirstPages(const VirtualTextureDesc& desc)
+    {
+        std::vector<size_t> firstPage;
+        size_t pages = 0;
+        for (uint32_t mip = 0; mip < desc.MipLevels(); ++mip)
+        {
+            firstPage.push_back(pages);
+            pages += (size_t)desc.PagesX(mip) * desc.PagesY(mip);
+        }
+        firstPage.push_back(pages);
+        return firstPage;
+    }
+}
+
+bool VirtualTextureFile::Open(const std::filesystem::path& filename)
+{
+    mFile = std::ifstream(filename, std::ios::binary);
+    if (!mFile.read((char*)&mHeader, sizeof(mHeader)) || mHeader.Magic != VirtualTextureFileMagic)
+    {
+        return false;
+    }
+
+    const VirtualTextureDesc desc = GetDesc();
+    if (desc.PageSize == 0 || desc.Width % desc.PageSize != 0 || desc.Height % desc.PageSize != 0 ||
+        desc.Width == 0 || desc.Height == 0 || GetPageBytes() == 0)
+    {
+        return false;
+    }
+
+    mFirstPage = GetFirstPages(desc);
+    mOffsets.resize(mFirstPage.back());
+    return (bool)mFile.read((char*)mOffsets.data(), mOffsets.size() * sizeof(uint64_t));
+}
+
+VirtualTextureDesc VirtualTextureFile::GetDesc() const
+{
+    VirtualTextureDesc desc;
+    desc.Width = mHeader.Width;
+    desc.Height = mHeader.Height;
+    desc.PageSize = mHeader.PageSize;
+    desc.Border = mHeader.Border;
+    return desc;
+}
+
+bool VirtualTextureFile::ReadPage(const VirtualPage& page, std::vector<uint8_t>& bytes)
+{
+    const VirtualTextureDesc desc = GetDesc();
+    if (!desc.IsValid(page))
+    {
+        return false;
+    }
+
+    const uint64_t offset = mOffsets[mFirstPage[page.Mip] + (size_t)page.Y * desc.PagesX(page.Mip) + page.X];
+    if (offset == 0)
+    {
+        return false;
+    }
+
+    // A failed read leaves the stream in error, the next page may still be fine.
+    mFile.clear();
+    bytes.resize(GetPageBytes());
+    mFile.seekg((std::streamoff)offset);
+    return (bool)mFile.read((char*)bytes.data(), bytes.size());
+}
+
+bool VirtualTextureFile::Write(const std::filesystem::path& filename, const VirtualTextureFileHeader& header,
+    const std::function<void(const VirtualPage& page, uint8_t* bytes)>& getPage)
+{
+    std::ofstream fout(filename, std::ios::binary);
+
+    VirtualTextureFile layout;
+    layout.mHeader = header;
+    const VirtualTextureDesc desc = layout.GetDesc();
+    const std::vector<size_t> firstPage = GetFirstPages(desc);
+    const size_t pageBytes = layout.GetPageBytes();
+
+    // Pages are stored in offset table order, right after it.
+    std::vector<uint64_t> offsets(firstPage.back());
+    uint64_t offset = sizeof(header) + offsets.size() * sizeof(uint64_t);
+    for (uint64_t& pageOffset : offsets)
+    {
+        pageOffset = offset;
+        offset += pageBytes;
+    }
+
+    fout.write((const char*)&header, sizeof(header));
+    fout.write((const char*)offsets.data(), offsets.size() * sizeof(uint64_t));
+
+    std::vector<uint8_t> bytes(pageBytes);
+    for (uint32_t mip = 0; mip < desc.MipLevels(); ++mip)
+    {
+        for (uint32_t y = 0; y < desc.PagesY(mip); ++y)
+        {
+            for (uint32_t x = 0; x < desc.PagesX(mip); ++x)
+            {
+                getPage({ x, y, mip }, bytes.data());
+                fout.write((const char*)bytes.data(), bytes.size());
+            }
+        }
+    }
+
+    return (bool)fout;
+}
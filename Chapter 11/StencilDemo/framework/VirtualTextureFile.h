@@ -0,0 +1,50 @@
+#pragma once
+
+#include "VirtualTexture.h"
+#include <filesystem>
+#include <fstream>
+#include <functional>
+
+// Tiled on-disk layout of a virtual texture, so a page is one seek and one read:
+//   VirtualTextureFileHeader
+//   uint64_t offset of every page, mip 0 first, each mip row by row, 0 for a missing page
+//   the pages, RowCount rows of RowPitch bytes each, borders included
+constexpr uint32_t VirtualTextureFileMagic = 0x31585456;	// "VTX1"
+
+struct VirtualTextureFileHeader
+{
+	uint32_t Magic = VirtualTextureFileMagic;
+	uint32_t Width = 0;
+	uint32_t Height = 0;
+	uint32_t PageSize = 0;
+	uint32_t Border = 0;
+	uint32_t Format = 0;	// DXGI_FORMAT of the texels
+	uint32_t RowPitch = 0;	// bytes per row of a page, a row of blocks for block compressed formats
+	uint32_t RowCount = 0;	// rows per page
+};
+
+// Reads pages of a tiled file. Not thread safe, VirtualTextureStreamer only reads from its
+// I/O thread.
+class VirtualTextureFile
+{
+public:
+	// False when the file can't be read or isn't a virtual texture.
+	bool Open(const std::filesystem::path& filename);
+
+	const VirtualTextureFileHeader& GetHeader() const { return mHeader; }
+	VirtualTextureDesc GetDesc() const;
+	size_t GetPageBytes() const { return (size_t)mHeader.RowPitch * mHeader.RowCount; }
+
+	// False when the page is missing from the file or can't be read.
+	bool ReadPage(const VirtualPage& page, std::vector<uint8_t>& bytes);
+
+	// Writes a file, getPage fills the GetPageBytes() bytes of every page.
+	static bool Write(const std::filesystem::path& filename, const VirtualTextureFileHeader& header,
+		const std::function<void(const VirtualPage& page, uint8_t* bytes)>& getPage);
+
+private:
+	std::ifstream mFile;
+	VirtualTextureFileHeader mHeader;
+	std::vector<uint64_t> mOffsets;
+	std::vector<size_t> mFirstPage;	// index in mOffsets of the first page of each mip
+};
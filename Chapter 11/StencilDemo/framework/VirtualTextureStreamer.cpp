@@ -0,0 +1,274 @@
+#include "VirtualTextureStreamer.h"
+#include "TextureLayout.h"
+#include "ResourceMemory.h"
+#include <algorithm>
+
+namespace
+{
+    UINT64 AlignPlacement(UINT64 offset)
+    {
+        return (offset + D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT - 1) & ~(UINT64)(D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT - 1);
+    }
+
+    VirtualTextureDesc OpenFile(VirtualTextureFile& file, const std::wstring& filename)
+    {
+        if (!file.Open(filename))
+        {
+            throw std::runtime_error("cannot open virtual texture file");
+        }
+        return file.GetDesc();
+    }
+}
+
+VirtualTextureStreamer::VirtualTextureStreamer(ID3D12Device* device, const std::wstring& filename,
+    UINT slotsX, UINT slotsY, UINT maxRequestsPerFrame, UINT maxUploadsPerFrame) :
+    mDevice(device),
+    mMaxUploadsPerFrame(maxUploadsPerFrame),
+    mSystem(OpenFile(mFile, filename), slotsX, slotsY, maxRequestsPerFrame)
+{
+    mHeader = mFile.GetHeader();
+    const VirtualTextureDesc& desc = mSystem.GetDesc();
+    const UINT paddedPageSize = desc.PaddedPageSize();
+
+    mDevice->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+        D3D12_HEAP_FLAG_NONE,
+        &CD3DX12_RESOURCE_DESC::Tex2D((DXGI_FORMAT)mHeader.Format, slotsX * paddedPageSize, slotsY * paddedPageSize, 1, 1),
+        D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
+        nullptr,
+        IID_PPV_ARGS(&mPhysicalTexture)) >> chk;
+    TrackResource(mPhysicalTexture.Get(), MemoryCategory::Texture, "VirtualTexturePhysical");
+
+    // Written as a whole on the first RecordUploads, every mip starts dirty.
+    mDevice->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+        D3D12_HEAP_FLAG_NONE,
+        &CD3DX12_RESOURCE_DESC::Tex2D(GetPageTableFormat(), desc.PagesX(0), desc.PagesY(0), 1, (UINT16)desc.MipLevels()),
+        D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
+        nullptr,
+        IID_PPV_ARGS(&mPageTable)) >> chk;
+    TrackResource(mPageTable.Get(), MemoryCategory::Texture, "VirtualTexturePageTable");
+
+    // Without feedback only the coarsest mip is asked for.
+    mSystem.ProcessFeedback(nullptr, 0, mNewRequests);
+    mRequests.insert(mRequests.end(), mNewRequests.begin(), mNewRequests.end());
+
+    mIoThread = std::thread(&VirtualTextureStreamer::IoThreadMain, this);
+}
+
+VirtualTextureStreamer::~VirtualTextureStreamer()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mQuit = true;
+    }
+    mCondition.notify_all();
+    mIoThread.join();
+}
+
+VirtualTextureStreamer::ShaderConstants VirtualTextureStreamer::GetShaderConstants() const
+{
+    const VirtualTextureDesc& desc = mSystem.GetDesc();
+
+    ShaderConstants constants;
+    constants.PageCount = XMFLOAT2((float)desc.PagesX(0), (float)desc.PagesY(0));
+    constants.SlotCount = XMFLOAT2((float)mSystem.GetSlotsX(), (float)mSystem.GetSlotsY());
+    constants.PageSize = (float)desc.PageSize;
+    constants.Border = (float)desc.Border;
+    constants.MipLevels = (float)desc.MipLevels();
+    return constants;
+}
+
+void VirtualTextureStreamer::ProcessFeedback(const uint32_t* feedback, size_t count)
+{
+    mNewRequests.clear();
+    mSystem.ProcessFeedback(feedback, count, mNewRequests);
+    if (mNewRequests.empty())
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mRequests.insert(mRequests.end(), mNewRequests.begin(), mNewRequests.end());
+    }
+    mCondition.notify_one();
+}
+
+bool VirtualTextureStreamer::RecordUploads(ID3D12GraphicsCommandList* cmdList, UINT64 fenceValue, UINT64 completedFenceValue)
+{
+    mRetired.erase(std::remove_if(mRetired.begin(), mRetired.end(),
+        [completedFenceValue](const RetiredResource& r) { return r.Fence <= completedFenceValue; }),
+        mRetired.end());
+
+    std::vector<PageData> arrived;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        while (!mCompleted.empty() && arrived.size() < mMaxUploadsPerFrame)
+        {
+            arrived.push_back(std::move(mCompleted.front()));
+            mCompleted.pop_front();
+        }
+    }
+
+    struct PageUpload
+    {
+        const PageData* Data;
+        UINT SlotX;
+        UINT SlotY;
+    };
+
+    std::vector<PageUpload> uploads;
+    for (const PageData& data : arrived)
+    {
+        UINT slotX = 0;
+        UINT slotY = 0;
+        if (!data.Loaded)
+        {
+            mSystem.CancelPage(data.Page);
+        }
+        else if (mSystem.CommitPage(data.Page, slotX, slotY))
+        {
+            uploads.push_back({ &data, slotX, slotY });
+        }
+    }
+
+    VirtualPageTable& pageTable = mSystem.PageTable();
+    const UINT dirtyMips = pageTable.GetDirtyMips();
+    mSystem.EndFrame();
+    if (uploads.empty() && dirtyMips == 0)
+    {
+        return false;
+    }
+
+    // Footprints of one page and of every page table mip, all in one staging buffer.
+    const D3D12_RESOURCE_DESC physicalDesc = mPhysicalTexture->GetDesc();
+    D3D12_RESOURCE_DESC pageDesc = physicalDesc;
+    pageDesc.Width = pageDesc.Height = mSystem.GetDesc().PaddedPageSize();
+
+    D3D12_PLACED_SUBRESOURCE_FOOTPRINT pageFootprint;
+    UINT pageRows = 0;
+    UINT64 pageRowSize = 0;
+    UINT64 pageSize = 0;
+    ComputeCopyableFootprints(pageDesc, 0, 1, 0, &pageFootprint, &pageRows, &pageRowSize, &pageSize);
+    if (pageRows != mHeader.RowCount || pageRowSize > mHeader.RowPitch)
+    {
+        throw std::runtime_error("virtual texture pages don't match their format");
+    }
+
+    const D3D12_RESOURCE_DESC tableDesc = mPageTable->GetDesc();
+    const UINT tableMips = tableDesc.MipLevels;
+    std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> tableFootprints(tableMips);
+    std::vector<UINT> tableRows(tableMips);
+    std::vector<UINT64> tableRowSizes(tableMips);
+    UINT64 tableSize = 0;
+    ComputeCopyableFootprints(tableDesc, 0, tableMips, 0,
+        tableFootprints.data(), tableRows.data(), tableRowSizes.data(), &tableSize);
+
+    const UINT64 tableOffset = AlignPlacement(uploads.size() * AlignPlacement(pageSize));
+
+    RetiredResource staging;
+    staging.Fence = fenceValue;
+    mDevice->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+        D3D12_HEAP_FLAG_NONE,
+        &CD3DX12_RESOURCE_DESC::Buffer(tableOffset + (dirtyMips != 0 ? tableSize : 0)),
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        IID_PPV_ARGS(&staging.Resource)) >> chk;
+    TrackResource(staging.Resource.Get(), MemoryCategory::Upload, "VirtualTextureStaging");
+
+    uint8_t* mapped = nullptr;
+    staging.Resource->Map(0, &CD3DX12_RANGE(0, 0), (void**)&mapped) >> chk;
+
+    std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> pageFootprints(uploads.size(), pageFootprint);
+    std::vector<D3D12_SUBRESOURCE_DATA> pageSources(uploads.size());
+    for (size_t i = 0; i < uploads.size(); ++i)
+    {
+        pageFootprints[i].Offset = i * AlignPlacement(pageSize);
+        pageSources[i].pData = uploads[i].Data->Bytes.data();
+        pageSources[i].RowPitch = mHeader.RowPitch;
+        pageSources[i].SlicePitch = (LONG_PTR)mHeader.RowPitch * mHeader.RowCount;
+    }
+    std::vector<UINT> pageRowCounts(uploads.size(), pageRows);
+    std::vector<UINT64> pageRowSizes(uploads.size(), pageRowSize);
+    CopySubresourceRows(mapped, pageFootprints.data(), pageRowCounts.data(), pageRowSizes.data(),
+        pageSources.data(), (UINT)uploads.size());
+
+    std::vector<UINT> copiedMips;
+    for (UINT mip = 0; mip < tableMips; ++mip)
+    {
+        if (dirtyMips & (1u << mip))
+        {
+            tableFootprints[mip].Offset += tableOffset;
+
+            const std::vector<uint32_t>& entries = pageTable.GetMip(mip);
+            D3D12_SUBRESOURCE_DATA source;
+            source.pData = entries.data();
+            source.RowPitch = (LONG_PTR)tableRowSizes[mip];
+            source.SlicePitch = (LONG_PTR)(tableRowSizes[mip] * tableRows[mip]);
+            CopySubresourceRows(mapped, &tableFootprints[mip], &tableRows[mip], &tableRowSizes[mip], &source, 1, 1);
+            copiedMips.push_back(mip);
+        }
+    }
+    pageTable.ClearDirty();
+    staging.Resource->Unmap(0, nullptr);
+
+    D3D12_RESOURCE_BARRIER barriers[] =
+    {
+        CD3DX12_RESOURCE_BARRIER::Transition(mPhysicalTexture.Get(),
+            D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_DEST),
+        CD3DX12_RESOURCE_BARRIER::Transition(mPageTable.Get(),
+            D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_DEST),
+    };
+    cmdList->ResourceBarrier(_countof(barriers), barriers);
+
+    const UINT paddedPageSize = mSystem.GetDesc().PaddedPageSize();
+    for (size_t i = 0; i < uploads.size(); ++i)
+    {
+        cmdList->CopyTextureRegion(
+            &CD3DX12_TEXTURE_COPY_LOCATION(mPhysicalTexture.Get(), 0),
+            uploads[i].SlotX * paddedPageSize, uploads[i].SlotY * paddedPageSize, 0,
+            &CD3DX12_TEXTURE_COPY_LOCATION(staging.Resource.Get(), pageFootprints[i]), nullptr);
+    }
+    for (UINT mip : copiedMips)
+    {
+        cmdList->CopyTextureRegion(
+            &CD3DX12_TEXTURE_COPY_LOCATION(mPageTable.Get(), mip), 0, 0, 0,
+            &CD3DX12_TEXTURE_COPY_LOCATION(staging.Resource.Get(), tableFootprints[mip]), nullptr);
+    }
+
+    for (D3D12_RESOURCE_BARRIER& barrier : barriers)
+    {
+        std::swap(barrier.Transition.StateBefore, barrier.Transition.StateAfter);
+    }
+    cmdList->ResourceBarrier(_countof(barriers), barriers);
+
+    mRetired.push_back(std::move(staging));
+    return true;
+}
+
+void VirtualTextureStreamer::IoThreadMain()
+{
+    for (;;)
+    {
+        VirtualPage page;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mCondition.wait(lock, [this]() { return mQuit || !mRequests.empty(); });
+            if (mQuit)
+            {
+                return;
+            }
+            page = mRequests.front();
+            mRequests.pop_front();
+        }
+
+        PageData data;
+        data.Page = page;
+        data.Loaded = mFile.ReadPage(page, data.Bytes);
+
+        std::lock_guard<std::mutex> lock(mMutex);
+        mCompleted.push_back(std::move(data));
+    }
+}
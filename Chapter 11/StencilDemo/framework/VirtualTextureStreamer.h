@@ -0,0 +1,96 @@
+#pragma once
+
+#include "d3dUtil.h"
+#include "VirtualTextureFile.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+// Streams the pages of a virtual texture file (VirtualTextureFile) into a physical texture
+// of slotsX x slotsY pages, driven by the page ids a feedback pass writes. The page table
+// texture (R8G8B8A8_UINT, one texel per page, one mip per virtual mip) and the physical
+// texture are both sampled by SampleVirtualTexture in shader/VirtualTexture.hlsl.
+//
+// Both resources live as long as the streamer, so their SRVs never change. Pages are read
+// by a background I/O thread and uploaded on the main thread a few per frame; evicting a
+// page and overwriting its slot is safe because the copies run on the same queue after
+// every frame that could still sample the old page.
+class VirtualTextureStreamer
+{
+public:
+	// Shader constants, see VirtualTexture.hlsl.
+	struct ShaderConstants
+	{
+		XMFLOAT2 PageCount = { 0.0f, 0.0f };	// pages of mip 0
+		XMFLOAT2 SlotCount = { 0.0f, 0.0f };	// pages of the physical texture
+		float PageSize = 0.0f;
+		float Border = 0.0f;
+		float MipLevels = 0.0f;
+		float Pad = 0.0f;
+	};
+
+	// Throws when the file can't be opened or the textures can't be created.
+	VirtualTextureStreamer(ID3D12Device* device, const std::wstring& filename,
+		UINT slotsX = 16, UINT slotsY = 16,
+		UINT maxRequestsPerFrame = 32, UINT maxUploadsPerFrame = 16);
+	VirtualTextureStreamer(const VirtualTextureStreamer&) = delete;
+	VirtualTextureStreamer& operator=(const VirtualTextureStreamer&) = delete;
+	~VirtualTextureStreamer();
+
+	// In PIXEL_SHADER_RESOURCE outside of RecordUploads.
+	ID3D12Resource* GetPhysicalTexture() const { return mPhysicalTexture.Get(); }
+	ID3D12Resource* GetPageTable() const { return mPageTable.Get(); }
+	DXGI_FORMAT GetPageTableFormat() const { return DXGI_FORMAT_R8G8B8A8_UINT; }
+	ShaderConstants GetShaderConstants() const;
+
+	// Takes the feedback pass output of a finished frame (a mapped readback buffer) and
+	// queues the pages it misses.
+	void ProcessFeedback(const uint32_t* feedback, size_t count);
+
+	// Call once per frame. Records the upload of the pages read since the last call and of
+	// the page table mips they changed. fenceValue is the fence value this frame signals,
+	// staging memory is released once completedFenceValue reaches it.
+	// Returns true when anything was uploaded.
+	bool RecordUploads(ID3D12GraphicsCommandList* cmdList, UINT64 fenceValue, UINT64 completedFenceValue);
+
+	VirtualTextureSystem& System() { return mSystem; }
+
+private:
+	struct PageData
+	{
+		VirtualPage Page;
+		bool Loaded = false;
+		std::vector<uint8_t> Bytes;
+	};
+
+	struct RetiredResource
+	{
+		UINT64 Fence = 0;
+		ComPtr<ID3D12Resource> Resource;
+	};
+
+	void IoThreadMain();
+
+private:
+	ComPtr<ID3D12Device> mDevice;
+	UINT mMaxUploadsPerFrame = 0;
+
+	VirtualTextureFile mFile;	// I/O thread only after construction
+	VirtualTextureFileHeader mHeader;
+	VirtualTextureSystem mSystem;
+
+	ComPtr<ID3D12Resource> mPhysicalTexture;
+	ComPtr<ID3D12Resource> mPageTable;
+	std::vector<RetiredResource> mRetired;
+	std::vector<VirtualPage> mNewRequests;
+
+	// Shared with the I/O thread.
+	std::mutex mMutex;
+	std::condition_variable mCondition;
+	std::deque<VirtualPage> mRequests;
+	std::deque<PageData> mCompleted;
+	bool mQuit = false;
+
+	std::thread mIoThread;
+};
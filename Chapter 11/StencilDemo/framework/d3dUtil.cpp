@@ -1,4 +1,5 @@
 #include "d3dUtil.h"
+#include "ResourceMemory.h"
 
 DxgiInfoManager dxgiInfoManager;
 CheckerToken chk;
@@ -18,6 +19,7 @@ ComPtr<ID3D12Resource> d3dUtil::CreateDefaultBuffer(
         D3D12_RESOURCE_STATE_COMMON,
         nullptr,
         IID_PPV_ARGS(&defaultBuffer) ) >> chk;
+    TrackResource(defaultBuffer.Get(), MemoryCategory::Geometry, "DefaultBuffer");
 
     device->CreateCommittedResource(
         &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
@@ -26,6 +28,7 @@ ComPtr<ID3D12Resource> d3dUtil::CreateDefaultBuffer(
         D3D12_RESOURCE_STATE_GENERIC_READ,
         nullptr,
         IID_PPV_ARGS(&uploadBuffer) ) >> chk;
+    TrackResource(uploadBuffer.Get(), MemoryCategory::Upload, "DefaultBufferUpload");
 
     D3D12_SUBRESOURCE_DATA subResourceData = {
         .pData = initData,
@@ -105,6 +108,45 @@ ComPtr<ID3DBlob> d3dUtil::LoadBinary(const std::wstring& filename)
     return blob;
 }
 
+HRESULT d3dUtil::ReadWholeFile(const std::wstring& filename, std::vector<uint8_t>& data)
+{
+    std::ifstream fin(filename, std::ios::binary | std::ios::ate);
+    if (!fin)
+    {
+        return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+    }
+
+    data.resize((size_t)fin.tellg());
+    fin.seekg(0, std::ios_base::beg);
+    if (!fin.read((char*)data.data(), data.size()))
+    {
+        return HRESULT_FROM_WIN32(ERROR_READ_FAULT);
+    }
+
+    return S_OK;
+}
+
+void d3dUtil::ComputeSubmeshBounds(SubmeshGeometry& submesh,
+    const void* vertices, UINT vertexByteStride, const std::uint16_t* indices)
+{
+    std::vector<XMFLOAT3> positions(submesh.IndexCount);
+    for (UINT i = 0; i < submesh.IndexCount; ++i)
+    {
+        const UINT vertex = submesh.BaseVertexLocation + indices[submesh.StartIndexLocation + i];
+        positions[i] = *(const XMFLOAT3*)((const uint8_t*)vertices + (size_t)vertex * vertexByteStride);
+    }
+
+    BoundingBox::CreateFromPoints(submesh.Bounds, positions.size(), positions.data(), sizeof(XMFLOAT3));
+    BoundingSphere::CreateFromPoints(submesh.Sphere, positions.size(), positions.data(), sizeof(XMFLOAT3));
+
+    // The sphere around the box is sometimes the tighter one.
+    const float boxRadius = XMVectorGetX(XMVector3Length(XMLoadFloat3(&submesh.Bounds.Extents)));
+    if (boxRadius < submesh.Sphere.Radius)
+    {
+        submesh.Sphere = BoundingSphere(submesh.Bounds.Center, boxRadius);
+    }
+}
+
 DxgiInfoManager::DxgiInfoManager()
 {
             /* Code copy from chili hw3d */
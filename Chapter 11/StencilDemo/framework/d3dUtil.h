@@ -20,6 +20,7 @@
 #include <directxcollision.h>
 #include <limits>
 #include "MathHelper.h"
+#include "DescriptorAllocator.h"
 #include "d3dx12.h"
 
 #include <WindowsX.h>
@@ -30,10 +31,15 @@ using namespace DirectX;
 
 extern class DxgiInfoManager dxgiInfoManager;
 extern struct CheckerToken chk;
-extern const int gNumFrameResources;
+// Frame resources the app allocates, and how many of them are in flight at the moment,
+// which may change from one frame to the next.
+extern const int gMaxFrameResources;
+extern int gNumFrameResources;
 
 constexpr auto MAX_SIZE = (std::numeric_limits<long>::max)();
 
+struct SubmeshGeometry;
+
 class d3dUtil {
 public:
 	static ComPtr<ID3D12Resource> CreateDefaultBuffer(
@@ -66,6 +72,14 @@ public:
 		const std::string& target);
 
 	static ComPtr<ID3DBlob> LoadBinary(const std::wstring& filename);
+	// Reads the whole file into data. Unlike LoadBinary, a missing or short file is an
+	// error rather than a blob of whatever was read.
+	static HRESULT ReadWholeFile(const std::wstring& filename, std::vector<uint8_t>& data);
+
+	// Fills the bounds of submesh from the vertices its indices reference. The position
+	// must be the first member of the vertex.
+	static void ComputeSubmeshBounds(SubmeshGeometry& submesh,
+		const void* vertices, UINT vertexByteStride, const std::uint16_t* indices);
 };
 
 struct SubmeshGeometry {
@@ -74,7 +88,9 @@ struct SubmeshGeometry {
 	UINT StartIndexLocation = 0;
 	UINT BaseVertexLocation = 0;
 
+	// Object space bounds, see d3dUtil::ComputeSubmeshBounds.
 	BoundingBox Bounds;
+	BoundingSphere Sphere;
 };
 
 struct MeshGeometry {
@@ -90,11 +106,20 @@ struct MeshGeometry {
 	ComPtr<ID3D12Resource> VertexBufferUploader;
 	ComPtr<ID3D12Resource> IndexBufferUploader;
 
+	// Set for meshes the CPU reads after initialization (picking, collision) so
+	// ReleaseUploadData keeps VertexBufferCPU and IndexBufferCPU.
+	bool CpuAccess = false;
+
 	UINT VertexByteStride = 0;
 	UINT VertexBufferByteSize = 0;
 	UINT IndexBufferByteSize = 0;
 	DXGI_FORMAT IndexFormat = DXGI_FORMAT_R16_UINT;
 
+	// Start of the data in VertexBufferGPU and IndexBufferGPU, which may be shared with
+	// other meshes, see StaticGeometryArena.
+	UINT64 VertexBufferOffset = 0;
+	UINT64 IndexBufferOffset = 0;
+
 	// Submesh is not a mesh, it just stores the offset so we can get 
 	// the mesh info from the big overall buffer. 
 	std::unordered_map<std::string, SubmeshGeometry> DrawArgs;
@@ -102,7 +127,7 @@ struct MeshGeometry {
 	D3D12_VERTEX_BUFFER_VIEW VertexBufferView() const
 	{
 		D3D12_VERTEX_BUFFER_VIEW vbv = {
-			.BufferLocation = VertexBufferGPU->GetGPUVirtualAddress(),
+			.BufferLocation = VertexBufferGPU->GetGPUVirtualAddress() + VertexBufferOffset,
 			.SizeInBytes = VertexBufferByteSize,
 			.StrideInBytes = VertexByteStride,
 		};
@@ -112,7 +137,7 @@ struct MeshGeometry {
 	D3D12_INDEX_BUFFER_VIEW IndexBufferView() const
 	{
 		D3D12_INDEX_BUFFER_VIEW ibv = {
-			.BufferLocation = IndexBufferGPU->GetGPUVirtualAddress(),
+			.BufferLocation = IndexBufferGPU->GetGPUVirtualAddress() + IndexBufferOffset,
 			.SizeInBytes = IndexBufferByteSize,
 			.Format = IndexFormat,
 		};
@@ -128,8 +153,17 @@ struct MaterialConstants {
 
 	// Used in texture mapping.
 	XMFLOAT4X4 MatTransform = MathHelper::Identity4x4();
+
+	// Finest resident mip of the diffuse map, see TextureStreamer.
+	float DiffuseMinMip = 0.0f;
+	XMFLOAT3 MaterialPad = { 0.0f, 0.0f, 0.0f };
+
+	// Region of the diffuse map sampled, see TextureAtlas.
+	XMFLOAT4 DiffuseAtlasRect = { 0.0f, 0.0f, 1.0f, 1.0f };
 };
 
+struct Texture;
+
 struct Material {
 	// Unique material name for lookup.
 	std::string Name;
@@ -137,12 +171,13 @@ struct Material {
 	// Index into constant buffer corresponding to this material.
 	int MatCBIndex = -1;
 
-	// Index into SRV heap for diffuse texture.
-	int DiffuseSrvHeapIndex = -1;
-
 	// Index into SRV heap for normal texture.
 	int NormalSrvHeapIndex = -1;
 
+	// The diffuse texture, its Srv is bound when drawing. Streamed textures are
+	// followed to their resident mips.
+	Texture* DiffuseMap = nullptr;
+
 	// Dirty flag indicating the material has changed and we need to update the constant buffer.
 	// Because we have a material constant buffer for each FrameResource, we have to apply the
 	// update to each FrameResource.  Thus, when we modify a material we should set 
@@ -154,6 +189,10 @@ struct Material {
 	XMFLOAT3 FresnelR0 = { 0.01f, 0.01f, 0.01f };
 	float Roughness = .25f;
 	XMFLOAT4X4 MatTransform = MathHelper::Identity4x4();
+
+	// Offset (xy) and scale (zw) of the region of DiffuseMap the material samples when
+	// it is an atlas, texture coordinates wrap inside it.
+	XMFLOAT4 DiffuseAtlasRect = { 0.0f, 0.0f, 1.0f, 1.0f };
 };
 
 // The Light struct in hlsl is 16-byte aligned, so the layout of variables matters.
@@ -173,6 +212,16 @@ struct Texture {
 	std::wstring Filename;
 	ComPtr<ID3D12Resource> Resource = nullptr;
 	ComPtr<ID3D12Resource> UploadHeap = nullptr;
+
+	// Finest mip of Resource that holds valid data. Always 0 unless the texture is streamed.
+	UINT MostDetailedMip = 0;
+
+	// SRV of Resource in the persistent region of the app's descriptor heap.
+	DescriptorHandle Srv;
+
+	// Dirty flag indicating Resource has been replaced (streamed textures are resized as
+	// their mips come and go), so Srv has to be replaced too.
+	int NumFramesDirty = gNumFrameResources;
 };
 
 class DxgiInfoManager {
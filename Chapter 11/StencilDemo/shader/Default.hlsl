@@ -70,6 +70,13 @@ cbuffer cbMaterial : register(b2)
     float3 gFresnelR0;
     float gRoughness;
     float4x4 gMatTransform;
+    
+    // Finest mip of gDiffuseMap that is resident, streamed textures lower it over time.
+    float gDiffuseMinMip;
+    float3 cbMaterialPad;
+
+    // Offset and scale of the region of gDiffuseMap sampled, an atlas holds several.
+    float4 gDiffuseAtlasRect;
 };
 
 struct VertexIn
@@ -108,9 +115,23 @@ VertexOut VS(VertexIn vin)
     return vout;
 }
 
+float4 SampleDiffuseMap(float2 texC)
+{
+    // Texture coordinates wrap inside the atlas region. The footprint comes from the
+    // unwrapped coordinates, frac would break the derivatives at the seams.
+    float2 atlasC = texC * gDiffuseAtlasRect.zw;
+    float2 uv = gDiffuseAtlasRect.xy + frac(texC) * gDiffuseAtlasRect.zw;
+
+    // Scaling the gradients moves the footprint down to gDiffuseMinMip without
+    // giving up anisotropic filtering, which SampleLevel would.
+    float lod = gDiffuseMap.CalculateLevelOfDetailUnclamped(gsamAnisotropicWrap, atlasC);
+    float scale = exp2(max(gDiffuseMinMip - lod, 0.f));
+    return gDiffuseMap.SampleGrad(gsamAnisotropicWrap, uv, ddx(atlasC) * scale, ddy(atlasC) * scale);
+}
+
 float4 PS(VertexOut pin) : SV_TARGET
 {
-    float4 diffuseAlbedo = gDiffuseMap.Sample(gsamAnisotropicWrap, pin.TexC) * gDiffuseAlbedo;
+    float4 diffuseAlbedo = SampleDiffuseMap(pin.TexC) * gDiffuseAlbedo;
     
 #ifdef ALPHA_TEST
     // Discard pixel if texture alpha < 0.1.  We do this test as soon 
@@ -0,0 +1,60 @@
+// Sparse virtual texture sampling, the CPU side is framework/VirtualTextureStreamer.h.
+// The page table holds one texel per page and one mip per virtual mip: slot x, slot y
+// and mip of the page resident in that slot, which is the page itself or the closest
+// coarser page loaded.
+
+struct VirtualTexture
+{
+    float2 PageCount;   // pages of mip 0
+    float2 SlotCount;   // pages of the physical texture
+    float PageSize;     // texels, without borders
+    float Border;
+    float MipLevels;
+    float Pad;
+};
+
+// Virtual mip a pixel samples, mipBias is log2 of how much smaller the render target is
+// than the one the derivatives are meant for (the feedback pass runs at low resolution).
+uint VirtualTextureMip(VirtualTexture vt, float2 uv, float mipBias)
+{
+    float2 texels = uv * vt.PageCount * vt.PageSize;
+    float2 dx = ddx(texels);
+    float2 dy = ddy(texels);
+    float lod = 0.5f * log2(max(dot(dx, dx), dot(dy, dy))) - mipBias;
+    return (uint)clamp(floor(lod), 0.0f, vt.MipLevels - 1.0f);
+}
+
+// Value for the feedback target, the same packing as VirtualPage::Pack.
+uint VirtualTextureFeedback(VirtualTexture vt, float2 uv, float mipBias)
+{
+    uint mip = VirtualTextureMip(vt, uv, mipBias);
+    uint2 pageCount = max(uint2(vt.PageCount) >> mip, 1);
+    uint2 page = min(uint2(frac(uv) * pageCount), pageCount - 1);
+    return page.x | (page.y << 12) | (mip << 24);
+}
+
+float4 SampleVirtualTexture(VirtualTexture vt, Texture2D physical, Texture2D<uint4> pageTable,
+                            SamplerState samp, float2 uv)
+{
+    // Derivatives of the unwrapped coordinates, frac would break them at the seams.
+    uint mip = VirtualTextureMip(vt, uv, 0.0f);
+    float2 uvDx = ddx(uv);
+    float2 uvDy = ddy(uv);
+    uv = frac(uv);
+
+    uint2 pageCount = max(uint2(vt.PageCount) >> mip, 1);
+    uint2 page = min(uint2(uv * pageCount), pageCount - 1);
+    uint4 entry = pageTable.Load(int3(page, mip));
+
+    // Position inside the resident page, which may be coarser than the one asked for.
+    float2 residentPages = float2(max(uint2(vt.PageCount) >> entry.z, 1));
+    float2 inPage = frac(uv * residentPages);
+
+    float paddedPageSize = vt.PageSize + 2.0f * vt.Border;
+    float2 physicalSize = vt.SlotCount * paddedPageSize;
+    float2 physicalUV = (entry.xy * paddedPageSize + vt.Border + inPage * vt.PageSize) / physicalSize;
+
+    // The physical texture has a single mip, the gradients only drive anisotropic filtering.
+    float2 scale = residentPages * vt.PageSize / physicalSize;
+    return physical.SampleGrad(samp, physicalUV, uvDx * scale, uvDy * scale);
+}
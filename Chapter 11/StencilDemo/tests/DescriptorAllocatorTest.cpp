@@ -0,0 +1,132 @@
+// Random trace test of the descriptor heap slot allocator (DescriptorAllocator.h).
+// Not part of the project, build it on its own:
+//
+//   cl /std:c++20 /EHsc /O2 DescriptorAllocatorTest.cpp ..\framework\DescriptorAllocator.cpp
+//   g++ -std=c++20 -O2 DescriptorAllocatorTest.cpp ../framework/DescriptorAllocator.cpp
+//
+// Allocates, frees and advances frames at random while tracking the state of every
+// persistent slot: a slot must never be handed out while it is allocated or while the
+// frame that freed it may still be on the GPU, and freed handles must stay invalid.
+// Exits with 1 on the first failure.
+
+#include "../framework/DescriptorAllocator.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#define CHECK(x) do { if (!(x)) { std::printf("FAILED: %s (line %d)\n", #x, __LINE__); std::exit(1); } } while (0)
+
+namespace
+{
+    constexpr uint32_t PersistentCount = 1000;
+    constexpr uint32_t TransientCountPerFrame = 64;
+    constexpr uint32_t FrameCount = 3;
+
+    // What the test knows about one persistent slot. Pending slots remember the fence
+    // they were freed with.
+    struct Slot
+    {
+        bool Allocated = false;
+        bool Pending = false;
+        uint64_t Fence = 0;
+    };
+
+    void RunTrace(uint32_t seed)
+    {
+        DescriptorAllocator allocator(PersistentCount, TransientCountPerFrame, FrameCount);
+        std::mt19937 rng(seed);
+
+        std::vector<Slot> slots(PersistentCount);
+        std::vector<DescriptorHandle> live;
+        std::vector<DescriptorHandle> freed;
+        uint64_t fence = 0;
+        uint64_t completed = 0;
+
+        for (int step = 0; step < 200000; ++step)
+        {
+            const uint32_t op = rng() % 10;
+            if (op < 5)
+            {
+                const uint32_t count = 1 + rng() % 8;
+                const DescriptorHandle handle = allocator.Allocate(count);
+                if (handle.IsNull())
+                {
+                    continue;
+                }
+                CHECK(handle.Count == count);
+                CHECK(handle.Index + count <= PersistentCount);
+                CHECK(allocator.IsValid(handle));
+                for (uint32_t i = handle.Index; i < handle.Index + count; ++i)
+                {
+                    CHECK(!slots[i].Allocated);
+                    CHECK(!slots[i].Pending || slots[i].Fence <= completed);
+                    slots[i] = { true, false, 0 };
+                }
+                live.push_back(handle);
+            }
+            else if (op < 9)
+            {
+                if (live.empty())
+                {
+                    continue;
+                }
+                const size_t i = rng() % live.size();
+                const DescriptorHandle copy = live[i];
+                allocator.Free(live[i], fence + 1);
+                CHECK(live[i].IsNull());
+                CHECK(!allocator.IsValid(copy));
+                for (uint32_t j = copy.Index; j < copy.Index + copy.Count; ++j)
+                {
+                    slots[j] = { false, true, fence + 1 };
+                }
+                freed.push_back(copy);
+                live[i] = live.back();
+                live.pop_back();
+            }
+            else
+            {
+                // The GPU lags up to two frames behind, its fence never goes back.
+                ++fence;
+                completed = (std::max)(completed, fence - (std::min)(fence, (uint64_t)(rng() % 3)));
+                const uint32_t frameIndex = (uint32_t)(fence % FrameCount);
+                allocator.BeginFrame(frameIndex, completed);
+
+                const uint32_t first = allocator.AllocateTransient(10);
+                CHECK(first == PersistentCount + frameIndex * TransientCountPerFrame);
+                CHECK(allocator.AllocateTransient(TransientCountPerFrame - 10) == first + 10);
+                CHECK(allocator.AllocateTransient(1) == UINT32_MAX);
+            }
+
+            if (freed.size() > 64)
+            {
+                freed.erase(freed.begin(), freed.begin() + 32);
+            }
+            for (const DescriptorHandle& handle : freed)
+            {
+                CHECK(!allocator.IsValid(handle));
+            }
+        }
+
+        for (DescriptorHandle& handle : live)
+        {
+            allocator.Free(handle, fence + 1);
+        }
+        allocator.BeginFrame(0, fence + 1);
+        CHECK(allocator.GetPersistentUsed() == 0);
+        CHECK(allocator.GetFreeRangeCount() == 1);
+        CHECK(allocator.Allocate(PersistentCount).Count == PersistentCount);
+    }
+}
+
+int main()
+{
+    for (uint32_t seed = 1; seed <= 3; ++seed)
+    {
+        RunTrace(seed);
+    }
+
+    std::printf("passed\n");
+    return 0;
+}
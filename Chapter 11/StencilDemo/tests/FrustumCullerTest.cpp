@@ -0,0 +1,150 @@
+// Test of the SSE frustum culler (FrustumCuller.h) against a brute force reference.
+// Not part of the project, build it on its own:
+//
+//   cl /std:c++20 /EHsc /O2 FrustumCullerTest.cpp ..\framework\FrustumCuller.cpp
+//   g++ -std=c++20 -O2 FrustumCullerTest.cpp ../framework/FrustumCuller.cpp
+//
+// A few hand placed boxes check the planes, then random boxes check that the culler
+// never drops a box with a point inside the frustum. The reference samples points of
+// each box and clips them, so it only finds false negatives: the culler is conservative
+// and may keep boxes that are just outside. Exits with 1 on the first failure.
+
+#include "../framework/FrustumCuller.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#define CHECK(x) do { if (!(x)) { std::printf("FAILED: %s (line %d)\n", #x, __LINE__); std::exit(1); } } while (0)
+
+namespace
+{
+    constexpr float NearZ = 1.0f;
+    constexpr float FarZ = 1000.0f;
+
+    // Left handed perspective projection with a 90 degree vertical field of view and a
+    // 4:3 aspect ratio, laid out like XMMatrixPerspectiveFovLH. The view is identity.
+    struct Projection
+    {
+        float ScaleX = 0.0f;
+        float ScaleY = 0.0f;
+        float Matrix[4][4] = {};
+
+        Projection()
+        {
+            ScaleY = 1.0f / std::tan(0.25f * 3.14159265f);
+            ScaleX = ScaleY / (4.0f / 3.0f);
+            const float range = FarZ / (FarZ - NearZ);
+            Matrix[0][0] = ScaleX;
+            Matrix[1][1] = ScaleY;
+            Matrix[2][2] = range;
+            Matrix[2][3] = 1.0f;
+            Matrix[3][2] = -NearZ * range;
+        }
+
+        bool Contains(float x, float y, float z) const
+        {
+            const float range = FarZ / (FarZ - NearZ);
+            const float clipX = x * ScaleX;
+            const float clipY = y * ScaleY;
+            const float clipZ = z * range - NearZ * range;
+            const float w = z;
+            return w > 0.0f && std::fabs(clipX) <= w && std::fabs(clipY) <= w && clipZ >= 0.0f && clipZ <= w;
+        }
+    };
+
+    void SetCube(FrustumCuller& culler, uint32_t index, float x, float y, float z, float extent)
+    {
+        const float center[3] = { x, y, z };
+        const float extents[3] = { extent, extent, extent };
+        culler.SetBounds(index, center, extents, center, extent * std::sqrt(3.0f));
+    }
+
+    void TestPlanes(const Projection& projection)
+    {
+        FrustumCuller culler;
+        culler.SetViewProj(projection.Matrix);
+        culler.Resize(7);
+
+        SetCube(culler, 0, 0.0f, 0.0f, 10.0f, 1.0f);        // in front
+        SetCube(culler, 1, 0.0f, 0.0f, -10.0f, 1.0f);       // behind
+        SetCube(culler, 2, 100.0f, 0.0f, 10.0f, 1.0f);      // far to the right
+        SetCube(culler, 3, 0.0f, 0.0f, 0.5f, 1.0f);         // across the near plane
+        SetCube(culler, 4, 0.0f, 0.0f, 2000.0f, 1.0f);      // beyond the far plane
+        SetCube(culler, 5, 0.0f, 0.0f, 1005.0f, 10.0f);     // across the far plane
+        // Item 6 never gets bounds and stays invisible.
+        culler.Cull();
+
+        const bool expected[7] = { true, false, false, true, false, true, false };
+        for (uint32_t i = 0; i < 7; ++i)
+        {
+            CHECK(culler.IsVisible(i) == expected[i]);
+        }
+        CHECK(culler.GetVisibleCount() == 3);
+
+        culler.Resize(3);
+        CHECK(culler.GetCount() == 3);
+    }
+
+    void TestRandomBoxes(const Projection& projection, uint32_t seed)
+    {
+        const uint32_t count = 2000;
+        FrustumCuller culler;
+        culler.SetViewProj(projection.Matrix);
+        culler.Resize(count);
+
+        std::mt19937 rng(seed);
+        std::uniform_real_distribution<float> position(-50.0f, 50.0f);
+        std::uniform_real_distribution<float> extent(0.1f, 5.0f);
+
+        std::vector<float> x(count), y(count), z(count), e(count);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            x[i] = position(rng);
+            y[i] = position(rng);
+            z[i] = position(rng) + 40.0f;
+            e[i] = extent(rng);
+            SetCube(culler, i, x[i], y[i], z[i], e[i]);
+        }
+        culler.Cull();
+
+        uint32_t falseNegatives = 0;
+        uint32_t visible = 0;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            // A 7 x 7 x 5 grid of points over the box, corners included.
+            bool anyInside = false;
+            for (int k = 0; k < 7 * 7 * 5 && !anyInside; ++k)
+            {
+                const float px = x[i] + e[i] * (2.0f * (k % 7) / 6.0f - 1.0f);
+                const float py = y[i] + e[i] * (2.0f * ((k / 7) % 7) / 6.0f - 1.0f);
+                const float pz = z[i] + e[i] * (2.0f * (k / 49) / 4.0f - 1.0f);
+                anyInside = projection.Contains(px, py, pz);
+            }
+
+            if (anyInside && !culler.IsVisible(i))
+            {
+                ++falseNegatives;
+            }
+            visible += culler.IsVisible(i);
+        }
+
+        std::printf("seed %u: %u of %u boxes visible, %u false negatives\n", seed, visible, count, falseNegatives);
+        CHECK(falseNegatives == 0);
+        CHECK(culler.GetVisibleCount() == visible);
+    }
+}
+
+int main()
+{
+    const Projection projection;
+    TestPlanes(projection);
+    for (uint32_t seed = 1; seed <= 3; ++seed)
+    {
+        TestRandomBoxes(projection, seed);
+    }
+
+    std::printf("passed\n");
+    return 0;
+}
@@ -0,0 +1,198 @@
+// Random trace test and benchmark of the heap block suballocators (HeapSuballocator.h).
+// Not part of the project, build it on its own:
+//
+//   cl /std:c++20 /EHsc /O2 HeapSuballocatorTest.cpp ..\framework\HeapSuballocator.cpp
+//   g++ -std=c++20 -O2 HeapSuballocatorTest.cpp ../framework/HeapSuballocator.cpp
+//
+// The traces check every allocation against a shadow map of the live ranges (alignment,
+// bounds, no overlap) and the stats against the shadow, then free everything and expect
+// a single free range again. Exits with 1 on the first failure.
+
+#include "../framework/HeapSuballocator.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <map>
+#include <random>
+#include <vector>
+
+#define CHECK(x) do { if (!(x)) { std::printf("FAILED: %s (line %d)\n", #x, __LINE__); std::exit(1); } } while (0)
+
+namespace
+{
+    struct TraceOptions
+    {
+        uint64_t Capacity = 0;
+        uint64_t Granularity = 0;
+        uint64_t MinSize = 1;
+        uint64_t MaxSize = 1;
+        // 64 KiB alignment, 4 MiB one time in eight, as textures and MSAA textures ask.
+        bool TextureAlignment = false;
+    };
+
+    template<typename Allocator>
+    void RunTrace(const char* name, const TraceOptions& options, uint32_t seed)
+    {
+        Allocator allocator(options.Capacity, options.Granularity);
+        std::mt19937_64 rng(seed);
+
+        std::vector<SuballocatorAllocation> live;
+        std::map<uint64_t, uint64_t> shadow; // offset to size of the live allocations
+        uint64_t failures = 0;
+
+        for (int step = 0; step < 200000; ++step)
+        {
+            if (live.empty() || rng() % 100 < 55)
+            {
+                const uint64_t size = options.MinSize + rng() % (options.MaxSize - options.MinSize + 1);
+                const uint64_t alignment = options.TextureAlignment ?
+                    (rng() % 8 == 0 ? 4ull << 20 : 64ull << 10) : 1ull << (rng() % 17);
+
+                SuballocatorAllocation allocation;
+                if (!allocator.Allocate(size, alignment, allocation))
+                {
+                    ++failures;
+                    continue;
+                }
+                CHECK(allocation.Offset % alignment == 0);
+                CHECK(allocation.Size >= size);
+                CHECK(allocation.Offset + allocation.Size <= allocator.GetCapacity());
+
+                auto next = shadow.lower_bound(allocation.Offset);
+                if (next != shadow.end())
+                {
+                    CHECK(next->first >= allocation.Offset + allocation.Size);
+                }
+                if (next != shadow.begin())
+                {
+                    auto prev = std::prev(next);
+                    CHECK(prev->first + prev->second <= allocation.Offset);
+                }
+                shadow[allocation.Offset] = allocation.Size;
+                live.push_back(allocation);
+            }
+            else
+            {
+                const size_t i = rng() % live.size();
+                allocator.Free(live[i]);
+                shadow.erase(live[i].Offset);
+                live[i] = live.back();
+                live.pop_back();
+            }
+
+            if (step % 1000 == 0)
+            {
+                uint64_t usedBytes = 0;
+                for (const auto& [offset, size] : shadow)
+                {
+                    usedBytes += size;
+                }
+                const SuballocatorStats stats = allocator.GetStats();
+                CHECK(stats.UsedBytes == usedBytes);
+                CHECK(stats.AllocationCount == live.size());
+                CHECK(stats.LargestFreeRange <= stats.Capacity - stats.UsedBytes);
+            }
+        }
+
+        SuballocatorStats stats = allocator.GetStats();
+        std::printf("%-10s seed %u: %zu live, %llu failed, %.1f%% used, fragmentation %.3f external %.3f internal, %llu free ranges\n",
+            name, seed, live.size(), (unsigned long long)failures, 100.0 * stats.UsedBytes / stats.Capacity,
+            stats.ExternalFragmentation(), stats.InternalFragmentation(), (unsigned long long)stats.FreeRangeCount);
+
+        for (const SuballocatorAllocation& allocation : live)
+        {
+            allocator.Free(allocation);
+        }
+        stats = allocator.GetStats();
+        CHECK(allocator.IsEmpty());
+        CHECK(stats.UsedBytes == 0 && stats.RequestedBytes == 0);
+        CHECK(stats.FreeRangeCount == 1 && stats.LargestFreeRange == allocator.GetCapacity());
+    }
+
+    // Average time of an Allocate or Free, with about a thousand allocations alive.
+    template<typename Allocator>
+    void RunBenchmark(const char* name, uint64_t capacity, uint64_t granularity, uint64_t minSize, uint64_t maxSize)
+    {
+        Allocator allocator(capacity, granularity);
+        std::mt19937_64 rng(7);
+
+        // The random numbers are drawn up front, so the timing is the allocator's alone.
+        const size_t count = 1 << 20;
+        std::vector<uint64_t> sizes(count);
+        std::vector<uint32_t> picks(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            sizes[i] = minSize + rng() % (maxSize - minSize + 1);
+            picks[i] = (uint32_t)rng();
+        }
+
+        std::vector<SuballocatorAllocation> live;
+        live.reserve(count);
+        size_t operations = 0;
+
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (live.size() > 2000 || (picks[i] & 1))
+            {
+                if (!live.empty())
+                {
+                    const size_t j = picks[i] % live.size();
+                    allocator.Free(live[j]);
+                    live[j] = live.back();
+                    live.pop_back();
+                    ++operations;
+                }
+            }
+            else
+            {
+                SuballocatorAllocation allocation;
+                if (allocator.Allocate(sizes[i], 256, allocation))
+                {
+                    live.push_back(allocation);
+                }
+                ++operations;
+            }
+        }
+        const auto end = std::chrono::steady_clock::now();
+
+        std::printf("%-10s %.1f ns per operation\n", name,
+            std::chrono::duration<double, std::nano>(end - start).count() / operations);
+    }
+
+    void TestEdgeCases()
+    {
+        SuballocatorAllocation allocation;
+
+        TlsfAllocator empty(0);
+        CHECK(!empty.Allocate(1, 1, allocation));
+
+        // Smaller than one 64 KiB block.
+        BuddyAllocator tooSmall(1000);
+        CHECK(!tooSmall.Allocate(1, 1, allocation));
+
+        TlsfAllocator full(4096, 256);
+        CHECK(full.Allocate(4096, 1, allocation));
+        CHECK(!full.Allocate(1, 1, allocation));
+        full.Free(allocation);
+        CHECK(full.Allocate(4096, 4096, allocation));
+    }
+}
+
+int main()
+{
+    for (uint32_t seed = 1; seed <= 3; ++seed)
+    {
+        RunTrace<TlsfAllocator>("tlsf", { 64ull << 20, 256, 1, 1 << 20 }, seed);
+        RunTrace<TlsfAllocator>("tlsf-odd", { (64ull << 20) + 12345, 256, 1, 4096 }, seed);
+        RunTrace<BuddyAllocator>("buddy", { 256ull << 20, 64 << 10, 1, 8 << 20, true }, seed);
+    }
+    TestEdgeCases();
+
+    RunBenchmark<TlsfAllocator>("tlsf", 1ull << 30, 256, 256, 1 << 20);
+    RunBenchmark<BuddyAllocator>("buddy", 1ull << 30, 64 << 10, 64 << 10, 1 << 20);
+
+    std::printf("passed\n");
+    return 0;
+}